@@ -0,0 +1,311 @@
+#include "fake_interception.h"
+#include "fake_win32.h"
+#include "fixer_core.h"
+#include "fixer_policies.h"
+#include "modifier_key_fixer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// Per-stroke cost of the fixer event loop (headless builds only):
+//
+//   production  ModifierKeyFixer on the fake driver: the shipped
+//               instantiation with all observers, plus the driver shim
+//   static      FixerCore with in-memory input and the production
+//               virtual state and clock, every policy call inlined
+//   dynamic     the same policies reached through virtual interfaces, as
+//               a runtime-swappable design would need
+//
+// static vs dynamic isolates the dispatch cost; production vs static shows
+// what the observers and the driver round trip add.
+
+namespace {
+
+const InterceptionDevice kKeyboard = INTERCEPTION_KEYBOARD(0);
+
+// Typing with Ctrl/Shift chords; no key ever gets stuck
+std::vector<InterceptionKeyStroke> makeStrokes(size_t count) {
+  static const unsigned short kLetters[] = {0x10, 0x11, 0x12, 0x1E,
+                                            0x1F, 0x20, 0x2C, 0x2D};
+  std::vector<InterceptionKeyStroke> strokes;
+  strokes.reserve(count + 4);
+  for (size_t i = 0; strokes.size() < count; ++i) {
+    unsigned short letter = kLetters[i % 8];
+    unsigned short modifier = (i % 3 == 0) ? 0x1D : (i % 3 == 1) ? 0x2A : 0;
+    if (modifier) {
+      strokes.push_back({modifier, INTERCEPTION_KEY_DOWN, 0});
+    }
+    strokes.push_back({letter, INTERCEPTION_KEY_DOWN, 0});
+    strokes.push_back({letter, INTERCEPTION_KEY_UP, 0});
+    if (modifier) {
+      strokes.push_back({modifier, INTERCEPTION_KEY_UP, 0});
+    }
+  }
+  strokes.resize(count);
+  return strokes;
+}
+
+// In-memory input; forwarded strokes reach the fake OS layer
+class ArrayInput {
+public:
+  ArrayInput() : strokes_(nullptr), next_(0) {}
+  void reset(const std::vector<InterceptionKeyStroke> &strokes) {
+    strokes_ = &strokes;
+    next_ = 0;
+  }
+  InterceptionDevice wait(int) {
+    return next_ < strokes_->size() ? kKeyboard : 0;
+  }
+  bool receive(InterceptionDevice, InterceptionKeyStroke &stroke) {
+    stroke = (*strokes_)[next_++];
+    return true;
+  }
+  void send(InterceptionDevice, const InterceptionKeyStroke &stroke) {
+    FakeWin32::applyKeyStroke(stroke);
+  }
+  void inject(InterceptionDevice device, const InterceptionKeyStroke &stroke) {
+    send(device, stroke);
+  }
+
+private:
+  const std::vector<InterceptionKeyStroke> *strokes_;
+  size_t next_;
+};
+
+// Runtime-polymorphic versions of the same policies
+struct InputInterface {
+  virtual ~InputInterface() = default;
+  virtual InterceptionDevice wait(int timeoutMs) = 0;
+  virtual bool receive(InterceptionDevice device,
+                       InterceptionKeyStroke &stroke) = 0;
+  virtual void send(InterceptionDevice device,
+                    const InterceptionKeyStroke &stroke) = 0;
+};
+
+struct VirtualStateInterface {
+  virtual ~VirtualStateInterface() = default;
+  virtual void update() = 0;
+  virtual const VirtualKeyStates &getStates() const = 0;
+};
+
+struct ClockInterface {
+  virtual ~ClockInterface() = default;
+  virtual Clock::TimePoint now() const = 0;
+  virtual void refresh() = 0;
+  virtual void sleepMs(int ms) = 0;
+};
+
+struct SinkInterface {
+  virtual ~SinkInterface() = default;
+  virtual void lap(Stage stage) = 0;
+  virtual void strokeReceived(InterceptionDevice device,
+                              const InterceptionKeyStroke &stroke) = 0;
+  virtual void strokeForwarded(FixStatistics &stats) = 0;
+  virtual void virtualStateUpdated(const ModifierKeyStates &physical,
+                                   const VirtualKeyStates &virtualStates) = 0;
+  virtual void trackerChanged(const TrackerEvent &event,
+                              const KeyState &key) = 0;
+};
+
+class ArrayInputImpl : public InputInterface {
+public:
+  InterceptionDevice wait(int timeoutMs) override {
+    return input.wait(timeoutMs);
+  }
+  bool receive(InterceptionDevice device,
+               InterceptionKeyStroke &stroke) override {
+    return input.receive(device, stroke);
+  }
+  void send(InterceptionDevice device,
+            const InterceptionKeyStroke &stroke) override {
+    input.send(device, stroke);
+  }
+  ArrayInput input;
+};
+
+class DetectorImpl : public VirtualStateInterface {
+public:
+  void update() override { detector.update(); }
+  const VirtualKeyStates &getStates() const override {
+    return detector.getStates();
+  }
+  VirtualKeyDetector detector;
+};
+
+class ClockImpl : public ClockInterface {
+public:
+  Clock::TimePoint now() const override { return clock.now(); }
+  void refresh() override { clock.refresh(); }
+  void sleepMs(int ms) override { clock.sleepMs(ms); }
+  IterationClock clock;
+};
+
+class SinkImpl : public SinkInterface {
+public:
+  void lap(Stage) override {}
+  void strokeReceived(InterceptionDevice,
+                      const InterceptionKeyStroke &) override {}
+  void strokeForwarded(FixStatistics &) override {}
+  void virtualStateUpdated(const ModifierKeyStates &,
+                           const VirtualKeyStates &) override {}
+  void trackerChanged(const TrackerEvent &, const KeyState &) override {}
+};
+
+// Adapters handing FixerCore the interfaces
+struct DynamicInput {
+  InputInterface *impl;
+  InterceptionDevice wait(int timeoutMs) { return impl->wait(timeoutMs); }
+  bool receive(InterceptionDevice device, InterceptionKeyStroke &stroke) {
+    return impl->receive(device, stroke);
+  }
+  void send(InterceptionDevice device, const InterceptionKeyStroke &stroke) {
+    impl->send(device, stroke);
+  }
+  void inject(InterceptionDevice device, const InterceptionKeyStroke &stroke) {
+    impl->send(device, stroke);
+  }
+};
+
+struct DynamicVirtualState {
+  DetectorImpl *impl;
+  void initialize() { impl->detector.initialize(); }
+  void initializeWithConfig(bool ctrl, bool shift, bool alt, bool win,
+                            const std::vector<std::string> &disabledKeys,
+                            const std::vector<CustomKeyConfig> &customKeys) {
+    impl->detector.initializeWithConfig(ctrl, shift, alt, win, disabledKeys,
+                                        customKeys);
+  }
+  void update() { static_cast<VirtualStateInterface *>(impl)->update(); }
+  const VirtualKeyStates &getStates() const {
+    return static_cast<const VirtualStateInterface *>(impl)->getStates();
+  }
+};
+
+struct DynamicClock {
+  ClockInterface *impl;
+  Clock::TimePoint now() const { return impl->now(); }
+  void refresh() { impl->refresh(); }
+  void sleepMs(int ms) { impl->sleepMs(ms); }
+};
+
+struct DynamicSink : NullSink {
+  SinkInterface *impl;
+  struct Iteration {
+    explicit Iteration(DynamicSink &sink) : impl(sink.impl) {}
+    void lap(Stage stage) { impl->lap(stage); }
+    SinkInterface *impl;
+  };
+  void strokeReceived(InterceptionDevice device,
+                      const InterceptionKeyStroke &stroke) {
+    impl->strokeReceived(device, stroke);
+  }
+  void strokeForwarded(FixStatistics &stats) { impl->strokeForwarded(stats); }
+  void virtualStateUpdated(const ModifierKeyStates &physical,
+                           const VirtualKeyStates &virtualStates) {
+    impl->virtualStateUpdated(physical, virtualStates);
+  }
+  void trackerChanged(const TrackerEvent &event, const KeyState &key) {
+    impl->trackerChanged(event, key);
+  }
+};
+
+using StaticCore =
+    FixerCore<ArrayInput, VirtualKeyDetector, IterationClock, NullSink>;
+using DynamicCore =
+    FixerCore<DynamicInput, DynamicVirtualState, DynamicClock, DynamicSink>;
+
+template <typename Run> double nsPerStroke(size_t strokes, Run run) {
+  auto start = std::chrono::steady_clock::now();
+  run();
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count() / strokes;
+}
+
+struct Result {
+  const char *name;
+  std::vector<double> samples;
+};
+
+void printResult(Result &result) {
+  std::sort(result.samples.begin(), result.samples.end());
+  double median = result.samples[result.samples.size() / 2];
+  std::printf("  %-11s median %8.1f ns/stroke   min %8.1f   max %8.1f\n",
+              result.name, median, result.samples.front(),
+              result.samples.back());
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  size_t strokeCount = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+  int repetitions = argc > 2 ? std::atoi(argv[2]) : 15;
+  std::vector<InterceptionKeyStroke> strokes = makeStrokes(strokeCount);
+
+  FakeInterception::reset();
+  FakeInterception::setWaitBlocks(false);
+  FakeInterception::setCaptureSent(false);
+  FakeWin32::reset();
+
+  ModifierKeyFixer production;
+  production.setShowMessages(false);
+  if (!production.initialize()) {
+    std::fprintf(stderr, "ERROR: fake driver context failed\n");
+    return 1;
+  }
+
+  StaticCore staticCore;
+  staticCore.initialize();
+
+  ArrayInputImpl inputImpl;
+  DetectorImpl detectorImpl;
+  ClockImpl clockImpl;
+  SinkImpl sinkImpl;
+  DynamicSink dynamicSink;
+  dynamicSink.impl = &sinkImpl;
+  DynamicCore dynamicCore(DynamicInput{&inputImpl},
+                          DynamicVirtualState{&detectorImpl},
+                          DynamicClock{&clockImpl}, dynamicSink);
+  dynamicCore.initialize();
+
+  Result results[] = {{"production", {}}, {"static", {}}, {"dynamic", {}}};
+
+  std::printf("Fixer event loop, %zu strokes x %d repetitions\n", strokeCount,
+              repetitions);
+  for (int rep = 0; rep < repetitions; ++rep) {
+    results[0].samples.push_back(nsPerStroke(strokeCount, [&]() {
+      FakeInterception::pushKeyStrokes(kKeyboard, strokes);
+      for (size_t i = 0; i < strokeCount; ++i) {
+        production.processEvents(0);
+      }
+    }));
+
+    staticCore.input().reset(strokes);
+    results[1].samples.push_back(nsPerStroke(strokeCount, [&]() {
+      for (size_t i = 0; i < strokeCount; ++i) {
+        staticCore.processEvents(0);
+      }
+    }));
+
+    inputImpl.input.reset(strokes);
+    results[2].samples.push_back(nsPerStroke(strokeCount, [&]() {
+      for (size_t i = 0; i < strokeCount; ++i) {
+        dynamicCore.processEvents(0);
+      }
+    }));
+  }
+
+  for (Result &result : results) {
+    printResult(result);
+  }
+
+  // Every variant must have seen the same input and fixed nothing
+  if (production.getStatistics().getTotalFixes() != 0 ||
+      staticCore.logic().getStatistics().getTotalFixes() != 0 ||
+      dynamicCore.logic().getStatistics().getTotalFixes() != 0) {
+    std::fprintf(stderr, "ERROR: unexpected fixes\n");
+    return 1;
+  }
+  return 0;
+}
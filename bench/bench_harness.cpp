@@ -0,0 +1,253 @@
+#include "bench_harness.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace Bench {
+
+namespace {
+
+double elapsedNs(const Body &body, uint64_t iterations) {
+  auto start = std::chrono::steady_clock::now();
+  body(iterations);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count();
+}
+
+// Smallest iteration count whose sample lasts at least minSampleMs
+uint64_t calibrate(const Body &body, double minSampleMs) {
+  const double targetNs = minSampleMs * 1e6;
+  uint64_t iterations = 1;
+  for (;;) {
+    double ns = elapsedNs(body, iterations);
+    if (ns >= targetNs || iterations >= (uint64_t(1) << 40)) {
+      return iterations;
+    }
+    // Overshoot slightly so the next try usually suffices
+    double grow = ns > 0 ? targetNs / ns * 1.2 : 100.0;
+    grow = std::min(100.0, std::max(2.0, grow));
+    iterations = static_cast<uint64_t>(std::ceil(iterations * grow));
+  }
+}
+
+double medianOfSorted(const std::vector<double> &sorted) {
+  size_t n = sorted.size();
+  return n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+}
+
+std::string escape(const std::string &text) {
+  std::string out;
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+    }
+    out += c;
+  }
+  return out;
+}
+
+// Value of "key": <number> inside one JSON object
+double findNumber(const std::string &object, const char *key) {
+  std::string quoted = std::string("\"") + key + "\"";
+  size_t pos = object.find(quoted);
+  if (pos == std::string::npos) {
+    return 0;
+  }
+  pos = object.find(':', pos + quoted.size());
+  if (pos == std::string::npos) {
+    return 0;
+  }
+  return std::strtod(object.c_str() + pos + 1, nullptr);
+}
+
+// Value of "key": "<string>" inside one JSON object
+std::string findString(const std::string &object, const char *key) {
+  std::string quoted = std::string("\"") + key + "\"";
+  size_t pos = object.find(quoted);
+  if (pos == std::string::npos) {
+    return std::string();
+  }
+  pos = object.find('"', object.find(':', pos + quoted.size()));
+  std::string value;
+  for (size_t i = pos + 1; pos != std::string::npos && i < object.size();
+       ++i) {
+    if (object[i] == '\\' && i + 1 < object.size()) {
+      value += object[++i];
+    } else if (object[i] == '"') {
+      break;
+    } else {
+      value += object[i];
+    }
+  }
+  return value;
+}
+
+} // namespace
+
+Result run(const Benchmark &benchmark, const Options &options) {
+  uint64_t iterations = calibrate(benchmark.body, options.minSampleMs);
+  int repetitions = std::max(1, options.repetitions);
+
+  for (int i = 0; i < options.warmupSamples; ++i) {
+    elapsedNs(benchmark.body, iterations);
+  }
+
+  std::vector<double> samples;
+  samples.reserve(repetitions);
+  for (int i = 0; i < repetitions; ++i) {
+    samples.push_back(elapsedNs(benchmark.body, iterations) / iterations);
+  }
+  return summarize(benchmark.name, samples, iterations);
+}
+
+Result summarize(const std::string &name, std::vector<double> samples,
+                 uint64_t iterations) {
+  Result result;
+  result.name = name;
+  result.iterations = iterations;
+  result.repetitions = static_cast<int>(samples.size());
+  if (samples.empty()) {
+    return result;
+  }
+  std::sort(samples.begin(), samples.end());
+
+  size_t n = samples.size();
+  double sum = 0;
+  for (double s : samples) {
+    sum += s;
+  }
+  result.meanNs = sum / n;
+  double squares = 0;
+  for (double s : samples) {
+    squares += (s - result.meanNs) * (s - result.meanNs);
+  }
+  result.stddevNs = n > 1 ? std::sqrt(squares / (n - 1)) : 0;
+  result.medianNs = medianOfSorted(samples);
+  result.minNs = samples.front();
+  result.maxNs = samples.back();
+
+  std::vector<double> deviations;
+  deviations.reserve(n);
+  for (double s : samples) {
+    deviations.push_back(std::fabs(s - result.medianNs));
+  }
+  std::sort(deviations.begin(), deviations.end());
+  result.madNs = medianOfSorted(deviations);
+
+  // Order statistics bracketing the median with 95% confidence (binomial,
+  // normal approximation); no assumption about the sample distribution
+  double halfWidth = 1.96 * std::sqrt(static_cast<double>(n)) / 2;
+  double low = std::floor(n / 2.0 - halfWidth);
+  double high = std::ceil(n / 2.0 + halfWidth);
+  size_t lowIndex = low < 1 ? 0 : static_cast<size_t>(low) - 1;
+  size_t highIndex = std::min(n - 1, static_cast<size_t>(high));
+  result.ciLowNs = samples[lowIndex];
+  result.ciHighNs = samples[highIndex];
+
+  return result;
+}
+
+std::string toJson(const std::vector<Result> &results, const Options &options) {
+  std::ostringstream out;
+  char buffer[512];
+  out << "{\n  \"version\": 1,\n";
+  std::snprintf(buffer, sizeof(buffer),
+                "  \"options\": {\"repetitions\": %d, \"warmup_samples\": %d, "
+                "\"min_sample_ms\": %.1f},\n",
+                options.repetitions, options.warmupSamples,
+                options.minSampleMs);
+  out << buffer << "  \"benchmarks\": [\n";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result &r = results[i];
+    std::snprintf(
+        buffer, sizeof(buffer),
+        "\"iterations\": %llu, \"repetitions\": %d, \"median_ns\": %.3f, "
+        "\"mean_ns\": %.3f, \"stddev_ns\": %.3f, \"mad_ns\": %.3f, "
+        "\"min_ns\": %.3f, \"max_ns\": %.3f, \"ci_low_ns\": %.3f, "
+        "\"ci_high_ns\": %.3f",
+        static_cast<unsigned long long>(r.iterations), r.repetitions,
+        r.medianNs, r.meanNs, r.stddevNs, r.madNs, r.minNs, r.maxNs,
+        r.ciLowNs, r.ciHighNs);
+    out << "    {\"name\": \"" << escape(r.name) << "\", " << buffer << "}"
+        << (i + 1 < results.size() ? ",\n" : "\n");
+  }
+  out << "  ]\n}\n";
+  return out.str();
+}
+
+bool loadJson(const std::string &path, std::vector<Result> &results) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  std::stringstream content;
+  content << file.rdbuf();
+  std::string text = content.str();
+
+  size_t pos = text.find("\"benchmarks\"");
+  if (pos == std::string::npos) {
+    return false;
+  }
+
+  // Result objects are flat: each runs from '{' to the next '}'
+  results.clear();
+  while ((pos = text.find('{', pos)) != std::string::npos) {
+    size_t end = text.find('}', pos);
+    if (end == std::string::npos) {
+      break;
+    }
+    std::string object = text.substr(pos, end - pos + 1);
+    pos = end + 1;
+
+    Result r;
+    r.name = findString(object, "name");
+    if (r.name.empty()) {
+      continue;
+    }
+    r.iterations = static_cast<uint64_t>(findNumber(object, "iterations"));
+    r.repetitions = static_cast<int>(findNumber(object, "repetitions"));
+    r.medianNs = findNumber(object, "median_ns");
+    r.meanNs = findNumber(object, "mean_ns");
+    r.stddevNs = findNumber(object, "stddev_ns");
+    r.madNs = findNumber(object, "mad_ns");
+    r.minNs = findNumber(object, "min_ns");
+    r.maxNs = findNumber(object, "max_ns");
+    r.ciLowNs = findNumber(object, "ci_low_ns");
+    r.ciHighNs = findNumber(object, "ci_high_ns");
+    results.push_back(r);
+  }
+  return !results.empty();
+}
+
+std::vector<Comparison> compare(const std::vector<Result> &baseline,
+                                const std::vector<Result> &current,
+                                double tolerance) {
+  std::vector<Comparison> comparisons;
+  for (const Result &now : current) {
+    Comparison c;
+    c.name = now.name;
+    c.currentNs = now.medianNs;
+
+    auto it = std::find_if(
+        baseline.begin(), baseline.end(),
+        [&now](const Result &base) { return base.name == now.name; });
+    if (it == baseline.end() || it->medianNs <= 0) {
+      c.inBaseline = false;
+      comparisons.push_back(c);
+      continue;
+    }
+
+    c.baselineNs = it->medianNs;
+    c.change = (now.medianNs - it->medianNs) / it->medianNs;
+    c.regression = c.change > tolerance && now.ciLowNs > it->ciHighNs;
+    c.improvement = c.change < -tolerance && now.ciHighNs < it->ciLowNs;
+    comparisons.push_back(c);
+  }
+  return comparisons;
+}
+
+} // namespace Bench
@@ -0,0 +1,92 @@
+#ifndef BENCH_HARNESS_H
+#define BENCH_HARNESS_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+// Minimal microbenchmark harness: calibrated repetitions, robust statistics,
+// JSON results and comparison against a stored baseline.
+namespace Bench {
+
+// Keep a value (and the work that produced it) from being optimised away
+template <class T> inline void doNotOptimize(const T &value) {
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : "r,m"(value) : "memory");
+#else
+  const volatile char *sink = reinterpret_cast<const volatile char *>(&value);
+  (void)*sink;
+  _ReadWriteBarrier();
+#endif
+}
+
+// Body of a benchmark: perform the measured operation `iterations` times
+using Body = std::function<void(uint64_t iterations)>;
+
+struct Benchmark {
+  std::string name; // "group/operation/parameters"
+  Body body;
+};
+
+struct Options {
+  int repetitions = 25;    // Timed samples per benchmark
+  int warmupSamples = 3;   // Untimed samples before the first timed one
+  double minSampleMs = 10; // Iterations per sample are chosen to last this long
+};
+
+struct Result {
+  std::string name;
+  uint64_t iterations = 0; // Per sample
+  int repetitions = 0;
+  // Nanoseconds per iteration across the samples
+  double medianNs = 0;
+  double meanNs = 0;
+  double stddevNs = 0;
+  double madNs = 0; // Median absolute deviation
+  double minNs = 0;
+  double maxNs = 0;
+  // Distribution-free 95% confidence interval of the median
+  double ciLowNs = 0;
+  double ciHighNs = 0;
+};
+
+// Calibrate, warm up, then take options.repetitions timed samples
+Result run(const Benchmark &benchmark, const Options &options);
+
+// Statistics of externally timed samples (nanoseconds per iteration), for
+// operations that cannot be repeated in a loop, such as a whole startup
+Result summarize(const std::string &name, std::vector<double> samples,
+                 uint64_t iterations = 1);
+
+// Serialise results (with the options used) as a JSON document
+std::string toJson(const std::vector<Result> &results, const Options &options);
+
+// Read a document written by toJson(); false if the file is unreadable or
+// holds no results
+bool loadJson(const std::string &path, std::vector<Result> &results);
+
+// One benchmark compared with its baseline. A change counts only if the
+// median moved by more than the tolerance and the two confidence intervals
+// do not overlap, so noisy benchmarks do not flap.
+struct Comparison {
+  std::string name;
+  double baselineNs = 0;
+  double currentNs = 0;
+  double change = 0; // Relative change of the median (+0.10 = 10% slower)
+  bool regression = false;
+  bool improvement = false;
+  bool inBaseline = true;
+};
+
+std::vector<Comparison> compare(const std::vector<Result> &baseline,
+                                const std::vector<Result> &current,
+                                double tolerance);
+
+} // namespace Bench
+
+#endif // BENCH_HARNESS_H
@@ -0,0 +1,387 @@
+#include "bench_harness.h"
+#include "config.h"
+#include "fix_logic.h"
+#include "physical_key_detector.h"
+#include "virtual_key_detector.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Microbenchmarks for the code every keystroke (or every poll) runs through,
+// plus configuration loading. Results are printed as a table and can be
+// written as JSON and compared with a stored baseline:
+//
+//   bench_hot_paths --json results.json
+//   bench_hot_paths --baseline bench/baseline.json
+//
+// The exit code is 1 if any benchmark regressed beyond the tolerance.
+
+namespace {
+
+const char *const kDefaultIds[] = {"lctrl",  "rctrl", "lshift", "rshift",
+                                   "lalt",   "ralt",  "lwin",   "rwin"};
+
+// Custom keys on F1.. and the keypad; mapping sources reuse the same scan
+// codes with E0 so both sets stay distinct
+std::vector<CustomKeyConfig> makeCustomKeys(int count) {
+  std::vector<CustomKeyConfig> keys;
+  for (int i = 0; i < count; ++i) {
+    keys.emplace_back(static_cast<unsigned short>(0x3B + i), false,
+                      "Custom" + std::to_string(i), 0x70 + i);
+  }
+  return keys;
+}
+
+std::vector<KeyMappingConfig> makeMappings(int count) {
+  std::vector<KeyMappingConfig> mappings;
+  for (int i = 0; i < count; ++i) {
+    mappings.emplace_back(static_cast<unsigned short>(0x3B + i), true,
+                          kDefaultIds[i % 8], "additional",
+                          "Mapping " + std::to_string(i));
+  }
+  return mappings;
+}
+
+// Typing with modifier chords, custom keys and mapped keys, down/up paired
+std::vector<InterceptionKeyStroke> makeStrokes(int extraKeys) {
+  static const unsigned short kLetters[] = {0x10, 0x11, 0x12, 0x1E,
+                                            0x1F, 0x20, 0x2C, 0x2D};
+  std::vector<InterceptionKeyStroke> strokes;
+  auto press = [&strokes](unsigned short code, unsigned short e0) {
+    strokes.push_back({code, static_cast<unsigned short>(
+                                 INTERCEPTION_KEY_DOWN | e0), 0});
+    strokes.push_back({code, static_cast<unsigned short>(
+                                 INTERCEPTION_KEY_UP | e0), 0});
+  };
+  for (int i = 0; i < 64; ++i) {
+    press(kLetters[i % 8], 0);
+    if (i % 4 == 0) {
+      press(0x1D, 0); // Left Ctrl
+    }
+    if (i % 4 == 1) {
+      press(0x38, INTERCEPTION_KEY_E0); // Right Alt
+    }
+    if (extraKeys > 0 && i % 4 == 2) {
+      press(static_cast<unsigned short>(0x3B + i % extraKeys), 0);
+    }
+    if (extraKeys > 0 && i % 4 == 3) {
+      press(static_cast<unsigned short>(0x3B + i % extraKeys),
+            INTERCEPTION_KEY_E0);
+    }
+  }
+  return strokes;
+}
+
+Bench::Benchmark processKeyStroke(int customKeys, int mappings) {
+  std::string name = "physical/processKeyStroke/custom=" +
+                     std::to_string(customKeys) +
+                     "/mappings=" + std::to_string(mappings);
+  auto detector = std::make_shared<PhysicalKeyDetector>();
+  detector->initializeWithConfig(true, true, true, true, {},
+                                 makeCustomKeys(customKeys),
+                                 makeMappings(mappings));
+  auto strokes = std::make_shared<std::vector<InterceptionKeyStroke>>(
+      makeStrokes(std::max(customKeys, mappings)));
+  return {name, [detector, strokes](uint64_t iterations) {
+            size_t next = 0;
+            for (uint64_t i = 0; i < iterations; ++i) {
+              detector->processKeyStroke((*strokes)[next]);
+              next = next + 1 == strokes->size() ? 0 : next + 1;
+            }
+            Bench::doNotOptimize(detector->getStates().pressedMask());
+          }};
+}
+
+VirtualKeyStates makeVirtualStates(int customKeys) {
+  VirtualKeyStates states;
+  states.initializeWithConfig(true, true, true, true, {},
+                              makeCustomKeys(customKeys));
+  return states;
+}
+
+ModifierKeyStates makePhysicalStates(int customKeys) {
+  ModifierKeyStates states;
+  states.initializeWithConfig(true, true, true, true, {},
+                              makeCustomKeys(customKeys));
+  return states;
+}
+
+// Look up the first key, the last key or a missing one
+Bench::Benchmark findKeyById(int customKeys, const char *which) {
+  std::string name = "virtual/findKeyById/keys=" +
+                     std::to_string(8 + customKeys) + "/" + which;
+  auto states =
+      std::make_shared<VirtualKeyStates>(makeVirtualStates(customKeys));
+  std::string id = std::strcmp(which, "first") == 0
+                       ? states->getKeys().front().id
+                   : std::strcmp(which, "last") == 0
+                       ? states->getKeys().back().id
+                       : std::string("missing");
+  return {name, [states, id](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+              Bench::doNotOptimize(states->findKeyById(id));
+            }
+          }};
+}
+
+std::vector<std::string> keyIds(const ModifierKeyStates &states) {
+  std::vector<std::string> ids;
+  for (const auto &key : states.getKeys()) {
+    ids.push_back(key.id);
+  }
+  return ids;
+}
+
+// No key stuck: the whole tracker set is scanned
+Bench::Benchmark hasAnyStuck(int customKeys) {
+  std::string name =
+      "trackers/hasAnyStuck/keys=" + std::to_string(8 + customKeys);
+  auto trackers = std::make_shared<ModifierMismatchTrackers>();
+  trackers->initializeForKeys(keyIds(makePhysicalStates(customKeys)));
+  return {name, [trackers](uint64_t iterations) {
+            MismatchTracker::TimePoint now = std::chrono::steady_clock::now();
+            for (uint64_t i = 0; i < iterations; ++i) {
+              Bench::doNotOptimize(trackers->hasAnyStuck(500, now));
+            }
+          }};
+}
+
+// Per-iteration tracker update (the fixer's former updateMismatchTrackers);
+// "mismatch" keeps one key physically released but virtually pressed
+struct TrackerFixture {
+  ModifierKeyStates physical;
+  VirtualKeyStates virtualStates;
+  FixLogic logic;
+  std::vector<TrackerEvent> events;
+};
+
+Bench::Benchmark updateTrackers(int customKeys, bool mismatch) {
+  std::string name = "logic/updateTrackers/keys=" +
+                     std::to_string(8 + customKeys) +
+                     (mismatch ? "/mismatch" : "/idle");
+  auto fixture = std::make_shared<TrackerFixture>();
+  fixture->physical = makePhysicalStates(customKeys);
+  fixture->virtualStates = makeVirtualStates(customKeys);
+  if (mismatch) {
+    fixture->virtualStates.getKeys().back().pressed = true;
+  }
+  fixture->logic.initialize(fixture->physical, fixture->virtualStates);
+  fixture->events.reserve(3 * fixture->logic.getKeyCount());
+  return {name, [fixture](uint64_t iterations) {
+            TrackerFixture &f = *fixture;
+            FixLogic::TimePoint now = std::chrono::steady_clock::now();
+            for (uint64_t i = 0; i < iterations; ++i) {
+              f.events.clear();
+              f.logic.updateTrackers(f.physical, f.virtualStates, now,
+                                     &f.events);
+            }
+            Bench::doNotOptimize(f.logic.hasAnyMismatch());
+          }};
+}
+
+// Equal states: every key is compared
+Bench::Benchmark statesNotEqual(int customKeys) {
+  std::string name =
+      "states/operator!=/keys=" + std::to_string(8 + customKeys);
+  auto a = std::make_shared<ModifierKeyStates>(makePhysicalStates(customKeys));
+  auto b = std::make_shared<ModifierKeyStates>(*a);
+  return {name, [a, b](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+              Bench::doNotOptimize(*a != *b);
+            }
+          }};
+}
+
+// Assignment into an existing snapshot (buffers already allocated)
+Bench::Benchmark statesCopy(int customKeys) {
+  std::string name = "states/copy/keys=" + std::to_string(8 + customKeys);
+  auto source =
+      std::make_shared<ModifierKeyStates>(makePhysicalStates(customKeys));
+  auto copy = std::make_shared<ModifierKeyStates>(*source);
+  return {name, [source, copy](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+              *copy = *source;
+              Bench::doNotOptimize(*copy);
+            }
+          }};
+}
+
+std::string tempPath(const char *fileName) {
+  return (std::filesystem::temp_directory_path() / fileName).string();
+}
+
+// A default configuration, or one with many custom keys and mappings
+std::string writeConfig(const char *fileName, int customKeys, int mappings) {
+  Config config;
+  config.loadDefaults();
+  config.setCustomKeys(makeCustomKeys(customKeys));
+  config.setKeyMappings(makeMappings(mappings));
+  std::string path = tempPath(fileName);
+  if (!config.save(path)) {
+    std::fprintf(stderr, "ERROR: cannot write %s\n", path.c_str());
+    std::exit(2);
+  }
+  return path;
+}
+
+Bench::Benchmark configLoad(const char *size, const std::string &path) {
+  return {std::string("config/load/") + size, [path](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+              Config config;
+              Bench::doNotOptimize(config.load(path));
+            }
+          }};
+}
+
+void printUsage(const char *program) {
+  std::printf(
+      "Usage: %s [options]\n"
+      "  --list              List benchmark names and exit\n"
+      "  --filter <text>     Run only benchmarks whose name contains text\n"
+      "  --repetitions <n>   Timed samples per benchmark (default 25)\n"
+      "  --min-time <ms>     Minimum duration of one sample (default 10)\n"
+      "  --json <file>       Write results as JSON (- for stdout)\n"
+      "  --baseline <file>   Compare with results written by --json\n"
+      "  --tolerance <pct>   Slowdown tolerated before failing (default 10)\n",
+      program);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Bench::Options options;
+  std::string filter;
+  std::string jsonPath;
+  std::string baselinePath;
+  double tolerancePct = 10;
+  bool listOnly = false;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--list") {
+      listOnly = true;
+    } else if (arg == "--filter" && hasValue) {
+      filter = argv[++i];
+    } else if (arg == "--repetitions" && hasValue) {
+      options.repetitions = std::atoi(argv[++i]);
+    } else if (arg == "--min-time" && hasValue) {
+      options.minSampleMs = std::atof(argv[++i]);
+    } else if (arg == "--json" && hasValue) {
+      jsonPath = argv[++i];
+    } else if (arg == "--baseline" && hasValue) {
+      baselinePath = argv[++i];
+    } else if (arg == "--tolerance" && hasValue) {
+      tolerancePct = std::atof(argv[++i]);
+    } else {
+      printUsage(argv[0]);
+      return arg == "--help" ? 0 : 2;
+    }
+  }
+
+  std::vector<Bench::Result> baseline;
+  if (!baselinePath.empty() && !Bench::loadJson(baselinePath, baseline)) {
+    std::fprintf(stderr, "ERROR: cannot read baseline %s\n",
+                 baselinePath.c_str());
+    return 2;
+  }
+
+  std::string smallConfig = writeConfig("escModKey_bench_small.toml", 0, 0);
+  std::string largeConfig = writeConfig("escModKey_bench_large.toml", 64, 256);
+
+  std::vector<Bench::Benchmark> benchmarks = {
+      processKeyStroke(0, 0),
+      processKeyStroke(8, 0),
+      processKeyStroke(0, 8),
+      processKeyStroke(8, 8),
+      processKeyStroke(32, 32),
+      findKeyById(0, "first"),
+      findKeyById(0, "last"),
+      findKeyById(0, "missing"),
+      findKeyById(32, "last"),
+      hasAnyStuck(0),
+      hasAnyStuck(32),
+      updateTrackers(0, false),
+      updateTrackers(0, true),
+      updateTrackers(32, false),
+      statesNotEqual(0),
+      statesNotEqual(32),
+      statesCopy(0),
+      statesCopy(32),
+      configLoad("small", smallConfig),
+      configLoad("large", largeConfig),
+  };
+
+  // With JSON on stdout the table goes to stderr
+  FILE *table = jsonPath == "-" ? stderr : stdout;
+  std::vector<Bench::Result> results;
+  for (const auto &benchmark : benchmarks) {
+    if (benchmark.name.find(filter) == std::string::npos) {
+      continue;
+    }
+    if (listOnly) {
+      std::printf("%s\n", benchmark.name.c_str());
+      continue;
+    }
+    Bench::Result r = Bench::run(benchmark, options);
+    std::fprintf(table, "%-48s %11.1f ns  (+-%.1f, 95%% CI %.1f..%.1f)\n",
+                 r.name.c_str(), r.medianNs, r.madNs, r.ciLowNs, r.ciHighNs);
+    std::fflush(table);
+    results.push_back(r);
+  }
+
+  std::remove(smallConfig.c_str());
+  std::remove(largeConfig.c_str());
+  if (listOnly) {
+    return 0;
+  }
+
+  if (!jsonPath.empty()) {
+    std::string json = Bench::toJson(results, options);
+    if (jsonPath == "-") {
+      std::fputs(json.c_str(), stdout);
+    } else {
+      std::ofstream out(jsonPath, std::ios::binary);
+      out << json;
+      if (!out) {
+        std::fprintf(stderr, "ERROR: cannot write %s\n", jsonPath.c_str());
+        return 2;
+      }
+    }
+  }
+
+  if (baselinePath.empty()) {
+    return 0;
+  }
+
+  int regressions = 0;
+  std::fprintf(table, "\nCompared with %s (tolerance %.0f%%):\n",
+               baselinePath.c_str(), tolerancePct);
+  for (const auto &c :
+       Bench::compare(baseline, results, tolerancePct / 100.0)) {
+    if (!c.inBaseline) {
+      std::fprintf(table, "  %-46s   new\n", c.name.c_str());
+      continue;
+    }
+    const char *verdict = c.regression    ? "REGRESSION"
+                          : c.improvement ? "faster"
+                                          : "ok";
+    std::fprintf(table, "  %-46s %+7.1f%%  %s\n", c.name.c_str(),
+                 c.change * 100.0, verdict);
+    if (c.regression) {
+      regressions++;
+    }
+  }
+  if (regressions > 0) {
+    std::fprintf(table, "%d benchmark(s) regressed\n", regressions);
+    return 1;
+  }
+  return 0;
+}
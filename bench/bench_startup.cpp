@@ -0,0 +1,213 @@
+#include "bench_harness.h"
+#include "config.h"
+#include "fake_interception.h"
+#include "fake_win32.h"
+#include "modifier_key_fixer.h"
+#include "startup_timer.h"
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+// Time-to-interception of the GUI startup sequence (headless builds only).
+//
+// Replays what WinMain does up to the point where typing works again, on
+// the fake driver, in both orders:
+//
+//   serial  config path, load, default-config write, initialize, worker
+//           start, first event wait
+//   fast    the same, with the default-config write deferred until after
+//           the first event wait (config fastStart = true)
+//
+// Window class registration, the tray icon and the notification cannot run
+// headless; in fast mode they come after interception is live anyway. Each
+// phase and the time to interception are reported as "startup/<mode>/..."
+// results so they can be stored and compared like bench_hot_paths.
+
+namespace {
+
+// One startup; phase name -> nanoseconds, including "time_to_interception"
+std::map<std::string, double> startOnce(bool fast,
+                                        const std::string &configPath) {
+  FakeInterception::reset();
+  FakeWin32::reset();
+
+  StartupTimer startup;
+  Config::getDefaultConfigPath();
+  startup.mark("configPath");
+
+  Config config;
+  bool saveDefaultConfig = false;
+  if (!config.load(configPath)) {
+    config.loadDefaults();
+    saveDefaultConfig = true;
+  }
+  config.setShowMessages(false);
+  config.setStageTimingLogIntervalMs(0);
+  startup.mark("configLoad");
+
+  if (saveDefaultConfig && !fast) {
+    config.save(configPath);
+    saveDefaultConfig = false;
+    startup.mark("configSave");
+  }
+
+  ModifierKeyFixer fixer;
+  fixer.setShowMessages(false);
+  if (!fixer.initialize(config)) {
+    std::fprintf(stderr, "ERROR: cannot create driver context\n");
+    std::exit(2);
+  }
+  startup.mark("initialize");
+  startup.markInterceptionLive("workerStart");
+  fixer.processEvents(0);
+  startup.mark("firstWait");
+
+  if (saveDefaultConfig) {
+    config.save(configPath);
+    startup.mark("configSave");
+  }
+
+  std::map<std::string, double> phases;
+  for (const StartupTimer::Phase &phase : startup.getPhases()) {
+    phases[phase.name] = static_cast<double>(phase.durationNs);
+  }
+  phases["time_to_interception"] =
+      static_cast<double>(startup.getTimeToInterceptionNs());
+  return phases;
+}
+
+void printUsage(const char *program) {
+  std::printf(
+      "Usage: %s [options]\n"
+      "  --repetitions <n>   Startups per mode (default 50)\n"
+      "  --missing-config    Start without a config file, so the default\n"
+      "                      config is written (first logon)\n"
+      "  --json <file>       Write results as JSON (- for stdout)\n"
+      "  --baseline <file>   Compare with results written by --json\n"
+      "  --tolerance <pct>   Slowdown tolerated before failing (default 10)\n",
+      program);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Bench::Options options;
+  options.repetitions = 50;
+  options.warmupSamples = 3;
+  options.minSampleMs = 0;
+  bool missingConfig = false;
+  std::string jsonPath;
+  std::string baselinePath;
+  double tolerancePct = 10;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--repetitions" && hasValue) {
+      options.repetitions = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--missing-config") {
+      missingConfig = true;
+    } else if (arg == "--json" && hasValue) {
+      jsonPath = argv[++i];
+    } else if (arg == "--baseline" && hasValue) {
+      baselinePath = argv[++i];
+    } else if (arg == "--tolerance" && hasValue) {
+      tolerancePct = std::atof(argv[++i]);
+    } else {
+      printUsage(argv[0]);
+      return arg == "--help" ? 0 : 2;
+    }
+  }
+
+  std::vector<Bench::Result> baseline;
+  if (!baselinePath.empty() && !Bench::loadJson(baselinePath, baseline)) {
+    std::fprintf(stderr, "ERROR: cannot read baseline %s\n",
+                 baselinePath.c_str());
+    return 2;
+  }
+
+  std::string configPath =
+      (std::filesystem::temp_directory_path() / "escModKey_bench_startup.toml")
+          .string();
+  Config defaults;
+  defaults.loadDefaults();
+
+  // With JSON on stdout the table goes to stderr
+  FILE *table = jsonPath == "-" ? stderr : stdout;
+  std::vector<Bench::Result> results;
+  const bool modes[] = {false, true};
+  for (bool fast : modes) {
+    const char *mode = fast ? "fast" : "serial";
+    std::map<std::string, std::vector<double>> samples;
+    for (int i = -options.warmupSamples; i < options.repetitions; ++i) {
+      if (missingConfig) {
+        std::remove(configPath.c_str());
+      } else if (!defaults.save(configPath)) {
+        std::fprintf(stderr, "ERROR: cannot write %s\n", configPath.c_str());
+        return 2;
+      }
+      std::map<std::string, double> phases = startOnce(fast, configPath);
+      if (i < 0) {
+        continue;
+      }
+      for (const auto &phase : phases) {
+        samples[phase.first].push_back(phase.second);
+      }
+    }
+    for (const auto &phase : samples) {
+      Bench::Result r = Bench::summarize(
+          std::string("startup/") + mode + "/" + phase.first, phase.second);
+      std::fprintf(table, "%-48s %11.1f us  (+-%.1f, 95%% CI %.1f..%.1f)\n",
+                   r.name.c_str(), r.medianNs / 1000, r.madNs / 1000,
+                   r.ciLowNs / 1000, r.ciHighNs / 1000);
+      results.push_back(r);
+    }
+  }
+  std::remove(configPath.c_str());
+
+  if (!jsonPath.empty()) {
+    std::string json = Bench::toJson(results, options);
+    if (jsonPath == "-") {
+      std::fputs(json.c_str(), stdout);
+    } else {
+      std::ofstream out(jsonPath, std::ios::binary);
+      out << json;
+      if (!out) {
+        std::fprintf(stderr, "ERROR: cannot write %s\n", jsonPath.c_str());
+        return 2;
+      }
+    }
+  }
+
+  if (baselinePath.empty()) {
+    return 0;
+  }
+
+  int regressions = 0;
+  std::fprintf(table, "\nCompared with %s (tolerance %.0f%%):\n",
+               baselinePath.c_str(), tolerancePct);
+  for (const auto &c :
+       Bench::compare(baseline, results, tolerancePct / 100.0)) {
+    if (!c.inBaseline) {
+      std::fprintf(table, "  %-46s   new\n", c.name.c_str());
+      continue;
+    }
+    const char *verdict = c.regression    ? "REGRESSION"
+                          : c.improvement ? "faster"
+                                          : "ok";
+    std::fprintf(table, "  %-46s %+7.1f%%  %s\n", c.name.c_str(),
+                 c.change * 100.0, verdict);
+    if (c.regression) {
+      regressions++;
+    }
+  }
+  if (regressions > 0) {
+    std::fprintf(table, "%d startup phase(s) regressed\n", regressions);
+    return 1;
+  }
+  return 0;
+}
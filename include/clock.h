@@ -0,0 +1,72 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <chrono>
+
+// Time source for mismatch tracking and fix decisions.
+// The fixer reads its clock once per processEvents() iteration through a
+// CachedClock; tests drive a ManualClock instead of sleeping.
+class Clock {
+public:
+  using TimePoint = std::chrono::steady_clock::time_point;
+
+  virtual ~Clock() = default;
+  virtual TimePoint now() const = 0;
+};
+
+// std::chrono::steady_clock
+class SteadyClock : public Clock {
+public:
+  TimePoint now() const override { return std::chrono::steady_clock::now(); }
+
+  // Shared instance used when no clock is injected
+  static const SteadyClock &instance() {
+    static const SteadyClock clock;
+    return clock;
+  }
+};
+
+// Holds one reading of a source clock until refresh() is called, so every
+// time query within one iteration sees the same instant and costs nothing
+class CachedClock : public Clock {
+public:
+  explicit CachedClock(const Clock &source = SteadyClock::instance())
+      : source_(&source), cached_(source.now()) {}
+
+  void setSource(const Clock &source) {
+    source_ = &source;
+    refresh();
+  }
+
+  // Take a new reading from the source
+  TimePoint refresh() {
+    cached_ = source_->now();
+    return cached_;
+  }
+
+  TimePoint now() const override { return cached_; }
+
+private:
+  const Clock *source_;
+  TimePoint cached_;
+};
+
+// Clock that only moves when told to (tests and simulations)
+class ManualClock : public Clock {
+public:
+  ManualClock() : now_() {}
+  explicit ManualClock(TimePoint start) : now_(start) {}
+
+  TimePoint now() const override { return now_; }
+
+  void set(TimePoint time) { now_ = time; }
+  void advance(std::chrono::nanoseconds delta) {
+    now_ += std::chrono::duration_cast<TimePoint::duration>(delta);
+  }
+  void advanceMs(int ms) { advance(std::chrono::milliseconds(ms)); }
+
+private:
+  TimePoint now_;
+};
+
+#endif // CLOCK_H
@@ -2,6 +2,7 @@
 #define CONFIG_H
 
 #include <string>
+#include <utility>
 #include <vector>
 
 // Custom key configuration
@@ -31,6 +32,16 @@ struct KeyMappingConfig {
         targetKeyId(targetId), mappingType(type), description(desc) {}
 };
 
+// Stuck thresholds learned from benign mismatches (see FixLogic::setAdaptive)
+struct AdaptiveThresholdConfig {
+  bool enabled = false;
+  double quantile = 0.99; // Quantile of benign mismatch durations
+  int marginMs = 250;     // Added to the quantile
+  int minMs = 300;        // Bounds of a learned threshold
+  int maxMs = 5000;
+  int minSamples = 50; // Benign mismatches of a key before it adapts
+};
+
 // Configuration class for Modifier Key Auto-Fix
 class Config {
 public:
@@ -50,6 +61,39 @@ public:
   int getThresholdMs() const { return thresholdMs_; }
   void setThresholdMs(int ms) { thresholdMs_ = ms; }
 
+  // Per-key thresholds (key ID, ms) overriding thresholdMs
+  const std::vector<std::pair<std::string, int>> &getKeyThresholds() const {
+    return keyThresholds_;
+  }
+  void setKeyThresholds(
+      const std::vector<std::pair<std::string, int>> &thresholds) {
+    keyThresholds_ = thresholds;
+  }
+
+  const AdaptiveThresholdConfig &getAdaptiveThreshold() const {
+    return adaptiveThreshold_;
+  }
+  void setAdaptiveThreshold(const AdaptiveThresholdConfig &adaptive) {
+    adaptiveThreshold_ = adaptive;
+  }
+
+  // Release stuck keys when their threshold passes, without waiting for a
+  // trigger key-down
+  bool getTimerFix() const { return timerFix_; }
+  void setTimerFix(bool enabled) { timerFix_ = enabled; }
+
+  // Window (ms) in which the OS must follow a forwarded key-up of a
+  // monitored key before the release counts as dropped; 0 = off
+  int getReleaseCheckMs() const { return releaseCheckMs_; }
+  void setReleaseCheckMs(int ms) { releaseCheckMs_ = ms; }
+
+  // A held key the OS has not registered for lostKeyDownMs counts as a lost
+  // key-down; with repairKeyDown its key-down is sent again
+  int getLostKeyDownMs() const { return lostKeyDownMs_; }
+  void setLostKeyDownMs(int ms) { lostKeyDownMs_ = ms; }
+  bool getRepairKeyDown() const { return repairKeyDown_; }
+  void setRepairKeyDown(bool enabled) { repairKeyDown_ = enabled; }
+
   bool getShowMessages() const { return showMessages_; }
   void setShowMessages(bool show) { showMessages_ = show; }
 
@@ -69,9 +113,65 @@ public:
   int getTooltipUpdateInterval() const { return tooltipUpdateInterval_; }
   void setTooltipUpdateInterval(int ms) { tooltipUpdateInterval_ = ms; }
 
+  // Log per-stroke decisions (debug level) to the console and logFile
   bool getDebugMode() const { return debugMode_; }
   void setDebugMode(bool debug) { debugMode_ = debug; }
 
+  // Rotating text log (empty path = console only)
+  const std::string &getLogFile() const { return logFile_; }
+  void setLogFile(const std::string &path) { logFile_ = path; }
+
+  int getLogFileSizeMB() const { return logFileSizeMB_; }
+  void setLogFileSizeMB(int mb) { logFileSizeMB_ = mb; }
+
+  int getLogMaxFiles() const { return logMaxFiles_; }
+  void setLogMaxFiles(int count) { logMaxFiles_ = count; }
+
+  int getStageTimingLogIntervalMs() const { return stageTimingLogIntervalMs_; }
+  void setStageTimingLogIntervalMs(int ms) { stageTimingLogIntervalMs_ = ms; }
+
+  // Chrome trace-event output file (empty = tracing off)
+  const std::string &getTraceFile() const { return traceFile_; }
+  void setTraceFile(const std::string &path) { traceFile_ = path; }
+
+  // Binary stroke recording (empty path = recording off)
+  const std::string &getRecordFile() const { return recordFile_; }
+  void setRecordFile(const std::string &path) { recordFile_ = path; }
+
+  int getRecordFileSizeMB() const { return recordFileSizeMB_; }
+  void setRecordFileSizeMB(int mb) { recordFileSizeMB_ = mb; }
+
+  int getRecordMaxFiles() const { return recordMaxFiles_; }
+  void setRecordMaxFiles(int count) { recordMaxFiles_ = count; }
+
+  // In-memory flight recorder dumped on every fix (0 events = off)
+  int getFlightRecorderEvents() const { return flightRecorderEvents_; }
+  void setFlightRecorderEvents(int count) { flightRecorderEvents_ = count; }
+
+  // Dump directory (empty = "dumps" beside the configuration file)
+  const std::string &getFlightRecorderDir() const {
+    return flightRecorderDir_;
+  }
+  void setFlightRecorderDir(const std::string &path) {
+    flightRecorderDir_ = path;
+  }
+
+  int getFlightRecorderMaxDumps() const { return flightRecorderMaxDumps_; }
+  void setFlightRecorderMaxDumps(int count) { flightRecorderMaxDumps_ = count; }
+
+  // Candidate fix policies evaluated without acting, "<ms>[:<trigger>]"
+  const std::vector<std::string> &getShadowPolicies() const {
+    return shadowPolicies_;
+  }
+  void setShadowPolicies(const std::vector<std::string> &policies) {
+    shadowPolicies_ = policies;
+  }
+
+  // Start interception first; tray icon, default-config write and startup
+  // notification follow after the first event wait (GUI version)
+  bool getFastStart() const { return fastStart_; }
+  void setFastStart(bool fast) { fastStart_ = fast; }
+
   // Key monitoring settings
   bool getMonitorCtrl() const { return monitorCtrl_; }
   void setMonitorCtrl(bool monitor) { monitorCtrl_ = monitor; }
@@ -114,6 +214,12 @@ public:
 private:
   // General settings
   int thresholdMs_;
+  std::vector<std::pair<std::string, int>> keyThresholds_;
+  AdaptiveThresholdConfig adaptiveThreshold_;
+  bool timerFix_;
+  int releaseCheckMs_;
+  int lostKeyDownMs_;
+  bool repairKeyDown_;
   bool showMessages_;
 
   // Notification settings
@@ -124,6 +230,19 @@ private:
   // Advanced settings
   int tooltipUpdateInterval_;
   bool debugMode_;
+  std::string logFile_;
+  int logFileSizeMB_;
+  int logMaxFiles_;
+  int stageTimingLogIntervalMs_;
+  std::string traceFile_;
+  std::string recordFile_;
+  int recordFileSizeMB_;
+  int recordMaxFiles_;
+  int flightRecorderEvents_;
+  std::string flightRecorderDir_;
+  int flightRecorderMaxDumps_;
+  std::vector<std::string> shadowPolicies_;
+  bool fastStart_;
 
   // Key monitoring settings
   bool monitorCtrl_;
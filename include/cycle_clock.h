@@ -0,0 +1,69 @@
+#ifndef CYCLE_CLOCK_H
+#define CYCLE_CLOCK_H
+
+#include <chrono>
+#include <cstdint>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define ESCMODKEY_HAS_RDTSC 1
+#elif (defined(__GNUC__) || defined(__clang__)) &&                             \
+    (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define ESCMODKEY_HAS_RDTSC 1
+#else
+#define ESCMODKEY_HAS_RDTSC 0
+#endif
+
+// Cheap monotonic tick source for hot-path timing.
+// Reads the time-stamp counter where available (a few ns, no syscall) and
+// falls back to steady_clock nanoseconds elsewhere. Ticks are only meaningful
+// as differences; use toNanoseconds() to convert.
+namespace CycleClock {
+
+inline uint64_t now() {
+#if ESCMODKEY_HAS_RDTSC
+  return __rdtsc();
+#else
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+#endif
+}
+
+// Nanoseconds per tick, measured once against steady_clock (~10ms spin on
+// first call). Call calibrate() during initialization to keep that cost off
+// the input path.
+inline double nanosecondsPerTick() {
+#if ESCMODKEY_HAS_RDTSC
+  static const double ratio = [] {
+    auto wallStart = std::chrono::steady_clock::now();
+    uint64_t tickStart = now();
+    auto wallEnd = wallStart;
+    do {
+      wallEnd = std::chrono::steady_clock::now();
+    } while (wallEnd - wallStart < std::chrono::milliseconds(10));
+    uint64_t ticks = now() - tickStart;
+    double ns = static_cast<double>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(wallEnd -
+                                                             wallStart)
+            .count());
+    return ticks > 0 ? ns / static_cast<double>(ticks) : 1.0;
+  }();
+  return ratio;
+#else
+  return 1.0;
+#endif
+}
+
+inline void calibrate() { (void)nanosecondsPerTick(); }
+
+inline uint64_t toNanoseconds(uint64_t ticks) {
+  return static_cast<uint64_t>(static_cast<double>(ticks) *
+                               nanosecondsPerTick());
+}
+
+} // namespace CycleClock
+
+#endif // CYCLE_CLOCK_H
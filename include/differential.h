@@ -0,0 +1,160 @@
+#ifndef DIFFERENTIAL_H
+#define DIFFERENTIAL_H
+
+#include "config.h"
+#include "fix_logic.h"
+#include "simulator.h"
+#include "work_stealing_pool.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Differential testing of the detector and fix logic (escModKey_diff).
+//
+// A case is a key selection, a fix policy and a stroke sequence. It is fed
+// through two subjects in lockstep: the frozen ReferenceFixer and the live
+// PhysicalKeyDetector + FixLogic. Each drives its own copy of a modelled
+// virtual (OS) key layer, which follows the strokes except for key-ups
+// marked lost and keys released by a fix. After every event the key
+// tables, physical states, tracker states and transitions, and fix
+// decisions are compared; the first difference fails the case. Failing
+// cases are shrunk to a minimal reproducer.
+
+// Key selection and fix policy of a case
+struct DiffConfig {
+  bool monitorCtrl = true;
+  bool monitorShift = true;
+  bool monitorAlt = true;
+  bool monitorWin = true;
+  std::vector<std::string> disabledKeys;
+  std::vector<CustomKeyConfig> customKeys;
+  std::vector<KeyMappingConfig> keyMappings;
+  int thresholdMs = 1000;
+  FixTrigger trigger = FixTrigger::IdleKeyDown;
+  std::vector<std::pair<size_t, int>> keyThresholds; // Key index, ms
+};
+
+// A stroke, or an idle iteration (wait timeout) if idle is set
+struct DiffEvent {
+  uint64_t timeNs = 0;
+  uint16_t code = 0;
+  uint16_t state = 0;
+  bool idle = false;
+  bool lost = false; // Key-up never reaches the virtual layer
+};
+
+struct DiffCase {
+  DiffConfig config;
+  std::vector<DiffEvent> events;
+};
+
+// Modelled OS key layer: the set of scan codes (with E0 flag) it considers
+// held
+class DiffVirtualLayer {
+public:
+  void clear() { down_.clear(); }
+  void apply(const DiffEvent &event);
+  void release(unsigned short scanCode, bool needsE0);
+  bool isDown(unsigned short scanCode, bool needsE0) const;
+
+private:
+  std::vector<uint32_t> down_;
+};
+
+// One monitored key as a subject sees it
+struct DiffKey {
+  std::string id;
+  unsigned short scanCode;
+  bool needsE0;
+
+  bool operator==(const DiffKey &other) const {
+    return id == other.id && scanCode == other.scanCode &&
+           needsE0 == other.needsE0;
+  }
+};
+
+// What a subject did for one event
+struct DiffStep {
+  bool fix = false;
+  std::vector<size_t> fixedKeys; // Stuck keys released by the fix
+  std::vector<bool> physical;
+  std::vector<bool> mismatched;
+  std::vector<bool> stuckReported;
+  std::vector<int> mismatchMs;
+  std::vector<TrackerEvent> changes;
+};
+
+// An implementation under comparison
+class DiffSubject {
+public:
+  virtual ~DiffSubject() = default;
+
+  virtual void initialize(const DiffConfig &config) = 0;
+  virtual std::vector<DiffKey> getKeys() const = 0;
+
+  // Run one event the way the fixer's loop does: fix decision on the
+  // pre-stroke state, physical update, then the tracker update against the
+  // layer (which this call updates with the stroke and any fix)
+  virtual void step(const DiffEvent &event, DiffVirtualLayer &layer,
+                    DiffStep &result) = 0;
+};
+
+using DiffSubjectFactory = std::function<std::unique_ptr<DiffSubject>()>;
+
+std::unique_ptr<DiffSubject> makeReferenceSubject();
+std::unique_ptr<DiffSubject> makeCurrentSubject();
+
+// Where and how two subjects first disagreed
+struct DiffMismatch {
+  bool found = false;
+  size_t eventIndex = 0; // events.size() if the key tables differ
+  std::string description;
+};
+
+// Run a case through both subjects in lockstep
+DiffMismatch runDiffCase(const DiffCase &testCase,
+                         const DiffSubjectFactory &reference,
+                         const DiffSubjectFactory &current);
+
+// Remove events, keys and mappings and simplify what is left while the
+// case still fails
+DiffCase shrinkDiffCase(const DiffCase &testCase,
+                        const DiffSubjectFactory &reference,
+                        const DiffSubjectFactory &current);
+
+// Generated case: random key selection (disabled, custom and duplicate
+// keys, mappings of every kind), policy and up to maxEvents events
+DiffCase generateDiffCase(uint64_t seed, size_t maxEvents);
+
+// Cases from recorded strokes: windows of up to windowSize strokes, each
+// under a random key selection and policy, with idle iterations inserted
+// every pollMs of silence and key-ups lost at dropRate
+std::vector<DiffCase>
+diffCasesFromStrokes(const std::vector<SimStroke> &strokes, uint64_t seed,
+                     size_t windowSize, int pollMs, double dropRate);
+
+// Readable listing of a case (config, then one line per event)
+std::string describeDiffCase(const DiffCase &testCase);
+
+struct DiffReport {
+  uint64_t cases = 0;
+  uint64_t events = 0;
+  uint64_t failures = 0;
+  bool hasFailure = false;
+  size_t firstFailure = 0; // Lowest failing case index
+  DiffMismatch mismatch;
+  DiffCase minimal; // First failing case after shrinking
+};
+
+// Run count cases on the pool; caseAt(index) builds case index. The lowest
+// failing case is shrunk.
+DiffReport runDifferential(size_t count,
+                           const std::function<DiffCase(size_t)> &caseAt,
+                           WorkStealingPool &pool,
+                           const DiffSubjectFactory &reference,
+                           const DiffSubjectFactory &current);
+
+#endif // DIFFERENTIAL_H
@@ -0,0 +1,364 @@
+#ifndef FIX_LOGIC_H
+#define FIX_LOGIC_H
+
+#include "clock.h"
+#include "config.h"
+#include "interception.h"
+#include "latency_histogram.h"
+#include "physical_key_detector.h"
+#include "quantile_estimator.h"
+#include "virtual_key_detector.h"
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+// Mismatch tracker for a single key. Tracks both directions: physical
+// released while virtual pressed (a stuck key; the start/reset/isStuck
+// methods) and physical pressed while virtual released (a lost key-down,
+// maintained by FixLogic). A key is in at most one of them, so they share
+// startTime.
+struct MismatchTracker {
+  using TimePoint = Clock::TimePoint;
+
+  bool isMismatched = false;
+  bool stuckReported = false; // Stuck transition already emitted as event
+  // Physical pressed, virtual released
+  bool isMissing = false;
+  bool missingReported = false; // Lost key-down already counted
+  TimePoint startTime;
+  const Clock *clock = nullptr; // For the overloads without a time argument
+                                // (steady clock if null)
+
+  void reset(); // Stuck direction only
+  void start();
+  int getDurationMs() const;
+  bool isStuck(int thresholdMs) const;
+
+  // Same as above with an explicit current time (no clock reads)
+  void start(TimePoint now);
+  int getDurationMs(TimePoint now) const;
+  bool isStuck(int thresholdMs, TimePoint now) const;
+};
+
+// Tracker for all modifier keys (dynamic, supports any number of keys)
+// Automatically tracks mismatch state for all monitored keys
+// Can be initialized with custom key lists
+class ModifierMismatchTrackers {
+public:
+  ModifierMismatchTrackers();
+
+  // Initialize trackers for given key IDs
+  void initializeForKeys(const std::vector<std::string> &keyIds);
+
+  // Time source for all trackers (nullptr = steady clock)
+  void setClock(const Clock *clock);
+
+  // Get tracker by key ID
+  MismatchTracker *getTracker(const std::string &keyId);
+  const MismatchTracker *getTracker(const std::string &keyId) const;
+
+  // Check if any key is stuck
+  bool hasAnyStuck(int thresholdMs) const;
+  bool hasAnyStuck(int thresholdMs, MismatchTracker::TimePoint now) const;
+
+  // Backward compatibility: access by field name
+  const MismatchTracker &lctrl() const;
+  const MismatchTracker &rctrl() const;
+  const MismatchTracker &lshift() const;
+  const MismatchTracker &rshift() const;
+  const MismatchTracker &lalt() const;
+  const MismatchTracker &ralt() const;
+  const MismatchTracker &lwin() const;
+  const MismatchTracker &rwin() const;
+
+private:
+  std::map<std::string, MismatchTracker> trackers_;
+  MismatchTracker emptyTracker_; // For backward compatibility
+  const Clock *clock_;
+};
+
+// Fix statistics (dynamic, supports any number of keys)
+// Automatically tracks fix counts for all monitored keys
+// Can be initialized with custom key lists
+class FixStatistics {
+public:
+  FixStatistics();
+
+  // Initialize statistics for given key IDs
+  void initializeForKeys(const std::vector<std::string> &keyIds);
+
+  // Increment fix count for a key
+  void incrementFix(const std::string &keyId);
+
+  // Get fix count for a key
+  int getFixCount(const std::string &keyId) const;
+
+  // Get total fixes
+  int getTotalFixes() const { return totalFixes_; }
+
+  // Reset all statistics
+  void reset();
+
+  // Record the time one stroke spent between interception_receive returning
+  // and interception_send completing, in CycleClock ticks (input thread
+  // only; converted to nanoseconds when read)
+  void recordForwardLatency(uint64_t ticks) { forwardLatency_.record(ticks); }
+
+  // Per-stroke forwarding latency distribution
+  const LatencyHistogram &getForwardLatency() const { return forwardLatency_; }
+
+  // Backward compatibility: access by field name
+  int lctrlFixes() const;
+  int rctrlFixes() const;
+  int lshiftFixes() const;
+  int rshiftFixes() const;
+  int laltFixes() const;
+  int raltFixes() const;
+  int lwinFixes() const;
+  int rwinFixes() const;
+
+  // Get all fix counts
+  const std::map<std::string, int> &getAllFixes() const { return fixes_; }
+
+  // Lost key-downs (a held key the OS did not register) and key-downs sent
+  // again to repair them, per key
+  void incrementLostKeyDown(const std::string &keyId);
+  int getLostKeyDownCount(const std::string &keyId) const;
+  int getTotalLostKeyDowns() const { return totalLostKeyDowns_; }
+  void incrementKeyDownRepair(const std::string &keyId);
+  int getKeyDownRepairCount(const std::string &keyId) const;
+  int getTotalKeyDownRepairs() const { return totalKeyDownRepairs_; }
+
+  // How long each direction's mismatches lasted until the OS caught up:
+  // releasing a key let go (release lag) or registering a key held
+  // (key-down lag). Measured at loop iteration granularity.
+  void recordReleaseLag(uint64_t ns) { releaseLag_.record(ns); }
+  void recordKeyDownLag(uint64_t ns) { keyDownLag_.record(ns); }
+  const LatencyHistogram &getReleaseLag() const { return releaseLag_; }
+  const LatencyHistogram &getKeyDownLag() const { return keyDownLag_; }
+
+private:
+  int totalFixes_;
+  std::map<std::string, int> fixes_;
+  LatencyHistogram forwardLatency_;
+
+  int totalLostKeyDowns_;
+  int totalKeyDownRepairs_;
+  std::map<std::string, int> lostKeyDowns_;
+  std::map<std::string, int> keyDownRepairs_;
+  LatencyHistogram releaseLag_;
+  LatencyHistogram keyDownLag_;
+};
+
+// Tracker transitions reported by FixLogic::updateTrackers
+enum class TrackerChange {
+  MismatchStart, // Physical released while virtual still pressed
+  Stuck,         // Mismatch lasted at least the threshold
+  Reset          // States agree again
+};
+
+struct TrackerEvent {
+  size_t keyIndex; // Index into the physical key list
+  TrackerChange change;
+  int mismatchMs; // Mismatch duration at the time of the change
+};
+
+// Key-downs that may trigger a fix while some key is stuck
+enum class FixTrigger {
+  IdleKeyDown, // Any key-down while no monitored key is held (default)
+  AnyKeyDown,  // Any key-down, even while monitored keys are held
+  OtherKeyDown // Key-down of an unmonitored key while none is held
+};
+
+// "idle", "any" or "other"
+const char *fixTriggerName(FixTrigger trigger);
+bool parseFixTrigger(const std::string &name, FixTrigger &trigger);
+
+// Stuck-key detection and fix decisions, independent of any I/O.
+// Works on physical/virtual state snapshots and an explicit current time,
+// so the same code runs in the live fixer and in the simulator.
+// Keys are addressed by their index in the physical key list.
+class FixLogic {
+public:
+  using TimePoint = MismatchTracker::TimePoint;
+
+  FixLogic();
+
+  // Create trackers and statistics for the physical keys and match each one
+  // to the virtual key with the same ID
+  void initialize(const ModifierKeyStates &physical,
+                  const VirtualKeyStates &virtualStates);
+
+  void setThreshold(int ms) { thresholdMs_ = ms; }
+  int getThreshold() const { return thresholdMs_; }
+
+  // Threshold of one key; 0 falls back to the global threshold. Overrides
+  // are cleared by initialize(). A learned threshold (see setAdaptive)
+  // takes precedence over both.
+  void setKeyThreshold(size_t keyIndex, int ms);
+  int getKeyThreshold(size_t keyIndex) const {
+    if (keyIndex < learnedMs_.size() && learnedMs_[keyIndex] > 0) {
+      return learnedMs_[keyIndex];
+    }
+    int ms = keyIndex < keyThresholdMs_.size() ? keyThresholdMs_[keyIndex] : 0;
+    return ms > 0 ? ms : thresholdMs_;
+  }
+
+  // Same by key ID (every key with the ID). Returns false if not monitored.
+  bool setKeyThreshold(const std::string &keyId, int ms);
+  void clearKeyThresholds();
+
+  // Learn each key's threshold online from benign mismatches: those that
+  // ended because the OS caught up, without a fix and without the key being
+  // pressed again. A fix of a key that was stuck (past its threshold) is a
+  // censored sample at the threshold, since its mismatch would have lasted
+  // at least that long; otherwise the threshold could only fall. A P²
+  // estimate of the configured quantile of the samples, plus the margin and
+  // clamped to [minMs, maxMs], becomes the key's threshold once it has
+  // minSamples of them. So the threshold rises by up to the margin while
+  // more than 1 - quantile of a key's mismatches end in a fix. Disabling,
+  // or changing the quantile, forgets what was learned. Kept across
+  // initialize().
+  void setAdaptive(const AdaptiveThresholdConfig &adaptive);
+  const AdaptiveThresholdConfig &getAdaptive() const { return adaptive_; }
+
+  // Learned threshold of a key (0 until learned) and its samples (benign
+  // mismatches and fixes)
+  int getLearnedThreshold(size_t keyIndex) const {
+    return keyIndex < learnedMs_.size() ? learnedMs_[keyIndex] : 0;
+  }
+  uint64_t getBenignMismatchCount(size_t keyIndex) const {
+    return keyIndex < benignMs_.size() ? benignMs_[keyIndex].count() : 0;
+  }
+
+  void setTrigger(FixTrigger trigger) { trigger_ = trigger; }
+  FixTrigger getTrigger() const { return trigger_; }
+
+  // Clock used by the trackers' no-argument queries (e.g. for display)
+  void setClock(const Clock *clock) { trackers_.setClock(clock); }
+
+  // Compare physical and virtual states and advance the trackers.
+  // Transitions are appended to events if given.
+  void updateTrackers(const ModifierKeyStates &physical,
+                      const VirtualKeyStates &virtualStates, TimePoint now,
+                      std::vector<TrackerEvent> *events = nullptr);
+
+  // Fix trigger: a key-down arrives while some key is stuck and, by default,
+  // no monitored key is physically held (see FixTrigger; evaluated before
+  // the stroke updates the states)
+  bool shouldFix(const InterceptionKeyStroke &stroke,
+                 const ModifierKeyStates &physical, TimePoint now) const;
+
+  // Fix without a trigger stroke (timer): some key is stuck and no
+  // monitored key is physically held
+  bool shouldFixIdle(const ModifierKeyStates &physical, TimePoint now) const;
+
+  // Earliest time a mismatched key that is not stuck at now becomes stuck.
+  // Returns false if there is none.
+  bool nextStuckTime(TimePoint now, TimePoint &when) const;
+
+  // Release checks: when updateTrackers() sees a key physically released
+  // while the OS still has it pressed, the OS gets ms to follow before the
+  // key-up counts as dropped (0 = off)
+  void setReleaseCheck(int ms);
+  int getReleaseCheck() const { return releaseCheckMs_; }
+
+  // True if some armed release check is due at now (a single comparison)
+  bool releaseCheckDue(TimePoint now) const {
+    return now >= nextReleaseCheck_;
+  }
+
+  // Earliest armed release check. Returns false if there is none.
+  bool nextReleaseCheck(TimePoint &when) const;
+
+  // Disarm the checks due at now and mark the keys still in a mismatch as
+  // dropped releases (see isDroppedRelease). Returns how many there are.
+  size_t collectDroppedReleases(TimePoint now);
+  bool isDroppedRelease(size_t keyIndex) const {
+    return keyIndex < droppedRelease_.size() && droppedRelease_[keyIndex];
+  }
+
+  // A key physically held that the OS has not registered for ms counts as
+  // a lost key-down (its key-down was dropped on the way)
+  void setLostKeyDownThreshold(int ms) { lostKeyDownMs_ = ms > 0 ? ms : 1; }
+  int getLostKeyDownThreshold() const { return lostKeyDownMs_; }
+
+  // True if updateTrackers() found lost key-downs not yet taken (a single
+  // comparison)
+  bool hasLostKeyDowns() const { return pendingLostKeyDowns_ > 0; }
+
+  // True once for each lost key-down of a key that is still missing
+  bool takeLostKeyDown(size_t keyIndex);
+
+  // Reverse direction queries (physical pressed, virtual released)
+  bool isMissing(size_t keyIndex) const;
+  int getMissingMs(size_t keyIndex, TimePoint now) const;
+
+  // Count a key-down sent again for a lost one
+  void recordKeyDownRepair(size_t keyIndex);
+
+  // True if any tracker is currently in a mismatch (stuck direction)
+  bool hasAnyMismatch() const;
+  // Same for the lost key-down direction
+  bool hasAnyMissing() const;
+
+  // Per-key queries used when executing a fix
+  bool isStuck(size_t keyIndex, TimePoint now) const;
+  int getMismatchMs(size_t keyIndex, TimePoint now) const;
+
+  // Count a fix for statistics (and, if adaptive, learn from it)
+  void recordFix(size_t keyIndex, TimePoint now);
+
+  // Start a new mismatch period for a key just released by a fix, so it is
+  // not released again before the injected key-up reaches the OS
+  void restartMismatch(size_t keyIndex, TimePoint now);
+
+  size_t getKeyCount() const { return keyIds_.size(); }
+  const std::string &getKeyId(size_t keyIndex) const {
+    return keyIds_[keyIndex];
+  }
+
+  const ModifierMismatchTrackers &getTrackers() const { return trackers_; }
+  const FixStatistics &getStatistics() const { return stats_; }
+  FixStatistics &getStatistics() { return stats_; }
+
+private:
+  void resetAdaptive();
+  void learnMismatch(size_t keyIndex, int mismatchMs);
+  void resetReleaseChecks();
+  void updateNextReleaseCheck();
+  void updateMissing(size_t keyIndex, TimePoint now);
+  void endMissing(size_t keyIndex, TimePoint now, bool registered);
+
+  ModifierMismatchTrackers trackers_;
+  FixStatistics stats_;
+  int thresholdMs_;
+  FixTrigger trigger_;
+  AdaptiveThresholdConfig adaptive_;
+
+  // Index-aligned with the physical key list
+  std::vector<std::string> keyIds_;
+  std::vector<MismatchTracker *> trackerByIndex_;
+  std::vector<int> virtualIndex_; // -1 if no virtual key with the same ID
+  std::vector<int> keyThresholdMs_; // 0 = global threshold
+
+  // Adaptive thresholds, index-aligned too (empty while disabled)
+  std::vector<P2Quantile> benignMs_;   // Benign mismatch durations
+  std::vector<int> learnedMs_;         // 0 = not learned yet
+  std::vector<char> fixedInMismatch_;  // Current mismatch ended by a fix
+
+  // Release checks, index-aligned too
+  int releaseCheckMs_;
+  TimePoint nextReleaseCheck_;            // TimePoint::max() if none armed
+  std::vector<TimePoint> releaseCheckAt_; // TimePoint::max() if not armed
+  std::vector<char> physicalPressed_;     // At the last updateTrackers()
+  std::vector<char> droppedRelease_;      // Found by the last collection
+
+  // Lost key-downs, index-aligned too
+  int lostKeyDownMs_;
+  size_t pendingLostKeyDowns_;
+  std::vector<char> lostKeyDown_; // Found and not yet taken
+};
+
+#endif // FIX_LOGIC_H
@@ -0,0 +1,386 @@
+#ifndef FIXER_CORE_H
+#define FIXER_CORE_H
+
+#include "config.h"
+#include "fix_logic.h"
+#include "interception.h"
+#include "physical_key_detector.h"
+#include "stage_timers.h"
+#include "virtual_key_detector.h"
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+// The fixer's event loop, parameterised by policies for everything outside
+// the detection and fix logic. Policies are plain members called directly,
+// so an instantiation with concrete policies compiles to an inlined hot
+// path with no virtual dispatch.
+//
+// Input         InterceptionDevice wait(int timeoutMs)
+//               bool receive(InterceptionDevice, InterceptionKeyStroke &)
+//               void send(InterceptionDevice, const InterceptionKeyStroke &)
+//               void inject(InterceptionDevice, const InterceptionKeyStroke &)
+//                 (a release generated by a fix)
+// VirtualState  initialize(), initializeWithConfig(...) and update() as
+//               VirtualKeyDetector, plus const VirtualKeyStates &getStates()
+// Clock         Clock::TimePoint now() const
+//               void refresh()      start of an iteration: take one reading
+//               void sleepMs(int)   wait for injected input to settle
+// Sink          observer of the loop, see NullSink
+//
+// ModifierKeyFixer and Simulator are instantiations of this template.
+template <class Input, class VirtualState, class ClockPolicy, class Sink>
+class FixerCore {
+public:
+  explicit FixerCore(const Input &input = Input(),
+                     const VirtualState &virtualState = VirtualState(),
+                     const ClockPolicy &clock = ClockPolicy(),
+                     const Sink &sink = Sink())
+      : input_(input), virtual_(virtualState), clock_(clock), sink_(sink),
+        paused_(false), fixSettleMs_(20), timerFix_(false),
+        repairKeyDown_(false), lastDevice_(0) {}
+
+  // Policies may be referenced by the logic (e.g. as its clock)
+  FixerCore(const FixerCore &) = delete;
+  FixerCore &operator=(const FixerCore &) = delete;
+
+  // Monitor the default key set
+  void initialize() {
+    physical_.initialize();
+    virtual_.initialize();
+    initializeLogic();
+  }
+
+  // Monitor the keys selected by a configuration (thresholds included)
+  void initialize(const Config &config) {
+    physical_.initializeWithConfig(
+        config.getMonitorCtrl(), config.getMonitorShift(),
+        config.getMonitorAlt(), config.getMonitorWin(),
+        config.getDisabledKeys(), config.getCustomKeys(),
+        config.getKeyMappings());
+    virtual_.initializeWithConfig(
+        config.getMonitorCtrl(), config.getMonitorShift(),
+        config.getMonitorAlt(), config.getMonitorWin(),
+        config.getDisabledKeys(), config.getCustomKeys());
+    initializeLogic();
+    applyFixPolicy(config);
+  }
+
+  // Thresholds (global, per-key, adaptive), timer fixes, release checks and
+  // lost key-down handling of a configuration; what the adaptive mode
+  // learned survives unless its quantile changes
+  void applyFixPolicy(const Config &config) {
+    timerFix_ = config.getTimerFix();
+    repairKeyDown_ = config.getRepairKeyDown();
+    logic_.setReleaseCheck(config.getReleaseCheckMs());
+    logic_.setLostKeyDownThreshold(config.getLostKeyDownMs());
+    logic_.setThreshold(config.getThresholdMs());
+    logic_.clearKeyThresholds();
+    for (const auto &threshold : config.getKeyThresholds()) {
+      logic_.setKeyThreshold(threshold.first, threshold.second);
+    }
+    logic_.setAdaptive(config.getAdaptiveThreshold());
+  }
+
+  // One iteration: wait for a stroke, fix stuck keys if it triggers a fix,
+  // forward it, then re-read the virtual state and advance the trackers.
+  // With timer fixes the wait ends by the next stuck deadline at the latest,
+  // and an iteration whose wait timed out releases the keys that are stuck.
+  // With release checks it also ends by the next check, and keys whose
+  // key-up the OS has not followed by then are released first thing. Held
+  // keys the OS has lost are reported at the end, and repaired if enabled.
+  void processEvents(int timeoutMs) {
+    typename Sink::Iteration iteration(sink_);
+
+    InterceptionDevice device = input_.wait(waitTimeoutMs(timeoutMs));
+    // One clock read per iteration; every decision below uses this instant
+    clock_.refresh();
+    iteration.lap(Stage::Wait);
+
+    // Before the next stroke, so that it reaches the OS after the release
+    if (logic_.releaseCheckDue(clock_.now())) {
+      checkReleases(device > 0 ? device : lastDevice_);
+      iteration.lap(Stage::Fix);
+    }
+
+    InterceptionKeyStroke stroke;
+    if (device > 0 && input_.receive(device, stroke)) {
+      iteration.lap(Stage::Receive);
+      lastDevice_ = device;
+      sink_.strokeReceived(device, stroke);
+
+      // If paused, just forward the key and don't process
+      if (paused_) {
+        input_.send(device, stroke);
+        iteration.lap(Stage::Forward);
+      } else {
+        // Check for fix trigger (before updating physical state)
+        bool fixTriggered =
+            logic_.shouldFix(stroke, physical_.getStates(), clock_.now());
+        iteration.lap(Stage::CheckFix);
+
+        if (fixTriggered) {
+          sink_.fixTriggered(device, stroke);
+          fixStuckKeys(device);
+          iteration.lap(Stage::Fix);
+        }
+
+        physical_.processKeyStroke(stroke);
+        iteration.lap(Stage::PhysicalUpdate);
+
+        input_.send(device, stroke);
+        iteration.lap(Stage::Forward);
+      }
+
+      sink_.strokeForwarded(logic_.getStatistics());
+    }
+
+    // Always update virtual state
+    virtual_.update();
+    sink_.virtualStateUpdated(physical_.getStates(), virtual_.getStates());
+    iteration.lap(Stage::VirtualUpdate);
+
+    updateTrackers();
+    iteration.lap(Stage::TrackerUpdate);
+
+    if (logic_.hasLostKeyDowns()) {
+      handleLostKeyDowns(device > 0 ? device : lastDevice_);
+      iteration.lap(Stage::Fix);
+    }
+
+    // Only after a timed-out wait: no input was queued, so the releases
+    // never land between the strokes of a burst. They go to the keyboard
+    // that sent the last stroke.
+    if (timerFix_ && device <= 0 && !paused_ && lastDevice_ > 0 &&
+        logic_.shouldFixIdle(physical_.getStates(), clock_.now())) {
+      sink_.timerFixTriggered(lastDevice_);
+      fixStuckKeys(lastDevice_);
+      iteration.lap(Stage::Fix);
+    }
+  }
+
+  // Wait timeout of processEvents(timeoutMs): no later than the next
+  // release check and, with timer fixes, the next moment a key becomes stuck
+  int waitTimeoutMs(int timeoutMs) const {
+    Clock::TimePoint now = clock_.now();
+    Clock::TimePoint when = Clock::TimePoint::max();
+    Clock::TimePoint next;
+    if (timerFix_ && logic_.nextStuckTime(now, next)) {
+      when = next;
+    }
+    if (logic_.nextReleaseCheck(next)) {
+      when = std::min(when, next);
+    }
+    if (when == Clock::TimePoint::max()) {
+      return timeoutMs;
+    }
+    auto wait = std::chrono::ceil<std::chrono::milliseconds>(when - now);
+    return static_cast<int>(
+        std::min<int64_t>(std::max<int64_t>(wait.count(), 0), timeoutMs));
+  }
+
+  // Control
+  void pause() { paused_ = true; }
+  void resume() { paused_ = false; }
+  bool isPaused() const { return paused_; }
+
+  void setThreshold(int ms) { logic_.setThreshold(ms); }
+  int getThreshold() const { return logic_.getThreshold(); }
+
+  // Time given to injected releases before the virtual state is re-read
+  void setFixSettleMs(int ms) { fixSettleMs_ = ms; }
+  int getFixSettleMs() const { return fixSettleMs_; }
+
+  // Release stuck keys when their threshold passes instead of waiting for a
+  // trigger key-down (key-downs still trigger fixes)
+  void setTimerFix(bool enabled) { timerFix_ = enabled; }
+  bool getTimerFix() const { return timerFix_; }
+
+  // Send the key-down of a held key again when the OS has lost it
+  void setRepairKeyDown(bool enabled) { repairKeyDown_ = enabled; }
+  bool getRepairKeyDown() const { return repairKeyDown_; }
+
+  // State access
+  const ModifierKeyStates &getPhysicalStates() const {
+    return physical_.getStates();
+  }
+  const VirtualKeyStates &getVirtualStates() const {
+    return virtual_.getStates();
+  }
+  FixLogic &logic() { return logic_; }
+  const FixLogic &logic() const { return logic_; }
+
+  // Policies
+  Input &input() { return input_; }
+  const Input &input() const { return input_; }
+  VirtualState &virtualState() { return virtual_; }
+  const VirtualState &virtualState() const { return virtual_; }
+  ClockPolicy &clock() { return clock_; }
+  const ClockPolicy &clock() const { return clock_; }
+  Sink &sink() { return sink_; }
+  const Sink &sink() const { return sink_; }
+
+private:
+  void initializeLogic() {
+    logic_.initialize(physical_.getStates(), virtual_.getStates());
+    events_.clear();
+    events_.reserve(3 * logic_.getKeyCount());
+    fixedKeys_.clear();
+    fixedKeys_.reserve(logic_.getKeyCount());
+  }
+
+  // Release every stuck key, then let the releases settle
+  int fixStuckKeys(InterceptionDevice device) {
+    Clock::TimePoint now = clock_.now();
+    return releaseKeys(device,
+                       [&](size_t i) { return logic_.isStuck(i, now); });
+  }
+
+  // Re-read the OS state and release the keys whose release check failed
+  void checkReleases(InterceptionDevice device) {
+    virtual_.update();
+    sink_.virtualStateUpdated(physical_.getStates(), virtual_.getStates());
+    updateTrackers();
+    if (logic_.collectDroppedReleases(clock_.now()) == 0 || paused_) {
+      return;
+    }
+    sink_.releaseDropped(device);
+    releaseKeys(device, [&](size_t i) { return logic_.isDroppedRelease(i); });
+  }
+
+  // Report held keys the OS has not registered and, with repairs, send
+  // their key-down again
+  void handleLostKeyDowns(InterceptionDevice device) {
+    const auto &keys = physical_.getStates().getKeys();
+    Clock::TimePoint now = clock_.now();
+    for (size_t i = 0; i < keys.size(); ++i) {
+      if (!logic_.takeLostKeyDown(i)) {
+        continue;
+      }
+      const KeyState &key = keys[i];
+      bool repaired = repairKeyDown_ && !paused_ && device > 0;
+      if (repaired) {
+        InterceptionKeyStroke press;
+        press.code = key.scanCode;
+        press.state = INTERCEPTION_KEY_DOWN;
+        if (key.needsE0) {
+          press.state |= INTERCEPTION_KEY_E0;
+        }
+        press.information = 0;
+        input_.inject(device, press);
+        logic_.recordKeyDownRepair(i);
+      }
+      sink_.keyDownLost(device, i, key, logic_.getMissingMs(i, now), repaired);
+    }
+  }
+
+  // Release the selected keys, then let the releases settle
+  template <typename Select>
+  int releaseKeys(InterceptionDevice device, Select select) {
+    int fixedCount = 0;
+    fixedKeys_.clear();
+    const auto &keys = physical_.getStates().getKeys();
+    Clock::TimePoint now = clock_.now();
+
+    for (size_t i = 0; i < keys.size(); ++i) {
+      const KeyState &key = keys[i];
+      if (!select(i)) {
+        continue;
+      }
+
+      InterceptionKeyStroke release;
+      release.code = key.scanCode;
+      release.state = INTERCEPTION_KEY_UP;
+      if (key.needsE0) {
+        release.state |= INTERCEPTION_KEY_E0;
+      }
+      release.information = 0;
+      input_.inject(device, release);
+      fixedCount++;
+      fixedKeys_.push_back(i);
+
+      sink_.keyFixed(device, i, key, logic_.getMismatchMs(i, now));
+      logic_.recordFix(i, now);
+      logic_.restartMismatch(i, now);
+    }
+
+    if (fixedCount > 0) {
+      clock_.sleepMs(fixSettleMs_);
+      virtual_.update();
+
+      // Report whether each injected release reached the virtual state
+      if (sink_.verifyFixes()) {
+        for (size_t i : fixedKeys_) {
+          const VirtualKeyState *virtKey =
+              virtual_.getStates().findKeyById(keys[i].id);
+          if (virtKey) {
+            sink_.fixVerified(keys[i], !virtKey->pressed);
+          }
+        }
+      }
+    }
+
+    sink_.fixCompleted(fixedCount);
+    return fixedCount;
+  }
+
+  void updateTrackers() {
+    events_.clear();
+    logic_.updateTrackers(physical_.getStates(), virtual_.getStates(),
+                          clock_.now(), &events_);
+    if (events_.empty()) {
+      return;
+    }
+    const auto &keys = physical_.getStates().getKeys();
+    for (const TrackerEvent &event : events_) {
+      sink_.trackerChanged(event, keys[event.keyIndex]);
+    }
+  }
+
+  Input input_;
+  VirtualState virtual_;
+  ClockPolicy clock_;
+  Sink sink_;
+
+  PhysicalKeyDetector physical_;
+  FixLogic logic_;
+  std::vector<TrackerEvent> events_;
+  std::vector<size_t> fixedKeys_; // Keys released by the current fix
+
+  bool paused_;
+  int fixSettleMs_;
+  bool timerFix_;
+  bool repairKeyDown_;
+  InterceptionDevice lastDevice_; // Keyboard of the last stroke, 0 if none
+};
+
+// Sink that observes nothing (simulation and benchmarks)
+struct NullSink {
+  // Scope of one processEvents() iteration; lap() ends a stage
+  struct Iteration {
+    explicit Iteration(NullSink &) {}
+    void lap(Stage) {}
+  };
+
+  void strokeReceived(InterceptionDevice, const InterceptionKeyStroke &) {}
+  // After the stroke was forwarded (or fixed and forwarded)
+  void strokeForwarded(FixStatistics &) {}
+  void fixTriggered(InterceptionDevice, const InterceptionKeyStroke &) {}
+  // A timer fix, released on the given device
+  void timerFixTriggered(InterceptionDevice) {}
+  // The OS did not follow a key-up in time; released on the given device
+  void releaseDropped(InterceptionDevice) {}
+  // A held key the OS has not registered for missingMs; repaired if its
+  // key-down was sent again
+  void keyDownLost(InterceptionDevice, size_t, const KeyState &, int, bool) {}
+  void keyFixed(InterceptionDevice, size_t, const KeyState &, int) {}
+  void fixCompleted(int) {}
+  // fixVerified() is only called if verifyFixes() returns true
+  bool verifyFixes() const { return false; }
+  void fixVerified(const KeyState &, bool) {}
+  void virtualStateUpdated(const ModifierKeyStates &,
+                           const VirtualKeyStates &) {}
+  void trackerChanged(const TrackerEvent &, const KeyState &) {}
+};
+
+#endif // FIXER_CORE_H
@@ -0,0 +1,72 @@
+#ifndef FIXER_POLICIES_H
+#define FIXER_POLICIES_H
+
+#include "clock.h"
+#include "interception.h"
+#include <Windows.h>
+
+// Production policies for FixerCore (see fixer_core.h)
+
+// Keyboard input through the Interception driver
+class InterceptionInput {
+public:
+  InterceptionInput() : context_(nullptr) {}
+
+  // Create the context and capture all keyboard strokes
+  bool open() {
+    context_ = interception_create_context();
+    if (!context_) {
+      return false;
+    }
+    interception_set_filter(
+        context_, interception_is_keyboard,
+        INTERCEPTION_FILTER_KEY_DOWN | INTERCEPTION_FILTER_KEY_UP |
+            INTERCEPTION_FILTER_KEY_E0 | INTERCEPTION_FILTER_KEY_E1);
+    return true;
+  }
+
+  void close() {
+    if (context_) {
+      interception_destroy_context(context_);
+      context_ = nullptr;
+    }
+  }
+
+  bool isOpen() const { return context_ != nullptr; }
+
+  InterceptionDevice wait(int timeoutMs) {
+    return interception_wait_with_timeout(context_, timeoutMs);
+  }
+
+  bool receive(InterceptionDevice device, InterceptionKeyStroke &stroke) {
+    return interception_is_keyboard(device) &&
+           interception_receive(context_, device,
+                                (InterceptionStroke *)&stroke, 1) > 0;
+  }
+
+  void send(InterceptionDevice device, const InterceptionKeyStroke &stroke) {
+    interception_send(context_, device, (const InterceptionStroke *)&stroke,
+                      1);
+  }
+
+  void inject(InterceptionDevice device, const InterceptionKeyStroke &stroke) {
+    send(device, stroke);
+  }
+
+private:
+  InterceptionContext context_;
+};
+
+// Caches one reading of a source clock per iteration; waits with Sleep()
+class IterationClock final : public CachedClock {
+public:
+  explicit IterationClock(const Clock &source = SteadyClock::instance())
+      : CachedClock(source) {}
+
+  void sleepMs(int ms) {
+    Sleep(ms);
+    refresh();
+  }
+};
+
+#endif // FIXER_POLICIES_H
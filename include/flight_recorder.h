@@ -0,0 +1,157 @@
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include "cycle_clock.h"
+#include "trace_format.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Always-on in-memory ring of the most recent strokes, virtual state changes,
+// fixes and tracker transitions.
+//
+// Recording is a few plain stores into a fixed-size ring owned by the input
+// thread (timestamps are kept as CycleClock ticks until a dump). dump()
+// freezes the ring into a pre-allocated snapshot and hands it to a
+// background thread, which writes it as a trace file (*.emkt, see
+// trace_format.h) that escModKey_sim can replay, then deletes the oldest
+// dumps beyond maxDumps. While a dump is still being written, further dumps
+// are skipped and counted rather than blocking the input thread.
+//
+// Dump files are named "flight-<local time>-<reason>.emkt".
+class FlightRecorder {
+public:
+  struct Options {
+    std::string directory; // Empty = "dumps" beside the configuration file
+    size_t capacity = 4096; // Records kept in the ring
+    int maxDumps = 16;      // Oldest dumps are deleted
+  };
+
+  FlightRecorder();
+  ~FlightRecorder();
+
+  FlightRecorder(const FlightRecorder &) = delete;
+  FlightRecorder &operator=(const FlightRecorder &) = delete;
+
+  // Allocate the ring and snapshot and start the dump thread
+  void start(const Options &options,
+             const std::vector<TraceFormat::KeyInfo> &keys, int thresholdMs);
+
+  // Finish a pending dump and stop the dump thread
+  void stop();
+
+  bool isActive() const { return active_; }
+
+  // Hot path (input thread only)
+  void recordStroke(uint8_t device, uint16_t code, uint16_t state,
+                    uint32_t information) {
+    TraceFormat::TraceRecord &record = next(TraceFormat::kRecordStroke);
+    record.device = device;
+    record.code = code;
+    record.state = state;
+    record.information = information;
+  }
+
+  // Record the virtual pressed mask if it differs from the last one recorded
+  void recordVirtualState(uint32_t virtualMask, uint32_t physicalMask) {
+    if (virtualMask == lastVirtualMask_) {
+      return;
+    }
+    lastVirtualMask_ = virtualMask;
+    TraceFormat::TraceRecord &record = next(TraceFormat::kRecordVirtualState);
+    record.information = physicalMask;
+    record.value = virtualMask;
+  }
+
+  void recordFix(uint8_t device, uint8_t keyIndex, uint16_t code,
+                 uint16_t state, uint32_t mismatchMs) {
+    TraceFormat::TraceRecord &record = next(TraceFormat::kRecordFix);
+    record.device = device;
+    record.keyIndex = keyIndex;
+    record.code = code;
+    record.state = state;
+    record.value = mismatchMs;
+  }
+
+  void recordTracker(uint8_t keyIndex, TraceFormat::TrackerTransition what,
+                     uint32_t mismatchMs) {
+    TraceFormat::TraceRecord &record = next(TraceFormat::kRecordTracker);
+    record.keyIndex = keyIndex;
+    record.state = what;
+    record.value = mismatchMs;
+  }
+
+  // Freeze the ring and write it in the background (input thread only).
+  // reason must be a string literal. Returns false if the previous dump is
+  // still being written.
+  bool dump(const char *reason);
+
+  // Ask the input thread for a dump at its next opportunity (any thread)
+  void requestDump() { dumpRequested_.store(true, std::memory_order_relaxed); }
+  bool takeDumpRequest() {
+    return dumpRequested_.load(std::memory_order_relaxed) &&
+           dumpRequested_.exchange(false, std::memory_order_relaxed);
+  }
+
+  uint64_t getDumpCount() const {
+    return dumps_.load(std::memory_order_relaxed);
+  }
+  uint64_t getSkippedCount() const {
+    return skipped_.load(std::memory_order_relaxed);
+  }
+
+  // Path of the most recent dump file (empty if none was written)
+  std::string getLastDumpPath() const;
+
+  // Wait until no dump is being written (tests and shutdown)
+  void waitIdle();
+
+private:
+  TraceFormat::TraceRecord &next(uint8_t type) {
+    TraceFormat::TraceRecord &record = ring_[head_ & mask_];
+    head_++;
+    record = TraceFormat::TraceRecord();
+    record.timestampNs = CycleClock::now(); // ticks until dumped
+    record.type = type;
+    return record;
+  }
+
+  void writerLoop();
+  bool writeDump(std::string &path);
+  void pruneDumps(const std::string &directory);
+
+  Options options_;
+  std::vector<TraceFormat::KeyInfo> keys_;
+  int thresholdMs_;
+  uint64_t startUnixMs_;
+  uint64_t origin_;
+  bool active_;
+
+  // Input thread only
+  std::vector<TraceFormat::TraceRecord> ring_;
+  uint64_t head_;
+  uint64_t mask_;
+  uint32_t lastVirtualMask_;
+  std::atomic<bool> dumpRequested_;
+
+  // Handed to the dump thread while busy_ is set
+  std::vector<TraceFormat::TraceRecord> snapshot_;
+  const char *snapshotReason_;
+  std::atomic<bool> busy_;
+
+  std::atomic<uint64_t> dumps_;
+  std::atomic<uint64_t> skipped_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable idle_;
+  bool stopRequested_;
+  std::string lastDumpPath_;
+  std::thread writer_;
+};
+
+#endif // FLIGHT_RECORDER_H
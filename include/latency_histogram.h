@@ -0,0 +1,148 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include "cycle_clock.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Compile-time switch for per-stroke forwarding latency recording.
+// Build with ESCMODKEY_LATENCY_STATS=0 (xmake f --latency_stats=n) to remove
+// the timestamps from the input path entirely.
+#ifndef ESCMODKEY_LATENCY_STATS
+#define ESCMODKEY_LATENCY_STATS 1
+#endif
+
+// Log-linear latency histogram (HDR-style).
+// Values below 64 units are exact; above that each power of two is split
+// into 32 sub-buckets, so any recorded value is reported within ~3%.
+// Samples are recorded in nanoseconds or, to keep the conversion off the
+// hot path, in raw CycleClock ticks; everything read back is nanoseconds.
+//
+// Lock-free with a single writer: record() is only called from the input
+// thread and uses plain relaxed load/store (no locked RMW), while any other
+// thread may read counts and percentiles concurrently.
+class LatencyHistogram {
+public:
+  enum class Unit { Nanoseconds, CycleTicks };
+
+  static constexpr int kSubBucketBits = 6;
+  static constexpr uint64_t kSubBucketCount = 1ull << kSubBucketBits; // 64
+  static constexpr uint64_t kHalfSubBucketCount = kSubBucketCount / 2;
+  // Highest tracked power of two (2^40 ns ~ 18 minutes, 2^40 ticks several
+  // minutes); larger values are clamped into the last bucket.
+  static constexpr int kMaxExponent = 40;
+  static constexpr size_t kBucketCount =
+      kSubBucketCount +
+      (kMaxExponent - kSubBucketBits + 1) * kHalfSubBucketCount;
+
+  struct Summary {
+    uint64_t count = 0;
+    uint64_t p50Ns = 0;
+    uint64_t p99Ns = 0;
+    uint64_t p999Ns = 0;
+    uint64_t maxNs = 0;
+    uint64_t meanNs = 0;
+  };
+
+  explicit LatencyHistogram(Unit unit = Unit::Nanoseconds);
+
+  LatencyHistogram(const LatencyHistogram &) = delete;
+  LatencyHistogram &operator=(const LatencyHistogram &) = delete;
+
+  // Record one sample in the histogram's unit (single writer only)
+  void record(uint64_t value) {
+    std::atomic<uint64_t> &bucket = buckets_[bucketIndex(value)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_relaxed);
+    sum_.store(sum_.load(std::memory_order_relaxed) + value,
+               std::memory_order_relaxed);
+    if (value > max_.load(std::memory_order_relaxed)) {
+      max_.store(value, std::memory_order_relaxed);
+    }
+    // Published last so readers never see a count without its bucket
+    count_.store(count_.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_release);
+  }
+
+  // Clear all samples (must not race with record())
+  void reset();
+
+  // Add another histogram's samples (same single writer as record()); both
+  // must use the same unit
+  void merge(const LatencyHistogram &other);
+
+  uint64_t getCount() const { return count_.load(std::memory_order_acquire); }
+  // Largest sample in nanoseconds
+  uint64_t getMax() const {
+    return toNanoseconds(max_.load(std::memory_order_relaxed));
+  }
+
+  // Value at percentile (0-100], reported as the highest value equivalent
+  // to the containing bucket, capped at the recorded maximum
+  uint64_t valueAtPercentile(double percentile) const;
+
+  // Snapshot of count, p50/p99/p99.9, max and mean
+  Summary summarize() const;
+
+  // Bucket math in the histogram's unit (exposed for tests)
+  static size_t bucketIndex(uint64_t value) {
+    if (value < kSubBucketCount) {
+      return static_cast<size_t>(value);
+    }
+    int exponent = highestBit(value);
+    if (exponent > kMaxExponent) {
+      return kBucketCount - 1;
+    }
+    int shift = exponent - (kSubBucketBits - 1);
+    uint64_t subBucket = (value >> shift) - kHalfSubBucketCount;
+    return static_cast<size_t>(kSubBucketCount +
+                               (exponent - kSubBucketBits) *
+                                   kHalfSubBucketCount +
+                               subBucket);
+  }
+  static uint64_t bucketUpperBound(size_t index);
+
+private:
+  uint64_t toNanoseconds(uint64_t value) const {
+    return unit_ == Unit::CycleTicks ? CycleClock::toNanoseconds(value)
+                                     : value;
+  }
+
+  static int highestBit(uint64_t value) {
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return static_cast<int>(index);
+#elif defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(value);
+#else
+    int index = 0;
+    while (value >>= 1) {
+      index++;
+    }
+    return index;
+#endif
+  }
+
+  std::atomic<uint64_t> buckets_[kBucketCount];
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> sum_;
+  std::atomic<uint64_t> max_;
+  Unit unit_;
+};
+
+// Human-readable duration, e.g. "850ns", "12.4us", "3.10ms"
+std::string formatLatency(uint64_t ns);
+// Same into a caller's buffer (no allocation); returns the length written
+size_t formatLatency(uint64_t ns, char *buffer, size_t size);
+
+// One-line summary, e.g. "p50 2.1us | p99 8.4us | p99.9 21.0us | max 1.20ms"
+std::string formatLatencySummary(const LatencyHistogram::Summary &summary);
+
+#endif // LATENCY_HISTOGRAM_H
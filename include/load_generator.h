@@ -0,0 +1,144 @@
+#ifndef LOAD_GENERATOR_H
+#define LOAD_GENERATOR_H
+
+#include "interception.h"
+#include "latency_histogram.h"
+#include "modifier_key_fixer.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Synthetic keyboard load for capacity testing of the live event loop
+// (headless builds: runs ModifierKeyFixer on the fake driver).
+//
+// generateLoad() builds a timed stroke schedule for one or more keyboards;
+// each stroke carries its sequence number in the information field, which
+// the fixer forwards untouched. runLoad() pushes the schedule into the
+// driver in real time from a producer thread while the calling thread runs
+// processEvents(), and LoadMonitor matches forwarded strokes back to the
+// schedule to measure latency and detect lost, duplicated or reordered
+// strokes.
+
+// Key mix of each device's stream
+enum class LoadProfile {
+  Typing,    // Letters, some single-modifier chords
+  Modifiers, // Every letter under one to three modifiers (left, right, E0)
+  Typematic, // Held keys auto-repeating (repeated key-downs) under Shift
+  Scanner    // Barcode bursts: digits then Enter, as fast as the device can
+};
+
+const char *loadProfileName(LoadProfile profile);
+bool parseLoadProfile(const std::string &name, LoadProfile &profile);
+
+struct LoadOptions {
+  LoadProfile profile = LoadProfile::Typing;
+  int devices = 1;               // Keyboards 1..devices (at most 10)
+  uint64_t strokeCount = 100000; // Total over all devices
+  double rate = 1000; // Strokes per second per device (0 = all at once)
+  // Strokes emitted back to back; bursts start every burstSize / rate
+  // seconds so the average rate holds. 0 = profile default (28 for Scanner,
+  // one barcode; 1 otherwise).
+  int burstSize = 0;
+  double burstSpacingUs = 0; // Gap between strokes inside a burst
+  uint64_t seed = 1;
+};
+
+struct LoadStroke {
+  uint64_t timeNs; // Offset from the start of the run
+  InterceptionDevice device;
+  InterceptionKeyStroke stroke; // information = sequence number (from 1)
+};
+
+// Schedule sorted by time; sequence numbers follow schedule order
+std::vector<LoadStroke> generateLoad(const LoadOptions &options);
+
+// Bookkeeping for one run. pushed() is called by the producer before the
+// stroke enters the driver, forwarded() for every stroke the fixer sends;
+// the driver lock orders the two, so no extra synchronisation is needed.
+class LoadMonitor {
+public:
+  explicit LoadMonitor(const std::vector<LoadStroke> &schedule);
+
+  LoadMonitor(const LoadMonitor &) = delete;
+  LoadMonitor &operator=(const LoadMonitor &) = delete;
+
+  void pushed(uint32_t sequence, uint64_t nowNs);
+  void forwarded(InterceptionDevice device,
+                 const InterceptionKeyStroke &stroke, uint64_t nowNs);
+
+  uint64_t getPushed() const { return pushedCount_; }
+  uint64_t getForwarded() const { return forwardedCount_; }
+  // Strokes with no sequence number (releases injected by a fix)
+  uint64_t getInjected() const { return injected_; }
+  // Scheduled strokes never forwarded (valid once the run has drained)
+  uint64_t getDropped() const;
+  uint64_t getDuplicated() const { return duplicated_; }
+  // Forwarded after a later stroke of the same device
+  uint64_t getReordered() const { return reordered_; }
+  // Forwarded with a code or state different from the one pushed
+  uint64_t getCorrupted() const { return corrupted_; }
+
+  uint64_t getFirstPushNs() const { return firstPushNs_; }
+  uint64_t getLastForwardNs() const { return lastForwardNs_; }
+
+  // Push to forward, including time queued in the driver
+  const LatencyHistogram &getLatency() const { return latency_; }
+
+private:
+  const std::vector<LoadStroke> &schedule_;
+  std::vector<uint64_t> pushedAt_;  // By sequence number
+  std::vector<uint8_t> seen_;       // By sequence number
+  uint32_t lastSequence_[INTERCEPTION_MAX_DEVICE + 1];
+  uint64_t pushedCount_;
+  uint64_t forwardedCount_;
+  uint64_t injected_;
+  uint64_t duplicated_;
+  uint64_t reordered_;
+  uint64_t corrupted_;
+  uint64_t firstPushNs_;
+  uint64_t lastForwardNs_;
+  LatencyHistogram latency_;
+};
+
+struct LoadReport {
+  uint64_t scheduled = 0;
+  uint64_t pushed = 0;
+  uint64_t forwarded = 0; // Including injected releases
+  uint64_t injected = 0;
+  uint64_t dropped = 0;
+  uint64_t duplicated = 0;
+  uint64_t reordered = 0;
+  uint64_t corrupted = 0;
+  int fixes = 0;
+
+  double scheduleSeconds = 0; // Span of the schedule
+  double elapsedSeconds = 0;  // First push to last forward
+  double offeredRate = 0;     // Strokes per second asked for (0 = unpaced)
+  double throughput = 0;      // Strokes per second forwarded
+  uint64_t maxProducerLagNs = 0; // Worst push behind its scheduled time
+
+  // Push to forward (driver queueing included) and the fixer's own
+  // receive to forward time
+  LatencyHistogram::Summary latency;
+  LatencyHistogram::Summary fixerLatency;
+
+  // CPU time of the thread running processEvents()
+  double cpuNsPerStroke = 0;
+  double cpuUtilisation = 0; // Of one core over the run
+
+  // No stroke lost, duplicated, reordered or altered
+  bool intact() const {
+    return dropped == 0 && duplicated == 0 && reordered == 0 &&
+           corrupted == 0;
+  }
+};
+
+// Run the schedule through a fixer initialised on the fake driver (after
+// FakeInterception::reset(), which clears context filters). Devices used by
+// the schedule are added to the driver and sent strokes are not captured.
+// pollTimeoutMs is the processEvents() wait timeout.
+LoadReport runLoad(ModifierKeyFixer &fixer,
+                   const std::vector<LoadStroke> &schedule,
+                   int pollTimeoutMs = 50);
+
+#endif // LOAD_GENERATOR_H
@@ -0,0 +1,215 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include "cycle_clock.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+enum class LogLevel : uint8_t { Error, Warning, Info, Debug };
+
+// One fixed-size log record. The format must be a string literal (only the
+// pointer is stored): "{}" is replaced by the next integer argument in
+// decimal, "{x}" in hex and "{s}" by the text, which is copied inline and
+// truncated to fit.
+struct LogRecord {
+  uint64_t ticks;
+  const char *format;
+  int64_t args[3];
+  LogLevel level;
+  char text[207];
+};
+
+// Levelled logger that keeps formatting and I/O off the input thread.
+//
+// Producers append LogRecord entries to a lock-free single-producer ring
+// owned by their thread (registered on first use), as TraceWriter does. A
+// background thread drains all rings every 10ms, orders the records by
+// time, formats them and writes them to the console and/or a log file that
+// rotates at a size limit ("<path>", "<path>.1", ... oldest last). If a
+// ring fills up, records from that thread are dropped and counted.
+//
+// Before start() (and in tools that never call it) records are formatted
+// and written to the console on the calling thread; the first kBacklog of
+// them are kept and written at the top of the log file by start(), so
+// messages from loading the configuration that chose the file still end up
+// in it.
+class Logger {
+public:
+  static constexpr size_t kRingCapacity = 1 << 11; // records per thread
+  static constexpr size_t kBacklog = 32;
+
+  struct Options {
+    bool console = true;             // stdout (Info, Debug) and stderr
+    std::string filePath;            // Empty = no file
+    uint64_t fileBytes = 4ull << 20; // Rotate when a file reaches this size
+    int maxFiles = 3;                // Files kept, the current one included
+    LogLevel level = LogLevel::Info;
+  };
+
+  static Logger &instance();
+
+  // Start the writer thread. Returns false if the log file can't be opened
+  // or the logger is already running.
+  bool start(const Options &options);
+
+  // Write remaining records and stop the writer thread
+  void stop();
+
+  bool isRunning() const { return running_.load(std::memory_order_relaxed); }
+
+  // Records above the level are discarded by the Log helpers before they
+  // are built. Independent of start(), so tools can raise it too.
+  void setLevel(LogLevel level) {
+    level_.store(static_cast<uint8_t>(level), std::memory_order_relaxed);
+  }
+  LogLevel getLevel() const {
+    return static_cast<LogLevel>(level_.load(std::memory_order_relaxed));
+  }
+  bool enabled(LogLevel level) const {
+    return static_cast<uint8_t>(level) <=
+           level_.load(std::memory_order_relaxed);
+  }
+
+  uint64_t getDroppedCount() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+  uint64_t getWrittenCount() const {
+    return written_.load(std::memory_order_relaxed);
+  }
+
+  // Append a record from the calling thread
+  void emit(const LogRecord &record);
+
+  // Format a record's message (without time or level); returns its length
+  static size_t formatMessage(const LogRecord &record, char *buffer,
+                              size_t size);
+
+  ~Logger();
+
+private:
+  struct ThreadRing {
+    std::atomic<uint64_t> head{0}; // written by producer
+    std::atomic<uint64_t> tail{0}; // written by writer thread
+    LogRecord records[kRingCapacity];
+  };
+
+  Logger() = default;
+  Logger(const Logger &) = delete;
+  Logger &operator=(const Logger &) = delete;
+
+  ThreadRing *ringForThisThread();
+  void writeNow(const LogRecord &record);
+  void writerLoop();
+  void drainAll();
+  void writeRecord(const LogRecord &record);
+  void writeConsole(LogLevel level, const char *message, size_t length);
+  void writeFile(const char *line, size_t length);
+  void rotate();
+
+  std::atomic<bool> running_{false};
+  std::atomic<uint8_t> level_{static_cast<uint8_t>(LogLevel::Info)};
+  std::atomic<uint64_t> dropped_{0};
+  std::atomic<uint64_t> written_{0};
+
+  std::mutex ringsMutex_; // guards rings_ registration and draining
+  std::vector<std::unique_ptr<ThreadRing>> rings_;
+  std::vector<LogRecord> batch_; // writer thread only
+
+  // Records written before start() (guarded by directMutex_)
+  std::mutex directMutex_;
+  LogRecord backlog_[kBacklog];
+  size_t backlogCount_ = 0;
+
+  std::mutex wakeMutex_;
+  std::condition_variable wake_;
+  bool stopRequested_ = false;
+  std::thread writer_;
+
+  Options options_;
+  std::ofstream file_;
+  uint64_t fileBytes_ = 0;
+  uint64_t reportedDrops_ = 0;
+  uint64_t originTicks_ = 0;
+  std::chrono::system_clock::time_point originTime_;
+};
+
+// Convenience wrappers used by logging code
+namespace Log {
+
+inline bool enabled(LogLevel level) {
+  return Logger::instance().enabled(level);
+}
+
+namespace detail {
+
+inline void pack(LogRecord &record, size_t &, const char *text) {
+  // Truncated to fit, always terminated
+  size_t length = std::strlen(text);
+  if (length > sizeof(record.text) - 1) {
+    length = sizeof(record.text) - 1;
+  }
+  std::memcpy(record.text, text, length);
+  record.text[length] = '\0';
+}
+
+inline void pack(LogRecord &record, size_t &argIndex,
+                 const std::string &text) {
+  pack(record, argIndex, text.c_str());
+}
+
+template <class T, class = std::enable_if_t<std::is_integral<T>::value ||
+                                            std::is_enum<T>::value>>
+void pack(LogRecord &record, size_t &argIndex, const T &value) {
+  if (argIndex < 3) {
+    record.args[argIndex++] = static_cast<int64_t>(value);
+  }
+}
+
+} // namespace detail
+
+// Build and emit a record if the level is enabled. Arguments fill "{}"/"{x}"
+// placeholders in order; a string argument fills "{s}".
+template <class... Args>
+void write(LogLevel level, const char *format, const Args &...args) {
+  if (!enabled(level)) {
+    return;
+  }
+  LogRecord record{};
+  record.ticks = CycleClock::now();
+  record.format = format;
+  record.level = level;
+  [[maybe_unused]] size_t argIndex = 0;
+  (detail::pack(record, argIndex, args), ...);
+  Logger::instance().emit(record);
+}
+
+template <class... Args> void error(const char *format, const Args &...args) {
+  write(LogLevel::Error, format, args...);
+}
+
+template <class... Args>
+void warning(const char *format, const Args &...args) {
+  write(LogLevel::Warning, format, args...);
+}
+
+template <class... Args> void info(const char *format, const Args &...args) {
+  write(LogLevel::Info, format, args...);
+}
+
+template <class... Args> void debug(const char *format, const Args &...args) {
+  write(LogLevel::Debug, format, args...);
+}
+
+} // namespace Log
+
+#endif // LOGGER_H
@@ -1,101 +1,145 @@
 #ifndef MODIFIER_KEY_FIXER_H
 #define MODIFIER_KEY_FIXER_H
 
+#include "clock.h"
 #include "config.h"
+#include "cycle_clock.h"
+#include "fix_logic.h"
+#include "fixer_core.h"
+#include "fixer_policies.h"
+#include "flight_recorder.h"
 #include "interception.h"
+#include "logger.h"
 #include "physical_key_detector.h"
+#include "shadow_policy.h"
+#include "stage_timers.h"
+#include "stroke_recorder.h"
+#include "trace_writer.h"
 #include "virtual_key_detector.h"
 #include <chrono>
-#include <map>
 #include <string>
+#include <vector>
 
-// Mismatch tracker for a single key
-struct MismatchTracker {
-  bool isMismatched = false;
-  std::chrono::steady_clock::time_point startTime;
-
-  void reset();
-  void start();
-  int getDurationMs() const;
-  bool isStuck(int thresholdMs) const;
-};
-
-// Tracker for all modifier keys (dynamic, supports any number of keys)
-// Automatically tracks mismatch state for all monitored keys
-// Can be initialized with custom key lists
-class ModifierMismatchTrackers {
+// Observer of the production event loop: stage timing, trace events, stroke
+// recording, the flight recorder, shadow policies, forwarding latency and log
+// messages (per stroke at debug level)
+class FixerSink {
 public:
-  ModifierMismatchTrackers();
-
-  // Initialize trackers for given key IDs
-  void initializeForKeys(const std::vector<std::string> &keyIds);
-
-  // Get tracker by key ID
-  MismatchTracker *getTracker(const std::string &keyId);
-  const MismatchTracker *getTracker(const std::string &keyId) const;
-
-  // Check if any key is stuck
-  bool hasAnyStuck(int thresholdMs) const;
+  FixerSink(StageTimers &timers, StrokeRecorder &recorder,
+            FlightRecorder &flight, ShadowEvaluator &shadow)
+      : timers_(&timers), recorder_(&recorder), flight_(&flight),
+        shadow_(&shadow), showMessages_(true), receivedAt_(0),
+        loggedVirtualMask_(0) {}
+
+  class Iteration {
+  public:
+    explicit Iteration(FixerSink &sink)
+        : span_("processEvents"), lap_(*sink.timers_) {}
+    void lap(Stage stage) { lap_.lap(stage); }
+
+  private:
+    Trace::Span span_;
+    StageLap lap_;
+  };
+
+  // Stamped before any observer runs, so the forwarding latency includes
+  // their cost
+  void strokeReceived(InterceptionDevice device,
+                      const InterceptionKeyStroke &stroke) {
+#if ESCMODKEY_LATENCY_STATS
+    receivedAt_ = CycleClock::now();
+#endif
+    if (Trace::enabled()) {
+      Trace::instant("strokeReceived", "scanCode", stroke.code,
+                     (stroke.state & INTERCEPTION_KEY_UP) ? "up" : "down");
+    }
+    if (recorder_->isActive()) {
+      recorder_->recordStroke(static_cast<uint8_t>(device), stroke.code,
+                              stroke.state, stroke.information);
+    }
+    if (flight_->isActive()) {
+      flight_->recordStroke(static_cast<uint8_t>(device), stroke.code,
+                            stroke.state, stroke.information);
+    }
+    if (shadow_->isActive()) {
+      shadow_->recordStroke(stroke.code, stroke.state);
+    }
+    if (Log::enabled(LogLevel::Debug)) {
+      Log::debug("stroke device {} code 0x{x} state 0x{x}", device,
+                 stroke.code, stroke.state);
+    }
+  }
+
+  void strokeForwarded(FixStatistics &stats) {
+#if ESCMODKEY_LATENCY_STATS
+    stats.recordForwardLatency(CycleClock::now() - receivedAt_);
+#else
+    (void)stats;
+#endif
+  }
+
+  void fixTriggered(InterceptionDevice device,
+                    const InterceptionKeyStroke &trigger);
+  void timerFixTriggered(InterceptionDevice device);
+  void releaseDropped(InterceptionDevice device);
+  void keyDownLost(InterceptionDevice device, size_t keyIndex,
+                   const KeyState &key, int missingMs, bool repaired);
+  void keyFixed(InterceptionDevice device, size_t keyIndex,
+                const KeyState &key, int mismatchMs);
+  void fixCompleted(int fixedCount);
+  bool verifyFixes() const { return Trace::enabled(); }
+  void fixVerified(const KeyState &key, bool released);
+
+  void virtualStateUpdated(const ModifierKeyStates &physical,
+                           const VirtualKeyStates &virtualStates) {
+    if (recorder_->isActive()) {
+      recorder_->recordVirtualState(virtualStates.pressedMask(),
+                                    physical.pressedMask());
+    }
+    if (flight_->isActive()) {
+      flight_->recordVirtualState(virtualStates.pressedMask(),
+                                  physical.pressedMask());
+    }
+    if (shadow_->isActive()) {
+      shadow_->recordState(physical.pressedMask(), virtualStates.pressedMask());
+    }
+    if (Log::enabled(LogLevel::Debug) &&
+        virtualStates.pressedMask() != loggedVirtualMask_) {
+      loggedVirtualMask_ = virtualStates.pressedMask();
+      Log::debug("virtual keys 0x{x} (physical 0x{x})", loggedVirtualMask_,
+                 physical.pressedMask());
+    }
+  }
+
+  void trackerChanged(const TrackerEvent &event, const KeyState &key);
 
-  // Backward compatibility: access by field name
-  const MismatchTracker &lctrl() const;
-  const MismatchTracker &rctrl() const;
-  const MismatchTracker &lshift() const;
-  const MismatchTracker &rshift() const;
-  const MismatchTracker &lalt() const;
-  const MismatchTracker &ralt() const;
-  const MismatchTracker &lwin() const;
-  const MismatchTracker &rwin() const;
+  void setShowMessages(bool show) { showMessages_ = show; }
+  bool getShowMessages() const { return showMessages_; }
 
 private:
-  std::map<std::string, MismatchTracker> trackers_;
-  MismatchTracker emptyTracker_; // For backward compatibility
+  StageTimers *timers_;
+  StrokeRecorder *recorder_;
+  FlightRecorder *flight_;
+  ShadowEvaluator *shadow_;
+  bool showMessages_;
+  uint64_t receivedAt_;
+  uint32_t loggedVirtualMask_;
 };
 
-// Fix statistics (dynamic, supports any number of keys)
-// Automatically tracks fix counts for all monitored keys
-// Can be initialized with custom key lists
-class FixStatistics {
-public:
-  FixStatistics();
-
-  // Initialize statistics for given key IDs
-  void initializeForKeys(const std::vector<std::string> &keyIds);
-
-  // Increment fix count for a key
-  void incrementFix(const std::string &keyId);
-
-  // Get fix count for a key
-  int getFixCount(const std::string &keyId) const;
-
-  // Get total fixes
-  int getTotalFixes() const { return totalFixes_; }
-
-  // Reset all statistics
-  void reset();
-
-  // Backward compatibility: access by field name
-  int lctrlFixes() const;
-  int rctrlFixes() const;
-  int lshiftFixes() const;
-  int rshiftFixes() const;
-  int laltFixes() const;
-  int raltFixes() const;
-  int lwinFixes() const;
-  int rwinFixes() const;
-
-  // Get all fix counts
-  const std::map<std::string, int> &getAllFixes() const { return fixes_; }
-
-private:
-  int totalFixes_;
-  std::map<std::string, int> fixes_;
-};
+// The production event loop: Interception driver, GetAsyncKeyState, steady
+// clock (read once per iteration) and FixerSink
+using ProductionFixerCore =
+    FixerCore<InterceptionInput, VirtualKeyDetector, IterationClock, FixerSink>;
+extern template class FixerCore<InterceptionInput, VirtualKeyDetector,
+                                IterationClock, FixerSink>;
 
 // Main fixer class
 class ModifierKeyFixer {
 public:
   ModifierKeyFixer();
+  // Use the given time source instead of the steady clock. It is read once
+  // per processEvents() iteration and must outlive the fixer.
+  explicit ModifierKeyFixer(const Clock &clock);
   ~ModifierKeyFixer();
 
   // Initialization
@@ -111,47 +155,62 @@ public:
   const VirtualKeyStates &getVirtualStates() const;
   const ModifierMismatchTrackers &getMismatchTrackers() const;
   const FixStatistics &getStatistics() const;
+  const StageTimers &getStageTimers() const;
+  const StrokeRecorder &getRecorder() const { return recorder_; }
+  const FlightRecorder &getFlightRecorder() const { return flight_; }
+  // Write the flight recorder's recent history to a dump file. Safe from
+  // any thread; the dump is taken by the next processEvents() iteration.
+  void requestFlightDump() { flight_.requestDump(); }
+  // Candidate policies evaluated alongside the live one (shadowPolicies)
+  const ShadowEvaluator &getShadowEvaluator() const { return shadow_; }
+  // True if any monitored key's physical and virtual states disagree
+  bool hasAnyMismatch() const { return core_.logic().hasAnyMismatch(); }
 
   // Control
-  void pause();
-  void resume();
-  bool isPaused() const { return paused_; }
+  void pause() { core_.pause(); }
+  void resume() { core_.resume(); }
+  bool isPaused() const { return core_.isPaused(); }
 
   // Configuration
-  void setThreshold(int ms) { thresholdMs_ = ms; }
-  int getThreshold() const { return thresholdMs_; }
-  void setShowMessages(bool show) { showMessages_ = show; }
-  bool getShowMessages() const { return showMessages_; }
+  void setThreshold(int ms) { core_.setThreshold(ms); }
+  int getThreshold() const { return core_.getThreshold(); }
+  void setTimerFix(bool enabled) { core_.setTimerFix(enabled); }
+  bool getTimerFix() const { return core_.getTimerFix(); }
+  void setReleaseCheck(int ms) { core_.logic().setReleaseCheck(ms); }
+  int getReleaseCheck() const { return core_.logic().getReleaseCheck(); }
+  void setRepairKeyDown(bool enabled) { core_.setRepairKeyDown(enabled); }
+  bool getRepairKeyDown() const { return core_.getRepairKeyDown(); }
+  void setShowMessages(bool show) { core_.sink().setShowMessages(show); }
+  bool getShowMessages() const { return core_.sink().getShowMessages(); }
+  // Print a one-line stage timing summary every ms milliseconds (0 = off)
+  void setStageLogInterval(int ms);
+  int getStageLogInterval() const { return stageLogIntervalMs_; }
   void applyConfig(const Config &config);
 
   // Check if initialized
-  bool isInitialized() const { return context_ != nullptr; }
+  bool isInitialized() const;
 
 private:
-  // Detectors
-  PhysicalKeyDetector physicalDetector_;
-  VirtualKeyDetector virtualDetector_;
-
-  // Trackers
-  ModifierMismatchTrackers mismatchTrackers_;
-  FixStatistics stats_;
+  // Observed by the sink, so constructed before the core
+  StageTimers stageTimers_;
+  StrokeRecorder recorder_;
+  FlightRecorder flight_;
+  ShadowEvaluator shadow_;
 
-  // Interception
-  InterceptionContext context_;
+  // Detectors, trackers, fix decisions and the driver context
+  ProductionFixerCore core_;
 
   // Configuration
-  int thresholdMs_;
-  bool showMessages_;
-  bool paused_;
+  int stageLogIntervalMs_;
+  Clock::TimePoint nextStageLog_;
 
   // Internal methods
   bool initializeCommon();
-  void updateMismatchTrackers();
-  bool shouldCheckForFix(const InterceptionKeyStroke &stroke);
-  int fixStuckKeys(InterceptionDevice device);
-  void sendKeyRelease(InterceptionDevice device, unsigned short scanCode,
-                      bool needsE0);
-  bool hasOtherPhysicalKeyPressed(const InterceptionKeyStroke &stroke);
+  void startRecording(const Config &config);
+  void startFlightRecorder(const Config &config);
+  void startShadowPolicies(const Config &config);
+  std::vector<TraceFormat::KeyInfo> traceKeys() const;
+  void logStageTimings();
 };
 
 #endif // MODIFIER_KEY_FIXER_H
@@ -2,6 +2,7 @@
 #define PHYSICAL_KEY_DETECTOR_H
 
 #include "interception.h"
+#include <cstdint>
 #include <map>
 #include <string>
 #include <vector>
@@ -70,6 +71,9 @@ public:
   bool anyAlt() const;
   bool anyWin() const;
 
+  // Bit i set if key i is pressed (first 32 keys only)
+  uint32_t pressedMask() const;
+
   // Check if states have changed
   bool operator!=(const ModifierKeyStates &other) const;
 
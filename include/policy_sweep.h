@@ -0,0 +1,73 @@
+#ifndef POLICY_SWEEP_H
+#define POLICY_SWEEP_H
+
+#include "config.h"
+#include "fix_logic.h"
+#include "simulator.h"
+#include "work_stealing_pool.h"
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Parameter sweep of fix policies (escModKey_sweep).
+//
+// Every policy of a grid is replayed over every trace through Simulator, so
+// the real detector and fix logic decide under virtual time. The modelled
+// virtual layer is the ground truth: a fix is false if the key was only
+// lagging, and a lost key-up is missed if no fix released it (it healed on
+// the next key-up or was still stuck at the end). Each trace is replayed
+// with the same seed under every policy, so with no lag jitter all policies
+// see the same lost key-ups.
+
+// A fix policy to evaluate
+struct SweepPolicy {
+  int thresholdMs = 1000;
+  FixTrigger trigger = FixTrigger::IdleKeyDown;
+  std::vector<std::pair<std::string, int>> keyThresholds; // Key ID, ms
+
+  // e.g. "750ms idle lwin=2000"
+  std::string describe() const;
+};
+
+// Outcome of one policy, summed over traces
+struct SweepResult {
+  uint64_t strokes = 0;
+  uint64_t droppedKeyUps = 0;
+  uint64_t fixes = 0;
+  uint64_t falseFixes = 0;
+  uint64_t selfHealed = 0; // Lost key-ups repaired by the user, not a fix
+  uint64_t stillStuck = 0; // Lost key-ups never repaired
+  uint64_t stuckNs = 0;    // Time keys spent stuck (resolved cases only)
+  uint64_t virtualNs = 0;  // Replayed virtual time
+
+  uint64_t trueFixes() const { return fixes - falseFixes; }
+  uint64_t missedStuck() const { return selfHealed + stillStuck; }
+
+  // Share of fixes that released a key that was not stuck
+  double falseFixRate() const;
+  // Share of stuck keys that no fix released
+  double missedStuckRate() const;
+  double falseFixesPerHour() const;
+
+  void add(const SweepResult &other);
+};
+
+// Every combination of the given values. Each per-key list is a dimension
+// of its own; 0 in it means no override for that key.
+std::vector<SweepPolicy>
+buildSweepGrid(const std::vector<int> &thresholdsMs,
+               const std::vector<FixTrigger> &triggers,
+               const std::vector<std::pair<std::string, std::vector<int>>>
+                   &keyThresholds);
+
+// Replay every (policy, trace) pair on the pool and return one result per
+// policy, in grid order. Keys are selected by config if given, else the
+// default set; the policies' key IDs must be monitored.
+std::vector<SweepResult>
+runSweep(const std::vector<SweepPolicy> &policies,
+         const std::vector<std::vector<SimStroke>> &traces,
+         const SimulationOptions &options, const Config *config,
+         WorkStealingPool &pool);
+
+#endif // POLICY_SWEEP_H
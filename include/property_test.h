@@ -0,0 +1,124 @@
+#ifndef PROPERTY_TEST_H
+#define PROPERTY_TEST_H
+
+#include "work_stealing_pool.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Property-based test engine shared by the *_pbt tests.
+//
+// A property draws its inputs from a PropertySource and returns true if it
+// holds. Every draw is recorded as a number, so a failing case can be
+// replayed and shrunk by editing that sequence: runs of draws are removed
+// and values lowered towards zero while the property still fails. Any
+// generator therefore shrinks without extra code, as long as smaller draws
+// mean simpler inputs (shorter lists, earlier entries, false before true).
+// Do not redraw until a value fits: past the recorded draws a replay
+// returns 0 forever, so adjust the value instead.
+//
+// Cases are independent and run on a WorkStealingPool, so a property must
+// not share mutable state between cases (use index() for unique file
+// names). Case i of a property is drawn from the run seed, the property
+// name and i only, so a run is reproducible whatever the thread count. The
+// seed is printed with every failure; set ESCMODKEY_PBT_SEED to replay a
+// run exactly, and ESCMODKEY_PBT_SCALE to multiply the case counts.
+class PropertySource {
+public:
+  // Fresh case: draws come from seed
+  PropertySource(uint64_t seed, size_t index);
+
+  // Replay: draws come from choices (0 once they run out)
+  PropertySource(const std::vector<uint64_t> &choices, size_t index);
+
+  // Uniform in [0, count); count 0 is treated as 1
+  uint64_t draw(uint64_t count);
+
+  // Uniform in [low, high]
+  int range(int low, int high) {
+    return low + static_cast<int>(draw(static_cast<uint64_t>(high - low) + 1));
+  }
+
+  bool boolean() { return draw(2) == 1; }
+
+  template <typename T> const T &pick(const std::vector<T> &items) {
+    return items[static_cast<size_t>(draw(items.size()))];
+  }
+
+  // Whether to add another element to a list of size elements (at most
+  // maxSize). One draw per element, so removing an element's draws
+  // shortens the list. Mean length about 7 without a limit.
+  bool another(size_t size, size_t maxSize) {
+    return size < maxSize && draw(8) != 0;
+  }
+
+  // Describe an input; printed with the minimal failing case
+  void note(const std::string &text);
+
+  // Record why the property failed; returns false for 'return fail(...)'
+  bool fail(const std::string &message);
+
+  size_t index() const { return index_; }
+  const std::vector<uint64_t> &getChoices() const { return choices_; }
+  const std::vector<std::string> &getNotes() const { return notes_; }
+  const std::string &getMessage() const { return message_; }
+
+private:
+  uint64_t next();
+
+  uint64_t state_;
+  bool replay_;
+  size_t position_;
+  size_t index_;
+  std::vector<uint64_t> choices_;
+  std::vector<std::string> notes_;
+  std::string message_;
+};
+
+using Property = std::function<bool(PropertySource &source)>;
+
+// The minimal failing case of a property
+struct PropertyFailure {
+  std::string property;
+  size_t caseIndex = 0; // First failing case
+  std::vector<uint64_t> choices;
+  std::vector<std::string> notes;
+  std::string message;
+  size_t shrinkSteps = 0; // Accepted simplifications
+};
+
+class PropertyRunner {
+public:
+  // threads = 0 uses one worker per hardware thread. The seed is taken
+  // from ESCMODKEY_PBT_SEED if set, else from std::random_device.
+  explicit PropertyRunner(size_t threads = 0);
+
+  void setSeed(uint64_t seed) { seed_ = seed; }
+  uint64_t getSeed() const { return seed_; }
+
+  // Cases actually run for a requested count (ESCMODKEY_PBT_SCALE)
+  size_t scaled(size_t iterations) const;
+
+  // Run the property on scaled(iterations) cases, print the result and,
+  // on failure, the shrunk counterexample. Returns true if it held.
+  bool check(const std::string &name, size_t iterations,
+             const Property &property);
+
+  const PropertyFailure &getLastFailure() const { return lastFailure_; }
+
+  // Print the summary of all checks; returns the process exit code
+  int finish() const;
+
+private:
+  WorkStealingPool pool_;
+  uint64_t seed_;
+  double scale_;
+  size_t passed_;
+  size_t failed_;
+  uint64_t cases_;
+  PropertyFailure lastFailure_;
+};
+
+#endif // PROPERTY_TEST_H
@@ -0,0 +1,36 @@
+#ifndef QUANTILE_ESTIMATOR_H
+#define QUANTILE_ESTIMATOR_H
+
+#include <cstdint>
+
+// Streaming estimate of one quantile in constant memory: the P² algorithm
+// (Jain and Chlamtac, 1985). Five markers hold the minimum, the maximum, the
+// quantile and the quantiles halfway to either side; each value moves them
+// with a piecewise-parabolic interpolation. add() never allocates.
+class P2Quantile {
+public:
+  // quantile in (0, 1), e.g. 0.99
+  explicit P2Quantile(double quantile = 0.5);
+
+  void reset();
+  void add(double value);
+
+  // Current estimate; exact for fewer than five values, 0 if there are none
+  double value() const;
+
+  uint64_t count() const { return count_; }
+  double quantile() const { return p_; }
+
+private:
+  double parabolic(int i, double d) const;
+  double linear(int i, double d) const;
+
+  double p_;
+  uint64_t count_;
+  double heights_[5];   // Marker heights (the first values, until five)
+  double positions_[5]; // Actual marker positions, 1-based
+  double desired_[5];   // Desired marker positions
+  double increments_[5];
+};
+
+#endif // QUANTILE_ESTIMATOR_H
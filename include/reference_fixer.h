@@ -0,0 +1,83 @@
+#ifndef REFERENCE_FIXER_H
+#define REFERENCE_FIXER_H
+
+#include "config.h"
+#include "fix_logic.h"
+#include "interception.h"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Frozen reference of the physical key detector and the fix logic, used by
+// the differential harness (escModKey_diff) as the oracle for the live code.
+//
+// This is a deliberately separate, self-contained copy of the behaviour of
+// PhysicalKeyDetector, the ID matching of VirtualKeyStates, MismatchTracker
+// and FixLogic at the time the harness was introduced, including their
+// quirks (the first key wins a scan code, the last mapping wins a source,
+// keys with the same ID share one tracker). Do not change it along with the
+// live code: the harness exists to catch unintended differences. Change it
+// only to adopt a behaviour change on purpose, in its own commit.
+// Times are plain nanoseconds.
+class ReferenceFixer {
+public:
+  struct Key {
+    std::string id;
+    unsigned short scanCode;
+    bool needsE0;
+    bool pressed;
+  };
+
+  struct Tracker {
+    bool isMismatched = false;
+    bool stuckReported = false;
+    int64_t startNs = 0;
+  };
+
+  ReferenceFixer();
+
+  // Key tables, mapping table and trackers from the given key selection
+  void initialize(bool monitorCtrl, bool monitorShift, bool monitorAlt,
+                  bool monitorWin, const std::vector<std::string> &disabledKeys,
+                  const std::vector<CustomKeyConfig> &customKeys,
+                  const std::vector<KeyMappingConfig> &keyMappings);
+
+  void setThreshold(int ms) { thresholdMs_ = ms; }
+  void setKeyThreshold(size_t keyIndex, int ms);
+  void setTrigger(FixTrigger trigger) { trigger_ = trigger; }
+
+  // Physical state update for one stroke (monitored key, then mapping)
+  void processKeyStroke(const InterceptionKeyStroke &stroke);
+
+  // virtualPressed is index-aligned with getVirtualIds()
+  void updateTrackers(const std::vector<bool> &virtualPressed, int64_t nowNs,
+                      std::vector<TrackerEvent> *events);
+
+  bool shouldFix(const InterceptionKeyStroke &stroke, int64_t nowNs) const;
+  bool isStuck(size_t keyIndex, int64_t nowNs) const;
+  int getMismatchMs(size_t keyIndex, int64_t nowNs) const;
+
+  const std::vector<Key> &getKeys() const { return keys_; }
+  const std::vector<std::string> &getVirtualIds() const { return virtualIds_; }
+  const Tracker &getTracker(size_t keyIndex) const {
+    return *trackerByIndex_[keyIndex];
+  }
+
+private:
+  int keyThreshold(size_t keyIndex) const;
+  static int durationMs(const Tracker &tracker, int64_t nowNs);
+
+  std::vector<Key> keys_;
+  std::vector<std::string> virtualIds_;
+  std::map<std::pair<unsigned short, bool>, std::string> keyMappings_;
+  std::map<std::string, Tracker> trackers_;
+  std::vector<Tracker *> trackerByIndex_;
+  std::vector<int> virtualIndex_;
+  std::vector<int> keyThresholdMs_;
+  int thresholdMs_;
+  FixTrigger trigger_;
+};
+
+#endif // REFERENCE_FIXER_H
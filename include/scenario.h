@@ -0,0 +1,129 @@
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Scenario language for detector and fix logic tests (escModKey_scenario).
+//
+// A scenario is a list of commands, one per line or separated by ';'. '#'
+// starts a comment:
+//
+//   # A lost Ctrl key-up is fixed by the next key-down
+//   down lctrl; up lctrl lost
+//   advance 1200ms
+//   down a
+//   expect fix lctrl
+//
+// Scenarios run through FixerCore, the fixer's event loop, with in-memory
+// policies: a virtual clock that only moves on 'advance' and fix settle
+// delays, an input queue in place of the driver, and a modelled OS key
+// layer that applies forwarded and injected strokes at once. Every stroke
+// and every 'virt' is one loop iteration at the current time; 'advance'
+// runs an idle iteration (wait timeout) every poll interval, at release
+// checks and, with timer fixes, at the moment a key becomes stuck.
+//
+// Setup (monitor, disable, custom and map only before any other command)
+//   monitor <group>...          ctrl shift alt win (default: all)
+//   disable <id>                stop monitoring a key
+//   custom <name> <scan> <vk>   monitor a custom key; its id is the name
+//                               in lower case without spaces
+//   map <scan> <id>             additional key mapping
+//   threshold [<id>] <ms>       global or per-key threshold
+//   trigger idle|any|other      fix trigger
+//   timer on|off                timer fixes: release stuck keys at their
+//                               deadline (after the first stroke)
+//   releasecheck <ms>           release a key whose key-up the OS has not
+//                               followed within ms (0: off)
+//   lostkeydown <ms>            a key held this long that the OS never saw
+//                               go down is a lost key-down (default 100)
+//   repair on|off               send lost key-downs again
+//   poll <ms>                   idle iteration interval (default 50)
+//   settle <ms>                 fix settle delay (default 20)
+// Input
+//   down <key>, up <key>        stroke; 'down|up <key> lost' never reaches
+//                               the OS layer
+//   virt <id>=0|1               set the OS state of a key
+//   advance <n>[ms|s]           let time pass
+// Checks (the first failing one ends the scenario)
+//   expect fix <id>...          the last stroke or advance released exactly
+//                               these keys
+//   expect nofix                the last stroke or advance released no key
+//   expect fixes <n>            keys released so far
+//   expect ok|mismatch|stuck|missing <id>
+//                               tracker state (mismatch: not yet stuck;
+//                               missing: held, but not down in the OS)
+//   expect phys|virt <id>=0|1   physical or OS state of a key
+//
+// <id> is a monitored key id. <key> is a monitored key id, a modifier id,
+// a name (a-z, 0-9, esc, tab, space, enter, backspace, capslock) or a scan
+// code. <scan> is a scan code: 0x1e, 30, or e0:0x1d for an E0 key.
+
+enum class ScenarioOp {
+  Monitor,
+  Disable,
+  Custom,
+  Map,
+  Threshold,
+  Trigger,
+  Timer,
+  ReleaseCheck,
+  LostKeyDown,
+  Repair,
+  Poll,
+  Settle,
+  Down,
+  Up,
+  Virt,
+  Advance,
+  ExpectFix,
+  ExpectFixes,
+  ExpectTracker,
+  ExpectPhysical,
+  ExpectVirtual
+};
+
+// Tracker states for 'expect ok|mismatch|stuck|missing'
+enum class ScenarioTracker { Ok, Mismatch, Stuck, Missing };
+
+struct ScenarioCommand {
+  ScenarioOp op = ScenarioOp::Advance;
+  int line = 0;
+  std::string key;               // Key, id, name or trigger argument
+  std::vector<std::string> keys; // Monitored groups, fixed key ids
+  unsigned short scanCode = 0;   // custom, map
+  bool needsE0 = false;
+  int64_t value = 0; // ms, ns (advance), count, vk code or 0/1 state
+  bool flag = false; // Stroke lost
+  ScenarioTracker tracker = ScenarioTracker::Ok;
+};
+
+struct Scenario {
+  std::string name; // File name, for reports
+  std::vector<ScenarioCommand> commands;
+};
+
+// Parse scenario text. On error returns false with "line N: ..." in error.
+bool parseScenario(const std::string &text, Scenario &scenario,
+                   std::string &error);
+
+struct ScenarioResult {
+  bool passed = false;
+  int line = 0; // Line of the failing command, 0 if none
+  std::string message;
+  uint64_t strokes = 0;
+  uint64_t checks = 0;
+};
+
+// Run a parsed scenario from a fresh fixer state
+ScenarioResult runScenario(const Scenario &scenario);
+
+// Read and parse a file (the name is the path)
+bool loadScenarioFile(const std::string &path, Scenario &scenario,
+                      std::string &error);
+
+// Load and run a file; load errors fail the result
+ScenarioResult runScenarioFile(const std::string &path);
+
+#endif // SCENARIO_H
@@ -0,0 +1,186 @@
+#ifndef SHADOW_POLICY_H
+#define SHADOW_POLICY_H
+
+#include "clock.h"
+#include "fix_logic.h"
+#include "physical_key_detector.h"
+#include "virtual_key_detector.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Candidate fix policies evaluated alongside the live one without acting.
+//
+// The input thread pushes strokes, changes of the physical and virtual
+// pressed masks and live fixes into a fixed-size single-producer ring (a few
+// stores per event; when the ring is full events are dropped and counted
+// rather than blocking). A background thread drains the ring and runs one
+// FixLogic per shadow policy on the same snapshots. A policy "would fix" a
+// stuck key when its trigger fires; that decision is compared with what the
+// live policy did in the same mismatch episode. Events are stamped with the
+// live loop's clock, so both decide on the same instants. Nothing is
+// injected, so a shadow policy sees the virtual state the live policy
+// produced.
+struct ShadowPolicy {
+  int thresholdMs = 1000;
+  FixTrigger trigger = FixTrigger::IdleKeyDown;
+
+  // e.g. "750ms any"
+  std::string describe() const;
+
+  // "<ms>" or "<ms>:<trigger>" (e.g. "750", "1500:other")
+  static bool parse(const std::string &text, ShadowPolicy &policy);
+};
+
+struct ShadowResult {
+  ShadowPolicy policy;
+  uint64_t wouldFix = 0;   // Keys the policy would have released
+  uint64_t agreed = 0;     // ... that the live policy released too
+  uint64_t shadowOnly = 0; // ... whose mismatch ended without a live fix
+  uint64_t liveOnly = 0;   // Live fixes the policy had not made (yet)
+  int64_t leadNs = 0;      // Sum over agreed fixes of live minus shadow time
+
+  // Mean time by which the policy would have fixed before the live one
+  double meanLeadMs() const {
+    return agreed > 0 ? leadNs / 1e6 / static_cast<double>(agreed) : 0.0;
+  }
+};
+
+class ShadowEvaluator {
+public:
+  ShadowEvaluator();
+  ~ShadowEvaluator();
+
+  ShadowEvaluator(const ShadowEvaluator &) = delete;
+  ShadowEvaluator &operator=(const ShadowEvaluator &) = delete;
+
+  // Copy the monitored key tables and start the evaluation thread. Events
+  // are stamped with clock (read on the input thread; it must outlive the
+  // evaluator). capacity is the ring size in events (rounded up to a power
+  // of two).
+  void start(const std::vector<ShadowPolicy> &policies,
+             const ModifierKeyStates &physical,
+             const VirtualKeyStates &virtualStates, const Clock &clock,
+             size_t capacity = 4096);
+
+  // Evaluate what is left in the ring and stop the thread
+  void stop();
+
+  bool isActive() const { return active_; }
+
+  // Hot path (input thread only)
+  void recordStroke(uint16_t code, uint16_t state) {
+    Event event;
+    event.type = kStroke;
+    event.code = code;
+    event.state = state;
+    push(event);
+  }
+
+  // Record the pressed masks if they differ from the last ones recorded
+  void recordState(uint32_t physicalMask, uint32_t virtualMask) {
+    if (physicalMask == lastPhysicalMask_ && virtualMask == lastVirtualMask_) {
+      return;
+    }
+    Event event;
+    event.type = kState;
+    event.physicalMask = physicalMask;
+    event.virtualMask = virtualMask;
+    if (push(event)) {
+      lastPhysicalMask_ = physicalMask;
+      lastVirtualMask_ = virtualMask;
+    }
+  }
+
+  void recordLiveFix(size_t keyIndex) {
+    Event event;
+    event.type = kLiveFix;
+    event.keyIndex = static_cast<uint8_t>(keyIndex);
+    push(event);
+  }
+
+  // Results so far, one per policy in start() order
+  std::vector<ShadowResult> getResults() const;
+
+  // Multi-line comparison with the live policy's fix count
+  std::string summary(uint64_t liveFixes) const;
+
+  uint64_t getDroppedCount() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+  // Wait until every recorded event has been evaluated (tests)
+  void waitIdle();
+
+private:
+  enum EventType : uint8_t { kStroke, kState, kLiveFix };
+
+  struct Event {
+    int64_t timeNs = 0;
+    uint8_t type = kStroke;
+    uint8_t keyIndex = 0;
+    uint16_t code = 0;
+    uint16_t state = 0;
+    uint32_t physicalMask = 0;
+    uint32_t virtualMask = 0;
+  };
+
+  // One candidate policy and its per-key episode state
+  struct Shadow {
+    FixLogic logic;
+    ShadowResult result;
+    std::vector<bool> fixed;         // Would have fixed in this episode
+    std::vector<bool> liveFixed;     // Live policy fixed in this episode
+    std::vector<int64_t> fixedAtNs;  // When the policy would have fixed
+  };
+
+  bool push(Event &event) {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) > mask_) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    event.timeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       clock_->now().time_since_epoch())
+                       .count();
+    ring_[head & mask_] = event;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  void evaluatorLoop();
+  void evaluate(const Event &event);
+
+  bool active_;
+  const Clock *clock_;
+
+  // Ring: written by the input thread, read by the evaluation thread
+  std::vector<Event> ring_;
+  uint64_t mask_;
+  std::atomic<uint64_t> head_;
+  std::atomic<uint64_t> tail_;
+  std::atomic<uint64_t> dropped_;
+  uint32_t lastPhysicalMask_; // Input thread only
+  uint32_t lastVirtualMask_;
+
+  // Evaluation thread only
+  ModifierKeyStates physical_;
+  VirtualKeyStates virtual_;
+  std::vector<std::unique_ptr<Shadow>> shadows_;
+  std::vector<TrackerEvent> events_;
+
+  // Published results and thread control (guarded by mutex_)
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stopRequested_;
+  std::vector<ShadowResult> results_;
+  std::thread thread_;
+};
+
+#endif // SHADOW_POLICY_H
@@ -0,0 +1,308 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include "clock.h"
+#include "config.h"
+#include "fix_logic.h"
+#include "fixer_core.h"
+#include "physical_key_detector.h"
+#include "trace_format.h"
+#include "virtual_key_detector.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Headless, virtual-time simulation of the fixer.
+//
+// Strokes are fed with virtual timestamps and run through FixerCore, the
+// same event loop ModifierKeyFixer uses, with simulation policies for input,
+// virtual state and time. Forwarded strokes reach a modelled virtual (OS)
+// key layer after a configurable lag, and key-ups and key-downs can be
+// dropped on the way to reproduce stuck keys and keys the OS never
+// registered. Idle processEvents() iterations (wait timeouts) are emulated
+// too.
+// Nothing sleeps or reads the wall clock, so traces run at full CPU speed.
+
+// Small deterministic PRNG (xorshift64*) so runs are reproducible
+class SimRandom {
+public:
+  explicit SimRandom(uint64_t seed)
+      : state_(seed ? seed : 0x9E3779B97F4A7C15ull) {}
+
+  uint64_t next() {
+    state_ ^= state_ >> 12;
+    state_ ^= state_ << 25;
+    state_ ^= state_ >> 27;
+    return state_ * 0x2545F4914F6CDD1Dull;
+  }
+
+  // Uniform in [0, 1)
+  double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+
+  // Uniform integer in [low, high]
+  uint64_t range(uint64_t low, uint64_t high) {
+    return low + next() % (high - low + 1);
+  }
+
+private:
+  uint64_t state_;
+};
+
+// Behaviour of the modelled virtual key layer
+struct VirtualLayerModel {
+  double lagMs = 1.0;           // Delay from forwarding to OS state change
+  double lagJitterMs = 0.0;     // Extra uniform random delay (order is kept)
+  double dropKeyUpRate = 0.0;   // Probability a forwarded key-up is lost
+  double dropKeyDownRate = 0.0; // Same for a forwarded key-down
+  uint64_t seed = 1;
+};
+
+struct SimulationOptions {
+  VirtualLayerModel layer;
+  int pollTimeoutMs = 50; // processEvents() wait timeout
+  int fixSettleMs = 20;   // Delay after injecting releases (Sleep in fixer)
+};
+
+// One input stroke at a virtual time
+struct SimStroke {
+  uint64_t timeNs;
+  uint16_t code;
+  uint16_t state; // Interception key state flags
+};
+
+// A fix the logic decided to perform
+struct FixDecision {
+  uint64_t timeNs;      // Virtual time of the triggering key-down or timer
+  size_t keyIndex;      // Index into the physical key list
+  int mismatchMs;       // Mismatch duration when the fix fired
+  uint16_t triggerCode; // Scan code of the triggering key-down, 0 = none
+  bool releaseCheck;    // Released by a failed release check, not a timer
+  bool causedByDrop;    // The key really was stuck (its key-up was lost)
+};
+
+struct SimulationReport {
+  uint64_t strokes = 0;
+  uint64_t iterations = 0;        // processEvents() iterations executed
+  uint64_t droppedKeyUps = 0;     // Key-ups lost by the virtual layer
+  uint64_t stuckEvents = 0;       // Tracker Stuck transitions
+  uint64_t fixes = 0;             // Releases injected
+  uint64_t falseFixes = 0;        // Fixes for keys that were only lagging
+  uint64_t timerFixes = 0;        // Fixes released by the timer (no trigger)
+  uint64_t releaseCheckFixes = 0; // Fixes after a failed release check
+  uint64_t selfHealed = 0;        // Lost key-ups repaired by a later key-up
+  uint64_t stuckNs = 0;           // Time keys spent stuck (resolved cases only)
+  uint64_t droppedKeyDowns = 0;   // Key-downs lost by the virtual layer
+  uint64_t lostKeyDowns = 0;      // Held keys reported as not registered
+  uint64_t keyDownRepairs = 0;    // Key-downs sent again
+  uint64_t missingNs = 0;         // Time dropped key-downs went unregistered
+  uint64_t endTimeNs = 0;
+  std::vector<FixDecision> decisions;
+};
+
+class Simulator {
+public:
+  explicit Simulator(const SimulationOptions &options = SimulationOptions());
+
+  // Monitor the default key set, or the keys selected by a configuration
+  // (the threshold is taken from the configuration too)
+  void initialize();
+  void initialize(const Config &config);
+
+  void setThreshold(int ms) { core_.setThreshold(ms); }
+  int getThreshold() const { return core_.getThreshold(); }
+
+  // Fix policy beyond the threshold (after initialize()). Returns false if
+  // the key is not monitored.
+  bool setKeyThreshold(const std::string &keyId, int ms);
+  void setTrigger(FixTrigger trigger) { core_.logic().setTrigger(trigger); }
+  void setAdaptive(const AdaptiveThresholdConfig &adaptive) {
+    core_.logic().setAdaptive(adaptive);
+  }
+  // Idle iterations also run at stuck deadlines (see FixerCore)
+  void setTimerFix(bool enabled) { core_.setTimerFix(enabled); }
+  // Release keys whose key-up the virtual layer has not applied within ms
+  void setReleaseCheck(int ms) { core_.logic().setReleaseCheck(ms); }
+  // Lost key-down detection and repair
+  void setLostKeyDownThreshold(int ms) {
+    core_.logic().setLostKeyDownThreshold(ms);
+  }
+  void setRepairKeyDown(bool enabled) { core_.setRepairKeyDown(enabled); }
+  // Change the virtual layer's lag for strokes forwarded from now on
+  void setLag(double lagMs) { options_.layer.lagMs = lagMs; }
+
+  // Process one stroke. Strokes must be fed in non-decreasing time order.
+  void feed(const SimStroke &stroke);
+
+  // Process a whole trace, then idle until the last fix has settled
+  void run(const std::vector<SimStroke> &strokes);
+
+  // Run idle iterations up to timeNs
+  void advanceTo(uint64_t timeNs);
+
+  // Current virtual time
+  uint64_t now() const { return nowNs_; }
+
+  // Keys whose key-up was lost and that are still pressed in the OS
+  int countStuckKeys() const;
+
+  const SimulationReport &getReport() const { return report_; }
+  const FixLogic &getLogic() const { return core_.logic(); }
+  const ModifierKeyStates &getPhysicalStates() const {
+    return core_.getPhysicalStates();
+  }
+  const VirtualKeyStates &getVirtualStates() const {
+    return core_.getVirtualStates();
+  }
+
+private:
+  // FixerCore policies backed by the simulator state
+  class Input {
+  public:
+    explicit Input(Simulator *sim) : sim_(sim) {}
+    InterceptionDevice wait(int) { return sim_->stroke_ ? kDevice : 0; }
+    bool receive(InterceptionDevice, InterceptionKeyStroke &stroke);
+    void send(InterceptionDevice, const InterceptionKeyStroke &stroke) {
+      sim_->forward(stroke.code, stroke.state, false);
+    }
+    void inject(InterceptionDevice, const InterceptionKeyStroke &stroke) {
+      sim_->forward(stroke.code, stroke.state, true);
+    }
+
+  private:
+    Simulator *sim_;
+  };
+
+  // The modelled OS key layer; update() applies the changes that are due
+  class VirtualLayer {
+  public:
+    explicit VirtualLayer(Simulator *sim) : sim_(sim) {}
+    void initialize() { states_.initializeDefaultKeys(); }
+    void initializeWithConfig(bool monitorCtrl, bool monitorShift,
+                              bool monitorAlt, bool monitorWin,
+                              const std::vector<std::string> &disabledKeys,
+                              const std::vector<CustomKeyConfig> &customKeys) {
+      states_.initializeWithConfig(monitorCtrl, monitorShift, monitorAlt,
+                                   monitorWin, disabledKeys, customKeys);
+    }
+    void update() { sim_->applyDueChanges(); }
+    const VirtualKeyStates &getStates() const { return states_; }
+    VirtualKeyStates &getStates() { return states_; }
+
+  private:
+    Simulator *sim_;
+    VirtualKeyStates states_;
+  };
+
+  // Virtual time; also serves the trackers' no-argument queries
+  class SimClock final : public Clock {
+  public:
+    explicit SimClock(Simulator *sim) : sim_(sim) {}
+    TimePoint now() const override;
+    void refresh() {}
+    void sleepMs(int ms);
+
+  private:
+    Simulator *sim_;
+  };
+
+  // Collects the report
+  class Sink : public NullSink {
+  public:
+    explicit Sink(Simulator *sim)
+        : sim_(sim), triggerCode_(0), releaseCheck_(false) {}
+    struct Iteration {
+      explicit Iteration(Sink &sink) { sink.sim_->report_.iterations++; }
+      void lap(Stage) {}
+    };
+    void strokeReceived(InterceptionDevice, const InterceptionKeyStroke &) {
+      sim_->report_.strokes++;
+    }
+    void fixTriggered(InterceptionDevice, const InterceptionKeyStroke &trigger) {
+      triggerCode_ = trigger.code;
+      releaseCheck_ = false;
+    }
+    void timerFixTriggered(InterceptionDevice) {
+      triggerCode_ = 0;
+      releaseCheck_ = false;
+    }
+    void releaseDropped(InterceptionDevice) {
+      triggerCode_ = 0;
+      releaseCheck_ = true;
+    }
+    void keyDownLost(InterceptionDevice, size_t, const KeyState &, int,
+                     bool repaired) {
+      sim_->report_.lostKeyDowns++;
+      if (repaired) {
+        sim_->report_.keyDownRepairs++;
+      }
+    }
+    void keyFixed(InterceptionDevice, size_t keyIndex, const KeyState &,
+                  int mismatchMs);
+    void trackerChanged(const TrackerEvent &event, const KeyState &) {
+      if (event.change == TrackerChange::Stuck) {
+        sim_->report_.stuckEvents++;
+      }
+    }
+
+  private:
+    Simulator *sim_;
+    uint16_t triggerCode_;
+    bool releaseCheck_;
+  };
+
+  static const InterceptionDevice kDevice = 1;
+
+  struct PendingChange {
+    uint64_t dueNs;
+    int virtualIndex;
+    bool pressed;
+    bool injected; // Release sent by a fix
+  };
+
+  void setup();
+  uint64_t nextIdleNs() const;
+  void iterate(const SimStroke *stroke);
+  void forward(uint16_t code, uint16_t state, bool injected);
+  void applyDueChanges();
+
+  SimulationOptions options_;
+  SimRandom random_;
+  FixerCore<Input, VirtualLayer, SimClock, Sink> core_;
+  const SimStroke *stroke_; // Input for the current iteration, if any
+
+  // Virtual layer
+  std::vector<PendingChange> pending_; // Sorted by dueNs
+  size_t pendingHead_;
+  uint64_t lastDueNs_;
+  std::vector<int> scanToVirtual_;     // (code | e0 << 8) -> virtual index
+  std::vector<uint64_t> droppedAt_;    // Per virtual key, 0 = not stuck
+  std::vector<uint64_t> missedAt_;     // Same for a dropped key-down
+  std::vector<int> physicalToVirtual_; // Physical index -> virtual index
+
+  uint64_t nowNs_;
+  uint64_t lastIterationNs_;
+  uint64_t pollNs_;
+  SimulationReport report_;
+};
+
+// Options for synthetic typing traces
+struct TraceGeneratorOptions {
+  uint64_t seed = 1;
+  uint64_t strokeCount = 100000; // Approximate number of strokes
+  double meanGapMs = 120.0;      // Mean pause between key presses
+  double chordRate = 0.3;        // Probability a press is a modifier chord
+  double holdMs = 80.0;          // Mean key hold time
+};
+
+// Generate modifier chords and plain key presses using the monitored keys
+std::vector<SimStroke> generateTrace(const TraceGeneratorOptions &options,
+                                     const ModifierKeyStates &keys);
+
+// Stroke records of a recorded trace, in order
+std::vector<SimStroke> strokesFromTrace(const TraceFormat::TraceFile &trace);
+
+// Convert strokes to trace records (for writing with writeTraceFile)
+std::vector<TraceFormat::TraceRecord>
+strokesToRecords(const std::vector<SimStroke> &strokes);
+
+#endif // SIMULATOR_H
@@ -0,0 +1,127 @@
+#ifndef STAGE_TIMERS_H
+#define STAGE_TIMERS_H
+
+#include "cycle_clock.h"
+#include "latency_histogram.h"
+#include "trace_writer.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Compile-time switch for per-stage hot-path timing.
+// Build with ESCMODKEY_STAGE_TIMING=0 (xmake f --stage_timing=n) to turn
+// every StageLap call into a no-op.
+#ifndef ESCMODKEY_STAGE_TIMING
+#define ESCMODKEY_STAGE_TIMING 1
+#endif
+
+// Stages of one FixerCore::processEvents() iteration, in execution order
+// (Fix also times the release check before a stroke and the lost key-down
+// and timer fix handling after the trackers)
+enum class Stage {
+  Wait,           // Input::wait (interception_wait_with_timeout)
+  Receive,        // Input::receive (interception_receive)
+  CheckFix,       // FixLogic::shouldFix
+  Fix,            // FixerCore::fixStuckKeys (includes its settle delay)
+  PhysicalUpdate, // PhysicalKeyDetector::processKeyStroke
+  Forward,        // Input::send (interception_send)
+  VirtualUpdate,  // VirtualState::update
+  TrackerUpdate,  // FixerCore::updateTrackers
+  Count
+};
+
+constexpr int kStageCount = static_cast<int>(Stage::Count);
+
+// Short stage name for dumps and log lines (e.g. "checkFix")
+const char *stageName(Stage stage);
+
+// Per-stage totals, maximums and duration histograms.
+// Single writer (the input thread); readers on other threads see relaxed but
+// never torn per-field values.
+class StageTimers {
+public:
+  StageTimers();
+
+  StageTimers(const StageTimers &) = delete;
+  StageTimers &operator=(const StageTimers &) = delete;
+
+  // Record one execution of a stage, duration in CycleClock ticks
+  void record(Stage stage, uint64_t ticks) {
+    StageCounter &counter = stages_[static_cast<int>(stage)];
+    counter.count.store(counter.count.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_relaxed);
+    counter.totalTicks.store(
+        counter.totalTicks.load(std::memory_order_relaxed) + ticks,
+        std::memory_order_relaxed);
+    if (ticks > counter.maxTicks.load(std::memory_order_relaxed)) {
+      counter.maxTicks.store(ticks, std::memory_order_relaxed);
+    }
+    counter.histogram.record(ticks);
+  }
+
+  // Clear all counters (must not race with record())
+  void reset();
+
+  uint64_t getCount(Stage stage) const;
+  uint64_t getTotalNs(Stage stage) const;
+  uint64_t getMaxNs(Stage stage) const;
+  const LatencyHistogram &getHistogram(Stage stage) const {
+    return stages_[static_cast<int>(stage)].histogram;
+  }
+
+  // Multi-line table: count, total, mean, p50/p99/max per stage
+  std::string dump() const;
+
+  // Compact single line for periodic logging
+  std::string logLine() const;
+  // Same into a caller's buffer, truncated if needed (no allocation, so it
+  // can run on the event loop thread); returns the length written
+  size_t formatLogLine(char *buffer, size_t size) const;
+
+private:
+  // Raw ticks throughout; converted to nanoseconds when read
+  struct StageCounter {
+    StageCounter() : histogram(LatencyHistogram::Unit::CycleTicks) {}
+
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> totalTicks;
+    std::atomic<uint64_t> maxTicks;
+    LatencyHistogram histogram;
+  };
+
+  StageCounter stages_[kStageCount];
+};
+
+// Lap timer over StageTimers: each lap() charges the time since the previous
+// lap (or construction) to the given stage, so consecutive stages cost one
+// counter read each. While tracing is active every lap is also emitted as a
+// trace span named after the stage.
+class StageLap {
+public:
+#if ESCMODKEY_STAGE_TIMING
+  explicit StageLap(StageTimers &timers)
+      : timers_(timers), last_(CycleClock::now()) {}
+
+  void lap(Stage stage) {
+    uint64_t now = CycleClock::now();
+    timers_.record(stage, now - last_);
+    if (Trace::enabled()) {
+      Trace::complete(stageName(stage), last_, now);
+    }
+    last_ = now;
+  }
+
+  // Restart the lap without charging any stage
+  void skip() { last_ = CycleClock::now(); }
+
+private:
+  StageTimers &timers_;
+  uint64_t last_;
+#else
+  explicit StageLap(StageTimers &) {}
+  void lap(Stage) {}
+  void skip() {}
+#endif
+};
+
+#endif // STAGE_TIMERS_H
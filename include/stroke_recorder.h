@@ -0,0 +1,181 @@
+#ifndef STROKE_RECORDER_H
+#define STROKE_RECORDER_H
+
+#include "cycle_clock.h"
+#include "trace_format.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Memory-mapped segment file (platform specific parts live in the .cpp)
+struct MappedSegment;
+
+// Always-on binary recorder for keyboard strokes and fixer decisions.
+//
+// Records are written straight into a memory-mapped segment file, so the
+// input thread never calls into the file system. When a segment fills up the
+// recorder switches to a spare segment that a background thread has already
+// created and mapped; the same thread finalizes full segments (trims them to
+// their used length) and deletes the oldest ones so that at most maxSegments
+// recorded files exist (plus one empty pre-allocated spare while running).
+// If no spare is ready at rotation time, records are dropped and counted
+// rather than blocking the input thread.
+//
+// Segment files are named "<basePath>.<6-digit sequence>.emkt".
+// The file format is described in trace_format.h and docs/TRACE_FORMAT.md.
+class StrokeRecorder {
+public:
+  struct Options {
+    std::string basePath;               // Path prefix of segment files
+    uint64_t segmentBytes = 8ull << 20; // Size of one segment file
+    int maxSegments = 8;                // Oldest segments are deleted
+  };
+
+  StrokeRecorder();
+  ~StrokeRecorder();
+
+  StrokeRecorder(const StrokeRecorder &) = delete;
+  StrokeRecorder &operator=(const StrokeRecorder &) = delete;
+
+  // Create the first segment and start the rotation thread.
+  // Returns false if the first segment cannot be created.
+  bool start(const Options &options,
+             const std::vector<TraceFormat::KeyInfo> &keys, int thresholdMs);
+
+  // Finalize all segments and stop the rotation thread
+  void stop();
+
+  bool isActive() const { return active_; }
+
+  // Hot path (input thread only)
+  void recordStroke(uint8_t device, uint16_t code, uint16_t state,
+                    uint32_t information) {
+    TraceFormat::TraceRecord *record = next(TraceFormat::kRecordStroke);
+    if (record) {
+      record->device = device;
+      record->code = code;
+      record->state = state;
+      record->information = information;
+      commit();
+    }
+  }
+
+  // Record the virtual pressed mask if it differs from the last one recorded
+  void recordVirtualState(uint32_t virtualMask, uint32_t physicalMask) {
+    if (virtualMask == lastVirtualMask_) {
+      return;
+    }
+    TraceFormat::TraceRecord *record =
+        next(TraceFormat::kRecordVirtualState);
+    if (record) {
+      lastVirtualMask_ = virtualMask;
+      record->information = physicalMask;
+      record->value = virtualMask;
+      commit();
+    }
+  }
+
+  void recordFix(uint8_t device, uint8_t keyIndex, uint16_t code,
+                 uint16_t state, uint32_t mismatchMs) {
+    TraceFormat::TraceRecord *record = next(TraceFormat::kRecordFix);
+    if (record) {
+      record->device = device;
+      record->keyIndex = keyIndex;
+      record->code = code;
+      record->state = state;
+      record->value = mismatchMs;
+      commit();
+    }
+  }
+
+  void recordTracker(uint8_t keyIndex, TraceFormat::TrackerTransition what,
+                     uint32_t mismatchMs) {
+    TraceFormat::TraceRecord *record = next(TraceFormat::kRecordTracker);
+    if (record) {
+      record->keyIndex = keyIndex;
+      record->state = what;
+      record->value = mismatchMs;
+      commit();
+    }
+  }
+
+  // Records written / dropped since start()
+  uint64_t getRecordCount() const {
+    return recorded_.load(std::memory_order_relaxed);
+  }
+  uint64_t getDroppedCount() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+  // Path of the segment currently being written
+  std::string getCurrentPath() const;
+
+  // Segment file name for a base path and sequence number
+  static std::string segmentPath(const std::string &basePath,
+                                 uint64_t sequence);
+
+private:
+  // Reserve the next record slot, rotating if the segment is full.
+  // Returns nullptr (and counts a drop) if no slot is available.
+  TraceFormat::TraceRecord *next(uint8_t type) {
+    if (!current_ || used_ == capacity_) {
+      if (!rotate()) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+      }
+    }
+    TraceFormat::TraceRecord *record = records_ + used_;
+    *record = TraceFormat::TraceRecord();
+    record->timestampNs = CycleClock::now() - origin_; // Ticks, see header
+    record->type = type;
+    return record;
+  }
+
+  // Publish the slot returned by next()
+  void commit() {
+    used_++;
+    header_->recordCount = used_;
+    recorded_.store(recorded_.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_relaxed);
+  }
+
+  bool rotate();
+  void rotatorLoop();
+  MappedSegment *createSegment(uint64_t sequence);
+  void retireSegment(MappedSegment *segment, bool stillRecording);
+
+  Options options_;
+  std::vector<TraceFormat::KeyInfo> keys_;
+  int thresholdMs_;
+  uint64_t startUnixMs_;
+  uint64_t origin_;
+  bool active_;
+
+  // Producer-side view of the current segment
+  MappedSegment *current_;
+  TraceFormat::FileHeader *header_;
+  TraceFormat::TraceRecord *records_;
+  uint64_t capacity_;
+  uint64_t used_;
+  uint32_t lastVirtualMask_;
+
+  std::atomic<uint64_t> recorded_;
+  std::atomic<uint64_t> dropped_;
+
+  // Shared with the rotation thread (guarded by mutex_)
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stopRequested_;
+  MappedSegment *spare_;
+  std::vector<MappedSegment *> retired_;
+  std::deque<std::string> finished_; // Oldest first
+  uint64_t nextSequence_;
+  std::thread rotator_;
+};
+
+#endif // STROKE_RECORDER_H
@@ -0,0 +1,70 @@
+#ifndef TRACE_ANALYSIS_H
+#define TRACE_ANALYSIS_H
+
+#include "latency_histogram.h"
+#include "trace_format.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Statistics mined from recorded traces (*.emkt) by escModKey_analyze.
+//
+// analyzeTrace() makes one pass over a segment's records. Mismatch episodes
+// run from the tracker's MismatchStart to its Reset; an episode with a Fix
+// record in between counts as fixed, otherwise as self-resolved. Episodes
+// still open at the end of a segment are counted as open (a recording that
+// continues in the next segment is not stitched together). Durations are
+// taken from record timestamps and kept in LatencyHistograms (nanoseconds).
+
+constexpr size_t kMaxTraceDevices = 32; // Higher device numbers share the last
+
+struct KeyTraceStats {
+  explicit KeyTraceStats(const std::string &keyId) : id(keyId) {}
+
+  std::string id;
+  uint64_t presses = 0;      // Key-downs, auto-repeat excluded
+  uint64_t episodes = 0;     // Mismatch episodes started
+  uint64_t stuck = 0;        // Episodes that reached the threshold
+  uint64_t fixes = 0;        // Releases injected
+  uint64_t selfResolved = 0; // Episodes that ended without a fix
+  LatencyHistogram episodeNs;   // Mismatch start to reset
+  LatencyHistogram timeToFixNs; // Mismatch start to injected release
+  LatencyHistogram holdNs;      // Physical press to release
+};
+
+struct DeviceTraceStats {
+  uint64_t strokes = 0;
+  uint64_t presses = 0;
+  uint64_t fixes = 0;
+};
+
+struct TraceStats {
+  uint64_t files = 0;
+  uint64_t bytes = 0;
+  uint64_t records = 0;
+  uint64_t strokes = 0;
+  uint64_t virtualChanges = 0;
+  uint64_t durationNs = 0;   // Sum of each segment's first-to-last span
+  uint64_t openEpisodes = 0; // Still mismatched at the end of a segment
+  std::vector<std::unique_ptr<KeyTraceStats>> keys; // In order first seen
+  DeviceTraceStats devices[kMaxTraceDevices];
+  LatencyHistogram interKeyNs; // Between consecutive key-downs (any key)
+
+  // Statistics of a key, added if not seen yet
+  KeyTraceStats &key(const std::string &id);
+  const KeyTraceStats *findKey(const std::string &id) const;
+
+  uint64_t totalEpisodes() const;
+  uint64_t totalFixes() const;
+
+  // Add another file's or worker's statistics (keys matched by ID)
+  void merge(const TraceStats &other);
+};
+
+// Add one segment's records to stats
+void analyzeTrace(const TraceFormat::FileHeader &header,
+                  const TraceFormat::TraceRecord *records, size_t count,
+                  TraceStats &stats);
+
+#endif // TRACE_ANALYSIS_H
@@ -0,0 +1,181 @@
+#ifndef TRACE_FORMAT_H
+#define TRACE_FORMAT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// On-disk format of recorded stroke traces (*.emkt), version 2.
+// See docs/TRACE_FORMAT.md for the full description.
+//
+// A trace segment is a 1024-byte header followed by fixed-width 24-byte
+// records. All integers are little-endian. Timestamps are monotonic time
+// since the recording started: nanoseconds, or raw CycleClock ticks when the
+// header's nanosecondsPerTick is non-zero (the live recorder does not convert
+// on the input thread). The header also carries the wall-clock start time so
+// records can be matched to user reports.
+namespace TraceFormat {
+
+constexpr char kMagic[8] = {'E', 'M', 'K', 'T', 'R', 'A', 'C', 'E'};
+constexpr uint16_t kVersion = 2;
+constexpr uint16_t kMinVersion = 1; // Oldest version readers still accept
+constexpr uint32_t kHeaderSize = 1024;
+constexpr uint32_t kMaxKeys = 32;
+constexpr const char *kFileExtension = ".emkt";
+
+// Record types
+enum RecordType : uint8_t {
+  kRecordEmpty = 0,        // Unused slot (end of data)
+  kRecordStroke = 1,       // Keyboard stroke received from the driver
+  kRecordVirtualState = 2, // Virtual (OS) key state snapshot changed
+  kRecordFix = 3,          // Fixer injected a release for a stuck key
+  kRecordTracker = 4       // Mismatch tracker transition
+};
+
+// Tracker transitions stored in TraceRecord::state for kRecordTracker
+enum TrackerTransition : uint16_t {
+  kTrackerMismatchStart = 1,
+  kTrackerStuck = 2,
+  kTrackerReset = 3
+};
+
+// Monitored key description (index in this table = bit in state masks)
+struct KeyEntry {
+  char id[16];         // Key ID, NUL-padded (e.g. "lctrl")
+  uint16_t scanCode;   // Physical scan code
+  uint8_t needsE0;     // 1 if the E0 prefix is required
+  uint8_t reserved;
+  int32_t vkCode;      // Virtual key code (0 if unknown)
+};
+static_assert(sizeof(KeyEntry) == 24, "KeyEntry must be 24 bytes");
+
+struct FileHeader {
+  char magic[8];           // kMagic
+  uint16_t version;        // kVersion
+  uint16_t recordSize;     // sizeof(TraceRecord)
+  uint32_t headerSize;     // kHeaderSize
+  uint64_t startUnixMs;    // Wall-clock time of recording start
+  uint64_t segmentIndex;   // Sequence number of this file in the recording
+  uint64_t recordCapacity; // Record slots in this file
+  uint64_t recordCount;    // Records written (updated while recording)
+  uint32_t keyCount;       // Valid entries in keys
+  uint32_t thresholdMs;    // Stuck threshold in effect
+  double nanosecondsPerTick; // Timestamp scale, 0 if already nanoseconds
+  KeyEntry keys[kMaxKeys];
+  uint8_t reserved1[kHeaderSize - 64 - kMaxKeys * sizeof(KeyEntry)];
+};
+static_assert(sizeof(FileHeader) == kHeaderSize, "Header must be 1024 bytes");
+
+// Fixed-width record. Field meaning depends on type:
+//   Stroke:       device, code = scan code, state = stroke state,
+//                 information = stroke information
+//   VirtualState: value = virtual pressed mask, information = physical mask
+//   Fix:          device, keyIndex, code = scan code, state = stroke state
+//                 of the injected release, value = mismatch duration (ms)
+//   Tracker:      keyIndex, state = TrackerTransition,
+//                 value = mismatch duration (ms)
+struct TraceRecord {
+  uint64_t timestampNs; // See FileHeader::nanosecondsPerTick
+  uint8_t type;
+  uint8_t device;
+  uint16_t code;
+  uint16_t state;
+  uint8_t keyIndex;
+  uint8_t reserved;
+  uint32_t information;
+  uint32_t value;
+};
+static_assert(sizeof(TraceRecord) == 24, "TraceRecord must be 24 bytes");
+
+// Record time in nanoseconds since the recording started
+inline uint64_t timestampNs(const FileHeader &header,
+                            const TraceRecord &record) {
+  return header.nanosecondsPerTick > 0
+             ? static_cast<uint64_t>(static_cast<double>(record.timestampNs) *
+                                     header.nanosecondsPerTick)
+             : record.timestampNs;
+}
+
+// Key descriptions passed to writers
+struct KeyInfo {
+  std::string id;
+  unsigned short scanCode;
+  bool needsE0;
+  int vkCode;
+};
+
+// Fill a header for a new segment
+void initHeader(FileHeader &header, const std::vector<KeyInfo> &keys,
+                uint64_t startUnixMs, uint64_t segmentIndex,
+                uint64_t recordCapacity, int thresholdMs);
+
+// Validate magic, version and sizes. Returns an empty string if valid.
+std::string validateHeader(const FileHeader &header, uint64_t fileSize);
+
+// Key ID from a header entry
+std::string keyId(const KeyEntry &entry);
+
+// Fully loaded trace file
+struct TraceFile {
+  FileHeader header;
+  std::vector<TraceRecord> records;
+};
+
+// Read a whole segment into memory. Stops at the first empty slot if the
+// header count is stale (e.g. the recorder was killed). Tick timestamps are
+// converted to nanoseconds and nanosecondsPerTick is cleared.
+bool readTraceFile(const std::string &path, TraceFile &out,
+                   std::string *error = nullptr);
+
+// Write a complete segment (used by tools that generate traces)
+bool writeTraceFile(const std::string &path, const FileHeader &header,
+                    const std::vector<TraceRecord> &records,
+                    std::string *error = nullptr);
+
+// Append path if it is a file, or the files with the given extension found
+// under it (recursively, sorted so output is stable) if it is a directory.
+// Returns false if path is neither.
+bool collectTraceFiles(const std::string &path,
+                       std::vector<std::string> &files,
+                       const std::string &extension = kFileExtension);
+
+// Read-only memory mapping of a segment, for tools that scan large corpora
+// without copying the records. Records are valid until close(); timestamps
+// are as stored, read them through timestampNs(header(), record).
+class MappedTraceFile {
+public:
+  MappedTraceFile() = default;
+  ~MappedTraceFile() { close(); }
+
+  MappedTraceFile(const MappedTraceFile &) = delete;
+  MappedTraceFile &operator=(const MappedTraceFile &) = delete;
+
+  // Map the file and validate its header
+  bool open(const std::string &path, std::string *error = nullptr);
+  void close();
+
+  const FileHeader &header() const {
+    return *reinterpret_cast<const FileHeader *>(base_);
+  }
+  const TraceRecord *records() const {
+    return reinterpret_cast<const TraceRecord *>(base_ + kHeaderSize);
+  }
+  // Records written, trailing empty slots excluded (as readTraceFile)
+  size_t recordCount() const { return count_; }
+  uint64_t fileBytes() const { return bytes_; }
+
+private:
+  const uint8_t *base_ = nullptr;
+  uint64_t bytes_ = 0;
+  size_t count_ = 0;
+#ifdef _WIN32
+  void *file_ = nullptr; // HANDLE
+  void *mapping_ = nullptr;
+#else
+  int fd_ = -1;
+#endif
+};
+
+} // namespace TraceFormat
+
+#endif // TRACE_FORMAT_H
@@ -0,0 +1,39 @@
+#ifndef TRACE_REPLAY_H
+#define TRACE_REPLAY_H
+
+#include "config.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Timed replay of recorded traces (*.emkt) through the shipped event loop
+// (ModifierKeyFixer, i.e. ProductionFixerCore and FixerSink) in virtual
+// time. It is built into the shipped binaries (escModKey --replay,
+// escModKey_gui --replay), so profile-guided optimisation trains the code
+// those binaries run, without a keyboard or the Interception driver: the
+// driver and the OS key state are replaced by an in-process stand-in for
+// the duration of the replay (see trace_replay.cpp).
+
+struct ReplayOptions {
+  std::vector<std::string> paths; // Trace files, or directories of them
+  std::string configPath;         // Key selection and threshold (optional)
+  int passes = 1;                 // Timed passes over the whole corpus
+  double dropKeyUpRate = 0.001;   // Lost key-ups, so fixes happen too
+};
+
+struct ReplayResult {
+  uint64_t strokes = 0; // Per pass
+  uint64_t fixes = 0;   // Per pass
+  double medianNsPerStroke = 0; // Driver stand-in included
+  double minNsPerStroke = 0;
+};
+
+// Load every trace, then replay the corpus options.passes times
+bool replayTraces(const ReplayOptions &options, ReplayResult &result,
+                  std::string &error);
+
+// "--replay [--passes n] [--drop rate] [--config file] <trace|dir>..."
+// from a command line; prints the result. Returns the process exit code.
+int replayMain(int argc, char *argv[]);
+
+#endif // TRACE_REPLAY_H
@@ -0,0 +1,156 @@
+#ifndef TRACE_WRITER_H
+#define TRACE_WRITER_H
+
+#include "cycle_clock.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Event phases of the Chrome trace-event format
+enum class TracePhase : char {
+  Complete = 'X', // span with start and duration
+  Instant = 'i'   // single point in time
+};
+
+// One fixed-size trace record. Names must be string literals (only the
+// pointer is stored); the optional detail text is copied inline.
+struct TraceEvent {
+  const char *name;
+  const char *argName; // nullptr if the event has no numeric argument
+  uint64_t startTicks;
+  uint64_t durationTicks;
+  int64_t arg;
+  char detail[16]; // e.g. key ID or "down"/"up", empty if unused
+  TracePhase phase;
+};
+
+// Opt-in Chrome trace-event / Perfetto JSON exporter.
+//
+// Producers append TraceEvent records to a lock-free single-producer ring
+// owned by their thread (registered on first use). A background thread
+// drains all rings and formats JSON, so the input path never touches the
+// file. If a ring fills up, further events from that thread are dropped and
+// counted rather than blocking.
+//
+// Load the output in ui.perfetto.dev or chrome://tracing.
+class TraceWriter {
+public:
+  static constexpr size_t kRingCapacity = 1 << 13; // events per thread
+
+  static TraceWriter &instance();
+
+  // Start writing to path (truncates). Returns false if the file can't be
+  // opened or tracing is already active.
+  bool start(const std::string &path);
+
+  // Flush remaining events, close the JSON document and stop the writer
+  void stop();
+
+  bool isActive() const { return enabled_.load(std::memory_order_relaxed); }
+  uint64_t getDroppedCount() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+  uint64_t getWrittenCount() const {
+    return written_.load(std::memory_order_relaxed);
+  }
+
+  // Append an event from the calling thread (no-op unless active)
+  void emit(const TraceEvent &event);
+
+  ~TraceWriter();
+
+private:
+  struct ThreadRing {
+    uint32_t tid;
+    std::atomic<uint64_t> head{0}; // written by producer
+    std::atomic<uint64_t> tail{0}; // written by writer thread
+    TraceEvent events[kRingCapacity];
+  };
+
+  TraceWriter() = default;
+  TraceWriter(const TraceWriter &) = delete;
+  TraceWriter &operator=(const TraceWriter &) = delete;
+
+  ThreadRing *ringForThisThread();
+  void writerLoop();
+  void drainAll();
+  void writeEvent(const TraceEvent &event, uint32_t tid);
+
+  std::atomic<bool> enabled_{false};
+  std::atomic<uint64_t> dropped_{0};
+  std::atomic<uint64_t> written_{0};
+
+  std::mutex ringsMutex_; // guards rings_ registration and draining
+  std::vector<std::unique_ptr<ThreadRing>> rings_;
+
+  std::mutex wakeMutex_;
+  std::condition_variable wake_;
+  bool stopRequested_ = false;
+  std::thread writer_;
+
+  std::ofstream file_;
+  uint64_t originTicks_ = 0;
+};
+
+// Convenience wrappers used by instrumented code
+namespace Trace {
+
+inline bool enabled() { return TraceWriter::instance().isActive(); }
+
+// Span between two CycleClock readings
+inline void complete(const char *name, uint64_t startTicks,
+                     uint64_t endTicks) {
+  TraceEvent event{};
+  event.name = name;
+  event.startTicks = startTicks;
+  event.durationTicks = endTicks - startTicks;
+  event.phase = TracePhase::Complete;
+  TraceWriter::instance().emit(event);
+}
+
+// Point event with an optional numeric argument and detail text
+inline void instant(const char *name, const char *argName = nullptr,
+                    int64_t arg = 0, const char *detail = nullptr) {
+  TraceEvent event{};
+  event.name = name;
+  event.argName = argName;
+  event.arg = arg;
+  event.startTicks = CycleClock::now();
+  event.phase = TracePhase::Instant;
+  if (detail) {
+    std::strncpy(event.detail, detail, sizeof(event.detail) - 1);
+  }
+  TraceWriter::instance().emit(event);
+}
+
+inline void instant(const char *name, const char *argName, int64_t arg,
+                    const std::string &detail) {
+  instant(name, argName, arg, detail.c_str());
+}
+
+// RAII span covering the enclosing scope (only timed while tracing)
+class Span {
+public:
+  explicit Span(const char *name)
+      : name_(name), start_(enabled() ? CycleClock::now() : 0) {}
+  ~Span() {
+    if (start_ != 0 && enabled()) {
+      complete(name_, start_, CycleClock::now());
+    }
+  }
+
+private:
+  const char *name_;
+  uint64_t start_;
+};
+
+} // namespace Trace
+
+#endif // TRACE_WRITER_H
@@ -2,6 +2,7 @@
 #define VIRTUAL_KEY_DETECTOR_H
 
 #include <Windows.h>
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -62,6 +63,9 @@ public:
   bool anyAlt() const;
   bool anyWin() const;
 
+  // Bit i set if key i is pressed (first 32 keys only)
+  uint32_t pressedMask() const;
+
   // Check if states have changed
   bool operator!=(const VirtualKeyStates &other) const;
 
@@ -0,0 +1,71 @@
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for the offline tools (trace analysis,
+// parameter sweeps) that run a batch of independent, indexed tasks.
+//
+// run() deals the task indices into one contiguous range per worker. A
+// worker takes tasks from the front of its own range; once that is empty it
+// steals the back half of the largest remaining range, so a few expensive
+// tasks (large trace files, slow parameter sets) don't leave the other
+// cores idle. The calling thread works as well. Tasks must not throw.
+class WorkStealingPool {
+public:
+  // task(index, worker): worker is in [0, getWorkerCount()) and may be used
+  // to index per-worker scratch state
+  using Task = std::function<void(size_t index, size_t worker)>;
+
+  // threads = 0 uses one worker per hardware thread
+  explicit WorkStealingPool(size_t threads = 0);
+  ~WorkStealingPool();
+
+  WorkStealingPool(const WorkStealingPool &) = delete;
+  WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+  // Workers including the calling thread
+  size_t getWorkerCount() const { return queues_.size(); }
+
+  // Run task for every index in [0, count) and wait for all of them
+  void run(size_t count, const Task &task);
+
+  // Ranges stolen over the pool's lifetime
+  uint64_t getStealCount() const {
+    return steals_.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct Queue {
+    std::mutex mutex;
+    size_t begin = 0;
+    size_t end = 0;
+  };
+
+  void workerLoop(size_t worker);
+  void work(size_t worker);
+  bool take(size_t worker, size_t &index);
+  bool steal(size_t worker);
+
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::vector<std::thread> threads_;
+  const Task *task_;
+  std::atomic<uint64_t> steals_;
+
+  std::mutex mutex_;
+  std::condition_variable start_;
+  std::condition_variable done_;
+  uint64_t generation_;
+  size_t busyWorkers_;
+  bool stopRequested_;
+};
+
+#endif // WORK_STEALING_POOL_H
@@ -0,0 +1,62 @@
+#ifndef ESCMODKEY_SHIM_WINDOWS_H
+#define ESCMODKEY_SHIM_WINDOWS_H
+
+// Stand-in for <Windows.h> on platforms without Win32 (headless builds).
+// Declares only the types and calls the library sources use. Key state and
+// Sleep() are backed by the fake OS layer in fake_win32.h, which also sees
+// every stroke sent through the fake Interception driver.
+
+typedef int BOOL;
+typedef unsigned short WORD;
+typedef unsigned long DWORD;
+typedef long HRESULT;
+typedef void *HANDLE;
+typedef void *HMODULE;
+typedef void *HWND;
+typedef char *LPSTR;
+typedef const char *LPCSTR;
+
+#define TRUE 1
+#define FALSE 0
+#define MAX_PATH 260
+#define INFINITE 0xFFFFFFFF
+#define S_OK ((HRESULT)0)
+#define E_FAIL ((HRESULT)0x80004005L)
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+
+// Virtual key codes
+#define VK_BACK 0x08
+#define VK_TAB 0x09
+#define VK_RETURN 0x0D
+#define VK_SHIFT 0x10
+#define VK_CONTROL 0x11
+#define VK_MENU 0x12
+#define VK_CAPITAL 0x14
+#define VK_ESCAPE 0x1B
+#define VK_SPACE 0x20
+#define VK_LWIN 0x5B
+#define VK_RWIN 0x5C
+#define VK_APPS 0x5D
+#define VK_F1 0x70
+#define VK_F12 0x7B
+#define VK_LSHIFT 0xA0
+#define VK_RSHIFT 0xA1
+#define VK_LCONTROL 0xA2
+#define VK_RCONTROL 0xA3
+#define VK_LMENU 0xA4
+#define VK_RMENU 0xA5
+
+// Bit 15 set while the key is down in the fake OS layer
+short GetAsyncKeyState(int vKey);
+
+// Sleeps for real unless disabled with FakeWin32::setSleepEnabled(false)
+void Sleep(DWORD milliseconds);
+
+// Path of the running executable (module must be null)
+DWORD GetModuleFileNameA(HMODULE module, LPSTR fileName, DWORD size);
+
+BOOL CreateDirectoryA(LPCSTR pathName, void *securityAttributes);
+DWORD GetLastError();
+
+#endif // ESCMODKEY_SHIM_WINDOWS_H
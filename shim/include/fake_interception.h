@@ -0,0 +1,71 @@
+#ifndef FAKE_INTERCEPTION_H
+#define FAKE_INTERCEPTION_H
+
+#include "interception.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// In-process implementation of the Interception API for headless builds.
+//
+// Instead of a kernel driver, input comes from scripted queues filled with
+// push*() and strokes passed to interception_send() are captured. Filters,
+// devices and hardware IDs behave like the real driver's: input a context's
+// filter does not match goes straight to the fake OS layer (fake_win32.h),
+// and so does every keyboard stroke the program sends.
+//
+// Input may be pushed from another thread while the program waits.
+namespace FakeInterception {
+
+// A stroke passed to interception_send()
+struct SentStroke {
+  InterceptionDevice device;
+  InterceptionKeyStroke stroke;
+};
+
+// Decides whether a sent keyboard stroke reaches the OS layer
+using DeliveryFilter =
+    std::function<bool(InterceptionDevice, const InterceptionKeyStroke &)>;
+
+// Restore defaults: keyboard 1 and mouse 11 present, no queued input,
+// nothing captured, no delivery filter, waits block. Existing contexts
+// stay valid but their filters are cleared.
+void reset();
+
+// Devices (keyboards are 1..10, mice 11..20)
+void addDevice(InterceptionDevice device, const std::string &hardwareId);
+void removeDevice(InterceptionDevice device);
+
+// Queue input as if the device produced it
+void pushKeyStroke(InterceptionDevice device, unsigned short code,
+                   unsigned short state, unsigned int information = 0);
+void pushKeyStrokes(InterceptionDevice device,
+                    const std::vector<InterceptionKeyStroke> &strokes);
+void pushMouseStroke(InterceptionDevice device,
+                     const InterceptionMouseStroke &stroke);
+
+// Input captured by a context but not received yet
+size_t getPendingCount();
+
+// Keep a copy of every sent keyboard stroke (default on). Turn off for
+// long benchmarks; getSentCount() keeps counting.
+void setCaptureSent(bool capture);
+std::vector<SentStroke> takeSent();
+uint64_t getSentCount();
+
+// Lose sent keyboard strokes: the filter returns false to keep a stroke
+// from reaching the OS layer (e.g. a dropped key-up). Empty = deliver all.
+// Called with the driver lock held: it must not call back into this API.
+void setDeliveryFilter(DeliveryFilter filter);
+
+// If true (default), waits with no queued input block until input is
+// pushed or the timeout expires. If false they return 0 immediately.
+void setWaitBlocks(bool block);
+
+// Contexts created and not yet destroyed
+int getContextCount();
+
+} // namespace FakeInterception
+
+#endif // FAKE_INTERCEPTION_H
@@ -0,0 +1,39 @@
+#ifndef FAKE_WIN32_H
+#define FAKE_WIN32_H
+
+#include "interception.h"
+#include <cstdint>
+
+// Fake OS layer behind the Windows.h stand-in.
+//
+// Holds the virtual key state GetAsyncKeyState() reports. Keyboard strokes
+// sent through the fake Interception driver (or bypassing it) are applied
+// here the way Windows would apply them, using a scan code to virtual key
+// table that covers the modifiers by default.
+namespace FakeWin32 {
+
+// Restore defaults: all keys up, default scan code table, real Sleep(),
+// slept time counter cleared
+void reset();
+
+// Virtual key state
+void setKeyState(int vkCode, bool pressed);
+bool getKeyState(int vkCode);
+void resetKeyStates();
+
+// Map a scan code (with or without the E0 prefix) to a virtual key.
+// vkCode 0 removes the mapping. Configure before strokes are flowing.
+void mapScanCode(unsigned short scanCode, bool e0, int vkCode);
+
+// Update the key state for a keyboard stroke reaching the OS.
+// Unmapped scan codes are ignored.
+void applyKeyStroke(const InterceptionKeyStroke &stroke);
+
+// Sleep() behaviour: sleep for real (default) or return immediately.
+// The requested time is accumulated either way.
+void setSleepEnabled(bool enabled);
+uint64_t getSleptMs();
+
+} // namespace FakeWin32
+
+#endif // FAKE_WIN32_H
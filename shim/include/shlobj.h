@@ -0,0 +1,14 @@
+#ifndef ESCMODKEY_SHIM_SHLOBJ_H
+#define ESCMODKEY_SHIM_SHLOBJ_H
+
+// Stand-in for <shlobj.h> (see Windows.h in this directory)
+
+#include <Windows.h>
+
+#define CSIDL_APPDATA 0x001a
+
+// CSIDL_APPDATA maps to $XDG_CONFIG_HOME, or ~/.config
+HRESULT SHGetFolderPathA(HWND owner, int folder, HANDLE token, DWORD flags,
+                         LPSTR path);
+
+#endif // ESCMODKEY_SHIM_SHLOBJ_H
@@ -0,0 +1,461 @@
+#include "fake_interception.h"
+#include "fake_win32.h"
+#include <Windows.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+
+namespace {
+
+struct Context {
+  InterceptionFilter filters[INTERCEPTION_MAX_DEVICE];
+  InterceptionPrecedence precedences[INTERCEPTION_MAX_DEVICE];
+};
+
+// Input captured by a context, waiting for interception_receive
+struct QueuedStroke {
+  Context *context;
+  InterceptionDevice device;
+  InterceptionStroke stroke;
+};
+
+struct Driver {
+  std::mutex mutex;
+  std::condition_variable inputArrived;
+  std::vector<Context *> contexts;
+  std::deque<QueuedStroke> queue;
+  std::string hardwareIds[INTERCEPTION_MAX_DEVICE];
+  bool present[INTERCEPTION_MAX_DEVICE];
+  std::vector<FakeInterception::SentStroke> sent;
+  uint64_t sentCount;
+  bool captureSent;
+  bool waitBlocks;
+  FakeInterception::DeliveryFilter deliveryFilter;
+
+  Driver() { resetLocked(); }
+
+  void resetLocked() {
+    for (Context *context : contexts) {
+      std::fill(std::begin(context->filters), std::end(context->filters), 0);
+    }
+    queue.clear();
+    for (int i = 0; i < INTERCEPTION_MAX_DEVICE; ++i) {
+      hardwareIds[i].clear();
+      present[i] = false;
+    }
+    present[INTERCEPTION_KEYBOARD(0) - 1] = true;
+    hardwareIds[INTERCEPTION_KEYBOARD(0) - 1] = "HID\\FAKE_KEYBOARD";
+    present[INTERCEPTION_MOUSE(0) - 1] = true;
+    hardwareIds[INTERCEPTION_MOUSE(0) - 1] = "HID\\FAKE_MOUSE";
+    sent.clear();
+    sentCount = 0;
+    captureSent = true;
+    waitBlocks = true;
+    deliveryFilter = nullptr;
+  }
+};
+
+Driver &driver() {
+  static Driver instance;
+  return instance;
+}
+
+bool validDevice(InterceptionDevice device) {
+  return !interception_is_invalid(device);
+}
+
+bool keyboardFilterMatches(InterceptionFilter filter,
+                           const InterceptionKeyStroke &stroke) {
+  if (filter == INTERCEPTION_FILTER_KEY_ALL) {
+    return true;
+  }
+  bool up = (stroke.state & INTERCEPTION_KEY_UP) != 0;
+  if (filter & (up ? INTERCEPTION_FILTER_KEY_UP : INTERCEPTION_FILTER_KEY_DOWN)) {
+    return true;
+  }
+  // Remaining flags map to filter bits shifted left by one
+  return (filter & ((stroke.state & ~INTERCEPTION_KEY_UP) << 1)) != 0;
+}
+
+bool mouseFilterMatches(InterceptionFilter filter,
+                        const InterceptionMouseStroke &stroke) {
+  if (stroke.state == 0) {
+    return (filter & INTERCEPTION_FILTER_MOUSE_MOVE) != 0;
+  }
+  return (filter & stroke.state) != 0;
+}
+
+// Capturing context for a stroke, or null if it goes straight to the OS
+// (highest precedence wins, then the oldest context)
+Context *findCapturingContext(Driver &d, InterceptionDevice device,
+                              const InterceptionStroke &stroke) {
+  Context *best = nullptr;
+  for (Context *context : d.contexts) {
+    InterceptionFilter filter = context->filters[device - 1];
+    bool match =
+        interception_is_keyboard(device)
+            ? keyboardFilterMatches(
+                  filter, *reinterpret_cast<const InterceptionKeyStroke *>(
+                              &stroke))
+            : mouseFilterMatches(
+                  filter, *reinterpret_cast<const InterceptionMouseStroke *>(
+                              &stroke));
+    if (match && (!best || context->precedences[device - 1] >
+                               best->precedences[device - 1])) {
+      best = context;
+    }
+  }
+  return best;
+}
+
+void deliverToOs(Driver &d, InterceptionDevice device,
+                 const InterceptionKeyStroke &stroke) {
+  if (d.deliveryFilter && !d.deliveryFilter(device, stroke)) {
+    return;
+  }
+  FakeWin32::applyKeyStroke(stroke);
+}
+
+void push(InterceptionDevice device, const InterceptionStroke &stroke) {
+  Driver &d = driver();
+  std::lock_guard<std::mutex> lock(d.mutex);
+  if (!validDevice(device) || !d.present[device - 1]) {
+    return;
+  }
+  Context *context = findCapturingContext(d, device, stroke);
+  if (!context) {
+    if (interception_is_keyboard(device)) {
+      FakeWin32::applyKeyStroke(
+          *reinterpret_cast<const InterceptionKeyStroke *>(&stroke));
+    }
+    return;
+  }
+  QueuedStroke queued;
+  queued.context = context;
+  queued.device = device;
+  std::memcpy(queued.stroke, stroke, sizeof(InterceptionStroke));
+  d.queue.push_back(queued);
+  d.inputArrived.notify_all();
+}
+
+// First queued stroke for a context (and device, if given)
+std::deque<QueuedStroke>::iterator findQueued(Driver &d, Context *context,
+                                              InterceptionDevice device) {
+  return std::find_if(d.queue.begin(), d.queue.end(),
+                      [context, device](const QueuedStroke &queued) {
+                        return queued.context == context &&
+                               (device == 0 || queued.device == device);
+                      });
+}
+
+InterceptionDevice wait(InterceptionContext handle,
+                        std::chrono::milliseconds timeout, bool infinite) {
+  Driver &d = driver();
+  Context *context = static_cast<Context *>(handle);
+  std::unique_lock<std::mutex> lock(d.mutex);
+  auto ready = [&d, context]() {
+    return findQueued(d, context, 0) != d.queue.end();
+  };
+  if (!ready() && d.waitBlocks) {
+    if (infinite) {
+      d.inputArrived.wait(lock, ready);
+    } else {
+      d.inputArrived.wait_for(lock, timeout, ready);
+    }
+  }
+  auto it = findQueued(d, context, 0);
+  return it != d.queue.end() ? it->device : 0;
+}
+
+} // namespace
+
+namespace FakeInterception {
+
+void reset() {
+  Driver &d = driver();
+  std::lock_guard<std::mutex> lock(d.mutex);
+  d.resetLocked();
+}
+
+void addDevice(InterceptionDevice device, const std::string &hardwareId) {
+  if (!validDevice(device)) {
+    return;
+  }
+  Driver &d = driver();
+  std::lock_guard<std::mutex> lock(d.mutex);
+  d.present[device - 1] = true;
+  d.hardwareIds[device - 1] = hardwareId;
+}
+
+void removeDevice(InterceptionDevice device) {
+  if (!validDevice(device)) {
+    return;
+  }
+  Driver &d = driver();
+  std::lock_guard<std::mutex> lock(d.mutex);
+  d.present[device - 1] = false;
+  d.hardwareIds[device - 1].clear();
+  d.queue.erase(std::remove_if(d.queue.begin(), d.queue.end(),
+                               [device](const QueuedStroke &queued) {
+                                 return queued.device == device;
+                               }),
+                d.queue.end());
+}
+
+void pushKeyStroke(InterceptionDevice device, unsigned short code,
+                   unsigned short state, unsigned int information) {
+  InterceptionStroke stroke = {};
+  InterceptionKeyStroke *key = reinterpret_cast<InterceptionKeyStroke *>(&stroke);
+  key->code = code;
+  key->state = state;
+  key->information = information;
+  push(device, stroke);
+}
+
+void pushKeyStrokes(InterceptionDevice device,
+                    const std::vector<InterceptionKeyStroke> &strokes) {
+  for (const auto &stroke : strokes) {
+    pushKeyStroke(device, stroke.code, stroke.state, stroke.information);
+  }
+}
+
+void pushMouseStroke(InterceptionDevice device,
+                     const InterceptionMouseStroke &stroke) {
+  InterceptionStroke raw = {};
+  std::memcpy(raw, &stroke, sizeof(stroke));
+  push(device, raw);
+}
+
+size_t getPendingCount() {
+  Driver &d = driver();
+  std::lock_guard<std::mutex> lock(d.mutex);
+  return d.queue.size();
+}
+
+void setCaptureSent(bool capture) {
+  Driver &d = driver();
+  std::lock_guard<std::mutex> lock(d.mutex);
+  d.captureSent = capture;
+}
+
+std::vector<SentStroke> takeSent() {
+  Driver &d = driver();
+  std::lock_guard<std::mutex> lock(d.mutex);
+  std::vector<SentStroke> sent;
+  sent.swap(d.sent);
+  return sent;
+}
+
+uint64_t getSentCount() {
+  Driver &d = driver();
+  std::lock_guard<std::mutex> lock(d.mutex);
+  return d.sentCount;
+}
+
+void setDeliveryFilter(DeliveryFilter filter) {
+  Driver &d = driver();
+  std::lock_guard<std::mutex> lock(d.mutex);
+  d.deliveryFilter = std::move(filter);
+}
+
+void setWaitBlocks(bool block) {
+  Driver &d = driver();
+  std::lock_guard<std::mutex> lock(d.mutex);
+  d.waitBlocks = block;
+  d.inputArrived.notify_all();
+}
+
+int getContextCount() {
+  Driver &d = driver();
+  std::lock_guard<std::mutex> lock(d.mutex);
+  return static_cast<int>(d.contexts.size());
+}
+
+} // namespace FakeInterception
+
+// Interception API
+extern "C" {
+
+InterceptionContext interception_create_context(void) {
+  Context *context = new Context();
+  std::fill(std::begin(context->filters), std::end(context->filters), 0);
+  std::fill(std::begin(context->precedences), std::end(context->precedences),
+            0);
+  Driver &d = driver();
+  std::lock_guard<std::mutex> lock(d.mutex);
+  d.contexts.push_back(context);
+  return context;
+}
+
+void interception_destroy_context(InterceptionContext handle) {
+  if (!handle) {
+    return;
+  }
+  Context *context = static_cast<Context *>(handle);
+  Driver &d = driver();
+  {
+    std::lock_guard<std::mutex> lock(d.mutex);
+    d.contexts.erase(
+        std::remove(d.contexts.begin(), d.contexts.end(), context),
+        d.contexts.end());
+    d.queue.erase(std::remove_if(d.queue.begin(), d.queue.end(),
+                                 [context](const QueuedStroke &queued) {
+                                   return queued.context == context;
+                                 }),
+                  d.queue.end());
+  }
+  delete context;
+}
+
+InterceptionPrecedence interception_get_precedence(InterceptionContext handle,
+                                                   InterceptionDevice device) {
+  if (!handle || !validDevice(device)) {
+    return 0;
+  }
+  Driver &d = driver();
+  std::lock_guard<std::mutex> lock(d.mutex);
+  return static_cast<Context *>(handle)->precedences[device - 1];
+}
+
+void interception_set_precedence(InterceptionContext handle,
+                                 InterceptionDevice device,
+                                 InterceptionPrecedence precedence) {
+  if (!handle || !validDevice(device)) {
+    return;
+  }
+  Driver &d = driver();
+  std::lock_guard<std::mutex> lock(d.mutex);
+  static_cast<Context *>(handle)->precedences[device - 1] = precedence;
+}
+
+InterceptionFilter interception_get_filter(InterceptionContext handle,
+                                           InterceptionDevice device) {
+  if (!handle || !validDevice(device)) {
+    return 0;
+  }
+  Driver &d = driver();
+  std::lock_guard<std::mutex> lock(d.mutex);
+  return static_cast<Context *>(handle)->filters[device - 1];
+}
+
+void interception_set_filter(InterceptionContext handle,
+                             InterceptionPredicate predicate,
+                             InterceptionFilter filter) {
+  if (!handle) {
+    return;
+  }
+  Context *context = static_cast<Context *>(handle);
+  Driver &d = driver();
+  std::lock_guard<std::mutex> lock(d.mutex);
+  for (int i = 0; i < INTERCEPTION_MAX_DEVICE; ++i) {
+    if (predicate(i + 1)) {
+      context->filters[i] = filter;
+    }
+  }
+}
+
+InterceptionDevice interception_wait(InterceptionContext context) {
+  return wait(context, std::chrono::milliseconds(0), true);
+}
+
+InterceptionDevice interception_wait_with_timeout(InterceptionContext context,
+                                                  unsigned long milliseconds) {
+  if (milliseconds == INFINITE) {
+    return wait(context, std::chrono::milliseconds(0), true);
+  }
+  return wait(context, std::chrono::milliseconds(milliseconds), false);
+}
+
+int interception_send(InterceptionContext handle, InterceptionDevice device,
+                      const InterceptionStroke *stroke, unsigned int nstroke) {
+  if (!handle || !validDevice(device)) {
+    return 0;
+  }
+  Driver &d = driver();
+  std::lock_guard<std::mutex> lock(d.mutex);
+  if (!interception_is_keyboard(device)) {
+    return static_cast<int>(nstroke);
+  }
+  // Keyboard strokes are packed as InterceptionKeyStroke, as in the real
+  // library
+  const InterceptionKeyStroke *keys =
+      reinterpret_cast<const InterceptionKeyStroke *>(stroke);
+  for (unsigned int i = 0; i < nstroke; ++i) {
+    d.sentCount++;
+    if (d.captureSent) {
+      d.sent.push_back({device, keys[i]});
+    }
+    deliverToOs(d, device, keys[i]);
+  }
+  return static_cast<int>(nstroke);
+}
+
+int interception_receive(InterceptionContext handle, InterceptionDevice device,
+                         InterceptionStroke *stroke, unsigned int nstroke) {
+  if (!handle || !validDevice(device)) {
+    return 0;
+  }
+  Context *context = static_cast<Context *>(handle);
+  bool keyboard = interception_is_keyboard(device) != 0;
+  Driver &d = driver();
+  std::lock_guard<std::mutex> lock(d.mutex);
+  unsigned int received = 0;
+  while (received < nstroke) {
+    auto it = findQueued(d, context, device);
+    if (it == d.queue.end()) {
+      break;
+    }
+    if (keyboard) {
+      std::memcpy(reinterpret_cast<InterceptionKeyStroke *>(stroke) + received,
+                  it->stroke, sizeof(InterceptionKeyStroke));
+    } else {
+      std::memcpy(stroke + received, it->stroke, sizeof(InterceptionStroke));
+    }
+    d.queue.erase(it);
+    received++;
+  }
+  return static_cast<int>(received);
+}
+
+unsigned int interception_get_hardware_id(InterceptionContext handle,
+                                          InterceptionDevice device,
+                                          void *buffer,
+                                          unsigned int bufferSize) {
+  if (!handle || !validDevice(device)) {
+    return 0;
+  }
+  Driver &d = driver();
+  std::lock_guard<std::mutex> lock(d.mutex);
+  if (!d.present[device - 1]) {
+    return 0;
+  }
+  // REG_MULTI_SZ of UTF-16 code units, like the real driver returns
+  const std::string &id = d.hardwareIds[device - 1];
+  std::vector<uint16_t> wide(id.begin(), id.end());
+  wide.push_back(0);
+  wide.push_back(0);
+  unsigned int bytes = static_cast<unsigned int>(wide.size() * sizeof(uint16_t));
+  if (buffer && bufferSize > 0) {
+    std::memcpy(buffer, wide.data(), std::min(bytes, bufferSize));
+  }
+  return bytes;
+}
+
+int interception_is_invalid(InterceptionDevice device) {
+  return !interception_is_keyboard(device) && !interception_is_mouse(device);
+}
+
+int interception_is_keyboard(InterceptionDevice device) {
+  return device >= INTERCEPTION_KEYBOARD(0) &&
+         device <= INTERCEPTION_KEYBOARD(INTERCEPTION_MAX_KEYBOARD - 1);
+}
+
+int interception_is_mouse(InterceptionDevice device) {
+  return device >= INTERCEPTION_MOUSE(0) &&
+         device <= INTERCEPTION_MOUSE(INTERCEPTION_MAX_MOUSE - 1);
+}
+
+} // extern "C"
@@ -0,0 +1,139 @@
+#include "fake_win32.h"
+#include <Windows.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <shlobj.h>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+std::atomic<uint8_t> keyStates[256];
+std::atomic<bool> sleepEnabled(true);
+std::atomic<uint64_t> sleptMs(0);
+thread_local DWORD lastError = 0;
+
+// Indexed by (scanCode & 0xFF) | (e0 ? 0x100 : 0)
+int scanToVk[0x200];
+
+void loadDefaultScanCodes() {
+  std::memset(scanToVk, 0, sizeof(scanToVk));
+  scanToVk[0x1D] = VK_LCONTROL;
+  scanToVk[0x11D] = VK_RCONTROL;
+  scanToVk[0x2A] = VK_LSHIFT;
+  scanToVk[0x36] = VK_RSHIFT;
+  scanToVk[0x38] = VK_LMENU;
+  scanToVk[0x138] = VK_RMENU;
+  scanToVk[0x15B] = VK_LWIN;
+  scanToVk[0x15C] = VK_RWIN;
+}
+
+struct DefaultScanCodes {
+  DefaultScanCodes() { loadDefaultScanCodes(); }
+} defaultScanCodes;
+
+} // namespace
+
+namespace FakeWin32 {
+
+void reset() {
+  resetKeyStates();
+  loadDefaultScanCodes();
+  sleepEnabled.store(true);
+  sleptMs.store(0);
+}
+
+void setKeyState(int vkCode, bool pressed) {
+  if (vkCode >= 0 && vkCode < 256) {
+    keyStates[vkCode].store(pressed ? 1 : 0, std::memory_order_release);
+  }
+}
+
+bool getKeyState(int vkCode) {
+  return vkCode >= 0 && vkCode < 256 &&
+         keyStates[vkCode].load(std::memory_order_acquire) != 0;
+}
+
+void resetKeyStates() {
+  for (auto &state : keyStates) {
+    state.store(0, std::memory_order_relaxed);
+  }
+}
+
+void mapScanCode(unsigned short scanCode, bool e0, int vkCode) {
+  scanToVk[(scanCode & 0xFF) | (e0 ? 0x100 : 0)] = vkCode;
+}
+
+void applyKeyStroke(const InterceptionKeyStroke &stroke) {
+  bool e0 = (stroke.state & INTERCEPTION_KEY_E0) != 0;
+  int vkCode = scanToVk[(stroke.code & 0xFF) | (e0 ? 0x100 : 0)];
+  if (vkCode != 0) {
+    setKeyState(vkCode, !(stroke.state & INTERCEPTION_KEY_UP));
+  }
+}
+
+void setSleepEnabled(bool enabled) { sleepEnabled.store(enabled); }
+
+uint64_t getSleptMs() { return sleptMs.load(); }
+
+} // namespace FakeWin32
+
+// Win32 stand-ins
+short GetAsyncKeyState(int vKey) {
+  return FakeWin32::getKeyState(vKey) ? static_cast<short>(0x8000) : 0;
+}
+
+void Sleep(DWORD milliseconds) {
+  sleptMs.fetch_add(milliseconds, std::memory_order_relaxed);
+  if (sleepEnabled.load(std::memory_order_relaxed)) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+  }
+}
+
+DWORD GetModuleFileNameA(HMODULE, LPSTR fileName, DWORD size) {
+  if (size == 0) {
+    return 0;
+  }
+  ssize_t length = readlink("/proc/self/exe", fileName, size - 1);
+  if (length < 0) {
+    // No procfs: fall back to the current directory
+    std::strncpy(fileName, "./escModKey", size - 1);
+    length = static_cast<ssize_t>(std::strlen(fileName));
+  }
+  fileName[length] = '\0';
+  return static_cast<DWORD>(length);
+}
+
+BOOL CreateDirectoryA(LPCSTR pathName, void *) {
+  if (mkdir(pathName, 0755) != 0) {
+    lastError = static_cast<DWORD>(errno);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+DWORD GetLastError() { return lastError; }
+
+HRESULT SHGetFolderPathA(HWND, int folder, HANDLE, DWORD, LPSTR path) {
+  if (folder != CSIDL_APPDATA) {
+    return E_FAIL;
+  }
+  std::string dir;
+  if (const char *config = std::getenv("XDG_CONFIG_HOME")) {
+    dir = config;
+  } else if (const char *home = std::getenv("HOME")) {
+    dir = std::string(home) + "/.config";
+  } else {
+    return E_FAIL;
+  }
+  if (dir.size() >= MAX_PATH) {
+    return E_FAIL;
+  }
+  std::strcpy(path, dir.c_str());
+  return S_OK;
+}
@@ -1,9 +1,9 @@
 #include "config.h"
+#include "logger.h"
 #include "toml.h"
 #include <Windows.h>
 #include <fstream>
 #include <iomanip>
-#include <iostream>
 #include <set>
 #include <shlobj.h>
 
@@ -14,11 +14,34 @@ static bool isValidModifierKeyId(const std::string &keyId) {
   return validKeys.find(keyId) != validKeys.end();
 }
 
+// TOML string for a path: a literal string so Windows paths need no
+// escaping, or a basic string if the path contains a quote a literal
+// string cannot hold
+static std::string tomlPath(const std::string &path) {
+  if (path.find('\'') == std::string::npos) {
+    return "'" + path + "'";
+  }
+  std::string text = "\"";
+  for (char c : path) {
+    if (c == '\\' || c == '"') {
+      text += '\\';
+    }
+    text += c;
+  }
+  return text + "\"";
+}
+
 Config::Config() { loadDefaults(); }
 
 void Config::loadDefaults() {
   // General settings
   thresholdMs_ = 1000;
+  keyThresholds_.clear();
+  adaptiveThreshold_ = AdaptiveThresholdConfig();
+  timerFix_ = false;
+  releaseCheckMs_ = 0;
+  lostKeyDownMs_ = 100;
+  repairKeyDown_ = false;
   showMessages_ = true;
 
   // Notification settings
@@ -29,6 +52,19 @@ void Config::loadDefaults() {
   // Advanced settings
   tooltipUpdateInterval_ = 1000;
   debugMode_ = false;
+  logFile_.clear();
+  logFileSizeMB_ = 4;
+  logMaxFiles_ = 3;
+  stageTimingLogIntervalMs_ = 0;
+  traceFile_.clear();
+  recordFile_.clear();
+  recordFileSizeMB_ = 8;
+  recordMaxFiles_ = 8;
+  flightRecorderEvents_ = 4096;
+  flightRecorderDir_.clear();
+  flightRecorderMaxDumps_ = 16;
+  shadowPolicies_.clear();
+  fastStart_ = true;
 
   // Key monitoring settings (default: monitor all)
   monitorCtrl_ = true;
@@ -50,11 +86,77 @@ bool Config::load(const std::string &filepath) {
       if (auto threshold = (*general)["thresholdMs"].value<int64_t>()) {
         thresholdMs_ = static_cast<int>(*threshold);
       }
+      if (auto thresholds = (*general)["keyThresholds"].as_table()) {
+        keyThresholds_.clear();
+        for (const auto &entry : *thresholds) {
+          auto ms = entry.second.value<int64_t>();
+          if (!ms || *ms <= 0) {
+            Log::warning("Invalid threshold for key '{s}'. Ignored.",
+                         std::string(entry.first.str()));
+            continue;
+          }
+          keyThresholds_.emplace_back(std::string(entry.first.str()),
+                                      static_cast<int>(*ms));
+        }
+      }
+      if (auto timerFix = (*general)["timerFix"].value<bool>()) {
+        timerFix_ = *timerFix;
+      }
+      if (auto check = (*general)["releaseCheckMs"].value<int64_t>()) {
+        if (*check < 0) {
+          Log::warning("Invalid releaseCheckMs {}. Release checks disabled.",
+                       *check);
+          releaseCheckMs_ = 0;
+        } else {
+          releaseCheckMs_ = static_cast<int>(*check);
+        }
+      }
+      if (auto lost = (*general)["lostKeyDownMs"].value<int64_t>()) {
+        if (*lost <= 0) {
+          Log::warning("Invalid lostKeyDownMs {}. Using default.", *lost);
+        } else {
+          lostKeyDownMs_ = static_cast<int>(*lost);
+        }
+      }
+      if (auto repair = (*general)["repairKeyDown"].value<bool>()) {
+        repairKeyDown_ = *repair;
+      }
       if (auto showMsg = (*general)["showMessages"].value<bool>()) {
         showMessages_ = *showMsg;
       }
     }
 
+    // Load adaptive threshold settings
+    if (auto adaptive = config["adaptiveThreshold"].as_table()) {
+      AdaptiveThresholdConfig loaded = adaptiveThreshold_;
+      if (auto enabled = (*adaptive)["enabled"].value<bool>()) {
+        loaded.enabled = *enabled;
+      }
+      if (auto quantile = (*adaptive)["quantile"].value<double>()) {
+        loaded.quantile = *quantile;
+      }
+      if (auto margin = (*adaptive)["marginMs"].value<int64_t>()) {
+        loaded.marginMs = static_cast<int>(*margin);
+      }
+      if (auto minMs = (*adaptive)["minMs"].value<int64_t>()) {
+        loaded.minMs = static_cast<int>(*minMs);
+      }
+      if (auto maxMs = (*adaptive)["maxMs"].value<int64_t>()) {
+        loaded.maxMs = static_cast<int>(*maxMs);
+      }
+      if (auto samples = (*adaptive)["minSamples"].value<int64_t>()) {
+        loaded.minSamples = static_cast<int>(*samples);
+      }
+
+      if (loaded.quantile <= 0.0 || loaded.quantile >= 1.0 ||
+          loaded.marginMs < 0 || loaded.minMs <= 0 ||
+          loaded.maxMs < loaded.minMs || loaded.minSamples < 1) {
+        Log::warning("Invalid adaptiveThreshold settings. Using defaults.");
+      } else {
+        adaptiveThreshold_ = loaded;
+      }
+    }
+
     // Load notification settings
     if (auto notifications = config["notifications"].as_table()) {
       if (auto enabled = (*notifications)["enabled"].value<bool>()) {
@@ -77,6 +179,53 @@ bool Config::load(const std::string &filepath) {
       if (auto debug = (*advanced)["debugMode"].value<bool>()) {
         debugMode_ = *debug;
       }
+      if (auto logFile = (*advanced)["logFile"].value<std::string>()) {
+        logFile_ = *logFile;
+      }
+      if (auto sizeMB = (*advanced)["logFileSizeMB"].value<int64_t>()) {
+        logFileSizeMB_ = static_cast<int>(*sizeMB);
+      }
+      if (auto maxFiles = (*advanced)["logMaxFiles"].value<int64_t>()) {
+        logMaxFiles_ = static_cast<int>(*maxFiles);
+      }
+      if (auto interval =
+              (*advanced)["stageTimingLogIntervalMs"].value<int64_t>()) {
+        stageTimingLogIntervalMs_ = static_cast<int>(*interval);
+      }
+      if (auto traceFile = (*advanced)["traceFile"].value<std::string>()) {
+        traceFile_ = *traceFile;
+      }
+      if (auto recordFile = (*advanced)["recordFile"].value<std::string>()) {
+        recordFile_ = *recordFile;
+      }
+      if (auto sizeMB = (*advanced)["recordFileSizeMB"].value<int64_t>()) {
+        recordFileSizeMB_ = static_cast<int>(*sizeMB);
+      }
+      if (auto maxFiles = (*advanced)["recordMaxFiles"].value<int64_t>()) {
+        recordMaxFiles_ = static_cast<int>(*maxFiles);
+      }
+      if (auto events =
+              (*advanced)["flightRecorderEvents"].value<int64_t>()) {
+        flightRecorderEvents_ = static_cast<int>(*events);
+      }
+      if (auto dir = (*advanced)["flightRecorderDir"].value<std::string>()) {
+        flightRecorderDir_ = *dir;
+      }
+      if (auto maxDumps =
+              (*advanced)["flightRecorderMaxDumps"].value<int64_t>()) {
+        flightRecorderMaxDumps_ = static_cast<int>(*maxDumps);
+      }
+      if (auto policies = (*advanced)["shadowPolicies"].as_array()) {
+        shadowPolicies_.clear();
+        for (const auto &policy : *policies) {
+          if (auto policyStr = policy.value<std::string>()) {
+            shadowPolicies_.push_back(*policyStr);
+          }
+        }
+      }
+      if (auto fastStart = (*advanced)["fastStart"].value<bool>()) {
+        fastStart_ = *fastStart;
+      }
     }
 
     // Load key monitoring settings
@@ -139,16 +288,15 @@ bool Config::load(const std::string &filepath) {
 
           // Validate required fields
           if (!sourceScanCode || !sourceNeedsE0.has_value() || !targetKeyId) {
-            std::cerr << "Warning: Key mapping missing required field. Mapping "
-                         "ignored."
-                      << std::endl;
+            Log::warning("Key mapping missing required field. Mapping "
+                         "ignored.");
             continue;
           }
 
           // Validate target key ID
           if (!isValidModifierKeyId(*targetKeyId)) {
-            std::cerr << "Error: Invalid target key ID '" << *targetKeyId
-                      << "'. Mapping rejected." << std::endl;
+            Log::error("Invalid target key ID '{s}'. Mapping rejected.",
+                       *targetKeyId);
             continue;
           }
 
@@ -158,8 +306,9 @@ bool Config::load(const std::string &filepath) {
             if (*mappingType == "additional" || *mappingType == "replace") {
               type = *mappingType;
             } else {
-              std::cerr << "Warning: Invalid mapping type '" << *mappingType
-                        << "'. Using default 'additional'." << std::endl;
+              Log::warning("Invalid mapping type '{s}'. Using default "
+                           "'additional'.",
+                           *mappingType);
             }
           }
 
@@ -174,11 +323,11 @@ bool Config::load(const std::string &filepath) {
 
     return true;
   } catch (const toml::parse_error &err) {
-    std::cerr << "Error parsing config file: " << err.description()
-              << std::endl;
+    Log::error("Failed to parse config file: {s}",
+               std::string(err.description()));
     return false;
   } catch (const std::exception &e) {
-    std::cerr << "Error loading config: " << e.what() << std::endl;
+    Log::error("Failed to load config: {s}", e.what());
     return false;
   }
 }
@@ -198,10 +347,55 @@ bool Config::save(const std::string &filepath) const {
     file << "# 判定按键卡住的时间阈值（毫秒）\n";
     file << "thresholdMs = " << thresholdMs_ << "\n\n";
 
+    file << "# Per-key thresholds (ms) overriding thresholdMs\n";
+    file << "# 按键单独的阈值（毫秒），覆盖 thresholdMs\n";
+    file << "keyThresholds = {";
+    for (size_t i = 0; i < keyThresholds_.size(); ++i) {
+      file << (i > 0 ? ", " : " ") << "\"" << keyThresholds_[i].first
+           << "\" = " << keyThresholds_[i].second;
+    }
+    file << (keyThresholds_.empty() ? "}" : " }") << "\n\n";
+
+    file << "# Release a stuck key as soon as its threshold passes while no\n";
+    file << "# monitored key is held, without waiting for the next key-down\n";
+    file << "# 阈值一到且没有按住监控按键时立即释放卡住的按键，不等待下一次按键\n";
+    file << "timerFix = " << (timerFix_ ? "true" : "false") << "\n\n";
+
+    file << "# Release a key at once if the OS has not followed its key-up\n";
+    file << "# within this many ms (dropped key-up); 0 = off\n";
+    file << "# 按键松开后系统在此时间（毫秒）内仍显示按下时立即释放；0 = 关闭\n";
+    file << "releaseCheckMs = " << releaseCheckMs_ << "\n\n";
+
+    file << "# A held key the OS has not registered for this many ms counts\n";
+    file << "# as a lost key-down; repairKeyDown sends its key-down again\n";
+    file << "# 按住的按键在此时间（毫秒）内系统仍未按下即视为按下事件丢失；\n";
+    file << "# repairKeyDown 为 true 时重新发送按下事件\n";
+    file << "lostKeyDownMs = " << lostKeyDownMs_ << "\n";
+    file << "repairKeyDown = " << (repairKeyDown_ ? "true" : "false")
+         << "\n\n";
+
     file << "# Show console messages (console version only)\n";
     file << "# 是否显示控制台消息（仅控制台版本）\n";
     file << "showMessages = " << (showMessages_ ? "true" : "false") << "\n\n";
 
+    file << "[adaptiveThreshold]\n";
+    file << "# Learn each key's threshold from its mismatch durations (a "
+            "fixed one counts\n";
+    file << "# as lasting the threshold):\n";
+    file << "# threshold = quantile of the durations + marginMs, within "
+            "[minMs, maxMs]\n";
+    file << "# 根据不一致持续时间学习每个按键的阈值（被修复的按阈值计）：\n";
+    file << "# 阈值 = 时长分位数 + marginMs，限制在 [minMs, maxMs] 内\n";
+    file << "enabled = " << (adaptiveThreshold_.enabled ? "true" : "false")
+         << "\n";
+    file << "quantile = " << adaptiveThreshold_.quantile << "\n";
+    file << "marginMs = " << adaptiveThreshold_.marginMs << "\n";
+    file << "minMs = " << adaptiveThreshold_.minMs << "\n";
+    file << "maxMs = " << adaptiveThreshold_.maxMs << "\n";
+    file << "# Mismatches a key needs before its learned threshold applies\n";
+    file << "# 学习到的阈值生效前该按键所需的不一致次数\n";
+    file << "minSamples = " << adaptiveThreshold_.minSamples << "\n\n";
+
     file << "[notifications]\n";
     file << "# Show balloon notifications (GUI version)\n";
     file << "# 是否显示气泡通知（GUI 版本）\n";
@@ -222,10 +416,62 @@ bool Config::save(const std::string &filepath) const {
     file << "# 托盘提示更新间隔（毫秒）\n";
     file << "tooltipUpdateInterval = " << tooltipUpdateInterval_ << "\n\n";
 
-    file << "# Enable debug logging\n";
-    file << "# 启用调试日志\n";
+    file << "# Enable debug logging (every stroke and tracker change)\n";
+    file << "# 启用调试日志（记录每次按键和追踪器变化）\n";
     file << "debugMode = " << (debugMode_ ? "true" : "false") << "\n\n";
 
+    file << "# Write log messages to rotating text files (empty = console)\n";
+    file << "# 将日志写入滚动文本文件（留空 = 仅控制台）\n";
+    file << "logFile = " << tomlPath(logFile_) << "\n";
+    file << "# Size of one log file (MB) and number of files kept\n";
+    file << "# 单个日志文件大小（MB）及保留的文件数\n";
+    file << "logFileSizeMB = " << logFileSizeMB_ << "\n";
+    file << "logMaxFiles = " << logMaxFiles_ << "\n\n";
+
+    file << "# Log per-stage timing summary every N ms (0 = off)\n";
+    file << "# 每隔 N 毫秒输出一次各阶段耗时摘要（0 = 关闭）\n";
+    file << "stageTimingLogIntervalMs = " << stageTimingLogIntervalMs_
+         << "\n\n";
+
+    file << "# Write a Chrome/Perfetto trace of the event loop (empty = off)\n";
+    file << "# 将事件循环写入 Chrome/Perfetto 跟踪文件（留空 = 关闭）\n";
+    file << "traceFile = " << tomlPath(traceFile_) << "\n\n";
+
+    file << "# Record strokes and fixes to rotating binary files (empty = off)\n";
+    file << "# 将按键和修复记录到滚动二进制文件（留空 = 关闭）\n";
+    file << "recordFile = " << tomlPath(recordFile_) << "\n";
+    file << "# Size of one record file (MB) and number of files kept\n";
+    file << "# 单个记录文件大小（MB）及保留的文件数\n";
+    file << "recordFileSizeMB = " << recordFileSizeMB_ << "\n";
+    file << "recordMaxFiles = " << recordMaxFiles_ << "\n\n";
+
+    file << "# Keep the last N events in memory and dump them on every fix "
+            "(0 = off)\n";
+    file << "# 在内存中保留最近 N 个事件，每次修复时写出（0 = 关闭）\n";
+    file << "flightRecorderEvents = " << flightRecorderEvents_ << "\n";
+    file << "# Dump directory (empty = \"dumps\" beside this file) and dumps "
+            "kept\n";
+    file << "# 转储目录（留空 = 本文件旁的 \"dumps\"）及保留的转储数\n";
+    file << "flightRecorderDir = " << tomlPath(flightRecorderDir_) << "\n";
+    file << "flightRecorderMaxDumps = " << flightRecorderMaxDumps_ << "\n\n";
+
+    file << "# Fix policies evaluated alongside the live one without "
+            "acting,\n";
+    file << "# \"<ms>\" or \"<ms>:<trigger>\" (trigger: idle, any, other)\n";
+    file << "# 与当前策略并行评估、但不执行修复的候选策略，"
+            "格式 \"<毫秒>\" 或 \"<毫秒>:<触发规则>\"\n";
+    file << "shadowPolicies = [";
+    for (size_t i = 0; i < shadowPolicies_.size(); ++i) {
+      if (i > 0)
+        file << ", ";
+      file << "\"" << shadowPolicies_[i] << "\"";
+    }
+    file << "]\n\n";
+
+    file << "# Start interception before the tray icon and notification\n";
+    file << "# 先启动按键拦截，再创建托盘图标和显示通知\n";
+    file << "fastStart = " << (fastStart_ ? "true" : "false") << "\n\n";
+
     file << "[keys]\n";
     file << "# Quick toggle for standard modifier keys\n";
     file << "# 标准修饰键快速开关\n";
@@ -279,7 +525,7 @@ bool Config::save(const std::string &filepath) const {
     file.close();
     return true;
   } catch (const std::exception &e) {
-    std::cerr << "Error saving config: " << e.what() << std::endl;
+    Log::error("Failed to save config: {s}", e.what());
     return false;
   }
 }
@@ -0,0 +1,760 @@
+#include "differential.h"
+#include "physical_key_detector.h"
+#include "reference_fixer.h"
+#include "virtual_key_detector.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <sstream>
+
+namespace {
+
+uint32_t layerKey(unsigned short scanCode, bool needsE0) {
+  return scanCode | (needsE0 ? 0x10000u : 0u);
+}
+
+// Common event sequence; subclasses adapt one implementation
+class LockstepSubject : public DiffSubject {
+public:
+  void step(const DiffEvent &event, DiffVirtualLayer &layer,
+            DiffStep &result) override {
+    int64_t nowNs = static_cast<int64_t>(event.timeNs);
+    result.fix = false;
+    result.fixedKeys.clear();
+    result.changes.clear();
+
+    if (!event.idle) {
+      InterceptionKeyStroke stroke;
+      stroke.code = event.code;
+      stroke.state = event.state;
+      stroke.information = 0;
+      result.fix = shouldFix(stroke, nowNs);
+      if (result.fix) {
+        std::vector<DiffKey> keys = getKeys();
+        for (size_t i = 0; i < keys.size(); ++i) {
+          if (isStuck(i, nowNs)) {
+            result.fixedKeys.push_back(i);
+            layer.release(keys[i].scanCode, keys[i].needsE0);
+          }
+        }
+      }
+      processKeyStroke(stroke);
+      layer.apply(event);
+    }
+
+    updateTrackers(layer, nowNs, result.changes);
+    snapshot(nowNs, result);
+  }
+
+protected:
+  virtual bool shouldFix(const InterceptionKeyStroke &stroke,
+                         int64_t nowNs) = 0;
+  virtual bool isStuck(size_t keyIndex, int64_t nowNs) = 0;
+  virtual void processKeyStroke(const InterceptionKeyStroke &stroke) = 0;
+  virtual void updateTrackers(const DiffVirtualLayer &layer, int64_t nowNs,
+                              std::vector<TrackerEvent> &changes) = 0;
+  virtual void snapshot(int64_t nowNs, DiffStep &result) = 0;
+};
+
+class ReferenceSubject : public LockstepSubject {
+public:
+  void initialize(const DiffConfig &config) override {
+    fixer_.initialize(config.monitorCtrl, config.monitorShift,
+                      config.monitorAlt, config.monitorWin,
+                      config.disabledKeys, config.customKeys,
+                      config.keyMappings);
+    fixer_.setThreshold(config.thresholdMs);
+    fixer_.setTrigger(config.trigger);
+    for (const auto &entry : config.keyThresholds) {
+      fixer_.setKeyThreshold(entry.first, entry.second);
+    }
+
+    // A virtual key is down when the layer holds the scan code of the
+    // physical key with its ID
+    virtualCodes_.clear();
+    for (const std::string &id : fixer_.getVirtualIds()) {
+      int64_t code = -1;
+      for (const auto &key : fixer_.getKeys()) {
+        if (key.id == id) {
+          code = layerKey(key.scanCode, key.needsE0);
+          break;
+        }
+      }
+      virtualCodes_.push_back(code);
+    }
+    virtualPressed_.assign(virtualCodes_.size(), false);
+  }
+
+  std::vector<DiffKey> getKeys() const override {
+    std::vector<DiffKey> keys;
+    for (const auto &key : fixer_.getKeys()) {
+      keys.push_back({key.id, key.scanCode, key.needsE0});
+    }
+    return keys;
+  }
+
+protected:
+  bool shouldFix(const InterceptionKeyStroke &stroke, int64_t nowNs) override {
+    return fixer_.shouldFix(stroke, nowNs);
+  }
+
+  bool isStuck(size_t keyIndex, int64_t nowNs) override {
+    return fixer_.isStuck(keyIndex, nowNs);
+  }
+
+  void processKeyStroke(const InterceptionKeyStroke &stroke) override {
+    fixer_.processKeyStroke(stroke);
+  }
+
+  void updateTrackers(const DiffVirtualLayer &layer, int64_t nowNs,
+                      std::vector<TrackerEvent> &changes) override {
+    for (size_t i = 0; i < virtualCodes_.size(); ++i) {
+      int64_t code = virtualCodes_[i];
+      virtualPressed_[i] =
+          code >= 0 && layer.isDown(static_cast<unsigned short>(code & 0xFFFF),
+                                    (code & 0x10000) != 0);
+    }
+    fixer_.updateTrackers(virtualPressed_, nowNs, &changes);
+  }
+
+  void snapshot(int64_t nowNs, DiffStep &result) override {
+    const auto &keys = fixer_.getKeys();
+    result.physical.resize(keys.size());
+    result.mismatched.resize(keys.size());
+    result.stuckReported.resize(keys.size());
+    result.mismatchMs.resize(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+      const ReferenceFixer::Tracker &tracker = fixer_.getTracker(i);
+      result.physical[i] = keys[i].pressed;
+      result.mismatched[i] = tracker.isMismatched;
+      result.stuckReported[i] = tracker.stuckReported;
+      result.mismatchMs[i] = fixer_.getMismatchMs(i, nowNs);
+    }
+  }
+
+private:
+  ReferenceFixer fixer_;
+  std::vector<int64_t> virtualCodes_;
+  std::vector<bool> virtualPressed_;
+};
+
+class CurrentSubject : public LockstepSubject {
+public:
+  void initialize(const DiffConfig &config) override {
+    detector_.initializeWithConfig(config.monitorCtrl, config.monitorShift,
+                                   config.monitorAlt, config.monitorWin,
+                                   config.disabledKeys, config.customKeys,
+                                   config.keyMappings);
+    virtual_.initializeWithConfig(config.monitorCtrl, config.monitorShift,
+                                  config.monitorAlt, config.monitorWin,
+                                  config.disabledKeys, config.customKeys);
+    logic_.initialize(detector_.getStates(), virtual_);
+    logic_.setThreshold(config.thresholdMs);
+    logic_.setTrigger(config.trigger);
+    for (const auto &entry : config.keyThresholds) {
+      logic_.setKeyThreshold(entry.first, entry.second);
+    }
+
+    virtualCodes_.clear();
+    for (const auto &key : virtual_.getKeys()) {
+      const KeyState *physical = detector_.getStates().findKeyById(key.id);
+      virtualCodes_.push_back(
+          physical ? layerKey(physical->scanCode, physical->needsE0) : -1);
+    }
+  }
+
+  std::vector<DiffKey> getKeys() const override {
+    std::vector<DiffKey> keys;
+    for (const auto &key : detector_.getStates().getKeys()) {
+      keys.push_back({key.id, key.scanCode, key.needsE0});
+    }
+    return keys;
+  }
+
+protected:
+  static FixLogic::TimePoint timePoint(int64_t nowNs) {
+    return FixLogic::TimePoint(
+        std::chrono::duration_cast<FixLogic::TimePoint::duration>(
+            std::chrono::nanoseconds(nowNs)));
+  }
+
+  bool shouldFix(const InterceptionKeyStroke &stroke, int64_t nowNs) override {
+    return logic_.shouldFix(stroke, detector_.getStates(), timePoint(nowNs));
+  }
+
+  bool isStuck(size_t keyIndex, int64_t nowNs) override {
+    return logic_.isStuck(keyIndex, timePoint(nowNs));
+  }
+
+  void processKeyStroke(const InterceptionKeyStroke &stroke) override {
+    detector_.processKeyStroke(stroke);
+  }
+
+  void updateTrackers(const DiffVirtualLayer &layer, int64_t nowNs,
+                      std::vector<TrackerEvent> &changes) override {
+    auto &keys = virtual_.getKeys();
+    for (size_t i = 0; i < keys.size(); ++i) {
+      int64_t code = virtualCodes_[i];
+      keys[i].pressed =
+          code >= 0 && layer.isDown(static_cast<unsigned short>(code & 0xFFFF),
+                                    (code & 0x10000) != 0);
+    }
+    logic_.updateTrackers(detector_.getStates(), virtual_, timePoint(nowNs),
+                          &changes);
+  }
+
+  void snapshot(int64_t nowNs, DiffStep &result) override {
+    const auto &keys = detector_.getStates().getKeys();
+    const auto &trackers = logic_.getTrackers();
+    result.physical.resize(keys.size());
+    result.mismatched.resize(keys.size());
+    result.stuckReported.resize(keys.size());
+    result.mismatchMs.resize(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+      const MismatchTracker *tracker = trackers.getTracker(keys[i].id);
+      result.physical[i] = keys[i].pressed;
+      result.mismatched[i] = tracker && tracker->isMismatched;
+      result.stuckReported[i] = tracker && tracker->stuckReported;
+      result.mismatchMs[i] = logic_.getMismatchMs(i, timePoint(nowNs));
+    }
+  }
+
+private:
+  PhysicalKeyDetector detector_;
+  VirtualKeyStates virtual_;
+  FixLogic logic_;
+  std::vector<int64_t> virtualCodes_;
+};
+
+const char *changeName(TrackerChange change) {
+  switch (change) {
+  case TrackerChange::MismatchStart:
+    return "mismatch";
+  case TrackerChange::Stuck:
+    return "stuck";
+  case TrackerChange::Reset:
+    return "reset";
+  }
+  return "?";
+}
+
+std::string describeChanges(const std::vector<TrackerEvent> &changes,
+                            const std::vector<DiffKey> &keys) {
+  std::ostringstream out;
+  out << "[";
+  for (size_t i = 0; i < changes.size(); ++i) {
+    const TrackerEvent &change = changes[i];
+    out << (i ? " " : "")
+        << (change.keyIndex < keys.size() ? keys[change.keyIndex].id : "?")
+        << ":" << changeName(change.change) << "@" << change.mismatchMs;
+  }
+  out << "]";
+  return out.str();
+}
+
+bool sameChanges(const std::vector<TrackerEvent> &a,
+                 const std::vector<TrackerEvent> &b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (a[i].keyIndex != b[i].keyIndex || a[i].change != b[i].change ||
+        a[i].mismatchMs != b[i].mismatchMs) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// First difference between two steps, or empty
+std::string compareSteps(const DiffStep &reference, const DiffStep &current,
+                         const std::vector<DiffKey> &keys) {
+  std::ostringstream out;
+  if (reference.fix != current.fix) {
+    out << "fix decision: reference " << reference.fix << ", current "
+        << current.fix;
+    return out.str();
+  }
+  if (reference.fixedKeys != current.fixedKeys) {
+    out << "keys fixed: reference " << reference.fixedKeys.size()
+        << ", current " << current.fixedKeys.size();
+    return out.str();
+  }
+  for (size_t i = 0; i < keys.size(); ++i) {
+    const char *field = nullptr;
+    long ref = 0;
+    long cur = 0;
+    if (reference.physical[i] != current.physical[i]) {
+      field = "physical";
+      ref = reference.physical[i];
+      cur = current.physical[i];
+    } else if (reference.mismatched[i] != current.mismatched[i]) {
+      field = "mismatched";
+      ref = reference.mismatched[i];
+      cur = current.mismatched[i];
+    } else if (reference.stuckReported[i] != current.stuckReported[i]) {
+      field = "stuck reported";
+      ref = reference.stuckReported[i];
+      cur = current.stuckReported[i];
+    } else if (reference.mismatchMs[i] != current.mismatchMs[i]) {
+      field = "mismatch ms";
+      ref = reference.mismatchMs[i];
+      cur = current.mismatchMs[i];
+    }
+    if (field) {
+      out << field << " of " << keys[i].id << ": reference " << ref
+          << ", current " << cur;
+      return out.str();
+    }
+  }
+  if (!sameChanges(reference.changes, current.changes)) {
+    out << "tracker changes: reference "
+        << describeChanges(reference.changes, keys) << ", current "
+        << describeChanges(current.changes, keys);
+  }
+  return out.str();
+}
+
+std::string describeKeys(const std::vector<DiffKey> &keys) {
+  std::ostringstream out;
+  out << std::hex << std::uppercase;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    out << (i ? " " : "") << keys[i].id << "=0x" << keys[i].scanCode
+        << (keys[i].needsE0 ? "/E0" : "");
+  }
+  return out.str();
+}
+
+// Scan codes the generator draws from: the monitored keys, keys used by
+// custom keys and mappings, a plain key and near misses (E0 mixed up)
+struct PoolKey {
+  unsigned short code;
+  bool e0;
+};
+
+const PoolKey kPoolKeys[] = {
+    {0x1D, false}, {0x1D, true},  {0x2A, false}, {0x36, false},
+    {0x38, false}, {0x38, true},  {0x5B, true},  {0x5C, true},
+    {0x3A, false}, {0x5D, true},  {0x1E, false}, {0x1F, false},
+    {0x5B, false}, {0x2A, true},  {0x46, false}, {0x1C, true}};
+const size_t kPoolKeyCount = sizeof(kPoolKeys) / sizeof(kPoolKeys[0]);
+
+const char *const kDisabledIds[] = {"lctrl", "RCTRL",    "lShift", "rshift",
+                                    "lalt",  "ralt",     "lwin",   "RWin",
+                                    "capslock", "nosuch"};
+
+// "L Ctrl" collides with the standard lctrl ID
+const char *const kCustomNames[] = {"Caps Lock", "CapsLock", "Apps",
+                                    "L Ctrl",    "Scroll Lock", "Num Enter"};
+
+const char *const kTargetIds[] = {"lctrl", "rctrl",    "lshift", "rshift",
+                                  "lalt",  "ralt",     "lwin",   "rwin",
+                                  "capslock", "apps", "LCtrl",  "nosuch"};
+
+const int kThresholdsMs[] = {1, 50, 200, 500, 1000};
+
+template <typename T, size_t N>
+const T &pick(SimRandom &random, const T (&items)[N]) {
+  return items[random.range(0, N - 1)];
+}
+
+DiffConfig generateConfig(SimRandom &random) {
+  DiffConfig config;
+  config.monitorCtrl = random.uniform() < 0.85;
+  config.monitorShift = random.uniform() < 0.85;
+  config.monitorAlt = random.uniform() < 0.85;
+  config.monitorWin = random.uniform() < 0.85;
+
+  size_t disabled = random.uniform() < 0.3 ? random.range(1, 3) : 0;
+  for (size_t i = 0; i < disabled; ++i) {
+    config.disabledKeys.push_back(pick(random, kDisabledIds));
+  }
+  size_t custom = random.uniform() < 0.4 ? random.range(1, 3) : 0;
+  for (size_t i = 0; i < custom; ++i) {
+    const PoolKey &key = pick(random, kPoolKeys);
+    config.customKeys.emplace_back(key.code, key.e0,
+                                   pick(random, kCustomNames), 0x14);
+  }
+  size_t mappings = random.uniform() < 0.5 ? random.range(1, 3) : 0;
+  for (size_t i = 0; i < mappings; ++i) {
+    const PoolKey &key = pick(random, kPoolKeys);
+    config.keyMappings.emplace_back(
+        key.code, key.e0, pick(random, kTargetIds),
+        random.uniform() < 0.85 ? "additional" : "replace");
+  }
+
+  config.thresholdMs = pick(random, kThresholdsMs);
+  static const FixTrigger triggers[] = {FixTrigger::IdleKeyDown,
+                                        FixTrigger::AnyKeyDown,
+                                        FixTrigger::OtherKeyDown};
+  config.trigger = pick(random, triggers);
+  if (random.uniform() < 0.3) {
+    config.keyThresholds.emplace_back(random.range(0, 9),
+                                      pick(random, kThresholdsMs));
+  }
+  return config;
+}
+
+uint64_t generateGapNs(SimRandom &random) {
+  double roll = random.uniform();
+  uint64_t ms;
+  if (roll < 0.1) {
+    ms = 0;
+  } else if (roll < 0.6) {
+    ms = random.range(1, 40);
+  } else if (roll < 0.9) {
+    ms = random.range(40, 700);
+  } else {
+    ms = random.range(700, 2500);
+  }
+  // Sub-millisecond part exercises the truncation of mismatch durations
+  return ms * 1000000 + random.range(0, 999999);
+}
+
+// Silences the detector's configuration warnings while cases run
+class QuietStderr {
+public:
+  QuietStderr() : saved_(std::cerr.rdbuf(nullptr)) {}
+  ~QuietStderr() {
+    std::cerr.rdbuf(saved_);
+    std::cerr.clear();
+  }
+
+private:
+  std::streambuf *saved_;
+};
+
+} // namespace
+
+void DiffVirtualLayer::apply(const DiffEvent &event) {
+  if (event.idle) {
+    return;
+  }
+  bool e0 = (event.state & INTERCEPTION_KEY_E0) != 0;
+  if (!(event.state & INTERCEPTION_KEY_UP)) {
+    if (!isDown(event.code, e0)) {
+      down_.push_back(layerKey(event.code, e0));
+    }
+  } else if (!event.lost) {
+    release(event.code, e0);
+  }
+}
+
+void DiffVirtualLayer::release(unsigned short scanCode, bool needsE0) {
+  down_.erase(std::remove(down_.begin(), down_.end(),
+                          layerKey(scanCode, needsE0)),
+              down_.end());
+}
+
+bool DiffVirtualLayer::isDown(unsigned short scanCode, bool needsE0) const {
+  return std::find(down_.begin(), down_.end(), layerKey(scanCode, needsE0)) !=
+         down_.end();
+}
+
+std::unique_ptr<DiffSubject> makeReferenceSubject() {
+  return std::unique_ptr<DiffSubject>(new ReferenceSubject());
+}
+
+std::unique_ptr<DiffSubject> makeCurrentSubject() {
+  return std::unique_ptr<DiffSubject>(new CurrentSubject());
+}
+
+DiffMismatch runDiffCase(const DiffCase &testCase,
+                         const DiffSubjectFactory &reference,
+                         const DiffSubjectFactory &current) {
+  DiffMismatch mismatch;
+  std::unique_ptr<DiffSubject> ref = reference();
+  std::unique_ptr<DiffSubject> cur = current();
+  ref->initialize(testCase.config);
+  cur->initialize(testCase.config);
+
+  std::vector<DiffKey> keys = ref->getKeys();
+  std::vector<DiffKey> currentKeys = cur->getKeys();
+  if (keys != currentKeys) {
+    mismatch.found = true;
+    mismatch.eventIndex = testCase.events.size();
+    mismatch.description = "key table: reference {" + describeKeys(keys) +
+                           "}, current {" + describeKeys(currentKeys) + "}";
+    return mismatch;
+  }
+
+  DiffVirtualLayer refLayer;
+  DiffVirtualLayer curLayer;
+  DiffStep refStep;
+  DiffStep curStep;
+  for (size_t i = 0; i < testCase.events.size(); ++i) {
+    ref->step(testCase.events[i], refLayer, refStep);
+    cur->step(testCase.events[i], curLayer, curStep);
+    std::string difference = compareSteps(refStep, curStep, keys);
+    if (!difference.empty()) {
+      mismatch.found = true;
+      mismatch.eventIndex = i;
+      mismatch.description = difference;
+      return mismatch;
+    }
+  }
+  return mismatch;
+}
+
+DiffCase shrinkDiffCase(const DiffCase &testCase,
+                        const DiffSubjectFactory &reference,
+                        const DiffSubjectFactory &current) {
+  DiffCase best = testCase;
+  DiffMismatch mismatch = runDiffCase(best, reference, current);
+  if (!mismatch.found) {
+    return best;
+  }
+  auto fails = [&](const DiffCase &candidate) {
+    return runDiffCase(candidate, reference, current).found;
+  };
+
+  // Nothing after the first difference matters
+  if (mismatch.eventIndex < best.events.size()) {
+    best.events.resize(mismatch.eventIndex + 1);
+  }
+
+  bool progress = true;
+  while (progress) {
+    progress = false;
+
+    // Remove runs of events, halving the run length (delta debugging)
+    for (size_t chunk = std::max<size_t>(best.events.size() / 2, 1);
+         chunk >= 1; chunk /= 2) {
+      for (size_t start = 0; start < best.events.size();) {
+        DiffCase candidate = best;
+        size_t end = std::min(start + chunk, candidate.events.size());
+        candidate.events.erase(candidate.events.begin() + start,
+                               candidate.events.begin() + end);
+        if (fails(candidate)) {
+          best = candidate;
+          progress = true;
+        } else {
+          start += chunk;
+        }
+      }
+      if (chunk == 1) {
+        break;
+      }
+    }
+
+    // Drop configuration entries one at a time
+    auto dropEach = [&](auto member) {
+      for (size_t i = 0; i < (best.config.*member).size();) {
+        DiffCase candidate = best;
+        auto &items = candidate.config.*member;
+        items.erase(items.begin() + i);
+        if (fails(candidate)) {
+          best = candidate;
+          progress = true;
+        } else {
+          ++i;
+        }
+      }
+    };
+    dropEach(&DiffConfig::disabledKeys);
+    dropEach(&DiffConfig::customKeys);
+    dropEach(&DiffConfig::keyMappings);
+    dropEach(&DiffConfig::keyThresholds);
+
+    bool DiffConfig::*groups[] = {
+        &DiffConfig::monitorCtrl, &DiffConfig::monitorShift,
+        &DiffConfig::monitorAlt, &DiffConfig::monitorWin};
+    for (auto group : groups) {
+      if (!(best.config.*group)) {
+        continue;
+      }
+      DiffCase candidate = best;
+      candidate.config.*group = false;
+      if (fails(candidate)) {
+        best = candidate;
+        progress = true;
+      }
+    }
+
+    // Simplify what is left: keep key-ups, default trigger
+    for (size_t i = 0; i < best.events.size(); ++i) {
+      if (!best.events[i].lost) {
+        continue;
+      }
+      DiffCase candidate = best;
+      candidate.events[i].lost = false;
+      if (fails(candidate)) {
+        best = candidate;
+        progress = true;
+      }
+    }
+    if (best.config.trigger != FixTrigger::IdleKeyDown) {
+      DiffCase candidate = best;
+      candidate.config.trigger = FixTrigger::IdleKeyDown;
+      if (fails(candidate)) {
+        best = candidate;
+        progress = true;
+      }
+    }
+  }
+  return best;
+}
+
+DiffCase generateDiffCase(uint64_t seed, size_t maxEvents) {
+  SimRandom random(seed * 0x9E3779B97F4A7C15ull + 1);
+  DiffCase testCase;
+  testCase.config = generateConfig(random);
+  if (maxEvents == 0) {
+    return testCase;
+  }
+
+  size_t count = random.range(1, maxEvents);
+  uint64_t timeNs = 1000000000;
+  std::vector<bool> held(kPoolKeyCount, false);
+  for (size_t i = 0; i < count; ++i) {
+    timeNs += generateGapNs(random);
+    DiffEvent event;
+    event.timeNs = timeNs;
+    if (random.uniform() < 0.15) {
+      event.idle = true;
+      testCase.events.push_back(event);
+      continue;
+    }
+    // Mostly presses and releases of the same key; stray key-ups and
+    // repeated key-downs too
+    size_t k = random.range(0, kPoolKeyCount - 1);
+    bool up = random.uniform() < 0.1 ? !held[k] : held[k];
+    held[k] = !up;
+    event.code = kPoolKeys[k].code;
+    event.state = static_cast<uint16_t>(
+        (up ? INTERCEPTION_KEY_UP : INTERCEPTION_KEY_DOWN) |
+        (kPoolKeys[k].e0 ? INTERCEPTION_KEY_E0 : 0));
+    event.lost = up && random.uniform() < 0.15;
+    testCase.events.push_back(event);
+  }
+  return testCase;
+}
+
+std::vector<DiffCase>
+diffCasesFromStrokes(const std::vector<SimStroke> &strokes, uint64_t seed,
+                     size_t windowSize, int pollMs, double dropRate) {
+  std::vector<DiffCase> cases;
+  SimRandom random(seed);
+  uint64_t pollNs = static_cast<uint64_t>(std::max(pollMs, 1)) * 1000000;
+  windowSize = std::max<size_t>(windowSize, 1);
+  for (size_t begin = 0; begin < strokes.size(); begin += windowSize) {
+    DiffCase testCase;
+    testCase.config = generateConfig(random);
+    size_t end = std::min(begin + windowSize, strokes.size());
+    for (size_t i = begin; i < end; ++i) {
+      // Idle iterations in the silence before the stroke (a few at most,
+      // and the last one just before it)
+      if (i > begin) {
+        uint64_t lastNs = strokes[i - 1].timeNs;
+        int idle = 0;
+        for (uint64_t t = lastNs + pollNs; t < strokes[i].timeNs && idle < 4;
+             t += pollNs, ++idle) {
+          DiffEvent event;
+          event.timeNs = t;
+          event.idle = true;
+          testCase.events.push_back(event);
+        }
+        if (idle == 4 && strokes[i].timeNs > lastNs + 5 * pollNs) {
+          DiffEvent event;
+          event.timeNs = strokes[i].timeNs - 1;
+          event.idle = true;
+          testCase.events.push_back(event);
+        }
+      }
+      DiffEvent event;
+      event.timeNs = strokes[i].timeNs;
+      event.code = strokes[i].code;
+      event.state = strokes[i].state;
+      event.lost = (strokes[i].state & INTERCEPTION_KEY_UP) &&
+                   random.uniform() < dropRate;
+      testCase.events.push_back(event);
+    }
+    cases.push_back(std::move(testCase));
+  }
+  return cases;
+}
+
+std::string describeDiffCase(const DiffCase &testCase) {
+  const DiffConfig &config = testCase.config;
+  std::ostringstream out;
+  out << "Monitor:" << (config.monitorCtrl ? " ctrl" : "")
+      << (config.monitorShift ? " shift" : "")
+      << (config.monitorAlt ? " alt" : "") << (config.monitorWin ? " win" : "")
+      << "\n";
+  for (const auto &id : config.disabledKeys) {
+    out << "Disabled: " << id << "\n";
+  }
+  out << std::hex << std::uppercase;
+  for (const auto &key : config.customKeys) {
+    out << "Custom key: \"" << key.name << "\" 0x" << key.scanCode
+        << (key.needsE0 ? "/E0" : "") << "\n";
+  }
+  for (const auto &mapping : config.keyMappings) {
+    out << "Mapping: 0x" << mapping.sourceScanCode
+        << (mapping.sourceNeedsE0 ? "/E0" : "") << " -> "
+        << mapping.targetKeyId << " (" << mapping.mappingType << ")\n";
+  }
+  out << std::dec << "Policy: " << config.thresholdMs << "ms "
+      << fixTriggerName(config.trigger);
+  for (const auto &entry : config.keyThresholds) {
+    out << ", key " << entry.first << "=" << entry.second << "ms";
+  }
+  out << "\n";
+
+  uint64_t startNs =
+      testCase.events.empty() ? 0 : testCase.events.front().timeNs;
+  for (size_t i = 0; i < testCase.events.size(); ++i) {
+    const DiffEvent &event = testCase.events[i];
+    out << std::dec << std::setw(6) << i << std::fixed << std::setprecision(3)
+        << std::setw(12) << (event.timeNs - startNs) / 1e6 << "ms  ";
+    if (event.idle) {
+      out << "idle\n";
+      continue;
+    }
+    out << std::hex << std::uppercase << "0x" << std::setw(2)
+        << std::setfill('0') << event.code << std::setfill(' ')
+        << ((event.state & INTERCEPTION_KEY_E0) ? "/E0 " : "    ")
+        << ((event.state & INTERCEPTION_KEY_UP) ? "up" : "down")
+        << (event.lost ? " (lost)" : "") << "\n";
+  }
+  return out.str();
+}
+
+DiffReport runDifferential(size_t count,
+                           const std::function<DiffCase(size_t)> &caseAt,
+                           WorkStealingPool &pool,
+                           const DiffSubjectFactory &reference,
+                           const DiffSubjectFactory &current) {
+  DiffReport report;
+  report.cases = count;
+  std::atomic<uint64_t> events(0);
+  std::atomic<uint64_t> failures(0);
+  std::mutex mutex;
+  size_t firstFailure = std::numeric_limits<size_t>::max();
+
+  QuietStderr quiet;
+  pool.run(count, [&](size_t index, size_t) {
+    DiffCase testCase = caseAt(index);
+    events.fetch_add(testCase.events.size(), std::memory_order_relaxed);
+    if (runDiffCase(testCase, reference, current).found) {
+      failures.fetch_add(1, std::memory_order_relaxed);
+      std::lock_guard<std::mutex> lock(mutex);
+      firstFailure = std::min(firstFailure, index);
+    }
+  });
+  report.events = events.load();
+  report.failures = failures.load();
+
+  if (report.failures > 0) {
+    report.hasFailure = true;
+    report.firstFailure = firstFailure;
+    report.minimal =
+        shrinkDiffCase(caseAt(firstFailure), reference, current);
+    report.mismatch = runDiffCase(report.minimal, reference, current);
+  }
+  return report;
+}
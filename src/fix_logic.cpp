@@ -0,0 +1,671 @@
+#include "fix_logic.h"
+#include <algorithm>
+#include <cmath>
+
+// MismatchTracker implementation
+void MismatchTracker::reset() {
+  isMismatched = false;
+  stuckReported = false;
+}
+
+void MismatchTracker::start() {
+  start(clock ? clock->now() : std::chrono::steady_clock::now());
+}
+
+int MismatchTracker::getDurationMs() const {
+  return getDurationMs(clock ? clock->now() : std::chrono::steady_clock::now());
+}
+
+bool MismatchTracker::isStuck(int thresholdMs) const {
+  return isStuck(thresholdMs,
+                 clock ? clock->now() : std::chrono::steady_clock::now());
+}
+
+void MismatchTracker::start(TimePoint now) {
+  if (!isMismatched) {
+    isMismatched = true;
+    startTime = now;
+  }
+}
+
+int MismatchTracker::getDurationMs(TimePoint now) const {
+  if (!isMismatched)
+    return 0;
+  auto duration =
+      std::chrono::duration_cast<std::chrono::milliseconds>(now - startTime);
+  return static_cast<int>(duration.count());
+}
+
+bool MismatchTracker::isStuck(int thresholdMs, TimePoint now) const {
+  return isMismatched && getDurationMs(now) >= thresholdMs;
+}
+
+// ModifierMismatchTrackers implementation
+ModifierMismatchTrackers::ModifierMismatchTrackers() : clock_(nullptr) {
+  // Will be initialized by initializeForKeys
+}
+
+void ModifierMismatchTrackers::initializeForKeys(
+    const std::vector<std::string> &keyIds) {
+  trackers_.clear();
+  for (const auto &keyId : keyIds) {
+    MismatchTracker tracker;
+    tracker.clock = clock_;
+    trackers_[keyId] = tracker;
+  }
+}
+
+void ModifierMismatchTrackers::setClock(const Clock *clock) {
+  clock_ = clock;
+  emptyTracker_.clock = clock;
+  for (auto &pair : trackers_) {
+    pair.second.clock = clock;
+  }
+}
+
+MismatchTracker *
+ModifierMismatchTrackers::getTracker(const std::string &keyId) {
+  auto it = trackers_.find(keyId);
+  return (it != trackers_.end()) ? &it->second : nullptr;
+}
+
+const MismatchTracker *
+ModifierMismatchTrackers::getTracker(const std::string &keyId) const {
+  auto it = trackers_.find(keyId);
+  return (it != trackers_.end()) ? &it->second : nullptr;
+}
+
+bool ModifierMismatchTrackers::hasAnyStuck(int thresholdMs) const {
+  // One clock read for all trackers
+  return hasAnyStuck(thresholdMs, clock_ ? clock_->now()
+                                         : std::chrono::steady_clock::now());
+}
+
+bool ModifierMismatchTrackers::hasAnyStuck(
+    int thresholdMs, MismatchTracker::TimePoint now) const {
+  for (const auto &pair : trackers_) {
+    if (pair.second.isStuck(thresholdMs, now)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Backward compatibility methods
+const MismatchTracker &ModifierMismatchTrackers::lctrl() const {
+  const MismatchTracker *tracker = getTracker("lctrl");
+  return tracker ? *tracker : emptyTracker_;
+}
+
+const MismatchTracker &ModifierMismatchTrackers::rctrl() const {
+  const MismatchTracker *tracker = getTracker("rctrl");
+  return tracker ? *tracker : emptyTracker_;
+}
+
+const MismatchTracker &ModifierMismatchTrackers::lshift() const {
+  const MismatchTracker *tracker = getTracker("lshift");
+  return tracker ? *tracker : emptyTracker_;
+}
+
+const MismatchTracker &ModifierMismatchTrackers::rshift() const {
+  const MismatchTracker *tracker = getTracker("rshift");
+  return tracker ? *tracker : emptyTracker_;
+}
+
+const MismatchTracker &ModifierMismatchTrackers::lalt() const {
+  const MismatchTracker *tracker = getTracker("lalt");
+  return tracker ? *tracker : emptyTracker_;
+}
+
+const MismatchTracker &ModifierMismatchTrackers::ralt() const {
+  const MismatchTracker *tracker = getTracker("ralt");
+  return tracker ? *tracker : emptyTracker_;
+}
+
+const MismatchTracker &ModifierMismatchTrackers::lwin() const {
+  const MismatchTracker *tracker = getTracker("lwin");
+  return tracker ? *tracker : emptyTracker_;
+}
+
+const MismatchTracker &ModifierMismatchTrackers::rwin() const {
+  const MismatchTracker *tracker = getTracker("rwin");
+  return tracker ? *tracker : emptyTracker_;
+}
+
+// FixStatistics implementation
+FixStatistics::FixStatistics()
+    : totalFixes_(0), forwardLatency_(LatencyHistogram::Unit::CycleTicks),
+      totalLostKeyDowns_(0), totalKeyDownRepairs_(0) {
+  // Empty constructor, will be initialized by initializeForKeys
+}
+
+void FixStatistics::initializeForKeys(const std::vector<std::string> &keyIds) {
+  fixes_.clear();
+  lostKeyDowns_.clear();
+  keyDownRepairs_.clear();
+  totalFixes_ = 0;
+  totalLostKeyDowns_ = 0;
+  totalKeyDownRepairs_ = 0;
+  for (const auto &keyId : keyIds) {
+    fixes_[keyId] = 0;
+    lostKeyDowns_[keyId] = 0;
+    keyDownRepairs_[keyId] = 0;
+  }
+}
+
+void FixStatistics::incrementFix(const std::string &keyId) {
+  totalFixes_++;
+  auto it = fixes_.find(keyId);
+  if (it != fixes_.end()) {
+    it->second++;
+  } else {
+    fixes_[keyId] = 1;
+  }
+}
+
+int FixStatistics::getFixCount(const std::string &keyId) const {
+  auto it = fixes_.find(keyId);
+  return (it != fixes_.end()) ? it->second : 0;
+}
+
+void FixStatistics::incrementLostKeyDown(const std::string &keyId) {
+  totalLostKeyDowns_++;
+  lostKeyDowns_[keyId]++;
+}
+
+int FixStatistics::getLostKeyDownCount(const std::string &keyId) const {
+  auto it = lostKeyDowns_.find(keyId);
+  return (it != lostKeyDowns_.end()) ? it->second : 0;
+}
+
+void FixStatistics::incrementKeyDownRepair(const std::string &keyId) {
+  totalKeyDownRepairs_++;
+  keyDownRepairs_[keyId]++;
+}
+
+int FixStatistics::getKeyDownRepairCount(const std::string &keyId) const {
+  auto it = keyDownRepairs_.find(keyId);
+  return (it != keyDownRepairs_.end()) ? it->second : 0;
+}
+
+void FixStatistics::reset() {
+  totalFixes_ = 0;
+  for (auto &pair : fixes_) {
+    pair.second = 0;
+  }
+  forwardLatency_.reset();
+  totalLostKeyDowns_ = 0;
+  totalKeyDownRepairs_ = 0;
+  for (auto &pair : lostKeyDowns_) {
+    pair.second = 0;
+  }
+  for (auto &pair : keyDownRepairs_) {
+    pair.second = 0;
+  }
+  releaseLag_.reset();
+  keyDownLag_.reset();
+}
+
+// Backward compatibility methods
+int FixStatistics::lctrlFixes() const { return getFixCount("lctrl"); }
+int FixStatistics::rctrlFixes() const { return getFixCount("rctrl"); }
+int FixStatistics::lshiftFixes() const { return getFixCount("lshift"); }
+int FixStatistics::rshiftFixes() const { return getFixCount("rshift"); }
+int FixStatistics::laltFixes() const { return getFixCount("lalt"); }
+int FixStatistics::raltFixes() const { return getFixCount("ralt"); }
+int FixStatistics::lwinFixes() const { return getFixCount("lwin"); }
+int FixStatistics::rwinFixes() const { return getFixCount("rwin"); }
+
+// FixLogic implementation
+const char *fixTriggerName(FixTrigger trigger) {
+  switch (trigger) {
+  case FixTrigger::IdleKeyDown:
+    return "idle";
+  case FixTrigger::AnyKeyDown:
+    return "any";
+  case FixTrigger::OtherKeyDown:
+    return "other";
+  }
+  return "?";
+}
+
+bool parseFixTrigger(const std::string &name, FixTrigger &trigger) {
+  for (FixTrigger candidate :
+       {FixTrigger::IdleKeyDown, FixTrigger::AnyKeyDown,
+        FixTrigger::OtherKeyDown}) {
+    if (name == fixTriggerName(candidate)) {
+      trigger = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+FixLogic::FixLogic()
+    : thresholdMs_(1000), trigger_(FixTrigger::IdleKeyDown),
+      releaseCheckMs_(0), nextReleaseCheck_(TimePoint::max()),
+      lostKeyDownMs_(100), pendingLostKeyDowns_(0) {}
+
+void FixLogic::initialize(const ModifierKeyStates &physical,
+                          const VirtualKeyStates &virtualStates) {
+  keyIds_.clear();
+  for (const auto &key : physical.getKeys()) {
+    keyIds_.push_back(key.id);
+  }
+  trackers_.initializeForKeys(keyIds_);
+  stats_.initializeForKeys(keyIds_);
+
+  // Resolve IDs once so the per-iteration update needs no lookups
+  trackerByIndex_.clear();
+  virtualIndex_.clear();
+  const auto &virtKeys = virtualStates.getKeys();
+  for (const auto &keyId : keyIds_) {
+    trackerByIndex_.push_back(trackers_.getTracker(keyId));
+    int index = -1;
+    for (size_t i = 0; i < virtKeys.size(); ++i) {
+      if (virtKeys[i].id == keyId) {
+        index = static_cast<int>(i);
+        break;
+      }
+    }
+    virtualIndex_.push_back(index);
+  }
+  keyThresholdMs_.assign(keyIds_.size(), 0);
+  resetAdaptive();
+  resetReleaseChecks();
+  lostKeyDown_.assign(keyIds_.size(), 0);
+  pendingLostKeyDowns_ = 0;
+}
+
+void FixLogic::setKeyThreshold(size_t keyIndex, int ms) {
+  if (keyIndex < keyThresholdMs_.size()) {
+    keyThresholdMs_[keyIndex] = ms > 0 ? ms : 0;
+  }
+}
+
+bool FixLogic::setKeyThreshold(const std::string &keyId, int ms) {
+  bool found = false;
+  for (size_t i = 0; i < keyIds_.size(); ++i) {
+    if (keyIds_[i] == keyId) {
+      setKeyThreshold(i, ms);
+      found = true;
+    }
+  }
+  return found;
+}
+
+void FixLogic::clearKeyThresholds() {
+  keyThresholdMs_.assign(keyIds_.size(), 0);
+}
+
+void FixLogic::setAdaptive(const AdaptiveThresholdConfig &adaptive) {
+  bool relearn = !adaptive.enabled || !adaptive_.enabled ||
+                 adaptive.quantile != adaptive_.quantile;
+  adaptive_ = adaptive;
+  if (relearn) {
+    resetAdaptive();
+    return;
+  }
+
+  // Same estimates, new margin or bounds
+  for (size_t i = 0; i < benignMs_.size(); ++i) {
+    learnedMs_[i] = 0;
+    if (benignMs_[i].count() > 0) {
+      learnMismatch(i, -1);
+    }
+  }
+}
+
+void FixLogic::resetAdaptive() {
+  benignMs_.clear();
+  learnedMs_.clear();
+  fixedInMismatch_.clear();
+  if (adaptive_.enabled) {
+    benignMs_.assign(keyIds_.size(), P2Quantile(adaptive_.quantile));
+    learnedMs_.assign(keyIds_.size(), 0);
+    fixedInMismatch_.assign(keyIds_.size(), 0);
+  }
+}
+
+void FixLogic::setReleaseCheck(int ms) {
+  releaseCheckMs_ = ms > 0 ? ms : 0;
+  resetReleaseChecks();
+}
+
+void FixLogic::resetReleaseChecks() {
+  releaseCheckAt_.clear();
+  physicalPressed_.clear();
+  droppedRelease_.clear();
+  nextReleaseCheck_ = TimePoint::max();
+  if (releaseCheckMs_ > 0) {
+    releaseCheckAt_.assign(keyIds_.size(), TimePoint::max());
+    physicalPressed_.assign(keyIds_.size(), 0);
+    droppedRelease_.assign(keyIds_.size(), 0);
+  }
+}
+
+void FixLogic::updateNextReleaseCheck() {
+  nextReleaseCheck_ = TimePoint::max();
+  for (TimePoint at : releaseCheckAt_) {
+    nextReleaseCheck_ = std::min(nextReleaseCheck_, at);
+  }
+}
+
+bool FixLogic::nextReleaseCheck(TimePoint &when) const {
+  if (nextReleaseCheck_ == TimePoint::max()) {
+    return false;
+  }
+  when = nextReleaseCheck_;
+  return true;
+}
+
+size_t FixLogic::collectDroppedReleases(TimePoint now) {
+  size_t dropped = 0;
+  for (size_t i = 0; i < releaseCheckAt_.size(); ++i) {
+    droppedRelease_[i] = 0;
+    if (releaseCheckAt_[i] > now) {
+      continue;
+    }
+    releaseCheckAt_[i] = TimePoint::max();
+    if (trackerByIndex_[i]->isMismatched) {
+      droppedRelease_[i] = 1;
+      ++dropped;
+    }
+  }
+  updateNextReleaseCheck();
+  return dropped;
+}
+
+void FixLogic::updateMissing(size_t keyIndex, TimePoint now) {
+  MismatchTracker *tracker = trackerByIndex_[keyIndex];
+  if (!tracker->isMissing) {
+    tracker->isMissing = true;
+    tracker->missingReported = false;
+    tracker->startTime = now;
+    return;
+  }
+  if (!tracker->missingReported &&
+      now - tracker->startTime >= std::chrono::milliseconds(lostKeyDownMs_)) {
+    tracker->missingReported = true;
+    stats_.incrementLostKeyDown(keyIds_[keyIndex]);
+    lostKeyDown_[keyIndex] = 1;
+    pendingLostKeyDowns_++;
+  }
+}
+
+// registered: the OS caught up (rather than the key being let go first)
+void FixLogic::endMissing(size_t keyIndex, TimePoint now, bool registered) {
+  MismatchTracker *tracker = trackerByIndex_[keyIndex];
+  if (registered) {
+    stats_.recordKeyDownLag(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            now - tracker->startTime)
+            .count()));
+  }
+  tracker->isMissing = false;
+  tracker->missingReported = false;
+  if (lostKeyDown_[keyIndex]) {
+    lostKeyDown_[keyIndex] = 0;
+    pendingLostKeyDowns_--;
+  }
+}
+
+bool FixLogic::takeLostKeyDown(size_t keyIndex) {
+  if (keyIndex >= lostKeyDown_.size() || !lostKeyDown_[keyIndex]) {
+    return false;
+  }
+  lostKeyDown_[keyIndex] = 0;
+  pendingLostKeyDowns_--;
+  return true;
+}
+
+bool FixLogic::isMissing(size_t keyIndex) const {
+  return keyIndex < trackerByIndex_.size() &&
+         trackerByIndex_[keyIndex]->isMissing;
+}
+
+int FixLogic::getMissingMs(size_t keyIndex, TimePoint now) const {
+  if (!isMissing(keyIndex)) {
+    return 0;
+  }
+  auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+      now - trackerByIndex_[keyIndex]->startTime);
+  return static_cast<int>(duration.count());
+}
+
+void FixLogic::recordKeyDownRepair(size_t keyIndex) {
+  if (keyIndex < keyIds_.size()) {
+    stats_.incrementKeyDownRepair(keyIds_[keyIndex]);
+  }
+}
+
+bool FixLogic::hasAnyMissing() const {
+  for (const MismatchTracker *tracker : trackerByIndex_) {
+    if (tracker->isMissing) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// mismatchMs < 0 only re-derives the threshold from the current estimate
+void FixLogic::learnMismatch(size_t keyIndex, int mismatchMs) {
+  P2Quantile &estimate = benignMs_[keyIndex];
+  if (mismatchMs >= 0) {
+    estimate.add(mismatchMs);
+  }
+  if (estimate.count() >= static_cast<uint64_t>(adaptive_.minSamples)) {
+    int ms = static_cast<int>(std::lround(estimate.value())) +
+             adaptive_.marginMs;
+    learnedMs_[keyIndex] = std::clamp(ms, adaptive_.minMs, adaptive_.maxMs);
+  }
+}
+
+void FixLogic::updateTrackers(const ModifierKeyStates &physical,
+                              const VirtualKeyStates &virtualStates,
+                              TimePoint now,
+                              std::vector<TrackerEvent> *events) {
+  const auto &physKeys = physical.getKeys();
+  const auto &virtKeys = virtualStates.getKeys();
+  size_t count = trackerByIndex_.size();
+  if (physKeys.size() < count) {
+    count = physKeys.size();
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    int virtIndex = virtualIndex_[i];
+    if (virtIndex < 0 || static_cast<size_t>(virtIndex) >= virtKeys.size()) {
+      continue;
+    }
+    MismatchTracker *tracker = trackerByIndex_[i];
+    bool physPressed = physKeys[i].pressed;
+    bool virtPressed = virtKeys[virtIndex].pressed;
+
+    // A physical release since the last update: the key-up was forwarded
+    bool released = false;
+    if (!releaseCheckAt_.empty()) {
+      released = physicalPressed_[i] && !physPressed;
+      physicalPressed_[i] = physPressed;
+    }
+
+    // Check mismatch: physical released but virtual pressed
+    if (!physPressed && virtPressed) {
+      if (tracker->isMissing) {
+        endMissing(i, now, true);
+      }
+      if (!tracker->isMismatched && events) {
+        events->push_back({i, TrackerChange::MismatchStart, 0});
+      }
+      tracker->start(now);
+
+      // The OS has not followed the key-up yet: give it releaseCheckMs_
+      if (released) {
+        releaseCheckAt_[i] = now + std::chrono::milliseconds(releaseCheckMs_);
+        nextReleaseCheck_ = std::min(nextReleaseCheck_, releaseCheckAt_[i]);
+      }
+
+      if (!tracker->stuckReported &&
+          tracker->isStuck(getKeyThreshold(i), now)) {
+        tracker->stuckReported = true;
+        if (events) {
+          events->push_back(
+              {i, TrackerChange::Stuck, tracker->getDurationMs(now)});
+        }
+      }
+    } else {
+      if (tracker->isMismatched) {
+        int mismatchMs = tracker->getDurationMs(now);
+        if (!physPressed) {
+          stats_.recordReleaseLag(static_cast<uint64_t>(
+              std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  now - tracker->startTime)
+                  .count()));
+        }
+        if (events) {
+          events->push_back({i, TrackerChange::Reset, mismatchMs});
+        }
+        // Learn from mismatches the OS resolved on its own (fixed ones were
+        // learned by recordFix)
+        if (!benignMs_.empty()) {
+          if (!fixedInMismatch_[i] && !physPressed) {
+            learnMismatch(i, mismatchMs);
+          }
+          fixedInMismatch_[i] = 0;
+        }
+        // The OS followed in time
+        if (!releaseCheckAt_.empty() &&
+            releaseCheckAt_[i] != TimePoint::max()) {
+          releaseCheckAt_[i] = TimePoint::max();
+          updateNextReleaseCheck();
+        }
+      }
+      tracker->reset();
+
+      // Reverse direction: physical pressed but virtual released
+      if (physPressed != virtPressed) {
+        updateMissing(i, now);
+      } else if (tracker->isMissing) {
+        endMissing(i, now, virtPressed);
+      }
+    }
+  }
+}
+
+bool FixLogic::shouldFix(const InterceptionKeyStroke &stroke,
+                         const ModifierKeyStates &physical,
+                         TimePoint now) const {
+  // Only trigger on key down
+  if (stroke.state & INTERCEPTION_KEY_UP) {
+    return false;
+  }
+
+  // Check if any key is stuck
+  bool anyStuck = false;
+  for (size_t i = 0; i < trackerByIndex_.size(); ++i) {
+    if (trackerByIndex_[i]->isStuck(getKeyThreshold(i), now)) {
+      anyStuck = true;
+      break;
+    }
+  }
+  if (!anyStuck) {
+    return false;
+  }
+
+  if (trigger_ == FixTrigger::AnyKeyDown) {
+    return true;
+  }
+
+  // Check if any monitored key is physically pressed (or, for OtherKeyDown,
+  // is the trigger itself)
+  bool e0 = (stroke.state & INTERCEPTION_KEY_E0) != 0;
+  for (const auto &key : physical.getKeys()) {
+    if (key.pressed) {
+      return false;
+    }
+    if (trigger_ == FixTrigger::OtherKeyDown &&
+        key.scanCode == stroke.code && key.needsE0 == e0) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool FixLogic::shouldFixIdle(const ModifierKeyStates &physical,
+                             TimePoint now) const {
+  bool anyStuck = false;
+  for (size_t i = 0; i < trackerByIndex_.size(); ++i) {
+    if (trackerByIndex_[i]->isStuck(getKeyThreshold(i), now)) {
+      anyStuck = true;
+      break;
+    }
+  }
+  if (!anyStuck) {
+    return false;
+  }
+  for (const auto &key : physical.getKeys()) {
+    if (key.pressed) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool FixLogic::nextStuckTime(TimePoint now, TimePoint &when) const {
+  bool found = false;
+  for (size_t i = 0; i < trackerByIndex_.size(); ++i) {
+    const MismatchTracker *tracker = trackerByIndex_[i];
+    if (!tracker->isMismatched) {
+      continue;
+    }
+    TimePoint stuckAt =
+        tracker->startTime + std::chrono::milliseconds(getKeyThreshold(i));
+    if (stuckAt > now && (!found || stuckAt < when)) {
+      when = stuckAt;
+      found = true;
+    }
+  }
+  return found;
+}
+
+bool FixLogic::hasAnyMismatch() const {
+  for (const MismatchTracker *tracker : trackerByIndex_) {
+    if (tracker->isMismatched) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool FixLogic::isStuck(size_t keyIndex, TimePoint now) const {
+  return keyIndex < trackerByIndex_.size() &&
+         trackerByIndex_[keyIndex]->isStuck(getKeyThreshold(keyIndex), now);
+}
+
+int FixLogic::getMismatchMs(size_t keyIndex, TimePoint now) const {
+  return keyIndex < trackerByIndex_.size()
+             ? trackerByIndex_[keyIndex]->getDurationMs(now)
+             : 0;
+}
+
+void FixLogic::restartMismatch(size_t keyIndex, TimePoint now) {
+  if (keyIndex < trackerByIndex_.size()) {
+    MismatchTracker *tracker = trackerByIndex_[keyIndex];
+    tracker->reset();
+    tracker->start(now);
+  }
+}
+
+void FixLogic::recordFix(size_t keyIndex, TimePoint now) {
+  if (keyIndex < keyIds_.size()) {
+    stats_.incrementFix(keyIds_[keyIndex]);
+  }
+  if (keyIndex < fixedInMismatch_.size()) {
+    // Censored at the threshold, once per mismatch. Releases fixed by the
+    // release check before the threshold tell nothing about the lag.
+    if (!fixedInMismatch_[keyIndex] && isStuck(keyIndex, now)) {
+      learnMismatch(keyIndex, getKeyThreshold(keyIndex));
+    }
+    fixedInMismatch_[keyIndex] = 1;
+  }
+}
@@ -0,0 +1,198 @@
+#include "flight_recorder.h"
+#include "config.h"
+#include "logger.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+
+namespace {
+
+constexpr const char *kDumpPrefix = "flight-";
+
+} // namespace
+
+FlightRecorder::FlightRecorder()
+    : thresholdMs_(0), startUnixMs_(0), origin_(0), active_(false), head_(0),
+      mask_(0), lastVirtualMask_(0), dumpRequested_(false),
+      snapshotReason_(""), busy_(false), dumps_(0), skipped_(0),
+      stopRequested_(false) {}
+
+FlightRecorder::~FlightRecorder() { stop(); }
+
+void FlightRecorder::start(const Options &options,
+                           const std::vector<TraceFormat::KeyInfo> &keys,
+                           int thresholdMs) {
+  stop();
+
+  options_ = options;
+  keys_ = keys;
+  thresholdMs_ = thresholdMs;
+
+  // Power of two so the ring index is a mask
+  size_t capacity = 1;
+  while (capacity < std::max<size_t>(options.capacity, 2)) {
+    capacity <<= 1;
+  }
+  ring_.assign(capacity, TraceFormat::TraceRecord());
+  snapshot_.reserve(capacity);
+  mask_ = capacity - 1;
+  head_ = 0;
+  lastVirtualMask_ = 0;
+  dumpRequested_.store(false, std::memory_order_relaxed);
+
+  startUnixMs_ = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count());
+  origin_ = CycleClock::now();
+
+  stopRequested_ = false;
+  writer_ = std::thread(&FlightRecorder::writerLoop, this);
+  active_ = true;
+}
+
+void FlightRecorder::stop() {
+  if (!writer_.joinable()) {
+    return;
+  }
+  active_ = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopRequested_ = true;
+  }
+  wake_.notify_one();
+  writer_.join();
+}
+
+bool FlightRecorder::dump(const char *reason) {
+  if (!active_) {
+    return false;
+  }
+  if (busy_.load(std::memory_order_acquire)) {
+    skipped_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  // Oldest record first; ticks become nanoseconds since start()
+  uint64_t count = std::min<uint64_t>(head_, ring_.size());
+  snapshot_.resize(static_cast<size_t>(count));
+  for (uint64_t i = 0; i < count; ++i) {
+    TraceFormat::TraceRecord record = ring_[(head_ - count + i) & mask_];
+    record.timestampNs = record.timestampNs > origin_
+                             ? CycleClock::toNanoseconds(record.timestampNs -
+                                                         origin_)
+                             : 0;
+    snapshot_[static_cast<size_t>(i)] = record;
+  }
+  snapshotReason_ = reason;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    busy_.store(true, std::memory_order_release);
+  }
+  wake_.notify_one();
+  return true;
+}
+
+std::string FlightRecorder::getLastDumpPath() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return lastDumpPath_;
+}
+
+void FlightRecorder::waitIdle() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_.wait(lock, [this] {
+    return !busy_.load(std::memory_order_acquire) || !writer_.joinable();
+  });
+}
+
+void FlightRecorder::writerLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    wake_.wait(lock, [this] {
+      return stopRequested_ || busy_.load(std::memory_order_acquire);
+    });
+    if (busy_.load(std::memory_order_acquire)) {
+      lock.unlock();
+      std::string path;
+      bool written = writeDump(path);
+      lock.lock();
+      if (written) {
+        lastDumpPath_ = path;
+        dumps_.fetch_add(1, std::memory_order_relaxed);
+      }
+      busy_.store(false, std::memory_order_release);
+      idle_.notify_all();
+    } else if (stopRequested_) {
+      break;
+    }
+  }
+}
+
+bool FlightRecorder::writeDump(std::string &path) {
+  std::string directory = options_.directory;
+  if (directory.empty()) {
+    directory = (std::filesystem::path(Config::getDefaultConfigPath())
+                     .parent_path() /
+                 "dumps")
+                    .string();
+  }
+  std::error_code ec;
+  std::filesystem::create_directories(directory, ec);
+
+  std::time_t now = std::time(nullptr);
+  std::tm local{};
+#ifdef _WIN32
+  localtime_s(&local, &now);
+#else
+  localtime_r(&now, &local);
+#endif
+  // Sequence after the time keeps dumps from the same second in order
+  uint64_t sequence = dumps_.load(std::memory_order_relaxed) + 1;
+  char name[64];
+  size_t length =
+      std::strftime(name, sizeof(name), "%Y%m%d-%H%M%S", &local);
+  snprintf(name + length, sizeof(name) - length, "-%06llu-",
+           static_cast<unsigned long long>(sequence));
+  std::string fileName = std::string(kDumpPrefix) + name + snapshotReason_ +
+                         TraceFormat::kFileExtension;
+  path = (std::filesystem::path(directory) / fileName).string();
+
+  TraceFormat::FileHeader header;
+  TraceFormat::initHeader(header, keys_, startUnixMs_, sequence,
+                          snapshot_.size(), thresholdMs_);
+  std::string error;
+  if (!TraceFormat::writeTraceFile(path, header, snapshot_, &error)) {
+    Log::warning("Flight recorder dump failed: {s}", error);
+    return false;
+  }
+  Log::info("Flight recorder dump written to {s}", path);
+
+  pruneDumps(directory);
+  return true;
+}
+
+void FlightRecorder::pruneDumps(const std::string &directory) {
+  // Names start with the local time, so name order is age order
+  std::vector<std::filesystem::path> found;
+  std::error_code ec;
+  for (const auto &entry :
+       std::filesystem::directory_iterator(directory, ec)) {
+    std::string name = entry.path().filename().string();
+    if (name.rfind(kDumpPrefix, 0) == 0 &&
+        entry.path().extension() == TraceFormat::kFileExtension) {
+      found.push_back(entry.path());
+    }
+  }
+  size_t keep = static_cast<size_t>(std::max(options_.maxDumps, 1));
+  if (found.size() <= keep) {
+    return;
+  }
+  std::sort(found.begin(), found.end());
+  size_t excess = found.size() - keep;
+  for (size_t i = 0; i < excess; ++i) {
+    std::filesystem::remove(found[i], ec);
+  }
+}
@@ -0,0 +1,123 @@
+#include "latency_histogram.h"
+#include <cmath>
+#include <cstdio>
+
+LatencyHistogram::LatencyHistogram(Unit unit) : unit_(unit) { reset(); }
+
+void LatencyHistogram::reset() {
+  for (auto &bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+  sum_.store(0, std::memory_order_relaxed);
+  max_.store(0, std::memory_order_relaxed);
+  count_.store(0, std::memory_order_release);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other) {
+  uint64_t otherCount = other.getCount();
+  if (otherCount == 0) {
+    return;
+  }
+  for (size_t i = 0; i < kBucketCount; ++i) {
+    uint64_t added = other.buckets_[i].load(std::memory_order_relaxed);
+    if (added != 0) {
+      buckets_[i].store(buckets_[i].load(std::memory_order_relaxed) + added,
+                        std::memory_order_relaxed);
+    }
+  }
+  sum_.store(sum_.load(std::memory_order_relaxed) +
+                 other.sum_.load(std::memory_order_relaxed),
+             std::memory_order_relaxed);
+  uint64_t otherMax = other.max_.load(std::memory_order_relaxed);
+  if (otherMax > max_.load(std::memory_order_relaxed)) {
+    max_.store(otherMax, std::memory_order_relaxed);
+  }
+  count_.store(count_.load(std::memory_order_relaxed) + otherCount,
+               std::memory_order_release);
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(size_t index) {
+  if (index < kSubBucketCount) {
+    return index;
+  }
+  size_t offset = index - kSubBucketCount;
+  int exponent = kSubBucketBits + static_cast<int>(offset / kHalfSubBucketCount);
+  uint64_t subBucket = kHalfSubBucketCount + offset % kHalfSubBucketCount;
+  int shift = exponent - (kSubBucketBits - 1);
+  return ((subBucket + 1) << shift) - 1;
+}
+
+uint64_t LatencyHistogram::valueAtPercentile(double percentile) const {
+  uint64_t total = getCount();
+  if (total == 0) {
+    return 0;
+  }
+
+  // Rank of the sample at this percentile (1-based, at least 1)
+  uint64_t rank = static_cast<uint64_t>(
+      std::ceil(percentile / 100.0 * static_cast<double>(total)));
+  if (rank < 1) {
+    rank = 1;
+  }
+
+  uint64_t maxValue = max_.load(std::memory_order_relaxed);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kBucketCount; ++i) {
+    seen += buckets_[i].load(std::memory_order_relaxed);
+    if (seen >= rank) {
+      uint64_t value = bucketUpperBound(i);
+      return toNanoseconds(value < maxValue ? value : maxValue);
+    }
+  }
+  return toNanoseconds(maxValue);
+}
+
+LatencyHistogram::Summary LatencyHistogram::summarize() const {
+  Summary summary;
+  summary.count = getCount();
+  if (summary.count == 0) {
+    return summary;
+  }
+  summary.p50Ns = valueAtPercentile(50.0);
+  summary.p99Ns = valueAtPercentile(99.0);
+  summary.p999Ns = valueAtPercentile(99.9);
+  summary.maxNs = getMax();
+  summary.meanNs =
+      toNanoseconds(sum_.load(std::memory_order_relaxed) / summary.count);
+  return summary;
+}
+
+std::string formatLatency(uint64_t ns) {
+  char buffer[32];
+  formatLatency(ns, buffer, sizeof(buffer));
+  return buffer;
+}
+
+size_t formatLatency(uint64_t ns, char *buffer, size_t size) {
+  int length;
+  if (ns < 1000) {
+    length = snprintf(buffer, size, "%lluns",
+                      static_cast<unsigned long long>(ns));
+  } else if (ns < 1000000) {
+    length = snprintf(buffer, size, "%.1fus", ns / 1000.0);
+  } else if (ns < 1000000000) {
+    length = snprintf(buffer, size, "%.2fms", ns / 1000000.0);
+  } else {
+    length = snprintf(buffer, size, "%.2fs", ns / 1000000000.0);
+  }
+  if (length < 0 || size == 0) {
+    return 0;
+  }
+  return static_cast<size_t>(length) < size ? length : size - 1;
+}
+
+std::string formatLatencySummary(const LatencyHistogram::Summary &summary) {
+  if (summary.count == 0) {
+    return "no samples";
+  }
+  std::string text = "p50 " + formatLatency(summary.p50Ns);
+  text += " | p99 " + formatLatency(summary.p99Ns);
+  text += " | p99.9 " + formatLatency(summary.p999Ns);
+  text += " | max " + formatLatency(summary.maxNs);
+  return text;
+}
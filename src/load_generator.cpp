@@ -0,0 +1,388 @@
+#include "load_generator.h"
+#include "fake_interception.h"
+#include "simulator.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <time.h>
+
+namespace {
+
+struct Key {
+  unsigned short code;
+  bool e0;
+};
+
+const unsigned short kLetters[] = {0x10, 0x11, 0x12, 0x13, 0x14, 0x15,
+                                   0x16, 0x17, 0x18, 0x19, 0x1E, 0x1F,
+                                   0x20, 0x21, 0x22, 0x23, 0x24, 0x25,
+                                   0x26, 0x2C, 0x2D, 0x2E, 0x2F, 0x30};
+const size_t kLetterCount = sizeof(kLetters) / sizeof(kLetters[0]);
+
+// The eight default monitored keys
+const Key kModifiers[] = {{0x1D, false}, {0x1D, true},  {0x2A, false},
+                          {0x36, false}, {0x38, false}, {0x38, true},
+                          {0x5B, true},  {0x5C, true}};
+const size_t kModifierCount = sizeof(kModifiers) / sizeof(kModifiers[0]);
+
+const unsigned short kShift = 0x2A;
+const unsigned short kEnter = 0x1C;
+const int kBarcodeDigits = 13;
+
+void emit(std::vector<InterceptionKeyStroke> &out, Key key, bool up) {
+  InterceptionKeyStroke stroke;
+  stroke.code = key.code;
+  stroke.state = up ? INTERCEPTION_KEY_UP : INTERCEPTION_KEY_DOWN;
+  if (key.e0) {
+    stroke.state |= INTERCEPTION_KEY_E0;
+  }
+  stroke.information = 0;
+  out.push_back(stroke);
+}
+
+void tap(std::vector<InterceptionKeyStroke> &out, Key key) {
+  emit(out, key, false);
+  emit(out, key, true);
+}
+
+Key randomLetter(SimRandom &random) {
+  return {kLetters[random.range(0, kLetterCount - 1)], false};
+}
+
+// Append one self-contained unit of the profile: every key pressed in it is
+// released again
+void appendUnit(LoadProfile profile, SimRandom &random,
+                std::vector<InterceptionKeyStroke> &out) {
+  switch (profile) {
+  case LoadProfile::Typing:
+    if (random.uniform() < 0.2) {
+      Key modifier = kModifiers[random.range(0, kModifierCount - 1)];
+      emit(out, modifier, false);
+      tap(out, randomLetter(random));
+      emit(out, modifier, true);
+    } else {
+      tap(out, randomLetter(random));
+    }
+    break;
+
+  case LoadProfile::Modifiers: {
+    size_t held[3];
+    size_t count = static_cast<size_t>(random.range(1, 3));
+    for (size_t i = 0; i < count; ++i) {
+      bool distinct;
+      do {
+        held[i] = static_cast<size_t>(random.range(0, kModifierCount - 1));
+        distinct = std::find(held, held + i, held[i]) == held + i;
+      } while (!distinct);
+      emit(out, kModifiers[held[i]], false);
+    }
+    tap(out, randomLetter(random));
+    for (size_t i = count; i-- > 0;) {
+      emit(out, kModifiers[held[i]], true);
+    }
+    break;
+  }
+
+  case LoadProfile::Typematic: {
+    bool shifted = random.uniform() < 0.5;
+    if (shifted) {
+      emit(out, {kShift, false}, false);
+    }
+    Key letter = randomLetter(random);
+    int repeats = static_cast<int>(random.range(10, 30));
+    for (int i = 0; i < repeats; ++i) {
+      emit(out, letter, false);
+    }
+    emit(out, letter, true);
+    if (shifted) {
+      emit(out, {kShift, false}, true);
+    }
+    break;
+  }
+
+  case LoadProfile::Scanner:
+    for (int i = 0; i < kBarcodeDigits; ++i) {
+      // Digits 1..9, 0 are scan codes 0x02..0x0B
+      tap(out, {static_cast<unsigned short>(0x02 + random.range(0, 9)),
+                false});
+    }
+    tap(out, {kEnter, false});
+    break;
+  }
+}
+
+using SteadyTime = std::chrono::steady_clock::time_point;
+
+uint64_t nsSince(SteadyTime start) {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count());
+}
+
+// CPU time consumed by the calling thread
+uint64_t threadCpuNs() {
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull +
+         static_cast<uint64_t>(ts.tv_nsec);
+}
+
+// Sleep most of the way, then spin for sub-scheduler-tick accuracy
+void waitUntil(SteadyTime start, uint64_t targetNs) {
+  const uint64_t kSpinNs = 200000;
+  uint64_t now = nsSince(start);
+  if (now + kSpinNs < targetNs) {
+    std::this_thread::sleep_for(
+        std::chrono::nanoseconds(targetNs - now - kSpinNs));
+  }
+  while (nsSince(start) < targetNs) {
+  }
+}
+
+struct Scheduled {
+  uint64_t timeNs;
+  uint64_t index; // Position in the device's stream
+  InterceptionDevice device;
+  InterceptionKeyStroke stroke;
+};
+
+} // namespace
+
+const char *loadProfileName(LoadProfile profile) {
+  switch (profile) {
+  case LoadProfile::Typing:
+    return "typing";
+  case LoadProfile::Modifiers:
+    return "modifiers";
+  case LoadProfile::Typematic:
+    return "typematic";
+  case LoadProfile::Scanner:
+    return "scanner";
+  }
+  return "unknown";
+}
+
+bool parseLoadProfile(const std::string &name, LoadProfile &profile) {
+  const LoadProfile all[] = {LoadProfile::Typing, LoadProfile::Modifiers,
+                             LoadProfile::Typematic, LoadProfile::Scanner};
+  for (LoadProfile candidate : all) {
+    if (name == loadProfileName(candidate)) {
+      profile = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+std::vector<LoadStroke> generateLoad(const LoadOptions &options) {
+  int devices =
+      std::max(1, std::min(options.devices, INTERCEPTION_MAX_KEYBOARD));
+  int burst = options.burstSize > 0 ? options.burstSize
+              : options.profile == LoadProfile::Scanner
+                  ? 2 * (kBarcodeDigits + 1)
+                  : 1;
+  double periodNs = options.rate > 0 ? burst * 1e9 / options.rate : 0;
+  double spacingNs = std::max(0.0, options.burstSpacingUs * 1000.0);
+
+  std::vector<Scheduled> all;
+  all.reserve(options.strokeCount);
+  for (int d = 0; d < devices; ++d) {
+    uint64_t count =
+        options.strokeCount / devices +
+        (static_cast<uint64_t>(d) < options.strokeCount % devices ? 1 : 0);
+    SimRandom random(options.seed + 0x9E3779B97F4A7C15ull * (d + 1));
+    std::vector<InterceptionKeyStroke> strokes;
+    strokes.reserve(count + 64);
+    while (strokes.size() < count) {
+      appendUnit(options.profile, random, strokes);
+    }
+    // Cut at the requested count; a key may stay held at the very end
+    strokes.resize(count);
+
+    // Devices start out of phase so their bursts do not coincide
+    double phaseNs = periodNs * d / devices;
+    uint64_t last = 0;
+    for (uint64_t i = 0; i < count; ++i) {
+      double t = phaseNs + (i / burst) * periodNs + (i % burst) * spacingNs;
+      // Overlong bursts run into the next one; never go back in time
+      uint64_t timeNs = std::max(last, static_cast<uint64_t>(t));
+      last = timeNs;
+      all.push_back({timeNs, i, INTERCEPTION_KEYBOARD(d), strokes[i]});
+    }
+  }
+
+  // Simultaneous strokes of different devices interleave round-robin
+  std::sort(all.begin(), all.end(),
+            [](const Scheduled &a, const Scheduled &b) {
+              if (a.timeNs != b.timeNs) {
+                return a.timeNs < b.timeNs;
+              }
+              if (a.index != b.index) {
+                return a.index < b.index;
+              }
+              return a.device < b.device;
+            });
+
+  std::vector<LoadStroke> schedule(all.size());
+  for (size_t i = 0; i < all.size(); ++i) {
+    schedule[i].timeNs = all[i].timeNs;
+    schedule[i].device = all[i].device;
+    schedule[i].stroke = all[i].stroke;
+    schedule[i].stroke.information = static_cast<unsigned int>(i + 1);
+  }
+  return schedule;
+}
+
+// LoadMonitor implementation
+LoadMonitor::LoadMonitor(const std::vector<LoadStroke> &schedule)
+    : schedule_(schedule), pushedAt_(schedule.size() + 1, 0),
+      seen_(schedule.size() + 1, 0), pushedCount_(0), forwardedCount_(0),
+      injected_(0), duplicated_(0), reordered_(0), corrupted_(0),
+      firstPushNs_(0), lastForwardNs_(0) {
+  std::memset(lastSequence_, 0, sizeof(lastSequence_));
+}
+
+void LoadMonitor::pushed(uint32_t sequence, uint64_t nowNs) {
+  if (sequence == 0 || sequence >= pushedAt_.size()) {
+    return;
+  }
+  if (pushedCount_ == 0) {
+    firstPushNs_ = nowNs;
+  }
+  pushedAt_[sequence] = nowNs;
+  pushedCount_++;
+}
+
+void LoadMonitor::forwarded(InterceptionDevice device,
+                            const InterceptionKeyStroke &stroke,
+                            uint64_t nowNs) {
+  forwardedCount_++;
+  lastForwardNs_ = nowNs;
+
+  uint32_t sequence = stroke.information;
+  if (sequence == 0 || sequence >= seen_.size()) {
+    injected_++;
+    return;
+  }
+  if (seen_[sequence]) {
+    duplicated_++;
+    return;
+  }
+  seen_[sequence] = 1;
+
+  const LoadStroke &expected = schedule_[sequence - 1];
+  if (expected.device != device || expected.stroke.code != stroke.code ||
+      expected.stroke.state != stroke.state) {
+    corrupted_++;
+  }
+
+  if (device > 0 && device <= INTERCEPTION_MAX_DEVICE) {
+    if (sequence < lastSequence_[device]) {
+      reordered_++;
+    } else {
+      lastSequence_[device] = sequence;
+    }
+  }
+
+  latency_.record(nowNs - pushedAt_[sequence]);
+}
+
+uint64_t LoadMonitor::getDropped() const {
+  uint64_t delivered = forwardedCount_ - injected_ - duplicated_;
+  return pushedCount_ > delivered ? pushedCount_ - delivered : 0;
+}
+
+// Real-time run
+LoadReport runLoad(ModifierKeyFixer &fixer,
+                   const std::vector<LoadStroke> &schedule,
+                   int pollTimeoutMs) {
+  LoadReport report;
+  report.scheduled = schedule.size();
+  if (schedule.empty()) {
+    return report;
+  }
+
+  bool present[INTERCEPTION_MAX_KEYBOARD + 1] = {};
+  for (const LoadStroke &s : schedule) {
+    if (interception_is_keyboard(s.device) && !present[s.device]) {
+      present[s.device] = true;
+      FakeInterception::addDevice(
+          s.device, "HID\\VID_FEED&PID_" + std::to_string(s.device));
+    }
+  }
+
+  LoadMonitor monitor(schedule);
+  SteadyTime start = std::chrono::steady_clock::now();
+  FakeInterception::setCaptureSent(false);
+  FakeInterception::setWaitBlocks(true);
+  FakeInterception::setDeliveryFilter(
+      [&monitor, start](InterceptionDevice device,
+                        const InterceptionKeyStroke &stroke) {
+        monitor.forwarded(device, stroke, nsSince(start));
+        return true;
+      });
+  int fixesBefore = fixer.getStatistics().getTotalFixes();
+
+  std::atomic<bool> producerDone(false);
+  uint64_t maxLagNs = 0;
+  std::thread producer([&]() {
+    for (const LoadStroke &s : schedule) {
+      waitUntil(start, s.timeNs);
+      uint64_t now = nsSince(start);
+      maxLagNs = std::max(maxLagNs, now - s.timeNs);
+      monitor.pushed(s.stroke.information, now);
+      FakeInterception::pushKeyStroke(s.device, s.stroke.code, s.stroke.state,
+                                      s.stroke.information);
+    }
+    producerDone.store(true, std::memory_order_release);
+  });
+
+  uint64_t cpuStart = threadCpuNs();
+  uint64_t wallStart = nsSince(start);
+  for (;;) {
+    // Done flag first: once set, every stroke is in the driver queue
+    bool done = producerDone.load(std::memory_order_acquire);
+    if (done && FakeInterception::getPendingCount() == 0) {
+      break;
+    }
+    fixer.processEvents(pollTimeoutMs);
+  }
+  uint64_t cpuNs = threadCpuNs() - cpuStart;
+  uint64_t wallNs = nsSince(start) - wallStart;
+  producer.join();
+  FakeInterception::setDeliveryFilter(nullptr);
+
+  report.pushed = monitor.getPushed();
+  report.forwarded = monitor.getForwarded();
+  report.injected = monitor.getInjected();
+  report.dropped = monitor.getDropped();
+  report.duplicated = monitor.getDuplicated();
+  report.reordered = monitor.getReordered();
+  report.corrupted = monitor.getCorrupted();
+  report.fixes = fixer.getStatistics().getTotalFixes() - fixesBefore;
+
+  report.scheduleSeconds = schedule.back().timeNs / 1e9;
+  report.offeredRate = schedule.back().timeNs > 0
+                           ? schedule.size() / report.scheduleSeconds
+                           : 0;
+  uint64_t spanNs = monitor.getLastForwardNs() > monitor.getFirstPushNs()
+                        ? monitor.getLastForwardNs() - monitor.getFirstPushNs()
+                        : 0;
+  report.elapsedSeconds = spanNs / 1e9;
+  uint64_t delivered = report.forwarded - report.injected;
+  report.throughput = spanNs > 0 ? delivered / report.elapsedSeconds : 0;
+  report.maxProducerLagNs = maxLagNs;
+
+  report.latency = monitor.getLatency().summarize();
+  report.fixerLatency = fixer.getStatistics().getForwardLatency().summarize();
+
+  report.cpuNsPerStroke =
+      report.forwarded > 0 ? static_cast<double>(cpuNs) / report.forwarded
+                           : 0;
+  report.cpuUtilisation =
+      wallNs > 0 ? static_cast<double>(cpuNs) / wallNs : 0;
+  return report;
+}
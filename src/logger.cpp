@@ -0,0 +1,331 @@
+#include "logger.h"
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <ctime>
+#include <iostream>
+
+namespace {
+
+const char *levelName(LogLevel level) {
+  switch (level) {
+  case LogLevel::Error:
+    return "ERROR";
+  case LogLevel::Warning:
+    return "WARN ";
+  case LogLevel::Info:
+    return "INFO ";
+  case LogLevel::Debug:
+    return "DEBUG";
+  }
+  return "?    ";
+}
+
+// Append at most size - 1 - length characters; returns the new length
+size_t append(char *buffer, size_t size, size_t length, const char *text,
+              size_t textLength) {
+  size_t room = size - 1 - length;
+  size_t count = std::min(room, textLength);
+  std::memcpy(buffer + length, text, count);
+  return length + count;
+}
+
+} // namespace
+
+Logger &Logger::instance() {
+  static Logger logger;
+  return logger;
+}
+
+Logger::~Logger() { stop(); }
+
+bool Logger::start(const Options &options) {
+  if (writer_.joinable()) {
+    return false;
+  }
+
+  options_ = options;
+  fileBytes_ = 0;
+  if (!options_.filePath.empty()) {
+    file_.open(options_.filePath, std::ios::out | std::ios::app);
+    if (!file_.is_open()) {
+      return false;
+    }
+    file_.seekp(0, std::ios::end);
+    fileBytes_ = static_cast<uint64_t>(file_.tellp());
+  }
+
+  // Discard anything left over from a previous session
+  {
+    std::lock_guard<std::mutex> lock(ringsMutex_);
+    for (auto &ring : rings_) {
+      ring->tail.store(ring->head.load(std::memory_order_acquire),
+                       std::memory_order_release);
+    }
+  }
+
+  setLevel(options_.level);
+  dropped_.store(0, std::memory_order_relaxed);
+  written_.store(0, std::memory_order_relaxed);
+  reportedDrops_ = 0;
+  batch_.reserve(kRingCapacity);
+
+  CycleClock::calibrate();
+  originTicks_ = CycleClock::now();
+  originTime_ = std::chrono::system_clock::now();
+
+  // Records written to the console before start() go to the file as well
+  {
+    std::lock_guard<std::mutex> lock(directMutex_);
+    if (file_.is_open()) {
+      bool console = options_.console;
+      options_.console = false;
+      for (size_t i = 0; i < backlogCount_; ++i) {
+        writeRecord(backlog_[i]);
+      }
+      options_.console = console;
+      file_.flush();
+    }
+    backlogCount_ = 0;
+    stopRequested_ = false;
+    writer_ = std::thread(&Logger::writerLoop, this);
+    running_.store(true, std::memory_order_release);
+  }
+  return true;
+}
+
+void Logger::stop() {
+  if (!writer_.joinable()) {
+    return;
+  }
+
+  running_.store(false, std::memory_order_release);
+  {
+    std::lock_guard<std::mutex> lock(wakeMutex_);
+    stopRequested_ = true;
+  }
+  wake_.notify_one();
+  writer_.join();
+
+  if (file_.is_open()) {
+    file_.close();
+  }
+}
+
+void Logger::emit(const LogRecord &record) {
+  if (!running_.load(std::memory_order_acquire)) {
+    writeNow(record);
+    return;
+  }
+
+  ThreadRing *ring = ringForThisThread();
+  uint64_t head = ring->head.load(std::memory_order_relaxed);
+  if (head - ring->tail.load(std::memory_order_acquire) >= kRingCapacity) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  ring->records[head & (kRingCapacity - 1)] = record;
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+Logger::ThreadRing *Logger::ringForThisThread() {
+  // Registered once per thread; rings live as long as the logger so a
+  // thread may exit without unregistering
+  thread_local ThreadRing *ring = nullptr;
+  if (!ring) {
+    std::lock_guard<std::mutex> lock(ringsMutex_);
+    rings_.push_back(std::make_unique<ThreadRing>());
+    ring = rings_.back().get();
+  }
+  return ring;
+}
+
+void Logger::writeNow(const LogRecord &record) {
+  char message[512];
+  size_t length = formatMessage(record, message, sizeof(message));
+
+  std::lock_guard<std::mutex> lock(directMutex_);
+  writeConsole(record.level, message, length);
+  std::cout.flush();
+  if (backlogCount_ < kBacklog) {
+    backlog_[backlogCount_++] = record;
+  }
+}
+
+void Logger::writerLoop() {
+  std::unique_lock<std::mutex> lock(wakeMutex_);
+  while (!stopRequested_) {
+    wake_.wait_for(lock, std::chrono::milliseconds(10));
+    lock.unlock();
+    drainAll();
+    lock.lock();
+  }
+  lock.unlock();
+  drainAll();
+}
+
+void Logger::drainAll() {
+  batch_.clear();
+  {
+    std::lock_guard<std::mutex> lock(ringsMutex_);
+    for (auto &ring : rings_) {
+      uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+      uint64_t head = ring->head.load(std::memory_order_acquire);
+      for (; tail != head; ++tail) {
+        batch_.push_back(ring->records[tail & (kRingCapacity - 1)]);
+      }
+      ring->tail.store(tail, std::memory_order_release);
+    }
+  }
+
+  // Interleave the threads' records in the order they were logged
+  std::stable_sort(batch_.begin(), batch_.end(),
+                   [](const LogRecord &a, const LogRecord &b) {
+                     return a.ticks < b.ticks;
+                   });
+  for (const LogRecord &record : batch_) {
+    writeRecord(record);
+  }
+
+  uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+  if (dropped != reportedDrops_) {
+    LogRecord record{};
+    record.ticks = CycleClock::now();
+    record.format = "{} log record(s) dropped (ring full)";
+    record.level = LogLevel::Warning;
+    record.args[0] = static_cast<int64_t>(dropped - reportedDrops_);
+    reportedDrops_ = dropped;
+    writeRecord(record);
+  }
+
+  if (options_.console) {
+    std::cout.flush();
+  }
+  if (file_.is_open()) {
+    file_.flush();
+  }
+}
+
+void Logger::writeRecord(const LogRecord &record) {
+  char message[512];
+  size_t length = formatMessage(record, message, sizeof(message));
+
+  if (options_.console) {
+    writeConsole(record.level, message, length);
+  }
+
+  if (file_.is_open()) {
+    // Wall-clock time of the record (records from before start() included)
+    int64_t sinceOriginNs =
+        record.ticks >= originTicks_
+            ? static_cast<int64_t>(
+                  CycleClock::toNanoseconds(record.ticks - originTicks_))
+            : -static_cast<int64_t>(
+                  CycleClock::toNanoseconds(originTicks_ - record.ticks));
+    auto time = originTime_ + std::chrono::duration_cast<
+                                  std::chrono::system_clock::duration>(
+                                  std::chrono::nanoseconds(sinceOriginNs));
+    std::time_t seconds = std::chrono::system_clock::to_time_t(time);
+    int ms = static_cast<int>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            time.time_since_epoch())
+            .count() %
+        1000);
+    std::tm local{};
+#ifdef _WIN32
+    localtime_s(&local, &seconds);
+#else
+    localtime_r(&seconds, &local);
+#endif
+
+    char line[600];
+    size_t prefix = std::strftime(line, sizeof(line), "%Y-%m-%d %H:%M:%S",
+                                  &local);
+    prefix += snprintf(line + prefix, sizeof(line) - prefix, ".%03d %s ",
+                       ms < 0 ? ms + 1000 : ms, levelName(record.level));
+    size_t total = append(line, sizeof(line), prefix, message, length);
+    line[total++] = '\n';
+    writeFile(line, total);
+  }
+  written_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Logger::writeConsole(LogLevel level, const char *message,
+                          size_t length) {
+  switch (level) {
+  case LogLevel::Error:
+    std::cerr << "Error: ";
+    std::cerr.write(message, length);
+    std::cerr << '\n';
+    break;
+  case LogLevel::Warning:
+    std::cerr << "Warning: ";
+    std::cerr.write(message, length);
+    std::cerr << '\n';
+    break;
+  default:
+    std::cout.write(message, length);
+    std::cout << '\n';
+    break;
+  }
+}
+
+void Logger::writeFile(const char *line, size_t length) {
+  if (fileBytes_ > 0 && fileBytes_ + length > options_.fileBytes) {
+    rotate();
+  }
+  file_.write(line, length);
+  fileBytes_ += length;
+}
+
+void Logger::rotate() {
+  file_.close();
+  const std::string &path = options_.filePath;
+  // "<path>.(n-1)" is deleted, "<path>.i" becomes "<path>.(i+1)"
+  for (int i = options_.maxFiles - 1; i >= 1; --i) {
+    std::string from = i == 1 ? path : path + "." + std::to_string(i - 1);
+    std::string to = path + "." + std::to_string(i);
+    std::remove(to.c_str());
+    std::rename(from.c_str(), to.c_str());
+  }
+  file_.open(path, std::ios::out | std::ios::trunc);
+  fileBytes_ = 0;
+}
+
+size_t Logger::formatMessage(const LogRecord &record, char *buffer,
+                             size_t size) {
+  if (size == 0) {
+    return 0;
+  }
+  size_t length = 0;
+  size_t argIndex = 0;
+  for (const char *p = record.format; *p && length + 1 < size; ++p) {
+    char number[24];
+    int written = -1;
+    if (std::strncmp(p, "{}", 2) == 0) {
+      int64_t arg = argIndex < 3 ? record.args[argIndex++] : 0;
+      written = snprintf(number, sizeof(number), "%" PRId64, arg);
+      p += 1;
+    } else if (std::strncmp(p, "{x}", 3) == 0) {
+      int64_t arg = argIndex < 3 ? record.args[argIndex++] : 0;
+      written = snprintf(number, sizeof(number), "%" PRIX64,
+                         static_cast<uint64_t>(arg));
+      p += 2;
+    } else if (std::strncmp(p, "{s}", 3) == 0) {
+      length = append(buffer, size, length, record.text,
+                      strnlen(record.text, sizeof(record.text)));
+      p += 2;
+      continue;
+    } else {
+      buffer[length++] = *p;
+      continue;
+    }
+    if (written > 0) {
+      length = append(buffer, size, length, number,
+                      static_cast<size_t>(written));
+    }
+  }
+  buffer[length] = '\0';
+  return length;
+}
@@ -1,12 +1,16 @@
 #include "config.h"
+#include "logger.h"
 #include "modifier_key_fixer.h"
+#include "trace_replay.h"
+#include "trace_writer.h"
 #include <Windows.h>
 #include <conio.h>
 #include <iomanip>
 #include <iostream>
+#include <string>
 
 // Display current states
-void displayStates(const ModifierKeyFixer &fixer) {
+void displayStates(const ModifierKeyFixer &fixer, bool showTiming) {
   system("cls");
 
   std::cout << "=== Modifier Key Auto-Fix Monitor ===" << std::endl;
@@ -15,7 +19,11 @@ void displayStates(const ModifierKeyFixer &fixer) {
             << " | ";
   std::cout << "Status: " << (fixer.isPaused() ? "PAUSED" : "RUNNING")
             << std::endl;
-  std::cout << "Press ESC to exit | Press P to pause/resume" << std::endl;
+  std::cout << "Press ESC to exit | Press P to pause/resume | Press T to "
+               "toggle stage timing"
+            << std::endl;
+  std::cout << "Press D to save a diagnostic dump of recent events"
+            << std::endl;
   std::cout << std::endl;
 
   const auto &pStates = fixer.getPhysicalStates();
@@ -66,9 +74,22 @@ void displayStates(const ModifierKeyFixer &fixer) {
   } else {
     std::cout << "All keys normal. Monitoring..." << std::endl;
   }
+
+  // Display per-stage timing dump
+  if (showTiming) {
+    std::cout << std::endl;
+    std::cout << "Stage Timing:" << std::endl;
+    std::cout << fixer.getStageTimers().dump();
+  }
 }
 
-int main() {
+int main(int argc, char *argv[]) {
+  // Headless replay of recorded traces (profile-guided optimisation
+  // training and its benchmark); no driver needed
+  if (argc > 1 && std::string(argv[1]) == "--replay") {
+    return replayMain(argc, argv);
+  }
+
   std::cout << "=== Modifier Key Auto-Fix Tool ===" << std::endl;
   std::cout << "Initializing..." << std::endl;
 
@@ -118,6 +139,22 @@ int main() {
 
   std::cout << std::endl;
 
+  // Fix messages (and per-stroke output in debug mode) are formatted and
+  // written by the logger's thread, not the input thread
+  Logger::Options logOptions;
+  logOptions.filePath = config.getLogFile();
+  logOptions.fileBytes = static_cast<uint64_t>(config.getLogFileSizeMB())
+                         << 20;
+  logOptions.maxFiles = config.getLogMaxFiles();
+  logOptions.level =
+      config.getDebugMode() ? LogLevel::Debug : LogLevel::Info;
+  if (!Logger::instance().start(logOptions)) {
+    std::cerr << "Warning: Failed to open log file " << config.getLogFile()
+              << std::endl;
+    logOptions.filePath.clear();
+    Logger::instance().start(logOptions);
+  }
+
   // Create and initialize fixer with config
   ModifierKeyFixer fixer;
 
@@ -131,18 +168,30 @@ int main() {
     return 1;
   }
 
+  // Start event-loop tracing if configured
+  if (!config.getTraceFile().empty()) {
+    if (TraceWriter::instance().start(config.getTraceFile())) {
+      std::cout << "Tracing to: " << config.getTraceFile() << std::endl;
+    } else {
+      std::cerr << "Warning: Failed to open trace file "
+                << config.getTraceFile() << std::endl;
+    }
+  }
+
   std::cout << "Initialized successfully!" << std::endl;
   std::cout << "Auto-fix will trigger when you press any key after a modifier "
                "key is stuck."
             << std::endl;
   Sleep(2000);
 
-  // Track previous states for display updates
-  ModifierKeyStates prevPhysicalStates;
-  VirtualKeyStates prevVirtualStates;
+  // Track previous states for display updates. Copies of the fixer's own
+  // key lists, so later assignments reuse their storage.
+  ModifierKeyStates prevPhysicalStates = fixer.getPhysicalStates();
+  VirtualKeyStates prevVirtualStates = fixer.getVirtualStates();
   bool prevPaused = false;
+  bool showTiming = false;
 
-  displayStates(fixer);
+  displayStates(fixer, showTiming);
 
   // Main loop
   bool running = true;
@@ -161,11 +210,19 @@ int main() {
           fixer.pause();
         }
         // Force display update immediately
-        displayStates(fixer);
+        displayStates(fixer, showTiming);
         prevPhysicalStates = fixer.getPhysicalStates();
         prevVirtualStates = fixer.getVirtualStates();
         prevPaused = fixer.isPaused();
         continue;
+      } else if (ch == 't' || ch == 'T') {
+        // Toggle stage timing dump
+        showTiming = !showTiming;
+        displayStates(fixer, showTiming);
+        continue;
+      } else if (ch == 'd' || ch == 'D') {
+        // Flight recorder dump, written in the background
+        fixer.requestFlightDump();
       }
     }
 
@@ -188,25 +245,35 @@ int main() {
     }
 
     // Update display if any key is mismatched
-    const auto &trackers = fixer.getMismatchTrackers();
-    if (trackers.lctrl().isMismatched || trackers.rctrl().isMismatched ||
-        trackers.lshift().isMismatched || trackers.rshift().isMismatched ||
-        trackers.lalt().isMismatched || trackers.ralt().isMismatched ||
-        trackers.lwin().isMismatched || trackers.rwin().isMismatched) {
+    if (fixer.hasAnyMismatch()) {
       stateChanged = true;
     }
 
     if (stateChanged) {
-      displayStates(fixer);
+      displayStates(fixer, showTiming);
       prevPhysicalStates = fixer.getPhysicalStates();
       prevVirtualStates = fixer.getVirtualStates();
       prevPaused = fixer.isPaused();
     }
   }
 
-  // Cleanup and show statistics
+  // Cleanup and show statistics (after the last log messages)
+  Logger::instance().stop();
   std::cout << "\nExiting..." << std::endl;
 
+  if (TraceWriter::instance().isActive()) {
+    TraceWriter::instance().stop();
+    std::cout << "Trace written: " << TraceWriter::instance().getWrittenCount()
+              << " events (" << TraceWriter::instance().getDroppedCount()
+              << " dropped)" << std::endl;
+  }
+
+  if (fixer.getRecorder().isActive()) {
+    std::cout << "Strokes recorded: " << fixer.getRecorder().getRecordCount()
+              << " records (" << fixer.getRecorder().getDroppedCount()
+              << " dropped)" << std::endl;
+  }
+
   const auto &stats = fixer.getStatistics();
   std::cout << "\nFix Statistics:" << std::endl;
   std::cout << "  Total fixes: " << stats.getTotalFixes() << std::endl;
@@ -220,6 +287,44 @@ int main() {
     }
   }
 
+  // Held keys the OS never registered, and the key-downs sent again
+  if (stats.getTotalLostKeyDowns() > 0) {
+    std::cout << "  Lost key-downs: " << stats.getTotalLostKeyDowns() << " ("
+              << stats.getTotalKeyDownRepairs() << " sent again)" << std::endl;
+    for (const auto &key : pStates.getKeys()) {
+      int lostCount = stats.getLostKeyDownCount(key.id);
+      if (lostCount > 0) {
+        std::cout << "  " << key.name << ": " << lostCount << std::endl;
+      }
+    }
+  }
+
+  // How long the OS took to follow modifier key-ups and key-downs
+  if (stats.getReleaseLag().getCount() > 0 ||
+      stats.getKeyDownLag().getCount() > 0) {
+    std::cout << "\nOS Lag:" << std::endl;
+    std::cout << "  Release:  "
+              << formatLatencySummary(stats.getReleaseLag().summarize())
+              << std::endl;
+    std::cout << "  Key-down: "
+              << formatLatencySummary(stats.getKeyDownLag().summarize())
+              << std::endl;
+  }
+
+  // Compare candidate policies with what the live one did
+  if (fixer.getShadowEvaluator().isActive()) {
+    std::cout << "\nShadow Policies:" << std::endl;
+    std::cout << fixer.getShadowEvaluator().summary(stats.getTotalFixes());
+  }
+
+#if ESCMODKEY_LATENCY_STATS
+  // Display forwarding latency added per keystroke
+  auto latency = stats.getForwardLatency().summarize();
+  std::cout << "\nForwarding Latency:" << std::endl;
+  std::cout << "  Strokes: " << latency.count << std::endl;
+  std::cout << "  " << formatLatencySummary(latency) << std::endl;
+#endif
+
   std::cout << "\nProgram exited successfully." << std::endl;
 
   return 0;
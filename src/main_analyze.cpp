@@ -0,0 +1,181 @@
+#include "latency_histogram.h"
+#include "trace_analysis.h"
+#include "trace_format.h"
+#include "work_stealing_pool.h"
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Offline analysis of recorded traces (*.emkt): mismatch episodes, fixes,
+// key timing and devices, per file and over the whole corpus. Files are
+// memory-mapped and analyzed in parallel on a work-stealing pool.
+
+void printUsage() {
+  std::cout
+      << "Usage: escModKey_analyze [options] <trace.emkt | directory> ...\n"
+      << "\n"
+      << "Directories are searched recursively for *.emkt files.\n"
+      << "\n"
+      << "Options:\n"
+      << "  --threads <n>   Worker threads (default: all cores)\n"
+      << "  --summary       Only print the overall results\n";
+}
+
+void printDistribution(std::ostream &out, const char *label,
+                       const LatencyHistogram &histogram) {
+  if (histogram.getCount() == 0) {
+    return;
+  }
+  out << "      " << std::setw(12) << std::left << label << std::right
+      << formatLatencySummary(histogram.summarize()) << "\n";
+}
+
+void printKeys(std::ostream &out, const TraceStats &stats, bool allKeys) {
+  for (const auto &key : stats.keys) {
+    if (!allKeys && key->episodes == 0 && key->fixes == 0) {
+      continue;
+    }
+    out << "    " << key->id << ": " << key->presses << " presses, "
+        << key->episodes << " episodes (" << key->stuck << " stuck, "
+        << key->fixes << " fixed, " << key->selfResolved
+        << " self-resolved)\n";
+    printDistribution(out, "episode", key->episodeNs);
+    printDistribution(out, "time-to-fix", key->timeToFixNs);
+    if (allKeys) {
+      printDistribution(out, "hold", key->holdNs);
+    }
+  }
+}
+
+// One block per file: totals, then keys with episodes or fixes
+std::string formatFile(const std::string &path, const TraceStats &stats) {
+  std::ostringstream out;
+  out << path << ": " << stats.records << " records, " << std::fixed
+      << std::setprecision(1) << stats.durationNs / 60e9 << " min, "
+      << stats.strokes << " strokes, " << stats.totalEpisodes()
+      << " episodes, " << stats.totalFixes() << " fixes";
+  if (stats.openEpisodes > 0) {
+    out << ", " << stats.openEpisodes << " open";
+  }
+  out << "\n";
+  printKeys(out, stats, false);
+  return out.str();
+}
+
+int main(int argc, char *argv[]) {
+  std::vector<std::string> files;
+  size_t threads = 0;
+  bool summaryOnly = false;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--help" || arg == "-h") {
+      printUsage();
+      return 0;
+    } else if (arg == "--summary") {
+      summaryOnly = true;
+    } else if (arg == "--threads" && hasValue) {
+      threads = static_cast<size_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+      std::cerr << "Unknown option: " << arg << std::endl;
+      printUsage();
+      return 1;
+    } else if (!TraceFormat::collectTraceFiles(arg, files)) {
+      std::cerr << "ERROR: No such file or directory: " << arg << std::endl;
+      return 1;
+    }
+  }
+  if (files.empty()) {
+    printUsage();
+    return 1;
+  }
+
+  WorkStealingPool pool(threads);
+  std::vector<std::string> reports(files.size());
+  std::vector<std::string> errors(files.size());
+  // One running total per worker, merged once at the end
+  std::vector<std::unique_ptr<TraceStats>> totals;
+  for (size_t i = 0; i < pool.getWorkerCount(); ++i) {
+    totals.push_back(std::make_unique<TraceStats>());
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  pool.run(files.size(), [&](size_t index, size_t worker) {
+    TraceFormat::MappedTraceFile trace;
+    if (!trace.open(files[index], &errors[index])) {
+      return;
+    }
+    TraceStats stats;
+    analyzeTrace(trace.header(), trace.records(), trace.recordCount(), stats);
+    if (!summaryOnly) {
+      reports[index] = formatFile(files[index], stats);
+    }
+    totals[worker]->merge(stats);
+  });
+  TraceStats overall;
+  for (const auto &total : totals) {
+    overall.merge(*total);
+  }
+  double elapsedSec = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+
+  size_t failed = 0;
+  for (size_t i = 0; i < files.size(); ++i) {
+    if (!errors[i].empty()) {
+      std::cerr << "ERROR: " << files[i] << ": " << errors[i] << std::endl;
+      failed++;
+    } else if (!summaryOnly) {
+      std::cout << reports[i];
+    }
+  }
+
+  std::cout << "\nOverall:" << std::endl;
+  std::cout << "  Files:            " << overall.files;
+  if (failed > 0) {
+    std::cout << " (" << failed << " unreadable)";
+  }
+  std::cout << std::endl;
+  std::cout << "  Records:          " << overall.records << " ("
+            << std::fixed << std::setprecision(1) << overall.bytes / 1e6
+            << " MB)" << std::endl;
+  std::cout << "  Recorded time:    " << std::setprecision(1)
+            << overall.durationNs / 3600e9 << " h" << std::endl;
+  std::cout << "  Strokes:          " << overall.strokes << std::endl;
+  std::cout << "  Virtual changes:  " << overall.virtualChanges << std::endl;
+  std::cout << "  Episodes:         " << overall.totalEpisodes() << " ("
+            << overall.openEpisodes << " open at end of file)" << std::endl;
+  std::cout << "  Fixes:            " << overall.totalFixes() << std::endl;
+  if (overall.interKeyNs.getCount() > 0) {
+    std::cout << "  Inter-key:        "
+              << formatLatencySummary(overall.interKeyNs.summarize())
+              << std::endl;
+  }
+
+  std::cout << "\n  Keys:" << std::endl;
+  printKeys(std::cout, overall, true);
+
+  std::cout << "\n  Devices:" << std::endl;
+  for (size_t i = 0; i < kMaxTraceDevices; ++i) {
+    const DeviceTraceStats &device = overall.devices[i];
+    if (device.strokes == 0 && device.fixes == 0) {
+      continue;
+    }
+    std::cout << "    device " << std::setw(2) << i << ": " << device.strokes
+              << " strokes, " << device.presses << " presses, "
+              << device.fixes << " fixes" << std::endl;
+  }
+
+  std::cout << "\n  Wall time:        " << std::setprecision(3) << elapsedSec
+            << " s (" << std::setprecision(2)
+            << (elapsedSec > 0 ? overall.bytes / 1e9 / elapsedSec : 0)
+            << " GB/s, " << pool.getWorkerCount() << " threads, "
+            << pool.getStealCount() << " steals)" << std::endl;
+
+  return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,142 @@
+#include "differential.h"
+#include "simulator.h"
+#include "trace_format.h"
+#include "work_stealing_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Differential testing: runs generated cases, or windows of recorded traces
+// (*.emkt), through the frozen reference and the live detector and fix
+// logic in lockstep, in parallel, and prints a shrunk reproducer for the
+// first divergence.
+
+void printUsage() {
+  std::cout
+      << "Usage: escModKey_diff [options] [trace.emkt | directory ...]\n"
+      << "\n"
+      << "Compares the live detector and fix logic with the frozen\n"
+      << "reference on generated cases, or on windows of the given traces\n"
+      << "(directories are searched recursively). Exits with 1 if they\n"
+      << "differ.\n"
+      << "\n"
+      << "Options:\n"
+      << "  --cases <n>       Generated cases (default 100000)\n"
+      << "  --events <n>      Maximum events per generated case "
+         "(default 200)\n"
+      << "  --seed <n>        Seed of case 0; case i uses seed + i "
+         "(default 1)\n"
+      << "  --window <n>      Strokes per case from traces (default 2000)\n"
+      << "  --poll <ms>       Idle iteration interval in traces "
+         "(default 50)\n"
+      << "  --drop <rate>     Probability a traced key-up is lost "
+         "(default 0.01)\n"
+      << "  --threads <n>     Worker threads (default: all cores)\n";
+}
+
+int main(int argc, char *argv[]) {
+  size_t caseCount = 100000;
+  size_t maxEvents = 200;
+  uint64_t seed = 1;
+  size_t window = 2000;
+  int pollMs = 50;
+  double dropRate = 0.01;
+  size_t threads = 0;
+  std::vector<std::string> files;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--help" || arg == "-h") {
+      printUsage();
+      return 0;
+    } else if (arg == "--cases" && hasValue) {
+      caseCount = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--events" && hasValue) {
+      maxEvents = std::max<size_t>(std::strtoull(argv[++i], nullptr, 10), 1);
+    } else if (arg == "--seed" && hasValue) {
+      seed = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--window" && hasValue) {
+      window = std::max<size_t>(std::strtoull(argv[++i], nullptr, 10), 1);
+    } else if (arg == "--poll" && hasValue) {
+      pollMs = std::atoi(argv[++i]);
+    } else if (arg == "--drop" && hasValue) {
+      dropRate = std::atof(argv[++i]);
+    } else if (arg == "--threads" && hasValue) {
+      threads = static_cast<size_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+      std::cerr << "Unknown option: " << arg << std::endl;
+      printUsage();
+      return 1;
+    } else if (!TraceFormat::collectTraceFiles(arg, files)) {
+      std::cerr << "ERROR: No such file or directory: " << arg << std::endl;
+      return 1;
+    }
+  }
+
+  WorkStealingPool pool(threads);
+
+  // Recorded strokes are cut into cases up front; generated cases are built
+  // by the worker that runs them
+  std::vector<DiffCase> traceCases;
+  if (!files.empty()) {
+    std::vector<std::vector<DiffCase>> perFile(files.size());
+    std::vector<std::string> errors(files.size());
+    pool.run(files.size(), [&](size_t index, size_t) {
+      TraceFormat::TraceFile trace;
+      if (TraceFormat::readTraceFile(files[index], trace, &errors[index])) {
+        perFile[index] = diffCasesFromStrokes(
+            strokesFromTrace(trace), seed + index, window, pollMs, dropRate);
+      }
+    });
+    for (size_t i = 0; i < files.size(); ++i) {
+      if (!errors[i].empty()) {
+        std::cerr << "ERROR: " << files[i] << ": " << errors[i] << std::endl;
+        return 1;
+      }
+      for (DiffCase &testCase : perFile[i]) {
+        traceCases.push_back(std::move(testCase));
+      }
+    }
+    caseCount = traceCases.size();
+  }
+
+  auto caseAt = [&](size_t index) {
+    return traceCases.empty() ? generateDiffCase(seed + index, maxEvents)
+                              : traceCases[index];
+  };
+
+  auto start = std::chrono::steady_clock::now();
+  DiffReport report = runDifferential(caseCount, caseAt, pool,
+                                      makeReferenceSubject, makeCurrentSubject);
+  double elapsedSec = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+
+  std::cout << report.cases << " cases, " << report.events << " events, "
+            << report.failures << " diverged" << std::endl;
+  std::cout << "Wall time: " << std::fixed << std::setprecision(3)
+            << elapsedSec << " s (" << pool.getWorkerCount() << " threads, "
+            << std::setprecision(0)
+            << (elapsedSec > 0 ? report.events / elapsedSec : 0)
+            << " events/s)" << std::endl;
+
+  if (!report.hasFailure) {
+    return 0;
+  }
+
+  std::cout << "\nFirst divergence in case " << report.firstFailure;
+  if (traceCases.empty()) {
+    std::cout << " (--seed " << seed + report.firstFailure
+              << " --cases 1 --events " << maxEvents << ")";
+  }
+  std::cout << "\nMinimal reproducer, differs at event "
+            << report.mismatch.eventIndex << ": "
+            << report.mismatch.description << "\n"
+            << describeDiffCase(report.minimal) << std::flush;
+  return 1;
+}
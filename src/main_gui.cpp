@@ -1,7 +1,14 @@
 #include "../resources/resource.h"
 #include "config.h"
+#include "logger.h"
 #include "modifier_key_fixer.h"
+#include "startup_timer.h"
+#include "trace_replay.h"
+#include "trace_writer.h"
 #include <Windows.h>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
 #include <shellapi.h>
 #include <string>
 
@@ -12,6 +19,8 @@
 #define ID_TRAY_PAUSE_RESUME 1003
 #define ID_TRAY_SHOW_STATS 1004
 #define ID_TRAY_RESTART 1005
+#define ID_TRAY_SHOW_TIMING 1006
+#define ID_TRAY_DUMP 1007
 
 // Global variables
 HINSTANCE g_hInstance = nullptr;
@@ -20,6 +29,14 @@ ModifierKeyFixer *g_pFixer = nullptr;
 Config *g_pConfig = nullptr;
 HWND g_hwnd = nullptr;
 bool g_running = true;
+StartupTimer *g_pStartup = nullptr;
+// Tray icon exists (the worker may run before it is created)
+std::atomic<bool> g_trayReady(false);
+// Signalled once the worker's first processEvents() wait has returned
+HANDLE g_firstWaitDone = nullptr;
+// Set by the tray menu; the worker restarts the fixer between two
+// processEvents() calls, never while the event loop is using its buffers
+std::atomic<bool> g_restartRequested(false);
 
 // Function declarations
 LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
@@ -28,6 +45,7 @@ void RemoveTrayIcon();
 void ShowContextMenu(HWND hwnd);
 void ShowNotification(const char *title, const char *message);
 void UpdateTrayTooltip();
+void RestartFixer();
 
 // Window procedure
 LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
@@ -74,30 +92,9 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
       PostQuitMessage(0);
       break;
 
-    case ID_TRAY_RESTART: {
-      // Reload configuration
-      std::string configPath = Config::getDefaultConfigPath();
-      if (!g_pConfig->load(configPath)) {
-        ShowNotification("Restart Failed", "Failed to reload configuration");
-        break;
-      }
-
-      // Cleanup old fixer
-      g_pFixer->cleanup();
-
-      // Reinitialize with new configuration
-      if (!g_pFixer->initialize(*g_pConfig)) {
-        ShowNotification("Restart Failed", "Failed to reinitialize");
-        break;
-      }
-
-      // Disable console messages for GUI mode
-      g_pFixer->setShowMessages(false);
-
-      ShowNotification("Restarted", "Configuration reloaded successfully");
-      UpdateTrayTooltip();
+    case ID_TRAY_RESTART:
+      g_restartRequested = true;
       break;
-    }
 
     case ID_TRAY_PAUSE_RESUME:
       if (g_pFixer->isPaused()) {
@@ -110,6 +107,29 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
       UpdateTrayTooltip();
       break;
 
+    case ID_TRAY_SHOW_TIMING: {
+      std::string timingText = g_pFixer->getStageTimers().dump();
+      if (g_pStartup) {
+        timingText += "\nStartup:\n" + g_pStartup->summary();
+      }
+      MessageBoxA(nullptr, timingText.c_str(),
+                  "Modifier Key Auto-Fix - Stage Timing",
+                  MB_OK | MB_ICONINFORMATION);
+      break;
+    }
+
+    case ID_TRAY_DUMP:
+      // Taken by the input thread, written by the recorder's thread
+      if (g_pFixer->getFlightRecorder().isActive()) {
+        g_pFixer->requestFlightDump();
+        ShowNotification("Diagnostic Dump",
+                         "Recent events are being saved to the dumps folder");
+      } else {
+        ShowNotification("Diagnostic Dump",
+                         "Flight recorder is off (flightRecorderEvents = 0)");
+      }
+      break;
+
     case ID_TRAY_SHOW_STATS: {
       const auto &stats = g_pFixer->getStatistics();
       const auto &pStates = g_pFixer->getPhysicalStates();
@@ -128,6 +148,51 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
         statsText += "\n";
       }
 
+      // Add held keys the OS never registered
+      if (stats.getTotalLostKeyDowns() > 0) {
+        statsText += "\nLost Key-Downs: ";
+        statsText += std::to_string(stats.getTotalLostKeyDowns());
+        statsText += " (";
+        statsText += std::to_string(stats.getTotalKeyDownRepairs());
+        statsText += " sent again)\n";
+        for (const auto &key : pStates.getKeys()) {
+          int lostCount = stats.getLostKeyDownCount(key.id);
+          if (lostCount > 0) {
+            statsText += key.name;
+            statsText += ": ";
+            statsText += std::to_string(lostCount);
+            statsText += "\n";
+          }
+        }
+      }
+
+      // Add how long the OS took to follow key-ups and key-downs
+      if (stats.getReleaseLag().getCount() > 0 ||
+          stats.getKeyDownLag().getCount() > 0) {
+        statsText += "\nOS Lag:\nRelease: ";
+        statsText += formatLatencySummary(stats.getReleaseLag().summarize());
+        statsText += "\nKey-down: ";
+        statsText += formatLatencySummary(stats.getKeyDownLag().summarize());
+        statsText += "\n";
+      }
+
+      // Add candidate policies compared with the live one
+      if (g_pFixer->getShadowEvaluator().isActive()) {
+        statsText += "\nShadow Policies:\n";
+        statsText +=
+            g_pFixer->getShadowEvaluator().summary(stats.getTotalFixes());
+      }
+
+#if ESCMODKEY_LATENCY_STATS
+      // Add forwarding latency summary
+      auto latency = stats.getForwardLatency().summarize();
+      statsText += "\nForwarding Latency (";
+      statsText += std::to_string(latency.count);
+      statsText += " strokes):\n";
+      statsText += formatLatencySummary(latency);
+      statsText += "\n";
+#endif
+
       MessageBoxA(nullptr, statsText.c_str(),
                   "Modifier Key Auto-Fix - Statistics",
                   MB_OK | MB_ICONINFORMATION);
@@ -167,6 +232,9 @@ void RemoveTrayIcon() { Shell_NotifyIcon(NIM_DELETE, &g_nid); }
 
 // Update tray tooltip
 void UpdateTrayTooltip() {
+  if (!g_trayReady) {
+    return;
+  }
   if (g_pFixer->isPaused()) {
     strcpy_s(g_nid.szTip, "Modifier Key Auto-Fix - Paused");
   } else {
@@ -192,6 +260,8 @@ void ShowContextMenu(HWND hwnd) {
   }
 
   AppendMenuA(hMenu, MF_STRING, ID_TRAY_SHOW_STATS, "Show Statistics");
+  AppendMenuA(hMenu, MF_STRING, ID_TRAY_SHOW_TIMING, "Show Stage Timing");
+  AppendMenuA(hMenu, MF_STRING, ID_TRAY_DUMP, "Save Diagnostic Dump");
   AppendMenuA(hMenu, MF_STRING, ID_TRAY_RESTART, "Restart (Reload Config)");
   AppendMenuA(hMenu, MF_SEPARATOR, 0, nullptr);
   AppendMenuA(hMenu, MF_STRING, ID_TRAY_EXIT, "Exit");
@@ -208,6 +278,9 @@ void ShowNotification(const char *title, const char *message) {
   if (g_pConfig && !g_pConfig->getNotificationsEnabled()) {
     return;
   }
+  if (!g_trayReady) {
+    return;
+  }
 
   g_nid.uFlags = NIF_INFO;
   strcpy_s(g_nid.szInfoTitle, title);
@@ -220,12 +293,51 @@ void ShowNotification(const char *title, const char *message) {
   g_nid.uFlags = NIF_ICON | NIF_MESSAGE | NIF_TIP;
 }
 
+// Reload the configuration and reinitialize the fixer (worker thread only)
+void RestartFixer() {
+  std::string configPath = Config::getDefaultConfigPath();
+  if (!g_pConfig->load(configPath)) {
+    ShowNotification("Restart Failed", "Failed to reload configuration");
+    return;
+  }
+
+  // Cleanup old fixer
+  g_pFixer->cleanup();
+
+  // Reinitialize with new configuration
+  if (!g_pFixer->initialize(*g_pConfig)) {
+    ShowNotification("Restart Failed", "Failed to reinitialize");
+    return;
+  }
+
+  // No console in GUI mode: fix messages only go to a log file
+  g_pFixer->setShowMessages(Logger::instance().isRunning() &&
+                            g_pConfig->getShowMessages());
+  Logger::instance().setLevel(g_pConfig->getDebugMode() ? LogLevel::Debug
+                                                         : LogLevel::Info);
+
+  ShowNotification("Restarted", "Configuration reloaded successfully");
+  UpdateTrayTooltip();
+}
+
 // Worker thread for processing events
 DWORD WINAPI WorkerThread(LPVOID lpParam) {
   int prevFixCount = 0;
 
+  bool firstWait = true;
   while (g_running) {
     g_pFixer->processEvents(50);
+    if (firstWait) {
+      firstWait = false;
+      if (g_firstWaitDone) {
+        SetEvent(g_firstWaitDone);
+      }
+    }
+
+    if (g_restartRequested.exchange(false)) {
+      RestartFixer();
+      prevFixCount = g_pFixer->getStatistics().getTotalFixes();
+    }
 
     // Check if a fix occurred
     int currentFixCount = g_pFixer->getStatistics().getTotalFixes();
@@ -249,6 +361,16 @@ DWORD WINAPI WorkerThread(LPVOID lpParam) {
 // WinMain entry point
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
                    LPSTR lpCmdLine, int nCmdShow) {
+  // Headless replay for profile-guided optimisation training
+  if (__argc > 1 && strcmp(__argv[1], "--replay") == 0) {
+    return replayMain(__argc, __argv);
+  }
+
+  // Startup breakdown, shown under "Show Stage Timing"
+  StartupTimer startup;
+  startup.setPreStartNs(StartupTimer::processAgeNs());
+  g_pStartup = &startup;
+
   // Check for single instance using Mutex
   HANDLE hMutex =
       CreateMutexA(nullptr, TRUE, "Global\\ModifierKeyAutoFix_SingleInstance");
@@ -259,6 +381,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
     }
     return 0;
   }
+  startup.mark("mutex");
 
   g_hInstance = hInstance;
 
@@ -267,11 +390,44 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
   g_pConfig = &config;
 
   std::string configPath = Config::getDefaultConfigPath();
+  startup.mark("configPath");
+  bool saveDefaultConfig = false;
   if (!config.load(configPath)) {
     // Config file doesn't exist or has errors, use defaults
     config.loadDefaults();
+    saveDefaultConfig = true;
+  }
+  startup.mark("configLoad");
+
+  // There is no console: log to logFile, or beside the configuration in
+  // debug mode
+  Logger::Options logOptions;
+  logOptions.console = false;
+  logOptions.filePath = config.getLogFile();
+  if (logOptions.filePath.empty() && config.getDebugMode()) {
+    size_t slash = configPath.find_last_of("\\/");
+    logOptions.filePath =
+        (slash == std::string::npos ? "" : configPath.substr(0, slash + 1)) +
+        "escModKey.log";
+  }
+  logOptions.fileBytes = static_cast<uint64_t>(config.getLogFileSizeMB())
+                         << 20;
+  logOptions.maxFiles = config.getLogMaxFiles();
+  logOptions.level =
+      config.getDebugMode() ? LogLevel::Debug : LogLevel::Info;
+  if (!logOptions.filePath.empty() &&
+      Logger::instance().start(logOptions)) {
+    startup.mark("logOpen");
+  }
+
+  // Fast start: interception goes live before anything the user does not
+  // need to type (tray icon, default config file, notification)
+  bool fastStart = config.getFastStart();
+  if (saveDefaultConfig && !fastStart) {
     // Try to save default config
     config.save(configPath);
+    saveDefaultConfig = false;
+    startup.mark("configSave");
   }
 
   // Create and initialize fixer with config
@@ -291,8 +447,33 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
     return 1;
   }
 
-  // Disable console messages for GUI mode
-  fixer.setShowMessages(false);
+  // No console in GUI mode: fix messages only go to a log file
+  fixer.setShowMessages(Logger::instance().isRunning() &&
+                        config.getShowMessages());
+  startup.mark("initialize");
+
+  // From initialize() on the driver holds keyboard input until the worker
+  // receives it, so the worker start is when typing works again
+  HANDLE hThread = nullptr;
+  auto stopWorker = [&hThread]() {
+    g_running = false;
+    if (hThread) {
+      WaitForSingleObject(hThread, 5000);
+      CloseHandle(hThread);
+      hThread = nullptr;
+    }
+  };
+
+  if (fastStart) {
+    g_firstWaitDone = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+    hThread = CreateThread(nullptr, 0, WorkerThread, nullptr, 0, nullptr);
+    startup.markInterceptionLive("workerStart");
+    // Let the worker reach its first wait before competing with it
+    if (g_firstWaitDone) {
+      WaitForSingleObject(g_firstWaitDone, 1000);
+    }
+    startup.mark("firstWait");
+  }
 
   // Register window class
   WNDCLASSEX wc = {};
@@ -302,6 +483,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
   wc.lpszClassName = "ModifierKeyFixerClass";
 
   if (!RegisterClassEx(&wc)) {
+    stopWorker();
     MessageBoxA(nullptr, "Failed to register window class", "Error",
                 MB_OK | MB_ICONERROR);
     if (hMutex) {
@@ -310,11 +492,12 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
     return 1;
   }
 
-  // Create hidden window
+  // Create hidden window (adds the tray icon)
   g_hwnd = CreateWindowEx(0, "ModifierKeyFixerClass", "Modifier Key Auto-Fix",
                           0, 0, 0, 0, 0, nullptr, nullptr, hInstance, nullptr);
 
   if (!g_hwnd) {
+    stopWorker();
     MessageBoxA(nullptr, "Failed to create window", "Error",
                 MB_OK | MB_ICONERROR);
     if (hMutex) {
@@ -322,14 +505,31 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
     }
     return 1;
   }
+  g_trayReady = true;
+  startup.mark("trayIcon");
+
+  if (saveDefaultConfig) {
+    // Try to save default config
+    config.save(configPath);
+    startup.mark("configSave");
+  }
 
   // Show startup notification (if enabled in config)
   if (config.getNotifyOnStartup()) {
     ShowNotification("Started", "Modifier Key Auto-Fix is now running");
+    startup.mark("notification");
+  }
+
+  // Start event-loop tracing if configured
+  if (!config.getTraceFile().empty()) {
+    TraceWriter::instance().start(config.getTraceFile());
   }
 
   // Create worker thread
-  HANDLE hThread = CreateThread(nullptr, 0, WorkerThread, nullptr, 0, nullptr);
+  if (!fastStart) {
+    hThread = CreateThread(nullptr, 0, WorkerThread, nullptr, 0, nullptr);
+    startup.markInterceptionLive("workerStart");
+  }
 
   // Message loop
   MSG msg;
@@ -339,12 +539,16 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
   }
 
   // Cleanup
-  g_running = false;
-  if (hThread) {
-    WaitForSingleObject(hThread, 5000);
-    CloseHandle(hThread);
+  stopWorker();
+  if (g_firstWaitDone) {
+    CloseHandle(g_firstWaitDone);
+    g_firstWaitDone = nullptr;
   }
 
+  // Flush and close the trace (no-op if tracing is off)
+  TraceWriter::instance().stop();
+  Logger::instance().stop();
+
   // Release mutex
   if (hMutex) {
     CloseHandle(hMutex);
@@ -0,0 +1,232 @@
+#include "config.h"
+#include "fake_interception.h"
+#include "fake_win32.h"
+#include "latency_histogram.h"
+#include "load_generator.h"
+#include "modifier_key_fixer.h"
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+// Synthetic load generator (headless builds): drives the real processEvents()
+// path on the fake driver with configurable stroke storms and reports
+// throughput, latency, integrity and CPU cost. With --min-throughput,
+// --max-p99 or --max-cpu it doubles as a capacity regression gate.
+
+void printUsage() {
+  std::cout
+      << "Usage: escModKey_load [options]\n"
+      << "\n"
+      << "Load:\n"
+      << "  --profile <name>      typing, modifiers, typematic or scanner\n"
+      << "                        (default typing)\n"
+      << "  --rate <n>            Strokes per second per device, 0 = as fast\n"
+      << "                        as possible (default 1000)\n"
+      << "  --devices <n>         Keyboards sending at once, 1-10 (default 1)\n"
+      << "  --strokes <n>         Total strokes (default 100000)\n"
+      << "  --burst <n>           Strokes per burst (default 28 for scanner,\n"
+      << "                        else 1)\n"
+      << "  --burst-spacing <us>  Gap between strokes in a burst (default 0)\n"
+      << "  --seed <n>            Random seed (default 1)\n"
+      << "  --config <file>       Load key selection and threshold\n"
+      << "  --poll <ms>           processEvents wait timeout (default 50)\n"
+      << "\n"
+      << "Gate (exit code 1 if violated; lost, duplicated, reordered or\n"
+      << "altered strokes always fail):\n"
+      << "  --min-throughput <n>  Minimum forwarded strokes per second\n"
+      << "  --max-p99 <us>        Maximum p99 push-to-forward latency\n"
+      << "  --max-cpu <ns>        Maximum CPU time per stroke\n"
+      << "  --json <file>         Write the report as JSON\n";
+}
+
+bool writeJson(const std::string &path, const LoadOptions &options,
+               const LoadReport &report) {
+  std::ofstream out(path);
+  if (!out) {
+    return false;
+  }
+  auto summary = [](const LatencyHistogram::Summary &s) {
+    return "{\"p50_ns\": " + std::to_string(s.p50Ns) +
+           ", \"p99_ns\": " + std::to_string(s.p99Ns) +
+           ", \"p999_ns\": " + std::to_string(s.p999Ns) +
+           ", \"max_ns\": " + std::to_string(s.maxNs) +
+           ", \"mean_ns\": " + std::to_string(s.meanNs) + "}";
+  };
+  out << std::fixed << std::setprecision(1) << "{\n"
+      << "  \"profile\": \"" << loadProfileName(options.profile) << "\",\n"
+      << "  \"devices\": " << options.devices << ",\n"
+      << "  \"rate\": " << options.rate << ",\n"
+      << "  \"burst\": " << options.burstSize << ",\n"
+      << "  \"scheduled\": " << report.scheduled << ",\n"
+      << "  \"forwarded\": " << report.forwarded << ",\n"
+      << "  \"injected\": " << report.injected << ",\n"
+      << "  \"dropped\": " << report.dropped << ",\n"
+      << "  \"duplicated\": " << report.duplicated << ",\n"
+      << "  \"reordered\": " << report.reordered << ",\n"
+      << "  \"corrupted\": " << report.corrupted << ",\n"
+      << "  \"fixes\": " << report.fixes << ",\n"
+      << "  \"offered_rate\": " << report.offeredRate << ",\n"
+      << "  \"throughput\": " << report.throughput << ",\n"
+      << "  \"elapsed_s\": " << std::setprecision(3) << report.elapsedSeconds
+      << ",\n"
+      << "  \"max_producer_lag_ns\": " << report.maxProducerLagNs << ",\n"
+      << "  \"latency\": " << summary(report.latency) << ",\n"
+      << "  \"fixer_latency\": " << summary(report.fixerLatency) << ",\n"
+      << "  \"cpu_ns_per_stroke\": " << std::setprecision(1)
+      << report.cpuNsPerStroke << ",\n"
+      << "  \"cpu_utilisation\": " << std::setprecision(3)
+      << report.cpuUtilisation << "\n"
+      << "}\n";
+  return static_cast<bool>(out);
+}
+
+int main(int argc, char *argv[]) {
+  LoadOptions options;
+  std::string configPath;
+  std::string jsonPath;
+  int pollMs = 50;
+  double minThroughput = 0;
+  double maxP99Us = 0;
+  double maxCpuNs = 0;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--help" || arg == "-h") {
+      printUsage();
+      return 0;
+    } else if (arg == "--profile" && hasValue) {
+      if (!parseLoadProfile(argv[++i], options.profile)) {
+        std::cerr << "Unknown profile: " << argv[i] << std::endl;
+        return 1;
+      }
+    } else if (arg == "--rate" && hasValue) {
+      options.rate = std::atof(argv[++i]);
+    } else if (arg == "--devices" && hasValue) {
+      options.devices = std::atoi(argv[++i]);
+    } else if (arg == "--strokes" && hasValue) {
+      options.strokeCount = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--burst" && hasValue) {
+      options.burstSize = std::atoi(argv[++i]);
+    } else if (arg == "--burst-spacing" && hasValue) {
+      options.burstSpacingUs = std::atof(argv[++i]);
+    } else if (arg == "--seed" && hasValue) {
+      options.seed = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--config" && hasValue) {
+      configPath = argv[++i];
+    } else if (arg == "--poll" && hasValue) {
+      pollMs = std::atoi(argv[++i]);
+    } else if (arg == "--min-throughput" && hasValue) {
+      minThroughput = std::atof(argv[++i]);
+    } else if (arg == "--max-p99" && hasValue) {
+      maxP99Us = std::atof(argv[++i]);
+    } else if (arg == "--max-cpu" && hasValue) {
+      maxCpuNs = std::atof(argv[++i]);
+    } else if (arg == "--json" && hasValue) {
+      jsonPath = argv[++i];
+    } else {
+      std::cerr << "Unknown option: " << arg << std::endl;
+      printUsage();
+      return 1;
+    }
+  }
+  if (options.devices < 1 || options.devices > INTERCEPTION_MAX_KEYBOARD) {
+    std::cerr << "ERROR: --devices must be 1-" << INTERCEPTION_MAX_KEYBOARD
+              << std::endl;
+    return 1;
+  }
+
+  FakeInterception::reset();
+  FakeWin32::reset();
+
+  ModifierKeyFixer fixer;
+  fixer.setShowMessages(false);
+  bool initialized;
+  if (!configPath.empty()) {
+    Config config;
+    if (!config.load(configPath)) {
+      std::cerr << "ERROR: Failed to load config " << configPath << std::endl;
+      return 1;
+    }
+    config.setShowMessages(false);
+    config.setStageTimingLogIntervalMs(0);
+    initialized = fixer.initialize(config);
+  } else {
+    initialized = fixer.initialize();
+  }
+  if (!initialized) {
+    std::cerr << "ERROR: Failed to create driver context" << std::endl;
+    return 1;
+  }
+
+  std::vector<LoadStroke> schedule = generateLoad(options);
+  std::cout << "Load: " << schedule.size() << " strokes, "
+            << loadProfileName(options.profile) << ", " << options.devices
+            << " device(s) at ";
+  if (options.rate > 0) {
+    std::cout << options.rate << " strokes/s";
+  } else {
+    std::cout << "full speed";
+  }
+  std::cout << std::endl;
+
+  LoadReport report = runLoad(fixer, schedule, pollMs);
+
+  std::cout << std::fixed << std::setprecision(0);
+  std::cout << "\nLoad Summary:" << std::endl;
+  std::cout << "  Strokes:          " << report.pushed << " pushed, "
+            << report.forwarded << " forwarded (" << report.injected
+            << " injected by " << report.fixes << " fix(es))" << std::endl;
+  std::cout << "  Integrity:        " << report.dropped << " lost, "
+            << report.duplicated << " duplicated, " << report.reordered
+            << " reordered, " << report.corrupted << " altered" << std::endl;
+  std::cout << "  Throughput:       " << report.throughput << " strokes/s";
+  if (report.offeredRate > 0) {
+    std::cout << " (offered " << report.offeredRate << ")";
+  }
+  std::cout << std::endl;
+  std::cout << "  Elapsed:          " << std::setprecision(3)
+            << report.elapsedSeconds << " s" << std::endl;
+  std::cout << "  Latency:          " << formatLatencySummary(report.latency)
+            << "  (push to forward)" << std::endl;
+  std::cout << "  Fixer latency:    "
+            << formatLatencySummary(report.fixerLatency)
+            << "  (receive to forward)" << std::endl;
+  std::cout << "  CPU:              " << std::setprecision(0)
+            << report.cpuNsPerStroke << " ns/stroke, "
+            << report.cpuUtilisation * 100 << "% of one core" << std::endl;
+  if (options.rate > 0) {
+    std::cout << "  Producer lag:     "
+              << formatLatency(report.maxProducerLagNs) << " max"
+              << std::endl;
+  }
+
+  if (!jsonPath.empty() && !writeJson(jsonPath, options, report)) {
+    std::cerr << "ERROR: Failed to write " << jsonPath << std::endl;
+    return 1;
+  }
+
+  // Capacity gate
+  bool failed = false;
+  if (!report.intact()) {
+    std::cout << "FAIL: strokes lost, duplicated, reordered or altered"
+              << std::endl;
+    failed = true;
+  }
+  if (minThroughput > 0 && report.throughput < minThroughput) {
+    std::cout << "FAIL: throughput below " << minThroughput << " strokes/s"
+              << std::endl;
+    failed = true;
+  }
+  if (maxP99Us > 0 && report.latency.p99Ns > maxP99Us * 1000) {
+    std::cout << "FAIL: p99 latency above " << maxP99Us << " us" << std::endl;
+    failed = true;
+  }
+  if (maxCpuNs > 0 && report.cpuNsPerStroke > maxCpuNs) {
+    std::cout << "FAIL: CPU above " << maxCpuNs << " ns/stroke" << std::endl;
+    failed = true;
+  }
+  return failed ? 1 : 0;
+}
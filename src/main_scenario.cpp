@@ -0,0 +1,102 @@
+#include "scenario.h"
+#include "trace_format.h"
+#include "work_stealing_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Runs scenario files (*.scn) through the detector and fix logic under
+// virtual time, in parallel, and reports every failing check.
+
+void printUsage() {
+  std::cout
+      << "Usage: escModKey_scenario [options] <file.scn | directory ...>\n"
+      << "\n"
+      << "Runs scenarios (directories are searched recursively) and prints\n"
+      << "file:line: message for each one that fails. Exits with 1 if any\n"
+      << "fails. The language is described in include/scenario.h.\n"
+      << "\n"
+      << "Options:\n"
+      << "  --repeat <n>      Run every scenario n times (default 1)\n"
+      << "  --threads <n>     Worker threads (default: all cores)\n";
+}
+
+int main(int argc, char *argv[]) {
+  size_t repeat = 1;
+  size_t threads = 0;
+  std::vector<std::string> files;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--help" || arg == "-h") {
+      printUsage();
+      return 0;
+    } else if (arg == "--repeat" && hasValue) {
+      repeat = std::max<size_t>(std::strtoull(argv[++i], nullptr, 10), 1);
+    } else if (arg == "--threads" && hasValue) {
+      threads = static_cast<size_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+      std::cerr << "Unknown option: " << arg << std::endl;
+      printUsage();
+      return 1;
+    } else if (!TraceFormat::collectTraceFiles(arg, files, ".scn")) {
+      std::cerr << "ERROR: No such file or directory: " << arg << std::endl;
+      return 1;
+    }
+  }
+  if (files.empty()) {
+    printUsage();
+    return 1;
+  }
+
+  WorkStealingPool pool(threads);
+
+  // Each file is read and parsed once; repeated runs reuse the parse
+  auto start = std::chrono::steady_clock::now();
+  std::vector<ScenarioResult> results(files.size());
+  pool.run(files.size(), [&](size_t index, size_t) {
+    Scenario scenario;
+    std::string error;
+    if (!loadScenarioFile(files[index], scenario, error)) {
+      results[index].message = error;
+      return;
+    }
+    results[index] = runScenario(scenario);
+    for (size_t i = 1; i < repeat && results[index].passed; ++i) {
+      runScenario(scenario);
+    }
+  });
+  double elapsedSec = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+
+  size_t failed = 0;
+  uint64_t checks = 0;
+  for (size_t i = 0; i < files.size(); ++i) {
+    const ScenarioResult &result = results[i];
+    checks += result.checks;
+    if (result.passed) {
+      continue;
+    }
+    ++failed;
+    std::cout << files[i] << ":";
+    if (result.line > 0) {
+      std::cout << result.line << ":";
+    }
+    std::cout << " " << result.message << std::endl;
+  }
+
+  uint64_t runs = static_cast<uint64_t>(files.size()) * repeat;
+  std::cout << files.size() - failed << " passed, " << failed << " failed ("
+            << checks << " checks)" << std::endl;
+  std::cout << "Wall time: " << std::fixed << std::setprecision(3)
+            << elapsedSec << " s (" << pool.getWorkerCount() << " threads, "
+            << std::setprecision(0) << (elapsedSec > 0 ? runs / elapsedSec : 0)
+            << " scenarios/s)" << std::endl;
+  return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,247 @@
+#include "config.h"
+#include "simulator.h"
+#include "trace_format.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Headless simulation of the fixer: replays recorded traces (*.emkt) or
+// generated typing through the real detection and fix logic in virtual time.
+
+void printUsage() {
+  std::cout
+      << "Usage: escModKey_sim [options] [trace.emkt ...]\n"
+      << "\n"
+      << "Replays the given recorded traces, or a generated trace if none.\n"
+      << "\n"
+      << "Options:\n"
+      << "  --config <file>     Load key selection and threshold\n"
+      << "  --threshold <ms>    Stuck threshold (default 1000)\n"
+      << "  --adaptive          Learn per-key thresholds from benign "
+         "mismatches\n"
+      << "  --timer-fix         Release stuck keys at their deadline\n"
+      << "  --release-check <ms> Release a key whose key-up is not applied\n"
+      << "                      within ms at once\n"
+      << "  --lag <ms>          Virtual layer lag (default 1)\n"
+      << "  --jitter <ms>       Extra random virtual layer lag (default 0)\n"
+      << "  --drop <rate>       Probability a key-up is lost (default 0.001)\n"
+      << "  --drop-down <rate>  Probability a key-down is lost (default 0)\n"
+      << "  --lost-key-down <ms> Held this long without reaching the OS counts\n"
+      << "                      as a lost key-down (default 100)\n"
+      << "  --repair-key-down   Send lost key-downs again\n"
+      << "  --poll <ms>         processEvents wait timeout (default 50)\n"
+      << "  --seed <n>          Random seed (default 1)\n"
+      << "  --generate <n>      Strokes to generate (default 1000000)\n"
+      << "  --gap <ms>          Mean pause between generated presses\n"
+      << "  --chords <rate>     Share of generated presses that are chords\n"
+      << "  --save <file.emkt>  Write the generated trace\n"
+      << "  --quiet             Do not list individual fix decisions\n";
+}
+
+int main(int argc, char *argv[]) {
+  SimulationOptions options;
+  options.layer.dropKeyUpRate = 0.001;
+  TraceGeneratorOptions generator;
+  generator.strokeCount = 1000000;
+  std::vector<std::string> traceFiles;
+  std::string configPath;
+  std::string savePath;
+  int thresholdMs = -1;
+  bool adaptive = false;
+  bool timerFix = false;
+  int releaseCheckMs = -1;
+  int lostKeyDownMs = -1;
+  bool repairKeyDown = false;
+  bool quiet = false;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--help" || arg == "-h") {
+      printUsage();
+      return 0;
+    } else if (arg == "--quiet") {
+      quiet = true;
+    } else if (arg == "--adaptive") {
+      adaptive = true;
+    } else if (arg == "--timer-fix") {
+      timerFix = true;
+    } else if (arg == "--repair-key-down") {
+      repairKeyDown = true;
+    } else if (arg == "--lost-key-down" && hasValue) {
+      lostKeyDownMs = std::atoi(argv[++i]);
+    } else if (arg == "--drop-down" && hasValue) {
+      options.layer.dropKeyDownRate = std::atof(argv[++i]);
+    } else if (arg == "--release-check" && hasValue) {
+      releaseCheckMs = std::atoi(argv[++i]);
+    } else if (arg == "--config" && hasValue) {
+      configPath = argv[++i];
+    } else if (arg == "--threshold" && hasValue) {
+      thresholdMs = std::atoi(argv[++i]);
+    } else if (arg == "--lag" && hasValue) {
+      options.layer.lagMs = std::atof(argv[++i]);
+    } else if (arg == "--jitter" && hasValue) {
+      options.layer.lagJitterMs = std::atof(argv[++i]);
+    } else if (arg == "--drop" && hasValue) {
+      options.layer.dropKeyUpRate = std::atof(argv[++i]);
+    } else if (arg == "--poll" && hasValue) {
+      options.pollTimeoutMs = std::atoi(argv[++i]);
+    } else if (arg == "--seed" && hasValue) {
+      options.layer.seed = std::strtoull(argv[++i], nullptr, 10);
+      generator.seed = options.layer.seed;
+    } else if (arg == "--generate" && hasValue) {
+      generator.strokeCount = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--gap" && hasValue) {
+      generator.meanGapMs = std::atof(argv[++i]);
+    } else if (arg == "--chords" && hasValue) {
+      generator.chordRate = std::atof(argv[++i]);
+    } else if (arg == "--save" && hasValue) {
+      savePath = argv[++i];
+    } else if (arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+      std::cerr << "Unknown option: " << arg << std::endl;
+      printUsage();
+      return 1;
+    } else {
+      traceFiles.push_back(arg);
+    }
+  }
+
+  Simulator simulator(options);
+  if (!configPath.empty()) {
+    Config config;
+    if (!config.load(configPath)) {
+      std::cerr << "ERROR: Failed to load config " << configPath << std::endl;
+      return 1;
+    }
+    simulator.initialize(config);
+  } else {
+    simulator.initialize();
+  }
+  if (thresholdMs >= 0) {
+    simulator.setThreshold(thresholdMs);
+  }
+  if (adaptive) {
+    AdaptiveThresholdConfig settings = simulator.getLogic().getAdaptive();
+    settings.enabled = true;
+    simulator.setAdaptive(settings);
+  }
+  if (timerFix) {
+    simulator.setTimerFix(true);
+  }
+  if (releaseCheckMs >= 0) {
+    simulator.setReleaseCheck(releaseCheckMs);
+  }
+  if (lostKeyDownMs > 0) {
+    simulator.setLostKeyDownThreshold(lostKeyDownMs);
+  }
+  if (repairKeyDown) {
+    simulator.setRepairKeyDown(true);
+  }
+
+  // Collect the input strokes
+  std::vector<SimStroke> strokes;
+  if (traceFiles.empty()) {
+    strokes = generateTrace(generator, simulator.getPhysicalStates());
+    std::cout << "Generated " << strokes.size() << " strokes (seed "
+              << generator.seed << ")" << std::endl;
+
+    if (!savePath.empty()) {
+      TraceFormat::FileHeader header;
+      std::vector<TraceFormat::KeyInfo> keys;
+      for (const auto &key : simulator.getPhysicalStates().getKeys()) {
+        keys.push_back({key.id, key.scanCode, key.needsE0, 0});
+      }
+      TraceFormat::initHeader(header, keys, 0, 1, 0,
+                              simulator.getThreshold());
+      std::string error;
+      if (!TraceFormat::writeTraceFile(savePath, header,
+                                       strokesToRecords(strokes), &error)) {
+        std::cerr << "ERROR: " << error << std::endl;
+        return 1;
+      }
+      std::cout << "Trace saved to: " << savePath << std::endl;
+    }
+  } else {
+    for (const auto &path : traceFiles) {
+      TraceFormat::TraceFile trace;
+      std::string error;
+      if (!TraceFormat::readTraceFile(path, trace, &error)) {
+        std::cerr << "ERROR: " << path << ": " << error << std::endl;
+        return 1;
+      }
+      std::vector<SimStroke> segment = strokesFromTrace(trace);
+      strokes.insert(strokes.end(), segment.begin(), segment.end());
+      std::cout << "Loaded " << segment.size() << " strokes from " << path
+                << std::endl;
+    }
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  simulator.run(strokes);
+  double elapsedSec = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+
+  const SimulationReport &report = simulator.getReport();
+  const FixLogic &logic = simulator.getLogic();
+
+  if (!quiet) {
+    std::cout << "\nFix Decisions:" << std::endl;
+    for (const auto &decision : report.decisions) {
+      std::cout << "  t=" << std::fixed << std::setprecision(3)
+                << decision.timeNs / 1e9 << "s " << std::setw(8) << std::left
+                << logic.getKeyId(decision.keyIndex) << std::right
+                << " mismatch=" << decision.mismatchMs << "ms trigger=0x"
+                << std::hex << decision.triggerCode << std::dec
+                << (decision.causedByDrop ? "" : " [FALSE]") << std::endl;
+    }
+  }
+
+  std::cout << "\nSimulation Summary:" << std::endl;
+  std::cout << "  Virtual time:     " << std::fixed << std::setprecision(1)
+            << report.endTimeNs / 1e9 << " s" << std::endl;
+  std::cout << "  Strokes:          " << report.strokes << std::endl;
+  std::cout << "  Iterations:       " << report.iterations << std::endl;
+  std::cout << "  Lost key-ups:     " << report.droppedKeyUps << std::endl;
+  std::cout << "  Stuck detections: " << report.stuckEvents << std::endl;
+  std::cout << "  Fixes:            " << report.fixes << " ("
+            << report.falseFixes << " false)" << std::endl;
+  if (report.timerFixes > 0) {
+    std::cout << "  Timer fixes:      " << report.timerFixes << std::endl;
+  }
+  if (report.releaseCheckFixes > 0) {
+    std::cout << "  Release checks:   " << report.releaseCheckFixes
+              << std::endl;
+  }
+  std::cout << "  Self-healed:      " << report.selfHealed << std::endl;
+  std::cout << "  Still stuck:      " << simulator.countStuckKeys()
+            << std::endl;
+  std::cout << "  Stuck time:       " << std::setprecision(3)
+            << report.stuckNs / 1e9 << " s" << std::endl;
+  if (report.droppedKeyDowns > 0 || report.lostKeyDowns > 0) {
+    std::cout << "  Lost key-downs:   " << report.droppedKeyDowns << " ("
+              << report.lostKeyDowns << " detected, " << report.keyDownRepairs
+              << " repaired)" << std::endl;
+    std::cout << "  Missing time:     " << report.missingNs / 1e9 << " s"
+              << std::endl;
+  }
+  if (logic.getAdaptive().enabled) {
+    std::cout << "  Learned (ms):    ";
+    for (size_t i = 0; i < logic.getKeyCount(); ++i) {
+      std::cout << " " << logic.getKeyId(i) << "="
+                << logic.getLearnedThreshold(i) << "/"
+                << logic.getBenignMismatchCount(i);
+    }
+    std::cout << std::endl;
+  }
+  std::cout << "  Wall time:        " << elapsedSec << " s ("
+            << std::setprecision(0)
+            << (elapsedSec > 0 ? report.strokes / elapsedSec : 0)
+            << " strokes/s)" << std::endl;
+
+  return 0;
+}
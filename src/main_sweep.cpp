@@ -0,0 +1,256 @@
+#include "config.h"
+#include "policy_sweep.h"
+#include "simulator.h"
+#include "trace_format.h"
+#include "work_stealing_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Parameter sweep of fix policies: replays recorded traces (*.emkt) or
+// generated typing under every combination of threshold, trigger rule and
+// per-key thresholds, in parallel, and reports false-fix and missed-stuck
+// rates for each.
+
+void printUsage() {
+  std::cout
+      << "Usage: escModKey_sweep [options] [trace.emkt | directory ...]\n"
+      << "\n"
+      << "Replays the given traces (directories are searched recursively),\n"
+      << "or generated traces if none, under every policy of the grid.\n"
+      << "\n"
+      << "Grid:\n"
+      << "  --thresholds <ms,...>   Stuck thresholds (default "
+         "500,750,1000,1500,2000)\n"
+      << "  --triggers <list>       Fix triggers: idle, any, other "
+         "(default idle)\n"
+      << "  --key <id>=<ms,...>     Thresholds for one key, 0 = global;\n"
+      << "                          repeatable, each is a grid dimension\n"
+      << "\n"
+      << "Simulation:\n"
+      << "  --config <file>         Load key selection\n"
+      << "  --lag <ms>              Virtual layer lag (default 1)\n"
+      << "  --jitter <ms>           Extra random virtual layer lag "
+         "(default 0)\n"
+      << "  --drop <rate>           Probability a key-up is lost "
+         "(default 0.001)\n"
+      << "  --poll <ms>             processEvents wait timeout (default 50)\n"
+      << "  --seed <n>              Random seed (default 1)\n"
+      << "  --generate <n>          Strokes per generated trace "
+         "(default 200000)\n"
+      << "  --traces <n>            Generated traces (default 8)\n"
+      << "  --threads <n>           Worker threads (default: all cores)\n"
+      << "  --csv                   Print the results as CSV\n";
+}
+
+bool parseIntList(const std::string &text, std::vector<int> &values) {
+  std::istringstream in(text);
+  std::string item;
+  while (std::getline(in, item, ',')) {
+    char *end = nullptr;
+    long value = std::strtol(item.c_str(), &end, 10);
+    if (item.empty() || *end != '\0' || value < 0) {
+      return false;
+    }
+    values.push_back(static_cast<int>(value));
+  }
+  return !values.empty();
+}
+
+int main(int argc, char *argv[]) {
+  SimulationOptions options;
+  options.layer.dropKeyUpRate = 0.001;
+  TraceGeneratorOptions generator;
+  generator.strokeCount = 200000;
+  size_t generatedTraces = 8;
+  std::vector<int> thresholds;
+  std::vector<FixTrigger> triggers;
+  std::vector<std::pair<std::string, std::vector<int>>> keyThresholds;
+  std::vector<std::string> files;
+  std::string configPath;
+  size_t threads = 0;
+  bool csv = false;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--help" || arg == "-h") {
+      printUsage();
+      return 0;
+    } else if (arg == "--csv") {
+      csv = true;
+    } else if (arg == "--thresholds" && hasValue) {
+      if (!parseIntList(argv[++i], thresholds)) {
+        std::cerr << "ERROR: Invalid threshold list: " << argv[i] << std::endl;
+        return 1;
+      }
+    } else if (arg == "--triggers" && hasValue) {
+      std::istringstream in(argv[++i]);
+      std::string name;
+      while (std::getline(in, name, ',')) {
+        FixTrigger trigger;
+        if (!parseFixTrigger(name, trigger)) {
+          std::cerr << "ERROR: Unknown trigger: " << name << std::endl;
+          return 1;
+        }
+        triggers.push_back(trigger);
+      }
+    } else if (arg == "--key" && hasValue) {
+      std::string spec = argv[++i];
+      size_t equals = spec.find('=');
+      std::vector<int> values;
+      if (equals == std::string::npos || equals == 0 ||
+          !parseIntList(spec.substr(equals + 1), values)) {
+        std::cerr << "ERROR: Invalid key thresholds: " << spec << std::endl;
+        return 1;
+      }
+      keyThresholds.emplace_back(spec.substr(0, equals), values);
+    } else if (arg == "--config" && hasValue) {
+      configPath = argv[++i];
+    } else if (arg == "--lag" && hasValue) {
+      options.layer.lagMs = std::atof(argv[++i]);
+    } else if (arg == "--jitter" && hasValue) {
+      options.layer.lagJitterMs = std::atof(argv[++i]);
+    } else if (arg == "--drop" && hasValue) {
+      options.layer.dropKeyUpRate = std::atof(argv[++i]);
+    } else if (arg == "--poll" && hasValue) {
+      options.pollTimeoutMs = std::atoi(argv[++i]);
+    } else if (arg == "--seed" && hasValue) {
+      options.layer.seed = std::strtoull(argv[++i], nullptr, 10);
+      generator.seed = options.layer.seed;
+    } else if (arg == "--generate" && hasValue) {
+      generator.strokeCount = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--traces" && hasValue) {
+      generatedTraces =
+          std::max<size_t>(std::strtoul(argv[++i], nullptr, 10), 1);
+    } else if (arg == "--threads" && hasValue) {
+      threads = static_cast<size_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+      std::cerr << "Unknown option: " << arg << std::endl;
+      printUsage();
+      return 1;
+    } else if (!TraceFormat::collectTraceFiles(arg, files)) {
+      std::cerr << "ERROR: No such file or directory: " << arg << std::endl;
+      return 1;
+    }
+  }
+  if (thresholds.empty()) {
+    thresholds = {500, 750, 1000, 1500, 2000};
+  }
+  if (triggers.empty()) {
+    triggers.push_back(FixTrigger::IdleKeyDown);
+  }
+
+  Config config;
+  if (!configPath.empty() && !config.load(configPath)) {
+    std::cerr << "ERROR: Failed to load config " << configPath << std::endl;
+    return 1;
+  }
+  const Config *keyConfig = configPath.empty() ? nullptr : &config;
+
+  // Per-key overrides must name monitored keys
+  Simulator probe(options);
+  if (keyConfig) {
+    probe.initialize(*keyConfig);
+  } else {
+    probe.initialize();
+  }
+  for (const auto &key : keyThresholds) {
+    if (!probe.setKeyThreshold(key.first, 0)) {
+      std::cerr << "ERROR: Key is not monitored: " << key.first << std::endl;
+      return 1;
+    }
+  }
+
+  WorkStealingPool pool(threads);
+
+  // Load every trace's strokes once; all policies replay the same input
+  std::vector<std::vector<SimStroke>> traces;
+  if (files.empty()) {
+    traces.resize(generatedTraces);
+    pool.run(traces.size(), [&](size_t index, size_t) {
+      TraceGeneratorOptions traceGenerator = generator;
+      traceGenerator.seed = generator.seed + index;
+      traces[index] = generateTrace(traceGenerator, probe.getPhysicalStates());
+    });
+  } else {
+    traces.resize(files.size());
+    std::vector<std::string> errors(files.size());
+    pool.run(files.size(), [&](size_t index, size_t) {
+      TraceFormat::TraceFile trace;
+      if (TraceFormat::readTraceFile(files[index], trace, &errors[index])) {
+        traces[index] = strokesFromTrace(trace);
+      }
+    });
+    for (size_t i = 0; i < files.size(); ++i) {
+      if (!errors[i].empty()) {
+        std::cerr << "ERROR: " << files[i] << ": " << errors[i] << std::endl;
+        return 1;
+      }
+    }
+  }
+
+  std::vector<SweepPolicy> grid =
+      buildSweepGrid(thresholds, triggers, keyThresholds);
+  auto start = std::chrono::steady_clock::now();
+  std::vector<SweepResult> results =
+      runSweep(grid, traces, options, keyConfig, pool);
+  double elapsedSec = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+
+  if (csv) {
+    std::cout << "policy,fixes,false_fixes,false_fix_rate,false_fixes_per_h,"
+                 "lost_key_ups,missed_stuck,missed_stuck_rate,stuck_s"
+              << std::endl;
+    for (size_t i = 0; i < grid.size(); ++i) {
+      const SweepResult &result = results[i];
+      std::cout << grid[i].describe() << "," << result.fixes << ","
+                << result.falseFixes << "," << result.falseFixRate() << ","
+                << result.falseFixesPerHour() << "," << result.droppedKeyUps
+                << "," << result.missedStuck() << ","
+                << result.missedStuckRate() << "," << result.stuckNs / 1e9
+                << std::endl;
+    }
+    return 0;
+  }
+
+  uint64_t strokes = 0;
+  for (const auto &trace : traces) {
+    strokes += trace.size();
+  }
+  std::cout << traces.size() << " traces, " << strokes << " strokes, "
+            << grid.size() << " policies" << std::endl;
+  if (!results.empty()) {
+    std::cout << "Virtual time: " << std::fixed << std::setprecision(1)
+              << results[0].virtualNs / 3600e9 << " h per policy, "
+              << results[0].droppedKeyUps << " lost key-ups" << std::endl;
+  }
+
+  std::cout << "\n" << std::left << std::setw(32) << "Policy" << std::right
+            << std::setw(8) << "Fixes" << std::setw(8) << "False"
+            << std::setw(9) << "False%" << std::setw(9) << "False/h"
+            << std::setw(8) << "Missed" << std::setw(9) << "Missed%"
+            << std::setw(10) << "Stuck s" << std::endl;
+  for (size_t i = 0; i < grid.size(); ++i) {
+    const SweepResult &result = results[i];
+    std::cout << std::left << std::setw(32) << grid[i].describe()
+              << std::right << std::setw(8) << result.fixes << std::setw(8)
+              << result.falseFixes << std::fixed << std::setprecision(2)
+              << std::setw(9) << result.falseFixRate() * 100 << std::setw(9)
+              << result.falseFixesPerHour() << std::setw(8)
+              << result.missedStuck() << std::setw(9)
+              << result.missedStuckRate() * 100 << std::setprecision(1)
+              << std::setw(10) << result.stuckNs / 1e9 << std::endl;
+  }
+
+  std::cout << "\nWall time: " << std::setprecision(3) << elapsedSec << " s ("
+            << pool.getWorkerCount() << " threads, " << pool.getStealCount()
+            << " steals)" << std::endl;
+  return 0;
+}
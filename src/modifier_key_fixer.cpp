@@ -1,170 +1,154 @@
 #include "modifier_key_fixer.h"
-#include <Windows.h>
-#include <iostream>
 
-// MismatchTracker implementation
-void MismatchTracker::reset() { isMismatched = false; }
+// Production event loop, compiled once here
+template class FixerCore<InterceptionInput, VirtualKeyDetector, IterationClock,
+                         FixerSink>;
 
-void MismatchTracker::start() {
-  if (!isMismatched) {
-    isMismatched = true;
-    startTime = std::chrono::steady_clock::now();
+// FixerSink implementation (cold paths: fixes and tracker transitions)
+void FixerSink::fixTriggered(InterceptionDevice, const InterceptionKeyStroke &) {
+  if (showMessages_) {
+    Log::info("[Auto-Fix Triggered]");
   }
 }
 
-int MismatchTracker::getDurationMs() const {
-  if (!isMismatched)
-    return 0;
-  auto now = std::chrono::steady_clock::now();
-  auto duration =
-      std::chrono::duration_cast<std::chrono::milliseconds>(now - startTime);
-  return static_cast<int>(duration.count());
-}
-
-bool MismatchTracker::isStuck(int thresholdMs) const {
-  return isMismatched && getDurationMs() >= thresholdMs;
-}
-
-// ModifierMismatchTrackers implementation
-ModifierMismatchTrackers::ModifierMismatchTrackers() {
-  // Empty constructor, will be initialized by initializeForKeys
-}
-
-void ModifierMismatchTrackers::initializeForKeys(
-    const std::vector<std::string> &keyIds) {
-  trackers_.clear();
-  for (const auto &keyId : keyIds) {
-    trackers_[keyId] = MismatchTracker();
+void FixerSink::timerFixTriggered(InterceptionDevice) {
+  if (showMessages_) {
+    Log::info("[Auto-Fix Triggered] (timer)");
   }
 }
 
-MismatchTracker *
-ModifierMismatchTrackers::getTracker(const std::string &keyId) {
-  auto it = trackers_.find(keyId);
-  return (it != trackers_.end()) ? &it->second : nullptr;
-}
-
-const MismatchTracker *
-ModifierMismatchTrackers::getTracker(const std::string &keyId) const {
-  auto it = trackers_.find(keyId);
-  return (it != trackers_.end()) ? &it->second : nullptr;
-}
-
-bool ModifierMismatchTrackers::hasAnyStuck(int thresholdMs) const {
-  for (const auto &pair : trackers_) {
-    if (pair.second.isStuck(thresholdMs)) {
-      return true;
-    }
+void FixerSink::releaseDropped(InterceptionDevice) {
+  if (showMessages_) {
+    Log::info("[Auto-Fix Triggered] (key-up not delivered)");
   }
-  return false;
-}
-
-// Backward compatibility methods
-const MismatchTracker &ModifierMismatchTrackers::lctrl() const {
-  const MismatchTracker *tracker = getTracker("lctrl");
-  return tracker ? *tracker : emptyTracker_;
-}
-
-const MismatchTracker &ModifierMismatchTrackers::rctrl() const {
-  const MismatchTracker *tracker = getTracker("rctrl");
-  return tracker ? *tracker : emptyTracker_;
-}
-
-const MismatchTracker &ModifierMismatchTrackers::lshift() const {
-  const MismatchTracker *tracker = getTracker("lshift");
-  return tracker ? *tracker : emptyTracker_;
-}
-
-const MismatchTracker &ModifierMismatchTrackers::rshift() const {
-  const MismatchTracker *tracker = getTracker("rshift");
-  return tracker ? *tracker : emptyTracker_;
-}
-
-const MismatchTracker &ModifierMismatchTrackers::lalt() const {
-  const MismatchTracker *tracker = getTracker("lalt");
-  return tracker ? *tracker : emptyTracker_;
 }
 
-const MismatchTracker &ModifierMismatchTrackers::ralt() const {
-  const MismatchTracker *tracker = getTracker("ralt");
-  return tracker ? *tracker : emptyTracker_;
-}
-
-const MismatchTracker &ModifierMismatchTrackers::lwin() const {
-  const MismatchTracker *tracker = getTracker("lwin");
-  return tracker ? *tracker : emptyTracker_;
+void FixerSink::keyDownLost(InterceptionDevice, size_t, const KeyState &key,
+                            int missingMs, bool repaired) {
+  if (Trace::enabled()) {
+    Trace::instant("keyDownLost", "missingMs", missingMs, key.id);
+  }
+  if (showMessages_) {
+    Log::info(repaired ? "[Lost Key-Down] {s} after {}ms, key-down sent again"
+                       : "[Lost Key-Down] {s} after {}ms",
+              key.name, missingMs);
+  }
 }
 
-const MismatchTracker &ModifierMismatchTrackers::rwin() const {
-  const MismatchTracker *tracker = getTracker("rwin");
-  return tracker ? *tracker : emptyTracker_;
-}
+void FixerSink::keyFixed(InterceptionDevice device, size_t keyIndex,
+                         const KeyState &key, int mismatchMs) {
+  if (recorder_->isActive()) {
+    recorder_->recordFix(
+        static_cast<uint8_t>(device), static_cast<uint8_t>(keyIndex),
+        key.scanCode,
+        INTERCEPTION_KEY_UP | (key.needsE0 ? INTERCEPTION_KEY_E0 : 0),
+        mismatchMs);
+  }
+  if (flight_->isActive()) {
+    flight_->recordFix(
+        static_cast<uint8_t>(device), static_cast<uint8_t>(keyIndex),
+        key.scanCode,
+        INTERCEPTION_KEY_UP | (key.needsE0 ? INTERCEPTION_KEY_E0 : 0),
+        static_cast<uint32_t>(mismatchMs));
+  }
+  if (shadow_->isActive()) {
+    shadow_->recordLiveFix(keyIndex);
+  }
 
-// FixStatistics implementation
-FixStatistics::FixStatistics() : totalFixes_(0) {
-  // Empty constructor, will be initialized by initializeForKeys
-}
+  if (Trace::enabled()) {
+    Trace::instant("fixInjected", "mismatchMs", mismatchMs, key.id);
+  }
 
-void FixStatistics::initializeForKeys(const std::vector<std::string> &keyIds) {
-  fixes_.clear();
-  totalFixes_ = 0;
-  for (const auto &keyId : keyIds) {
-    fixes_[keyId] = 0;
+  if (showMessages_) {
+    Log::info("  [Fixed] {s}", key.name);
+  } else {
+    Log::debug("fixed {s} after {}ms", key.id, mismatchMs);
   }
 }
 
-void FixStatistics::incrementFix(const std::string &keyId) {
-  totalFixes_++;
-  auto it = fixes_.find(keyId);
-  if (it != fixes_.end()) {
-    it->second++;
-  } else {
-    fixes_[keyId] = 1;
+void FixerSink::fixCompleted(int fixedCount) {
+  if (showMessages_ && fixedCount > 0) {
+    Log::info("[Auto-Fix] Fixed {} key(s)", fixedCount);
+  }
+  // Keep the history that led up to the fix
+  if (fixedCount > 0 && flight_->isActive()) {
+    flight_->dump("fix");
   }
 }
 
-int FixStatistics::getFixCount(const std::string &keyId) const {
-  auto it = fixes_.find(keyId);
-  return (it != fixes_.end()) ? it->second : 0;
+void FixerSink::fixVerified(const KeyState &key, bool released) {
+  Trace::instant("fixVerified", "released", released ? 1 : 0, key.id);
+  Log::debug(released ? "fix of {s} reached the virtual state"
+                      : "fix of {s} did not reach the virtual state",
+             key.id);
 }
 
-void FixStatistics::reset() {
-  totalFixes_ = 0;
-  for (auto &pair : fixes_) {
-    pair.second = 0;
+void FixerSink::trackerChanged(const TrackerEvent &event, const KeyState &key) {
+  uint8_t keyIndex = static_cast<uint8_t>(event.keyIndex);
+  if (flight_->isActive()) {
+    TraceFormat::TrackerTransition what = TraceFormat::kTrackerReset;
+    if (event.change == TrackerChange::MismatchStart) {
+      what = TraceFormat::kTrackerMismatchStart;
+    } else if (event.change == TrackerChange::Stuck) {
+      what = TraceFormat::kTrackerStuck;
+    }
+    flight_->recordTracker(keyIndex, what,
+                           static_cast<uint32_t>(event.mismatchMs));
+  }
+  switch (event.change) {
+  case TrackerChange::MismatchStart:
+    if (Trace::enabled()) {
+      Trace::instant("mismatchStart", nullptr, 0, key.id);
+    }
+    if (recorder_->isActive()) {
+      recorder_->recordTracker(keyIndex, TraceFormat::kTrackerMismatchStart, 0);
+    }
+    Log::debug("mismatch start {s}", key.id);
+    break;
+  case TrackerChange::Stuck:
+    if (Trace::enabled()) {
+      Trace::instant("stuck", "mismatchMs", event.mismatchMs, key.id);
+    }
+    if (recorder_->isActive()) {
+      recorder_->recordTracker(keyIndex, TraceFormat::kTrackerStuck,
+                               event.mismatchMs);
+    }
+    Log::debug("stuck {s} after {}ms", key.id, event.mismatchMs);
+    break;
+  case TrackerChange::Reset:
+    if (recorder_->isActive()) {
+      recorder_->recordTracker(keyIndex, TraceFormat::kTrackerReset,
+                               event.mismatchMs);
+    }
+    Log::debug("mismatch end {s} after {}ms", key.id, event.mismatchMs);
+    break;
   }
 }
 
-// Backward compatibility methods
-int FixStatistics::lctrlFixes() const { return getFixCount("lctrl"); }
-int FixStatistics::rctrlFixes() const { return getFixCount("rctrl"); }
-int FixStatistics::lshiftFixes() const { return getFixCount("lshift"); }
-int FixStatistics::rshiftFixes() const { return getFixCount("rshift"); }
-int FixStatistics::laltFixes() const { return getFixCount("lalt"); }
-int FixStatistics::raltFixes() const { return getFixCount("ralt"); }
-int FixStatistics::lwinFixes() const { return getFixCount("lwin"); }
-int FixStatistics::rwinFixes() const { return getFixCount("rwin"); }
-
 // ModifierKeyFixer implementation
 ModifierKeyFixer::ModifierKeyFixer()
-    : context_(nullptr), thresholdMs_(1000), showMessages_(true),
-      paused_(false) {}
+    : ModifierKeyFixer(SteadyClock::instance()) {}
+
+ModifierKeyFixer::ModifierKeyFixer(const Clock &clock)
+    : core_(InterceptionInput(), VirtualKeyDetector(), IterationClock(clock),
+            FixerSink(stageTimers_, recorder_, flight_, shadow_)),
+      stageLogIntervalMs_(0) {
+  // Trackers queried from outside (e.g. for display) see iteration time
+  core_.logic().setClock(&core_.clock());
+}
 
 ModifierKeyFixer::~ModifierKeyFixer() { cleanup(); }
 
 bool ModifierKeyFixer::initializeCommon() {
-  // Create Interception context
-  context_ = interception_create_context();
-
-  if (!context_) {
+  // Create Interception context listening for all keyboard events
+  if (!core_.input().open()) {
     return false;
   }
 
-  // Set filter to listen for all keyboard events
-  interception_set_filter(
-      context_, interception_is_keyboard,
-      INTERCEPTION_FILTER_KEY_DOWN | INTERCEPTION_FILTER_KEY_UP |
-          INTERCEPTION_FILTER_KEY_E0 | INTERCEPTION_FILTER_KEY_E1);
+#if ESCMODKEY_LATENCY_STATS
+  // Calibrate the tick source now rather than on the first stroke
+  CycleClock::calibrate();
+#endif
 
   return true;
 }
@@ -174,17 +158,8 @@ bool ModifierKeyFixer::initialize() {
     return false;
   }
 
-  // Initialize detectors with default keys
-  physicalDetector_.initialize();
-  virtualDetector_.initialize();
-
-  // Initialize trackers and statistics based on monitored keys
-  std::vector<std::string> keyIds;
-  for (const auto &key : physicalDetector_.getStates().getKeys()) {
-    keyIds.push_back(key.id);
-  }
-  mismatchTrackers_.initializeForKeys(keyIds);
-  stats_.initializeForKeys(keyIds);
+  // Initialize detectors, trackers and statistics with default keys
+  core_.initialize();
 
   return true;
 }
@@ -194,214 +169,158 @@ bool ModifierKeyFixer::initialize(const Config &config) {
     return false;
   }
 
-  // Initialize detectors with full configuration including key mappings
-  physicalDetector_.initializeWithConfig(
-      config.getMonitorCtrl(), config.getMonitorShift(), config.getMonitorAlt(),
-      config.getMonitorWin(), config.getDisabledKeys(), config.getCustomKeys(),
-      config.getKeyMappings());
-  virtualDetector_.initializeWithConfig(
-      config.getMonitorCtrl(), config.getMonitorShift(), config.getMonitorAlt(),
-      config.getMonitorWin(), config.getDisabledKeys(), config.getCustomKeys());
-
-  // Initialize trackers and statistics based on monitored keys
-  std::vector<std::string> keyIds;
-  for (const auto &key : physicalDetector_.getStates().getKeys()) {
-    keyIds.push_back(key.id);
-  }
-  mismatchTrackers_.initializeForKeys(keyIds);
-  stats_.initializeForKeys(keyIds);
+  // Initialize detectors with full configuration including key mappings,
+  // then trackers and statistics based on monitored keys
+  core_.initialize(config);
 
   // Apply other configuration settings
   applyConfig(config);
 
-  return true;
-}
+  startRecording(config);
+  startFlightRecorder(config);
+  startShadowPolicies(config);
 
-void ModifierKeyFixer::applyConfig(const Config &config) {
-  thresholdMs_ = config.getThresholdMs();
-  showMessages_ = config.getShowMessages();
+  return true;
 }
 
-void ModifierKeyFixer::cleanup() {
-  if (context_) {
-    interception_destroy_context(context_);
-    context_ = nullptr;
+std::vector<TraceFormat::KeyInfo> ModifierKeyFixer::traceKeys() const {
+  // Key table in physical order; bit i of recorded masks is key i
+  std::vector<TraceFormat::KeyInfo> keys;
+  for (const auto &key : core_.getPhysicalStates().getKeys()) {
+    const VirtualKeyState *virtKey =
+        core_.getVirtualStates().findKeyById(key.id);
+    keys.push_back({key.id, key.scanCode, key.needsE0,
+                    virtKey ? virtKey->vkCode : 0});
   }
+  return keys;
 }
 
-bool ModifierKeyFixer::processEvents(int timeoutMs) {
-  if (!context_) {
-    Sleep(timeoutMs);
-    return true;
-  }
-
-  InterceptionDevice device =
-      interception_wait_with_timeout(context_, timeoutMs);
-
-  if (device > 0) {
-    if (interception_is_keyboard(device)) {
-      InterceptionKeyStroke stroke;
-
-      if (interception_receive(context_, device, (InterceptionStroke *)&stroke,
-                               1) > 0) {
-
-        // If paused, just forward the key and don't process
-        if (paused_) {
-          interception_send(context_, device, (InterceptionStroke *)&stroke, 1);
-        } else {
-          // Check for fix trigger (before updating physical state)
-          if (shouldCheckForFix(stroke)) {
-            if (showMessages_) {
-              std::cout << "\n[Auto-Fix Triggered]" << std::endl;
-            }
-
-            int fixedCount = fixStuckKeys(device);
-
-            if (showMessages_ && fixedCount > 0) {
-              std::cout << "[Auto-Fix] Fixed " << fixedCount << " key(s)"
-                        << std::endl;
-            }
-          }
-
-          // Update physical key state
-          physicalDetector_.processKeyStroke(stroke);
-
-          // Forward key event
-          interception_send(context_, device, (InterceptionStroke *)&stroke, 1);
-        }
-      }
-    }
+void ModifierKeyFixer::startRecording(const Config &config) {
+  if (config.getRecordFile().empty()) {
+    return;
   }
 
-  // Always update virtual state
-  virtualDetector_.update();
+  std::vector<TraceFormat::KeyInfo> keys = traceKeys();
 
-  // Update mismatch trackers
-  updateMismatchTrackers();
+  StrokeRecorder::Options options;
+  options.basePath = config.getRecordFile();
+  options.segmentBytes =
+      static_cast<uint64_t>(config.getRecordFileSizeMB()) << 20;
+  options.maxSegments = config.getRecordMaxFiles();
 
-  return true;
+  if (recorder_.start(options, keys, core_.getThreshold())) {
+    if (getShowMessages()) {
+      Log::info("Recording strokes to: {s}", recorder_.getCurrentPath());
+    }
+  } else {
+    Log::warning("Failed to create record file {s}", config.getRecordFile());
+  }
 }
 
-const ModifierKeyStates &ModifierKeyFixer::getPhysicalStates() const {
-  return physicalDetector_.getStates();
-}
+void ModifierKeyFixer::startFlightRecorder(const Config &config) {
+  if (config.getFlightRecorderEvents() <= 0) {
+    return;
+  }
 
-const VirtualKeyStates &ModifierKeyFixer::getVirtualStates() const {
-  return virtualDetector_.getStates();
+  FlightRecorder::Options options;
+  options.directory = config.getFlightRecorderDir();
+  options.capacity = static_cast<size_t>(config.getFlightRecorderEvents());
+  options.maxDumps = config.getFlightRecorderMaxDumps();
+  flight_.start(options, traceKeys(), core_.getThreshold());
 }
 
-const ModifierMismatchTrackers &ModifierKeyFixer::getMismatchTrackers() const {
-  return mismatchTrackers_;
-}
-
-const FixStatistics &ModifierKeyFixer::getStatistics() const { return stats_; }
-
-void ModifierKeyFixer::pause() { paused_ = true; }
-
-void ModifierKeyFixer::resume() { paused_ = false; }
-
-void ModifierKeyFixer::updateMismatchTrackers() {
-  const auto &physical = physicalDetector_.getStates();
-  const auto &virtual_states = virtualDetector_.getStates();
-
-  // Iterate through all physical keys
-  for (const auto &physKey : physical.getKeys()) {
-    // Find corresponding virtual key
-    const VirtualKeyState *virtKey = virtual_states.findKeyById(physKey.id);
-    if (!virtKey) {
-      continue;
-    }
-
-    // Get tracker for this key
-    MismatchTracker *tracker = mismatchTrackers_.getTracker(physKey.id);
-    if (!tracker) {
-      continue;
-    }
-
-    // Check mismatch: physical released but virtual pressed
-    if (!physKey.pressed && virtKey->pressed) {
-      tracker->start();
+void ModifierKeyFixer::startShadowPolicies(const Config &config) {
+  std::vector<ShadowPolicy> policies;
+  for (const auto &text : config.getShadowPolicies()) {
+    ShadowPolicy policy;
+    if (ShadowPolicy::parse(text, policy)) {
+      policies.push_back(policy);
     } else {
-      tracker->reset();
+      Log::warning("Ignoring invalid shadow policy '{s}'", text);
     }
   }
-}
-
-bool ModifierKeyFixer::shouldCheckForFix(const InterceptionKeyStroke &stroke) {
-  // Only trigger on key down
-  if (stroke.state & INTERCEPTION_KEY_UP) {
-    return false;
-  }
-
-  // Check if any key is stuck
-  if (!mismatchTrackers_.hasAnyStuck(thresholdMs_)) {
-    return false;
+  if (policies.empty()) {
+    return;
   }
 
-  // Check if there are other physical keys pressed
-  if (hasOtherPhysicalKeyPressed(stroke)) {
-    return false;
+  // Stamped with the iteration clock the live decisions use
+  shadow_.start(policies, core_.getPhysicalStates(), core_.getVirtualStates(),
+                core_.clock());
+  if (getShowMessages()) {
+    Log::info("Evaluating {} shadow fix policies", policies.size());
   }
+}
 
-  return true;
+void ModifierKeyFixer::applyConfig(const Config &config) {
+  core_.applyFixPolicy(config);
+  setShowMessages(config.getShowMessages());
+  setStageLogInterval(config.getStageTimingLogIntervalMs());
 }
 
-int ModifierKeyFixer::fixStuckKeys(InterceptionDevice device) {
-  int fixedCount = 0;
-  const auto &physical = physicalDetector_.getStates();
+void ModifierKeyFixer::cleanup() {
+  recorder_.stop();
+  flight_.stop();
+  shadow_.stop();
+  core_.input().close();
+}
 
-  // Iterate through all physical keys
-  for (const auto &key : physical.getKeys()) {
-    const MismatchTracker *tracker = mismatchTrackers_.getTracker(key.id);
-    if (!tracker || !tracker->isStuck(thresholdMs_)) {
-      continue;
-    }
+bool ModifierKeyFixer::isInitialized() const { return core_.input().isOpen(); }
 
-    // Send release event for this key
-    sendKeyRelease(device, key.scanCode, key.needsE0);
-    fixedCount++;
+bool ModifierKeyFixer::processEvents(int timeoutMs) {
+  if (!core_.input().isOpen()) {
+    Sleep(timeoutMs);
+    return true;
+  }
 
-    // Update statistics
-    stats_.incrementFix(key.id);
+  core_.processEvents(timeoutMs);
 
-    if (showMessages_) {
-      std::cout << "  [Fixed] " << key.name << std::endl;
-    }
+  if (flight_.takeDumpRequest()) {
+    flight_.dump("manual");
   }
 
-  if (fixedCount > 0) {
-    Sleep(20);
-    virtualDetector_.update();
+  if (stageLogIntervalMs_ > 0) {
+    logStageTimings();
   }
 
-  return fixedCount;
+  return true;
 }
 
-void ModifierKeyFixer::sendKeyRelease(InterceptionDevice device,
-                                      unsigned short scanCode, bool needsE0) {
-  InterceptionKeyStroke releaseStroke;
-  releaseStroke.code = scanCode;
-  releaseStroke.state = INTERCEPTION_KEY_UP;
+const ModifierKeyStates &ModifierKeyFixer::getPhysicalStates() const {
+  return core_.getPhysicalStates();
+}
 
-  if (needsE0) {
-    releaseStroke.state |= INTERCEPTION_KEY_E0;
-  }
+const VirtualKeyStates &ModifierKeyFixer::getVirtualStates() const {
+  return core_.getVirtualStates();
+}
 
-  releaseStroke.information = 0;
+const ModifierMismatchTrackers &ModifierKeyFixer::getMismatchTrackers() const {
+  return core_.logic().getTrackers();
+}
 
-  interception_send(context_, device, (InterceptionStroke *)&releaseStroke, 1);
+const FixStatistics &ModifierKeyFixer::getStatistics() const {
+  return core_.logic().getStatistics();
 }
 
-bool ModifierKeyFixer::hasOtherPhysicalKeyPressed(
-    const InterceptionKeyStroke &stroke) {
-  const auto &physical = physicalDetector_.getStates();
+const StageTimers &ModifierKeyFixer::getStageTimers() const {
+  return stageTimers_;
+}
 
-  // Check if any monitored key is pressed
-  for (const auto &key : physical.getKeys()) {
-    if (key.pressed) {
-      return true;
-    }
+void ModifierKeyFixer::setStageLogInterval(int ms) {
+  stageLogIntervalMs_ = ms;
+  nextStageLog_ = core_.clock().now() + std::chrono::milliseconds(ms);
+}
+
+void ModifierKeyFixer::logStageTimings() {
+  auto now = core_.clock().now();
+  if (now < nextStageLog_) {
+    return;
   }
+  nextStageLog_ = now + std::chrono::milliseconds(stageLogIntervalMs_);
 
-  return false;
+  if (getShowMessages()) {
+    // Formatted on the stack: this runs on the event loop thread
+    char line[sizeof(LogRecord::text)];
+    stageTimers_.formatLogLine(line, sizeof(line));
+    Log::info("[Timing] {s}", line);
+  }
 }
@@ -166,6 +166,16 @@ bool ModifierKeyStates::anyAlt() const { return lalt() || ralt(); }
 
 bool ModifierKeyStates::anyWin() const { return lwin() || rwin(); }
 
+uint32_t ModifierKeyStates::pressedMask() const {
+  uint32_t mask = 0;
+  for (size_t i = 0; i < keys_.size() && i < 32; ++i) {
+    if (keys_[i].pressed) {
+      mask |= 1u << i;
+    }
+  }
+  return mask;
+}
+
 bool ModifierKeyStates::operator!=(const ModifierKeyStates &other) const {
   if (keys_.size() != other.keys_.size()) {
     return true;
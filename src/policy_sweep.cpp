@@ -0,0 +1,119 @@
+#include "policy_sweep.h"
+#include <sstream>
+
+std::string SweepPolicy::describe() const {
+  std::ostringstream out;
+  out << thresholdMs << "ms " << fixTriggerName(trigger);
+  for (const auto &entry : keyThresholds) {
+    out << " " << entry.first << "=" << entry.second;
+  }
+  return out.str();
+}
+
+double SweepResult::falseFixRate() const {
+  return fixes > 0 ? double(falseFixes) / fixes : 0.0;
+}
+
+double SweepResult::missedStuckRate() const {
+  uint64_t stuck = trueFixes() + missedStuck();
+  return stuck > 0 ? double(missedStuck()) / stuck : 0.0;
+}
+
+double SweepResult::falseFixesPerHour() const {
+  return virtualNs > 0 ? falseFixes / (virtualNs / 3600e9) : 0.0;
+}
+
+void SweepResult::add(const SweepResult &other) {
+  strokes += other.strokes;
+  droppedKeyUps += other.droppedKeyUps;
+  fixes += other.fixes;
+  falseFixes += other.falseFixes;
+  selfHealed += other.selfHealed;
+  stillStuck += other.stillStuck;
+  stuckNs += other.stuckNs;
+  virtualNs += other.virtualNs;
+}
+
+std::vector<SweepPolicy>
+buildSweepGrid(const std::vector<int> &thresholdsMs,
+               const std::vector<FixTrigger> &triggers,
+               const std::vector<std::pair<std::string, std::vector<int>>>
+                   &keyThresholds) {
+  std::vector<SweepPolicy> grid;
+  for (int thresholdMs : thresholdsMs) {
+    for (FixTrigger trigger : triggers) {
+      SweepPolicy policy;
+      policy.thresholdMs = thresholdMs;
+      policy.trigger = trigger;
+      grid.push_back(policy);
+    }
+  }
+  // Multiply in one key dimension at a time
+  for (const auto &key : keyThresholds) {
+    if (key.second.empty()) {
+      continue;
+    }
+    std::vector<SweepPolicy> expanded;
+    for (const SweepPolicy &base : grid) {
+      for (int ms : key.second) {
+        SweepPolicy policy = base;
+        if (ms > 0) {
+          policy.keyThresholds.emplace_back(key.first, ms);
+        }
+        expanded.push_back(policy);
+      }
+    }
+    grid.swap(expanded);
+  }
+  return grid;
+}
+
+std::vector<SweepResult>
+runSweep(const std::vector<SweepPolicy> &policies,
+         const std::vector<std::vector<SimStroke>> &traces,
+         const SimulationOptions &options, const Config *config,
+         WorkStealingPool &pool) {
+  // One result per (policy, trace); traces of a policy are neighbours, so
+  // a worker's contiguous range covers few policies
+  std::vector<SweepResult> runs(policies.size() * traces.size());
+  pool.run(runs.size(), [&](size_t index, size_t) {
+    const SweepPolicy &policy = policies[index / traces.size()];
+    size_t trace = index % traces.size();
+
+    SimulationOptions traceOptions = options;
+    traceOptions.layer.seed = options.layer.seed + trace;
+    Simulator simulator(traceOptions);
+    if (config) {
+      simulator.initialize(*config);
+    } else {
+      simulator.initialize();
+    }
+    simulator.setThreshold(policy.thresholdMs);
+    simulator.setTrigger(policy.trigger);
+    for (const auto &entry : policy.keyThresholds) {
+      simulator.setKeyThreshold(entry.first, entry.second);
+    }
+
+    simulator.run(traces[trace]);
+
+    const SimulationReport &report = simulator.getReport();
+    SweepResult &result = runs[index];
+    result.strokes = report.strokes;
+    result.droppedKeyUps = report.droppedKeyUps;
+    result.fixes = report.fixes;
+    result.falseFixes = report.falseFixes;
+    result.selfHealed = report.selfHealed;
+    result.stillStuck = static_cast<uint64_t>(simulator.countStuckKeys());
+    result.stuckNs = report.stuckNs;
+    result.virtualNs = report.endTimeNs;
+    if (!traces[trace].empty()) {
+      result.virtualNs -= traces[trace].front().timeNs;
+    }
+  });
+
+  std::vector<SweepResult> results(policies.size());
+  for (size_t i = 0; i < runs.size(); ++i) {
+    results[i / traces.size()].add(runs[i]);
+  }
+  return results;
+}
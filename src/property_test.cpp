@@ -0,0 +1,255 @@
+#include "property_test.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <random>
+#include <streambuf>
+
+namespace {
+
+uint64_t splitMix(uint64_t value) {
+  value += 0x9E3779B97F4A7C15ull;
+  value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+  value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+  return value ^ (value >> 31);
+}
+
+uint64_t hashName(const std::string &name) {
+  uint64_t hash = 0xCBF29CE484222325ull; // FNV-1a
+  for (unsigned char c : name) {
+    hash = (hash ^ c) * 0x100000001B3ull;
+  }
+  return hash;
+}
+
+// Discards what the code under test prints while cases run (a null rdbuf
+// would set badbit on a shared stream from several threads)
+class DiscardBuffer : public std::streambuf {
+protected:
+  int overflow(int c) override { return c; }
+  std::streamsize xsputn(const char *, std::streamsize count) override {
+    return count;
+  }
+};
+
+class QuietStderr {
+public:
+  QuietStderr() : saved_(std::cerr.rdbuf(&discard_)) {}
+  ~QuietStderr() { std::cerr.rdbuf(saved_); }
+
+private:
+  DiscardBuffer discard_;
+  std::streambuf *saved_;
+};
+
+// Run one case; exceptions count as failures
+bool holds(const Property &property, PropertySource &source) {
+  try {
+    return property(source);
+  } catch (const std::exception &e) {
+    source.fail(std::string("exception: ") + e.what());
+    return false;
+  }
+}
+
+bool failsWith(const Property &property, const std::vector<uint64_t> &choices,
+               size_t index) {
+  PropertySource source(choices, index);
+  return !holds(property, source);
+}
+
+// Simplify the draws of a failing case while it keeps failing: remove runs
+// of draws (long runs first), then lower each value (zero, half, minus one)
+std::vector<uint64_t> shrinkChoices(const Property &property,
+                                    std::vector<uint64_t> choices,
+                                    size_t index, size_t &steps) {
+  const size_t kMaxAttempts = 20000;
+  size_t attempts = 0;
+  bool progress = true;
+  while (progress && attempts < kMaxAttempts) {
+    progress = false;
+
+    for (size_t run = 8; run >= 1 && attempts < kMaxAttempts; run /= 2) {
+      for (size_t start = 0; start + run <= choices.size() &&
+                             attempts < kMaxAttempts;) {
+        std::vector<uint64_t> candidate = choices;
+        candidate.erase(candidate.begin() + start,
+                        candidate.begin() + start + run);
+        ++attempts;
+        if (failsWith(property, candidate, index)) {
+          choices.swap(candidate);
+          ++steps;
+          progress = true;
+        } else {
+          ++start;
+        }
+      }
+    }
+
+    for (size_t i = 0; i < choices.size() && attempts < kMaxAttempts; ++i) {
+      uint64_t value = choices[i];
+      const uint64_t smaller[] = {0, value / 2, value - 1};
+      for (uint64_t lower : smaller) {
+        if (value == 0 || lower >= choices[i]) {
+          continue;
+        }
+        std::vector<uint64_t> candidate = choices;
+        candidate[i] = lower;
+        ++attempts;
+        if (failsWith(property, candidate, index)) {
+          choices.swap(candidate);
+          ++steps;
+          progress = true;
+          break;
+        }
+      }
+    }
+  }
+  return choices;
+}
+
+} // namespace
+
+PropertySource::PropertySource(uint64_t seed, size_t index)
+    : state_(seed), replay_(false), position_(0), index_(index) {}
+
+PropertySource::PropertySource(const std::vector<uint64_t> &choices,
+                               size_t index)
+    : state_(0), replay_(true), position_(0), index_(index),
+      choices_(choices) {}
+
+uint64_t PropertySource::next() {
+  state_ += 0x9E3779B97F4A7C15ull;
+  return splitMix(state_);
+}
+
+uint64_t PropertySource::draw(uint64_t count) {
+  if (count == 0) {
+    count = 1;
+  }
+  if (replay_) {
+    // Edited values may be out of range for this draw; clamp
+    uint64_t value = position_ < choices_.size() ? choices_[position_] : 0;
+    ++position_;
+    return std::min(value, count - 1);
+  }
+  uint64_t value = next() % count;
+  choices_.push_back(value);
+  return value;
+}
+
+void PropertySource::note(const std::string &text) { notes_.push_back(text); }
+
+bool PropertySource::fail(const std::string &message) {
+  message_ = message;
+  return false;
+}
+
+PropertyRunner::PropertyRunner(size_t threads)
+    : pool_(threads), seed_(0), scale_(1.0), passed_(0), failed_(0),
+      cases_(0) {
+  const char *seed = std::getenv("ESCMODKEY_PBT_SEED");
+  if (seed && *seed) {
+    seed_ = std::strtoull(seed, nullptr, 0);
+  } else {
+    std::random_device device;
+    seed_ = (static_cast<uint64_t>(device()) << 32) ^ device();
+  }
+  const char *scale = std::getenv("ESCMODKEY_PBT_SCALE");
+  if (scale && *scale && std::atof(scale) > 0) {
+    scale_ = std::atof(scale);
+  }
+}
+
+size_t PropertyRunner::scaled(size_t iterations) const {
+  return std::max<size_t>(static_cast<size_t>(iterations * scale_), 1);
+}
+
+bool PropertyRunner::check(const std::string &name, size_t iterations,
+                           const Property &property) {
+  size_t count = scaled(iterations);
+  uint64_t base = splitMix(seed_ ^ hashName(name));
+  std::cout << name << std::endl;
+  std::cout << "Running " << count << " cases on " << pool_.getWorkerCount()
+            << " threads..." << std::endl;
+
+  std::mutex mutex;
+  size_t firstFailure = std::numeric_limits<size_t>::max();
+  std::atomic<uint64_t> failures(0);
+  auto start = std::chrono::steady_clock::now();
+  {
+    QuietStderr quiet;
+    pool_.run(count, [&](size_t index, size_t) {
+      PropertySource source(splitMix(base + index), index);
+      if (!holds(property, source)) {
+        failures.fetch_add(1, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(mutex);
+        firstFailure = std::min(firstFailure, index);
+      }
+    });
+  }
+  double elapsedMs = std::chrono::duration<double, std::milli>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+  cases_ += count;
+
+  if (failures.load() == 0) {
+    ++passed_;
+    std::cout << "Results: " << count << " passed, 0 failed (" << elapsedMs
+              << " ms)" << std::endl;
+    std::cout << std::endl;
+    return true;
+  }
+
+  // Regenerate the lowest failing case and shrink it
+  PropertyFailure failure;
+  failure.property = name;
+  failure.caseIndex = firstFailure;
+  PropertySource original(splitMix(base + firstFailure), firstFailure);
+  {
+    QuietStderr quiet;
+    holds(property, original);
+    failure.choices = shrinkChoices(property, original.getChoices(),
+                                    firstFailure, failure.shrinkSteps);
+  }
+  PropertySource minimal(failure.choices, firstFailure);
+  holds(property, minimal);
+  failure.notes = minimal.getNotes();
+  failure.message = minimal.getMessage();
+  lastFailure_ = failure;
+  ++failed_;
+
+  std::cout << "Results: " << count - failures.load() << " passed, "
+            << failures.load() << " failed" << std::endl;
+  std::cerr << "FAILED: " << name << ", first at case " << firstFailure
+            << std::endl;
+  std::cerr << "  Reproduce with ESCMODKEY_PBT_SEED=" << seed_ << std::endl;
+  std::cerr << "  Minimal counterexample (" << failure.shrinkSteps
+            << " shrink steps):" << std::endl;
+  for (const std::string &note : failure.notes) {
+    std::cerr << "    " << note << std::endl;
+  }
+  if (!failure.message.empty()) {
+    std::cerr << "  " << failure.message << std::endl;
+  }
+  std::cout << std::endl;
+  return false;
+}
+
+int PropertyRunner::finish() const {
+  std::cout << "=== Final Results ===" << std::endl;
+  std::cout << "Properties: " << passed_ << " passed, " << failed_
+            << " failed (" << cases_ << " cases, seed " << seed_ << ")"
+            << std::endl;
+  if (failed_ == 0) {
+    std::cout << "All property tests PASSED!" << std::endl;
+    return 0;
+  }
+  std::cout << "Some property tests FAILED!" << std::endl;
+  return 1;
+}
@@ -0,0 +1,102 @@
+#include "quantile_estimator.h"
+#include <algorithm>
+#include <cmath>
+
+P2Quantile::P2Quantile(double quantile) : p_(quantile) { reset(); }
+
+void P2Quantile::reset() {
+  count_ = 0;
+  for (int i = 0; i < 5; ++i) {
+    heights_[i] = 0.0;
+    positions_[i] = i + 1;
+  }
+  desired_[0] = 1;
+  desired_[1] = 1 + 2 * p_;
+  desired_[2] = 1 + 4 * p_;
+  desired_[3] = 3 + 2 * p_;
+  desired_[4] = 5;
+  increments_[0] = 0;
+  increments_[1] = p_ / 2;
+  increments_[2] = p_;
+  increments_[3] = (1 + p_) / 2;
+  increments_[4] = 1;
+}
+
+void P2Quantile::add(double value) {
+  // The first five values become the markers
+  if (count_ < 5) {
+    heights_[count_++] = value;
+    if (count_ == 5) {
+      std::sort(heights_, heights_ + 5);
+    }
+    return;
+  }
+  ++count_;
+
+  // Cell of the new value; the extreme markers follow new extremes
+  int cell;
+  if (value < heights_[0]) {
+    heights_[0] = value;
+    cell = 0;
+  } else if (value >= heights_[4]) {
+    heights_[4] = std::max(heights_[4], value);
+    cell = 3;
+  } else {
+    cell = 0;
+    while (cell < 3 && value >= heights_[cell + 1]) {
+      ++cell;
+    }
+  }
+  for (int i = cell + 1; i < 5; ++i) {
+    positions_[i] += 1;
+  }
+  for (int i = 0; i < 5; ++i) {
+    desired_[i] += increments_[i];
+  }
+
+  // Move the middle markers that are a whole position off their target
+  for (int i = 1; i < 4; ++i) {
+    double offset = desired_[i] - positions_[i];
+    if ((offset >= 1 && positions_[i + 1] - positions_[i] > 1) ||
+        (offset <= -1 && positions_[i - 1] - positions_[i] < -1)) {
+      double d = offset > 0 ? 1.0 : -1.0;
+      double height = parabolic(i, d);
+      if (height <= heights_[i - 1] || height >= heights_[i + 1]) {
+        height = linear(i, d);
+      }
+      heights_[i] = height;
+      positions_[i] += d;
+    }
+  }
+}
+
+double P2Quantile::parabolic(int i, double d) const {
+  double below = positions_[i] - positions_[i - 1];
+  double above = positions_[i + 1] - positions_[i];
+  return heights_[i] +
+         d / (positions_[i + 1] - positions_[i - 1]) *
+             ((below + d) * (heights_[i + 1] - heights_[i]) / above +
+              (above - d) * (heights_[i] - heights_[i - 1]) / below);
+}
+
+double P2Quantile::linear(int i, double d) const {
+  int j = i + static_cast<int>(d);
+  return heights_[i] +
+         d * (heights_[j] - heights_[i]) / (positions_[j] - positions_[i]);
+}
+
+double P2Quantile::value() const {
+  if (count_ == 0) {
+    return 0.0;
+  }
+  if (count_ < 5) {
+    // Nearest rank over the values seen so far
+    double sorted[5];
+    std::copy(heights_, heights_ + count_, sorted);
+    std::sort(sorted, sorted + count_);
+    double rank = std::ceil(p_ * static_cast<double>(count_));
+    size_t index = rank < 1 ? 0 : static_cast<size_t>(rank) - 1;
+    return sorted[std::min<size_t>(index, count_ - 1)];
+  }
+  return heights_[2];
+}
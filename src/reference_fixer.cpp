@@ -0,0 +1,215 @@
+#include "reference_fixer.h"
+#include <algorithm>
+#include <cctype>
+
+namespace {
+
+std::string lowerCase(const std::string &text) {
+  std::string result = text;
+  for (char &c : result) {
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  }
+  return result;
+}
+
+std::string idFromName(const std::string &name) {
+  std::string id = lowerCase(name);
+  id.erase(std::remove(id.begin(), id.end(), ' '), id.end());
+  return id;
+}
+
+} // namespace
+
+ReferenceFixer::ReferenceFixer()
+    : thresholdMs_(1000), trigger_(FixTrigger::IdleKeyDown) {}
+
+void ReferenceFixer::initialize(
+    bool monitorCtrl, bool monitorShift, bool monitorAlt, bool monitorWin,
+    const std::vector<std::string> &disabledKeys,
+    const std::vector<CustomKeyConfig> &customKeys,
+    const std::vector<KeyMappingConfig> &keyMappings) {
+  keys_.clear();
+  if (monitorCtrl) {
+    keys_.push_back({"lctrl", 0x1D, false, false});
+    keys_.push_back({"rctrl", 0x1D, true, false});
+  }
+  if (monitorShift) {
+    keys_.push_back({"lshift", 0x2A, false, false});
+    keys_.push_back({"rshift", 0x36, false, false});
+  }
+  if (monitorAlt) {
+    keys_.push_back({"lalt", 0x38, false, false});
+    keys_.push_back({"ralt", 0x38, true, false});
+  }
+  if (monitorWin) {
+    keys_.push_back({"lwin", 0x5B, true, false});
+    keys_.push_back({"rwin", 0x5C, true, false});
+  }
+  for (const auto &disabled : disabledKeys) {
+    std::string id = lowerCase(disabled);
+    keys_.erase(std::remove_if(keys_.begin(), keys_.end(),
+                               [&id](const Key &key) { return key.id == id; }),
+                keys_.end());
+  }
+  for (const auto &custom : customKeys) {
+    keys_.push_back(
+        {idFromName(custom.name), custom.scanCode, custom.needsE0, false});
+  }
+
+  // The virtual table is built from the same selection, so it has the same
+  // IDs in the same order
+  virtualIds_.clear();
+  for (const Key &key : keys_) {
+    virtualIds_.push_back(key.id);
+  }
+
+  keyMappings_.clear();
+  for (const auto &mapping : keyMappings) {
+    bool monitored = false;
+    for (const Key &key : keys_) {
+      monitored = monitored || key.id == mapping.targetKeyId;
+    }
+    if (!monitored || mapping.mappingType != "additional") {
+      continue;
+    }
+    keyMappings_[std::make_pair(mapping.sourceScanCode,
+                                mapping.sourceNeedsE0)] = mapping.targetKeyId;
+  }
+
+  trackers_.clear();
+  for (const Key &key : keys_) {
+    trackers_[key.id] = Tracker();
+  }
+  trackerByIndex_.clear();
+  virtualIndex_.clear();
+  for (const Key &key : keys_) {
+    trackerByIndex_.push_back(&trackers_[key.id]);
+    auto it = std::find(virtualIds_.begin(), virtualIds_.end(), key.id);
+    virtualIndex_.push_back(
+        it == virtualIds_.end() ? -1
+                                : static_cast<int>(it - virtualIds_.begin()));
+  }
+  keyThresholdMs_.assign(keys_.size(), 0);
+}
+
+void ReferenceFixer::setKeyThreshold(size_t keyIndex, int ms) {
+  if (keyIndex < keyThresholdMs_.size()) {
+    keyThresholdMs_[keyIndex] = ms > 0 ? ms : 0;
+  }
+}
+
+void ReferenceFixer::processKeyStroke(const InterceptionKeyStroke &stroke) {
+  bool isE0 = (stroke.state & INTERCEPTION_KEY_E0) != 0;
+  bool isPressed = !(stroke.state & INTERCEPTION_KEY_UP);
+
+  for (Key &key : keys_) {
+    if (key.scanCode == stroke.code && key.needsE0 == isE0) {
+      key.pressed = isPressed;
+      break;
+    }
+  }
+
+  auto it = keyMappings_.find(std::make_pair(stroke.code, isE0));
+  if (it == keyMappings_.end()) {
+    return;
+  }
+  for (Key &key : keys_) {
+    if (key.id == it->second) {
+      key.pressed = isPressed;
+      break;
+    }
+  }
+}
+
+void ReferenceFixer::updateTrackers(const std::vector<bool> &virtualPressed,
+                                    int64_t nowNs,
+                                    std::vector<TrackerEvent> *events) {
+  for (size_t i = 0; i < keys_.size(); ++i) {
+    int virtIndex = virtualIndex_[i];
+    if (virtIndex < 0 ||
+        static_cast<size_t>(virtIndex) >= virtualPressed.size()) {
+      continue;
+    }
+    Tracker &tracker = *trackerByIndex_[i];
+
+    if (!keys_[i].pressed && virtualPressed[virtIndex]) {
+      if (!tracker.isMismatched) {
+        if (events) {
+          events->push_back({i, TrackerChange::MismatchStart, 0});
+        }
+        tracker.isMismatched = true;
+        tracker.startNs = nowNs;
+      }
+      if (!tracker.stuckReported &&
+          durationMs(tracker, nowNs) >= keyThreshold(i)) {
+        tracker.stuckReported = true;
+        if (events) {
+          events->push_back(
+              {i, TrackerChange::Stuck, durationMs(tracker, nowNs)});
+        }
+      }
+    } else {
+      if (tracker.isMismatched && events) {
+        events->push_back(
+            {i, TrackerChange::Reset, durationMs(tracker, nowNs)});
+      }
+      tracker.isMismatched = false;
+      tracker.stuckReported = false;
+    }
+  }
+}
+
+bool ReferenceFixer::shouldFix(const InterceptionKeyStroke &stroke,
+                               int64_t nowNs) const {
+  if (stroke.state & INTERCEPTION_KEY_UP) {
+    return false;
+  }
+  bool anyStuck = false;
+  for (size_t i = 0; i < keys_.size() && !anyStuck; ++i) {
+    anyStuck = isStuck(i, nowNs);
+  }
+  if (!anyStuck) {
+    return false;
+  }
+  if (trigger_ == FixTrigger::AnyKeyDown) {
+    return true;
+  }
+
+  bool e0 = (stroke.state & INTERCEPTION_KEY_E0) != 0;
+  for (const Key &key : keys_) {
+    if (key.pressed) {
+      return false;
+    }
+    if (trigger_ == FixTrigger::OtherKeyDown && key.scanCode == stroke.code &&
+        key.needsE0 == e0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ReferenceFixer::isStuck(size_t keyIndex, int64_t nowNs) const {
+  if (keyIndex >= trackerByIndex_.size()) {
+    return false;
+  }
+  const Tracker &tracker = *trackerByIndex_[keyIndex];
+  return tracker.isMismatched &&
+         durationMs(tracker, nowNs) >= keyThreshold(keyIndex);
+}
+
+int ReferenceFixer::getMismatchMs(size_t keyIndex, int64_t nowNs) const {
+  return keyIndex < trackerByIndex_.size()
+             ? durationMs(*trackerByIndex_[keyIndex], nowNs)
+             : 0;
+}
+
+int ReferenceFixer::keyThreshold(size_t keyIndex) const {
+  int ms = keyThresholdMs_[keyIndex];
+  return ms > 0 ? ms : thresholdMs_;
+}
+
+int ReferenceFixer::durationMs(const Tracker &tracker, int64_t nowNs) {
+  return tracker.isMismatched
+             ? static_cast<int>((nowNs - tracker.startNs) / 1000000)
+             : 0;
+}
@@ -0,0 +1,778 @@
+#include "scenario.h"
+#include "clock.h"
+#include "config.h"
+#include "fix_logic.h"
+#include "fixer_core.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+namespace {
+
+constexpr int64_t kNsPerMs = 1000000;
+
+struct NamedKey {
+  const char *name;
+  unsigned short scanCode;
+  bool needsE0;
+};
+
+// Keys a scenario may press by name (monitored key ids come first)
+const NamedKey kNamedKeys[] = {
+    {"lctrl", 0x1D, false},     {"rctrl", 0x1D, true},
+    {"lshift", 0x2A, false},    {"rshift", 0x36, false},
+    {"lalt", 0x38, false},      {"ralt", 0x38, true},
+    {"lwin", 0x5B, true},       {"rwin", 0x5C, true},
+    {"esc", 0x01, false},       {"backspace", 0x0E, false},
+    {"tab", 0x0F, false},       {"enter", 0x1C, false},
+    {"space", 0x39, false},     {"capslock", 0x3A, false},
+    {"a", 0x1E, false},         {"b", 0x30, false},
+    {"c", 0x2E, false},         {"d", 0x20, false},
+    {"e", 0x12, false},         {"f", 0x21, false},
+    {"g", 0x22, false},         {"h", 0x23, false},
+    {"i", 0x17, false},         {"j", 0x24, false},
+    {"k", 0x25, false},         {"l", 0x26, false},
+    {"m", 0x32, false},         {"n", 0x31, false},
+    {"o", 0x18, false},         {"p", 0x19, false},
+    {"q", 0x10, false},         {"r", 0x13, false},
+    {"s", 0x1F, false},         {"t", 0x14, false},
+    {"u", 0x16, false},         {"v", 0x2F, false},
+    {"w", 0x11, false},         {"x", 0x2D, false},
+    {"y", 0x15, false},         {"z", 0x2C, false},
+    {"1", 0x02, false},         {"2", 0x03, false},
+    {"3", 0x04, false},         {"4", 0x05, false},
+    {"5", 0x06, false},         {"6", 0x07, false},
+    {"7", 0x08, false},         {"8", 0x09, false},
+    {"9", 0x0A, false},         {"0", 0x0B, false},
+};
+
+bool parseInteger(const std::string &text, int64_t &value) {
+  if (text.empty()) {
+    return false;
+  }
+  char *end = nullptr;
+  long long parsed = std::strtoll(text.c_str(), &end, 0);
+  if (*end != '\0') {
+    return false;
+  }
+  value = parsed;
+  return true;
+}
+
+// 0x1e, 30 or e0:0x1d
+bool parseScanCode(const std::string &text, unsigned short &scanCode,
+                   bool &needsE0) {
+  std::string number = text;
+  needsE0 = false;
+  if (number.compare(0, 3, "e0:") == 0) {
+    needsE0 = true;
+    number = number.substr(3);
+  }
+  int64_t value = 0;
+  if (!parseInteger(number, value) || value < 0 || value > 0xFF) {
+    return false;
+  }
+  scanCode = static_cast<unsigned short>(value);
+  return true;
+}
+
+// 1200, 1200ms or 2s
+bool parseDurationNs(const std::string &text, int64_t &ns) {
+  std::string number = text;
+  int64_t scale = kNsPerMs;
+  if (number.size() > 2 && number.compare(number.size() - 2, 2, "ms") == 0) {
+    number.erase(number.size() - 2);
+  } else if (number.size() > 1 && number.back() == 's') {
+    number.pop_back();
+    scale = 1000 * kNsPerMs;
+  }
+  int64_t value = 0;
+  if (!parseInteger(number, value) || value < 0) {
+    return false;
+  }
+  ns = value * scale;
+  return true;
+}
+
+// <id>=0|1
+bool parseKeyState(const std::string &text, std::string &key,
+                   int64_t &pressed) {
+  size_t equals = text.find('=');
+  if (equals == std::string::npos || equals == 0) {
+    return false;
+  }
+  key = text.substr(0, equals);
+  std::string state = text.substr(equals + 1);
+  if (state != "0" && state != "1") {
+    return false;
+  }
+  pressed = state == "1";
+  return true;
+}
+
+bool isSetup(ScenarioOp op) {
+  return op == ScenarioOp::Monitor || op == ScenarioOp::Disable ||
+         op == ScenarioOp::Custom || op == ScenarioOp::Map;
+}
+
+// Parse one command; returns an error message or ""
+std::string parseCommand(const std::vector<std::string> &words,
+                         ScenarioCommand &command) {
+  const std::string &name = words[0];
+  size_t args = words.size() - 1;
+
+  if (name == "monitor") {
+    if (args == 0) {
+      return "monitor needs at least one group";
+    }
+    for (size_t i = 1; i < words.size(); ++i) {
+      const std::string &group = words[i];
+      if (group != "ctrl" && group != "shift" && group != "alt" &&
+          group != "win") {
+        return "unknown key group '" + group + "'";
+      }
+      command.keys.push_back(group);
+    }
+    command.op = ScenarioOp::Monitor;
+  } else if (name == "disable") {
+    if (args != 1) {
+      return "usage: disable <id>";
+    }
+    command.op = ScenarioOp::Disable;
+    command.key = words[1];
+  } else if (name == "custom") {
+    if (args != 3 ||
+        !parseScanCode(words[2], command.scanCode, command.needsE0) ||
+        !parseInteger(words[3], command.value)) {
+      return "usage: custom <name> <scan> <vk>";
+    }
+    command.op = ScenarioOp::Custom;
+    command.key = words[1];
+  } else if (name == "map") {
+    if (args != 2 ||
+        !parseScanCode(words[1], command.scanCode, command.needsE0)) {
+      return "usage: map <scan> <id>";
+    }
+    command.op = ScenarioOp::Map;
+    command.key = words[2];
+  } else if (name == "threshold") {
+    if ((args != 1 && args != 2) ||
+        !parseInteger(words[args], command.value) || command.value <= 0) {
+      return "usage: threshold [<id>] <ms>";
+    }
+    command.op = ScenarioOp::Threshold;
+    if (args == 2) {
+      command.key = words[1];
+    }
+  } else if (name == "trigger") {
+    FixTrigger trigger;
+    if (args != 1 || !parseFixTrigger(words[1], trigger)) {
+      return "usage: trigger idle|any|other";
+    }
+    command.op = ScenarioOp::Trigger;
+    command.key = words[1];
+  } else if (name == "timer") {
+    if (args != 1 || (words[1] != "on" && words[1] != "off")) {
+      return "usage: timer on|off";
+    }
+    command.op = ScenarioOp::Timer;
+    command.value = words[1] == "on";
+  } else if (name == "releasecheck") {
+    if (args != 1 || !parseInteger(words[1], command.value) ||
+        command.value < 0) {
+      return "usage: releasecheck <ms>";
+    }
+    command.op = ScenarioOp::ReleaseCheck;
+  } else if (name == "lostkeydown") {
+    if (args != 1 || !parseInteger(words[1], command.value) ||
+        command.value <= 0) {
+      return "usage: lostkeydown <ms>";
+    }
+    command.op = ScenarioOp::LostKeyDown;
+  } else if (name == "repair") {
+    if (args != 1 || (words[1] != "on" && words[1] != "off")) {
+      return "usage: repair on|off";
+    }
+    command.op = ScenarioOp::Repair;
+    command.value = words[1] == "on";
+  } else if (name == "poll" || name == "settle") {
+    bool poll = name == "poll";
+    if (args != 1 || !parseInteger(words[1], command.value) ||
+        command.value < (poll ? 1 : 0)) {
+      return "usage: " + name + " <ms>";
+    }
+    command.op = poll ? ScenarioOp::Poll : ScenarioOp::Settle;
+  } else if (name == "down" || name == "up") {
+    if (args != 1 && !(args == 2 && words[2] == "lost")) {
+      return "usage: " + name + " <key> [lost]";
+    }
+    command.op = name == "up" ? ScenarioOp::Up : ScenarioOp::Down;
+    command.key = words[1];
+    command.flag = args == 2;
+  } else if (name == "virt") {
+    if (args != 1 || !parseKeyState(words[1], command.key, command.value)) {
+      return "usage: virt <id>=0|1";
+    }
+    command.op = ScenarioOp::Virt;
+  } else if (name == "advance") {
+    if (args != 1 || !parseDurationNs(words[1], command.value)) {
+      return "usage: advance <n>[ms|s]";
+    }
+    command.op = ScenarioOp::Advance;
+  } else if (name == "expect") {
+    if (args == 0) {
+      return "expect needs a check";
+    }
+    const std::string &check = words[1];
+    if (check == "fix" && args >= 2) {
+      command.op = ScenarioOp::ExpectFix;
+      command.keys.assign(words.begin() + 2, words.end());
+      std::sort(command.keys.begin(), command.keys.end());
+    } else if (check == "nofix" && args == 1) {
+      command.op = ScenarioOp::ExpectFix;
+    } else if (check == "fixes" && args == 2 &&
+               parseInteger(words[2], command.value)) {
+      command.op = ScenarioOp::ExpectFixes;
+    } else if ((check == "ok" || check == "mismatch" || check == "stuck" ||
+                check == "missing") &&
+               args == 2) {
+      command.op = ScenarioOp::ExpectTracker;
+      command.key = words[2];
+      command.tracker = check == "ok"         ? ScenarioTracker::Ok
+                        : check == "mismatch" ? ScenarioTracker::Mismatch
+                        : check == "stuck"    ? ScenarioTracker::Stuck
+                                              : ScenarioTracker::Missing;
+    } else if ((check == "phys" || check == "virt") && args == 2 &&
+               parseKeyState(words[2], command.key, command.value)) {
+      command.op = check == "phys" ? ScenarioOp::ExpectPhysical
+                                   : ScenarioOp::ExpectVirtual;
+    } else {
+      return "unknown check 'expect " + check + "'";
+    }
+  } else {
+    return "unknown command '" + name + "'";
+  }
+  return "";
+}
+
+const char *trackerName(ScenarioTracker tracker) {
+  switch (tracker) {
+  case ScenarioTracker::Ok:
+    return "ok";
+  case ScenarioTracker::Mismatch:
+    return "mismatch";
+  case ScenarioTracker::Stuck:
+    return "stuck";
+  case ScenarioTracker::Missing:
+    return "missing";
+  }
+  return "";
+}
+
+std::string joinIds(const std::vector<std::string> &ids) {
+  if (ids.empty()) {
+    return "nofix";
+  }
+  std::string text = "fix";
+  for (const std::string &id : ids) {
+    text += " " + id;
+  }
+  return text;
+}
+
+// Runs one scenario through FixerCore with in-memory policies
+class ScenarioMachine {
+public:
+  ScenarioMachine()
+      : core_(Input(this), Layer(), SimClock(this), Sink(this)),
+        started_(false), pending_(false), lost_(false), nowNs_(0),
+        lastIterationNs_(0), pollNs_(50 * kNsPerMs), fixes_(0) {
+    core_.logic().setClock(&core_.clock());
+  }
+
+  ScenarioMachine(const ScenarioMachine &) = delete;
+  ScenarioMachine &operator=(const ScenarioMachine &) = delete;
+
+  // Returns a failure message or ""
+  std::string execute(const ScenarioCommand &command, ScenarioResult &result);
+
+private:
+  class Input {
+  public:
+    explicit Input(ScenarioMachine *machine) : machine_(machine) {}
+    InterceptionDevice wait(int) { return machine_->pending_ ? 1 : 0; }
+    bool receive(InterceptionDevice, InterceptionKeyStroke &stroke) {
+      if (!machine_->pending_) {
+        return false;
+      }
+      stroke = machine_->stroke_;
+      machine_->pending_ = false;
+      return true;
+    }
+    void send(InterceptionDevice, const InterceptionKeyStroke &stroke) {
+      machine_->deliver(stroke, false);
+    }
+    void inject(InterceptionDevice, const InterceptionKeyStroke &stroke) {
+      machine_->deliver(stroke, true);
+    }
+
+  private:
+    ScenarioMachine *machine_;
+  };
+
+  // OS key layer; strokes and 'virt' change it directly
+  class Layer {
+  public:
+    void initialize() { states_.initializeDefaultKeys(); }
+    void initializeWithConfig(bool monitorCtrl, bool monitorShift,
+                              bool monitorAlt, bool monitorWin,
+                              const std::vector<std::string> &disabledKeys,
+                              const std::vector<CustomKeyConfig> &customKeys) {
+      states_.initializeWithConfig(monitorCtrl, monitorShift, monitorAlt,
+                                   monitorWin, disabledKeys, customKeys);
+    }
+    void update() {}
+    const VirtualKeyStates &getStates() const { return states_; }
+    VirtualKeyStates &getStates() { return states_; }
+
+  private:
+    VirtualKeyStates states_;
+  };
+
+  class SimClock final : public Clock {
+  public:
+    explicit SimClock(ScenarioMachine *machine) : machine_(machine) {}
+    TimePoint now() const override {
+      return TimePoint(std::chrono::duration_cast<TimePoint::duration>(
+          std::chrono::nanoseconds(machine_->nowNs_)));
+    }
+    void refresh() {}
+    void sleepMs(int ms) { machine_->nowNs_ += ms * kNsPerMs; }
+
+  private:
+    ScenarioMachine *machine_;
+  };
+
+  class Sink : public NullSink {
+  public:
+    explicit Sink(ScenarioMachine *machine) : machine_(machine) {}
+    void keyFixed(InterceptionDevice, size_t, const KeyState &key, int) {
+      machine_->fixed_.push_back(key.id);
+      machine_->fixes_++;
+    }
+
+  private:
+    ScenarioMachine *machine_;
+  };
+
+  std::string start();
+  int64_t nextIdleNs() const;
+  void iterate();
+  void deliver(const InterceptionKeyStroke &stroke, bool injected);
+  bool resolveStroke(const std::string &key, unsigned short &scanCode,
+                     bool &needsE0) const;
+  int physicalIndex(const std::string &id) const;
+  VirtualKeyState *virtualKey(const std::string &id);
+
+  FixerCore<Input, Layer, SimClock, Sink> core_;
+  Config config_;
+  std::vector<std::pair<std::string, int>> keyThresholds_; // Until start
+  std::vector<int> scanToVirtual_; // (code | e0 << 8) -> virtual index
+
+  bool started_;
+  bool pending_; // stroke_ waits to be received
+  bool lost_;    // stroke_ never reaches the OS layer
+  InterceptionKeyStroke stroke_;
+  int64_t nowNs_;
+  int64_t lastIterationNs_;
+  int64_t pollNs_;
+  std::vector<std::string> fixed_; // Keys released by the last stroke
+  uint64_t fixes_;
+};
+
+// Initialize the fixer from the setup commands; returns an error or ""
+std::string ScenarioMachine::start() {
+  started_ = true;
+  core_.initialize(config_);
+
+  const auto &physKeys = core_.getPhysicalStates().getKeys();
+  const auto &virtKeys = core_.getVirtualStates().getKeys();
+  scanToVirtual_.assign(0x200, -1);
+  for (const KeyState &key : physKeys) {
+    for (size_t v = 0; v < virtKeys.size(); ++v) {
+      if (virtKeys[v].id == key.id && key.scanCode <= 0xFF) {
+        scanToVirtual_[(key.scanCode & 0xFF) | (key.needsE0 ? 0x100 : 0)] =
+            static_cast<int>(v);
+        break;
+      }
+    }
+  }
+  for (const auto &mapping : config_.getKeyMappings()) {
+    if (physicalIndex(mapping.targetKeyId) < 0) {
+      return "map target '" + mapping.targetKeyId + "' is not monitored";
+    }
+  }
+  for (const auto &threshold : keyThresholds_) {
+    int index = physicalIndex(threshold.first);
+    if (index < 0) {
+      return "key '" + threshold.first + "' is not monitored";
+    }
+    core_.logic().setKeyThreshold(index, threshold.second);
+  }
+  return "";
+}
+
+// End of the last iteration's wait: the poll interval, or an earlier
+// release check or stuck deadline (see FixerCore::waitTimeoutMs)
+int64_t ScenarioMachine::nextIdleNs() const {
+  int waitMs = core_.waitTimeoutMs(std::numeric_limits<int>::max());
+  return std::min(lastIterationNs_ + pollNs_, nowNs_ + waitMs * kNsPerMs);
+}
+
+void ScenarioMachine::iterate() {
+  lastIterationNs_ = nowNs_;
+  core_.processEvents(0);
+}
+
+void ScenarioMachine::deliver(const InterceptionKeyStroke &stroke,
+                              bool injected) {
+  if (stroke.code > 0xFF || (lost_ && !injected)) {
+    return;
+  }
+  bool e0 = (stroke.state & INTERCEPTION_KEY_E0) != 0;
+  int index = scanToVirtual_[(stroke.code & 0xFF) | (e0 ? 0x100 : 0)];
+  if (index >= 0) {
+    core_.virtualState().getStates().getKeys()[index].pressed =
+        !(stroke.state & INTERCEPTION_KEY_UP);
+  }
+}
+
+bool ScenarioMachine::resolveStroke(const std::string &key,
+                                    unsigned short &scanCode,
+                                    bool &needsE0) const {
+  int index = physicalIndex(key);
+  if (index >= 0) {
+    const KeyState &state = core_.getPhysicalStates().getKeys()[index];
+    scanCode = state.scanCode;
+    needsE0 = state.needsE0;
+    return true;
+  }
+  for (const NamedKey &named : kNamedKeys) {
+    if (key == named.name) {
+      scanCode = named.scanCode;
+      needsE0 = named.needsE0;
+      return true;
+    }
+  }
+  return parseScanCode(key, scanCode, needsE0);
+}
+
+int ScenarioMachine::physicalIndex(const std::string &id) const {
+  const auto &keys = core_.getPhysicalStates().getKeys();
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (keys[i].id == id) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+VirtualKeyState *ScenarioMachine::virtualKey(const std::string &id) {
+  return core_.virtualState().getStates().findKeyById(id);
+}
+
+std::string ScenarioMachine::execute(const ScenarioCommand &command,
+                                     ScenarioResult &result) {
+  switch (command.op) {
+  case ScenarioOp::Monitor:
+    config_.setMonitorCtrl(false);
+    config_.setMonitorShift(false);
+    config_.setMonitorAlt(false);
+    config_.setMonitorWin(false);
+    for (const std::string &group : command.keys) {
+      if (group == "ctrl") {
+        config_.setMonitorCtrl(true);
+      } else if (group == "shift") {
+        config_.setMonitorShift(true);
+      } else if (group == "alt") {
+        config_.setMonitorAlt(true);
+      } else {
+        config_.setMonitorWin(true);
+      }
+    }
+    return "";
+  case ScenarioOp::Disable: {
+    std::vector<std::string> keys = config_.getDisabledKeys();
+    keys.push_back(command.key);
+    config_.setDisabledKeys(keys);
+    return "";
+  }
+  case ScenarioOp::Custom: {
+    std::vector<CustomKeyConfig> keys = config_.getCustomKeys();
+    keys.emplace_back(command.scanCode, command.needsE0, command.key,
+                      static_cast<int>(command.value));
+    config_.setCustomKeys(keys);
+    return "";
+  }
+  case ScenarioOp::Map: {
+    std::vector<KeyMappingConfig> mappings = config_.getKeyMappings();
+    mappings.emplace_back(command.scanCode, command.needsE0, command.key);
+    config_.setKeyMappings(mappings);
+    return "";
+  }
+  case ScenarioOp::Threshold:
+    if (command.key.empty()) {
+      config_.setThresholdMs(static_cast<int>(command.value));
+      core_.setThreshold(static_cast<int>(command.value));
+    } else if (!started_) {
+      keyThresholds_.emplace_back(command.key,
+                                  static_cast<int>(command.value));
+    } else if (physicalIndex(command.key) >= 0) {
+      core_.logic().setKeyThreshold(physicalIndex(command.key),
+                                    static_cast<int>(command.value));
+    } else {
+      return "key '" + command.key + "' is not monitored";
+    }
+    return "";
+  case ScenarioOp::Trigger: {
+    FixTrigger trigger = FixTrigger::IdleKeyDown;
+    parseFixTrigger(command.key, trigger);
+    core_.logic().setTrigger(trigger);
+    return "";
+  }
+  case ScenarioOp::Timer:
+    config_.setTimerFix(command.value != 0);
+    core_.setTimerFix(command.value != 0);
+    return "";
+  case ScenarioOp::ReleaseCheck:
+    config_.setReleaseCheckMs(static_cast<int>(command.value));
+    core_.logic().setReleaseCheck(static_cast<int>(command.value));
+    return "";
+  case ScenarioOp::LostKeyDown:
+    config_.setLostKeyDownMs(static_cast<int>(command.value));
+    core_.logic().setLostKeyDownThreshold(static_cast<int>(command.value));
+    return "";
+  case ScenarioOp::Repair:
+    config_.setRepairKeyDown(command.value != 0);
+    core_.setRepairKeyDown(command.value != 0);
+    return "";
+  case ScenarioOp::Poll:
+    pollNs_ = command.value * kNsPerMs;
+    return "";
+  case ScenarioOp::Settle:
+    core_.setFixSettleMs(static_cast<int>(command.value));
+    return "";
+  default:
+    break;
+  }
+
+  if (!started_) {
+    std::string message = start();
+    if (!message.empty()) {
+      return message;
+    }
+  }
+
+  switch (command.op) {
+  case ScenarioOp::Down:
+  case ScenarioOp::Up: {
+    unsigned short scanCode = 0;
+    bool needsE0 = false;
+    if (!resolveStroke(command.key, scanCode, needsE0)) {
+      return "unknown key '" + command.key + "'";
+    }
+    stroke_.code = scanCode;
+    stroke_.state = (command.op == ScenarioOp::Up ? INTERCEPTION_KEY_UP
+                                                  : INTERCEPTION_KEY_DOWN) |
+                    (needsE0 ? INTERCEPTION_KEY_E0 : 0);
+    stroke_.information = 0;
+    pending_ = true;
+    lost_ = command.flag;
+    fixed_.clear();
+    iterate();
+    lost_ = false;
+    result.strokes++;
+    return "";
+  }
+  case ScenarioOp::Virt: {
+    VirtualKeyState *key = virtualKey(command.key);
+    if (!key) {
+      return "key '" + command.key + "' is not monitored";
+    }
+    key->pressed = command.value != 0;
+    iterate();
+    return "";
+  }
+  case ScenarioOp::Advance: {
+    int64_t target = nowNs_ + command.value;
+    fixed_.clear();
+    while (nextIdleNs() <= target) {
+      if (!core_.logic().hasAnyMismatch() &&
+          !core_.logic().hasAnyMissing()) {
+        // Nothing changes without input: skip the idle iterations
+        lastIterationNs_ += ((target - lastIterationNs_) / pollNs_) * pollNs_;
+        break;
+      }
+      nowNs_ = nextIdleNs();
+      iterate();
+    }
+    nowNs_ = std::max(nowNs_, target);
+    return "";
+  }
+  default:
+    break;
+  }
+
+  // Checks
+  result.checks++;
+  if (command.op == ScenarioOp::ExpectFix) {
+    std::vector<std::string> fixed = fixed_;
+    std::sort(fixed.begin(), fixed.end());
+    if (fixed != command.keys) {
+      return "expected " + joinIds(command.keys) + ", got " + joinIds(fixed);
+    }
+    return "";
+  }
+  if (command.op == ScenarioOp::ExpectFixes) {
+    if (static_cast<int64_t>(fixes_) != command.value) {
+      return "expected " + std::to_string(command.value) + " fixes, got " +
+             std::to_string(fixes_);
+    }
+    return "";
+  }
+
+  int index = physicalIndex(command.key);
+  if (index < 0) {
+    return "key '" + command.key + "' is not monitored";
+  }
+  if (command.op == ScenarioOp::ExpectTracker) {
+    const FixLogic &logic = core_.logic();
+    const MismatchTracker *tracker =
+        logic.getTrackers().getTracker(command.key);
+    Clock::TimePoint now = core_.clock().now();
+    ScenarioTracker state =
+        logic.isStuck(index, now) ? ScenarioTracker::Stuck
+        : tracker && tracker->isMismatched ? ScenarioTracker::Mismatch
+        : logic.isMissing(index)           ? ScenarioTracker::Missing
+                                           : ScenarioTracker::Ok;
+    if (state != command.tracker) {
+      std::string message = "expected " + command.key + " " +
+                            trackerName(command.tracker) + ", got " +
+                            trackerName(state);
+      if (state == ScenarioTracker::Missing) {
+        message +=
+            " (" + std::to_string(logic.getMissingMs(index, now)) + " ms)";
+      } else if (state != ScenarioTracker::Ok) {
+        message += " (" + std::to_string(logic.getMismatchMs(index, now)) +
+                   " ms)";
+      }
+      return message;
+    }
+    return "";
+  }
+
+  bool pressed;
+  if (command.op == ScenarioOp::ExpectPhysical) {
+    pressed = core_.getPhysicalStates().getKeys()[index].pressed;
+  } else {
+    VirtualKeyState *key = virtualKey(command.key);
+    if (!key) {
+      return "key '" + command.key + "' has no OS state";
+    }
+    pressed = key->pressed;
+  }
+  if (pressed != (command.value != 0)) {
+    return std::string("expected ") +
+           (command.op == ScenarioOp::ExpectPhysical ? "phys " : "virt ") +
+           command.key + "=" + std::to_string(command.value) + ", got " +
+           (pressed ? "1" : "0");
+  }
+  return "";
+}
+
+} // namespace
+
+bool parseScenario(const std::string &text, Scenario &scenario,
+                   std::string &error) {
+  scenario.commands.clear();
+  bool started = false;
+  int lineNumber = 0;
+  std::istringstream lines(text);
+  std::string line;
+  while (std::getline(lines, line)) {
+    ++lineNumber;
+    line = line.substr(0, line.find('#'));
+
+    std::istringstream commands(line);
+    std::string part;
+    while (std::getline(commands, part, ';')) {
+      std::istringstream stream(part);
+      std::vector<std::string> words;
+      std::string word;
+      while (stream >> word) {
+        std::transform(word.begin(), word.end(), word.begin(),
+                       [](unsigned char c) { return std::tolower(c); });
+        words.push_back(word);
+      }
+      if (words.empty()) {
+        continue;
+      }
+
+      ScenarioCommand command;
+      command.line = lineNumber;
+      std::string message = parseCommand(words, command);
+      if (message.empty() && isSetup(command.op) && started) {
+        message = words[0] + " must come before other commands";
+      }
+      if (!message.empty()) {
+        error = "line " + std::to_string(lineNumber) + ": " + message;
+        return false;
+      }
+      started = started || !isSetup(command.op);
+      scenario.commands.push_back(std::move(command));
+    }
+  }
+  return true;
+}
+
+ScenarioResult runScenario(const Scenario &scenario) {
+  ScenarioResult result;
+  ScenarioMachine machine;
+  for (const ScenarioCommand &command : scenario.commands) {
+    std::string message = machine.execute(command, result);
+    if (!message.empty()) {
+      result.line = command.line;
+      result.message = message;
+      return result;
+    }
+  }
+  result.passed = true;
+  return result;
+}
+
+bool loadScenarioFile(const std::string &path, Scenario &scenario,
+                      std::string &error) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    error = "cannot read file";
+    return false;
+  }
+  std::ostringstream text;
+  text << file.rdbuf();
+  scenario.name = path;
+  return parseScenario(text.str(), scenario, error);
+}
+
+ScenarioResult runScenarioFile(const std::string &path) {
+  Scenario scenario;
+  std::string error;
+  if (!loadScenarioFile(path, scenario, error)) {
+    ScenarioResult result;
+    result.message = error;
+    return result;
+  }
+  return runScenario(scenario);
+}
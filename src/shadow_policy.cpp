@@ -0,0 +1,233 @@
+#include "shadow_policy.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <sstream>
+
+std::string ShadowPolicy::describe() const {
+  return std::to_string(thresholdMs) + "ms " + fixTriggerName(trigger);
+}
+
+bool ShadowPolicy::parse(const std::string &text, ShadowPolicy &policy) {
+  size_t colon = text.find(':');
+  std::string ms = text.substr(0, colon);
+  char *end = nullptr;
+  long value = std::strtol(ms.c_str(), &end, 10);
+  if (ms.empty() || *end != '\0' || value <= 0) {
+    return false;
+  }
+  ShadowPolicy parsed;
+  parsed.thresholdMs = static_cast<int>(value);
+  if (colon != std::string::npos &&
+      !parseFixTrigger(text.substr(colon + 1), parsed.trigger)) {
+    return false;
+  }
+  policy = parsed;
+  return true;
+}
+
+ShadowEvaluator::ShadowEvaluator()
+    : active_(false), clock_(nullptr), mask_(0), head_(0), tail_(0),
+      dropped_(0), lastPhysicalMask_(0), lastVirtualMask_(0),
+      stopRequested_(false) {}
+
+ShadowEvaluator::~ShadowEvaluator() { stop(); }
+
+void ShadowEvaluator::start(const std::vector<ShadowPolicy> &policies,
+                            const ModifierKeyStates &physical,
+                            const VirtualKeyStates &virtualStates,
+                            const Clock &clock, size_t capacity) {
+  stop();
+  if (policies.empty()) {
+    return;
+  }
+
+  clock_ = &clock;
+  physical_ = physical;
+  virtual_ = virtualStates;
+  shadows_.clear();
+  results_.clear();
+  for (const ShadowPolicy &policy : policies) {
+    auto shadow = std::make_unique<Shadow>();
+    shadow->logic.setThreshold(policy.thresholdMs);
+    shadow->logic.setTrigger(policy.trigger);
+    shadow->logic.initialize(physical_, virtual_);
+    shadow->result.policy = policy;
+    size_t keyCount = shadow->logic.getKeyCount();
+    shadow->fixed.assign(keyCount, false);
+    shadow->liveFixed.assign(keyCount, false);
+    shadow->fixedAtNs.assign(keyCount, 0);
+    results_.push_back(shadow->result);
+    shadows_.push_back(std::move(shadow));
+  }
+  events_.reserve(3 * physical_.getKeys().size());
+
+  // Power of two so the ring index is a mask
+  size_t size = 1;
+  while (size < std::max<size_t>(capacity, 2)) {
+    size <<= 1;
+  }
+  ring_.assign(size, Event());
+  mask_ = size - 1;
+  head_.store(0, std::memory_order_relaxed);
+  tail_.store(0, std::memory_order_relaxed);
+  dropped_.store(0, std::memory_order_relaxed);
+  lastPhysicalMask_ = physical_.pressedMask();
+  lastVirtualMask_ = virtual_.pressedMask();
+
+  stopRequested_ = false;
+  thread_ = std::thread(&ShadowEvaluator::evaluatorLoop, this);
+  active_ = true;
+}
+
+void ShadowEvaluator::stop() {
+  if (!thread_.joinable()) {
+    return;
+  }
+  active_ = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopRequested_ = true;
+  }
+  wake_.notify_all();
+  thread_.join();
+}
+
+std::vector<ShadowResult> ShadowEvaluator::getResults() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return results_;
+}
+
+std::string ShadowEvaluator::summary(uint64_t liveFixes) const {
+  std::ostringstream out;
+  out << "Live policy: " << liveFixes << " fixes\n";
+  out.setf(std::ios::fixed);
+  out.precision(0);
+  for (const ShadowResult &result : getResults()) {
+    out << "Shadow " << result.policy.describe() << ": " << result.wouldFix
+        << " would fix (" << result.agreed << " agreed, "
+        << result.shadowOnly << " shadow only), " << result.liveOnly
+        << " live only";
+    if (result.agreed > 0) {
+      out << ", " << result.meanLeadMs() << "ms earlier on average";
+    }
+    out << "\n";
+  }
+  uint64_t dropped = getDroppedCount();
+  if (dropped > 0) {
+    out << "(" << dropped << " events dropped)\n";
+  }
+  return out.str();
+}
+
+void ShadowEvaluator::waitIdle() {
+  while (thread_.joinable() && tail_.load(std::memory_order_acquire) !=
+                                   head_.load(std::memory_order_acquire)) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  // The last batch is published under the mutex after tail_ moves
+  std::lock_guard<std::mutex> lock(mutex_);
+}
+
+void ShadowEvaluator::evaluatorLoop() {
+  while (true) {
+    bool stopping;
+    {
+      // Polled: the input thread never signals, so it never makes a syscall
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait_for(lock, std::chrono::milliseconds(10),
+                     [this] { return stopRequested_; });
+      stopping = stopRequested_;
+    }
+
+    uint64_t head = head_.load(std::memory_order_acquire);
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    if (head != tail) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (; tail != head; ++tail) {
+        evaluate(ring_[tail & mask_]);
+      }
+      for (size_t i = 0; i < shadows_.size(); ++i) {
+        results_[i] = shadows_[i]->result;
+      }
+      tail_.store(tail, std::memory_order_release);
+    }
+
+    if (stopping) {
+      return;
+    }
+  }
+}
+
+void ShadowEvaluator::evaluate(const Event &event) {
+  Clock::TimePoint now{std::chrono::duration_cast<Clock::TimePoint::duration>(
+      std::chrono::nanoseconds(event.timeNs))};
+
+  switch (event.type) {
+  case kStroke: {
+    InterceptionKeyStroke stroke;
+    stroke.code = event.code;
+    stroke.state = event.state;
+    stroke.information = 0;
+    for (auto &shadow : shadows_) {
+      if (!shadow->logic.shouldFix(stroke, physical_, now)) {
+        continue;
+      }
+      for (size_t i = 0; i < shadow->fixed.size(); ++i) {
+        // Still stuck in the shadow's view, but decided once per episode
+        if (shadow->logic.isStuck(i, now) && !shadow->fixed[i] &&
+            !shadow->liveFixed[i]) {
+          shadow->fixed[i] = true;
+          shadow->fixedAtNs[i] = event.timeNs;
+          shadow->result.wouldFix++;
+        }
+      }
+    }
+    break;
+  }
+
+  case kState: {
+    auto &physicalKeys = physical_.getKeys();
+    for (size_t i = 0; i < physicalKeys.size() && i < 32; ++i) {
+      physicalKeys[i].pressed = (event.physicalMask >> i) & 1;
+    }
+    auto &virtualKeys = virtual_.getKeys();
+    for (size_t i = 0; i < virtualKeys.size() && i < 32; ++i) {
+      virtualKeys[i].pressed = (event.virtualMask >> i) & 1;
+    }
+    for (auto &shadow : shadows_) {
+      events_.clear();
+      shadow->logic.updateTrackers(physical_, virtual_, now, &events_);
+      for (const TrackerEvent &change : events_) {
+        if (change.change != TrackerChange::Reset) {
+          continue;
+        }
+        size_t i = change.keyIndex;
+        if (shadow->fixed[i]) {
+          shadow->result.shadowOnly++;
+        }
+        shadow->fixed[i] = false;
+        shadow->liveFixed[i] = false;
+      }
+    }
+    break;
+  }
+
+  case kLiveFix:
+    for (auto &shadow : shadows_) {
+      size_t i = event.keyIndex;
+      if (i >= shadow->fixed.size()) {
+        continue;
+      }
+      if (shadow->fixed[i]) {
+        shadow->result.agreed++;
+        shadow->result.leadNs += event.timeNs - shadow->fixedAtNs[i];
+        shadow->fixed[i] = false;
+      } else {
+        shadow->result.liveOnly++;
+      }
+      shadow->liveFixed[i] = true;
+    }
+    break;
+  }
+}
@@ -0,0 +1,342 @@
+#include "simulator.h"
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+constexpr uint64_t kNsPerMs = 1000000;
+
+FixLogic::TimePoint toTimePoint(uint64_t ns) {
+  return FixLogic::TimePoint(
+      std::chrono::duration_cast<FixLogic::TimePoint::duration>(
+          std::chrono::nanoseconds(ns)));
+}
+
+uint64_t msToNs(double ms) {
+  return ms > 0 ? static_cast<uint64_t>(ms * kNsPerMs) : 0;
+}
+
+size_t scanIndex(uint16_t code, bool e0) {
+  return (code & 0xFF) | (e0 ? 0x100 : 0);
+}
+
+} // namespace
+
+// Simulation policies
+bool Simulator::Input::receive(InterceptionDevice,
+                               InterceptionKeyStroke &stroke) {
+  if (!sim_->stroke_) {
+    return false;
+  }
+  stroke.code = sim_->stroke_->code;
+  stroke.state = sim_->stroke_->state;
+  stroke.information = 0;
+  sim_->stroke_ = nullptr;
+  return true;
+}
+
+Clock::TimePoint Simulator::SimClock::now() const {
+  return toTimePoint(sim_->nowNs_);
+}
+
+void Simulator::SimClock::sleepMs(int ms) { sim_->nowNs_ += msToNs(ms); }
+
+void Simulator::Sink::keyFixed(InterceptionDevice, size_t keyIndex,
+                               const KeyState &, int mismatchMs) {
+  int virtualIndex = sim_->physicalToVirtual_[keyIndex];
+  FixDecision decision;
+  decision.timeNs = sim_->nowNs_;
+  decision.keyIndex = keyIndex;
+  decision.mismatchMs = mismatchMs;
+  decision.triggerCode = triggerCode_;
+  decision.releaseCheck = releaseCheck_;
+  decision.causedByDrop =
+      virtualIndex >= 0 && sim_->droppedAt_[virtualIndex] != 0;
+  sim_->report_.decisions.push_back(decision);
+  sim_->report_.fixes++;
+  if (releaseCheck_) {
+    sim_->report_.releaseCheckFixes++;
+  } else if (triggerCode_ == 0) {
+    sim_->report_.timerFixes++;
+  }
+  if (!decision.causedByDrop) {
+    sim_->report_.falseFixes++;
+  }
+}
+
+// Simulator implementation
+Simulator::Simulator(const SimulationOptions &options)
+    : options_(options), random_(options.layer.seed),
+      core_(Input(this), VirtualLayer(this), SimClock(this), Sink(this)),
+      stroke_(nullptr), pendingHead_(0), lastDueNs_(0), nowNs_(0),
+      lastIterationNs_(0),
+      pollNs_(msToNs(options.pollTimeoutMs > 0 ? options.pollTimeoutMs : 1)) {
+  core_.setFixSettleMs(options.fixSettleMs);
+  core_.logic().setClock(&core_.clock());
+}
+
+void Simulator::initialize() {
+  core_.initialize();
+  setup();
+}
+
+void Simulator::initialize(const Config &config) {
+  core_.initialize(config);
+  setup();
+}
+
+bool Simulator::setKeyThreshold(const std::string &keyId, int ms) {
+  return core_.logic().setKeyThreshold(keyId, ms);
+}
+
+void Simulator::setup() {
+  const auto &physKeys = core_.getPhysicalStates().getKeys();
+  const auto &virtKeys = core_.getVirtualStates().getKeys();
+  scanToVirtual_.assign(0x200, -1);
+  physicalToVirtual_.assign(physKeys.size(), -1);
+  for (size_t i = 0; i < physKeys.size(); ++i) {
+    for (size_t v = 0; v < virtKeys.size(); ++v) {
+      if (virtKeys[v].id == physKeys[i].id) {
+        physicalToVirtual_[i] = static_cast<int>(v);
+        if (physKeys[i].scanCode <= 0xFF) {
+          scanToVirtual_[scanIndex(physKeys[i].scanCode,
+                                   physKeys[i].needsE0)] = static_cast<int>(v);
+        }
+        break;
+      }
+    }
+  }
+  droppedAt_.assign(virtKeys.size(), 0);
+  missedAt_.assign(virtKeys.size(), 0);
+
+  pending_.clear();
+  pendingHead_ = 0;
+  lastDueNs_ = 0;
+  nowNs_ = 0;
+  lastIterationNs_ = 0;
+  report_ = SimulationReport();
+}
+
+void Simulator::feed(const SimStroke &stroke) {
+  // A fix settle delay may have pushed virtual time past the stroke
+  uint64_t time = std::max(stroke.timeNs, nowNs_);
+  advanceTo(time);
+  nowNs_ = time;
+  iterate(&stroke);
+}
+
+void Simulator::run(const std::vector<SimStroke> &strokes) {
+  for (const auto &stroke : strokes) {
+    feed(stroke);
+  }
+  // Let in-flight virtual changes land and the trackers observe them
+  advanceTo(std::max(nowNs_, lastDueNs_) + pollNs_);
+}
+
+// Time the wait of the last iteration times out
+uint64_t Simulator::nextIdleNs() const {
+  int waitMs = core_.waitTimeoutMs(std::numeric_limits<int>::max());
+  return std::min(lastIterationNs_ + pollNs_, nowNs_ + msToNs(waitMs));
+}
+
+void Simulator::advanceTo(uint64_t timeNs) {
+  while (nextIdleNs() <= timeNs) {
+    if (pendingHead_ == pending_.size() && !core_.logic().hasAnyMismatch() &&
+        !core_.logic().hasAnyMissing()) {
+      // Nothing can change before the next stroke: skip the idle iterations
+      lastIterationNs_ += ((timeNs - lastIterationNs_) / pollNs_) * pollNs_;
+      break;
+    }
+    nowNs_ = nextIdleNs();
+    iterate(nullptr);
+  }
+  if (timeNs > nowNs_) {
+    nowNs_ = timeNs;
+  }
+  report_.endTimeNs = nowNs_;
+}
+
+void Simulator::iterate(const SimStroke *stroke) {
+  lastIterationNs_ = nowNs_;
+  stroke_ = stroke;
+  core_.processEvents(0);
+  report_.endTimeNs = nowNs_;
+}
+
+void Simulator::forward(uint16_t code, uint16_t state, bool injected) {
+  if (code > 0xFF) {
+    return;
+  }
+  int virtualIndex =
+      scanToVirtual_[scanIndex(code, (state & INTERCEPTION_KEY_E0) != 0)];
+  if (virtualIndex < 0) {
+    return;
+  }
+
+  bool pressed = !(state & INTERCEPTION_KEY_UP);
+  if (pressed && !injected && options_.layer.dropKeyDownRate > 0 &&
+      random_.uniform() < options_.layer.dropKeyDownRate) {
+    report_.droppedKeyDowns++;
+    if (missedAt_[virtualIndex] == 0) {
+      missedAt_[virtualIndex] = std::max<uint64_t>(nowNs_, 1);
+    }
+    return;
+  }
+  // Letting go of a key the OS never registered ends the miss
+  if (!pressed && missedAt_[virtualIndex] != 0) {
+    report_.missingNs += nowNs_ - missedAt_[virtualIndex];
+    missedAt_[virtualIndex] = 0;
+  }
+  if (!pressed && !injected && options_.layer.dropKeyUpRate > 0 &&
+      random_.uniform() < options_.layer.dropKeyUpRate) {
+    report_.droppedKeyUps++;
+    if (droppedAt_[virtualIndex] == 0) {
+      droppedAt_[virtualIndex] = std::max<uint64_t>(nowNs_, 1);
+    }
+    return;
+  }
+
+  uint64_t due = nowNs_ + msToNs(options_.layer.lagMs);
+  if (options_.layer.lagJitterMs > 0) {
+    due += msToNs(options_.layer.lagJitterMs * random_.uniform());
+  }
+  // The OS applies input in order
+  due = std::max(due, lastDueNs_);
+  lastDueNs_ = due;
+
+  PendingChange change;
+  change.dueNs = due;
+  change.virtualIndex = virtualIndex;
+  change.pressed = pressed;
+  change.injected = injected;
+  pending_.push_back(change);
+}
+
+void Simulator::applyDueChanges() {
+  auto &virtKeys = core_.virtualState().getStates().getKeys();
+  while (pendingHead_ < pending_.size() &&
+         pending_[pendingHead_].dueNs <= nowNs_) {
+    const PendingChange &change = pending_[pendingHead_++];
+    virtKeys[change.virtualIndex].pressed = change.pressed;
+
+    uint64_t &missedAt = missedAt_[change.virtualIndex];
+    if (change.pressed && missedAt != 0) {
+      report_.missingNs += change.dueNs - missedAt;
+      missedAt = 0;
+    }
+
+    uint64_t &droppedAt = droppedAt_[change.virtualIndex];
+    if (!change.pressed && droppedAt != 0) {
+      report_.stuckNs += change.dueNs - droppedAt;
+      if (!change.injected) {
+        report_.selfHealed++;
+      }
+      droppedAt = 0;
+    }
+  }
+
+  if (pendingHead_ == pending_.size()) {
+    pending_.clear();
+    pendingHead_ = 0;
+  }
+}
+
+int Simulator::countStuckKeys() const {
+  int count = 0;
+  for (uint64_t droppedAt : droppedAt_) {
+    if (droppedAt != 0) {
+      count++;
+    }
+  }
+  return count;
+}
+
+// Trace generation and conversion
+std::vector<SimStroke> generateTrace(const TraceGeneratorOptions &options,
+                                     const ModifierKeyStates &keys) {
+  // Letter keys used for plain presses and as chord targets
+  static const uint16_t kLetters[] = {0x10, 0x11, 0x12, 0x13, 0x14, 0x15,
+                                      0x16, 0x17, 0x18, 0x19, 0x1E, 0x1F,
+                                      0x20, 0x21, 0x22, 0x23, 0x24, 0x25,
+                                      0x26, 0x2C, 0x2D, 0x2E, 0x2F, 0x30};
+  const size_t letterCount = sizeof(kLetters) / sizeof(kLetters[0]);
+
+  SimRandom random(options.seed);
+  const auto &modifiers = keys.getKeys();
+  std::vector<SimStroke> strokes;
+  strokes.reserve(static_cast<size_t>(options.strokeCount) + 8);
+
+  uint64_t time = 0;
+  auto jitter = [&random](double meanMs) {
+    return msToNs(meanMs * (0.5 + random.uniform()));
+  };
+  auto emit = [&strokes, &time](uint16_t code, bool e0, bool up) {
+    uint16_t state = up ? INTERCEPTION_KEY_UP : INTERCEPTION_KEY_DOWN;
+    if (e0) {
+      state |= INTERCEPTION_KEY_E0;
+    }
+    strokes.push_back({time, code, state});
+  };
+
+  while (strokes.size() < options.strokeCount) {
+    time += jitter(options.meanGapMs);
+    uint16_t letter = kLetters[random.range(0, letterCount - 1)];
+
+    if (!modifiers.empty() && random.uniform() < options.chordRate) {
+      // One or two distinct modifiers around a letter
+      size_t first = static_cast<size_t>(random.range(0, modifiers.size() - 1));
+      size_t second = first;
+      if (modifiers.size() > 1 && random.uniform() < 0.25) {
+        while (second == first) {
+          second = static_cast<size_t>(random.range(0, modifiers.size() - 1));
+        }
+      }
+
+      emit(modifiers[first].scanCode, modifiers[first].needsE0, false);
+      if (second != first) {
+        time += jitter(30.0);
+        emit(modifiers[second].scanCode, modifiers[second].needsE0, false);
+      }
+      time += jitter(40.0);
+      emit(letter, false, false);
+      time += jitter(options.holdMs);
+      emit(letter, false, true);
+      time += jitter(40.0);
+      if (second != first) {
+        emit(modifiers[second].scanCode, modifiers[second].needsE0, true);
+        time += jitter(20.0);
+      }
+      emit(modifiers[first].scanCode, modifiers[first].needsE0, true);
+    } else {
+      emit(letter, false, false);
+      time += jitter(options.holdMs);
+      emit(letter, false, true);
+    }
+  }
+
+  return strokes;
+}
+
+std::vector<SimStroke> strokesFromTrace(const TraceFormat::TraceFile &trace) {
+  std::vector<SimStroke> strokes;
+  strokes.reserve(trace.records.size());
+  for (const auto &record : trace.records) {
+    if (record.type == TraceFormat::kRecordStroke) {
+      strokes.push_back({record.timestampNs, record.code, record.state});
+    }
+  }
+  return strokes;
+}
+
+std::vector<TraceFormat::TraceRecord>
+strokesToRecords(const std::vector<SimStroke> &strokes) {
+  std::vector<TraceFormat::TraceRecord> records(strokes.size());
+  for (size_t i = 0; i < strokes.size(); ++i) {
+    records[i].timestampNs = strokes[i].timeNs;
+    records[i].type = TraceFormat::kRecordStroke;
+    records[i].device = 1;
+    records[i].code = strokes[i].code;
+    records[i].state = strokes[i].state;
+  }
+  return records;
+}
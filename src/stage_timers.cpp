@@ -0,0 +1,113 @@
+#include "stage_timers.h"
+#include <algorithm>
+#include <cstdio>
+
+const char *stageName(Stage stage) {
+  switch (stage) {
+  case Stage::Wait:
+    return "wait";
+  case Stage::Receive:
+    return "receive";
+  case Stage::CheckFix:
+    return "checkFix";
+  case Stage::Fix:
+    return "fix";
+  case Stage::PhysicalUpdate:
+    return "physical";
+  case Stage::Forward:
+    return "forward";
+  case Stage::VirtualUpdate:
+    return "virtual";
+  case Stage::TrackerUpdate:
+    return "trackers";
+  default:
+    return "unknown";
+  }
+}
+
+StageTimers::StageTimers() { reset(); }
+
+void StageTimers::reset() {
+  for (auto &counter : stages_) {
+    counter.count.store(0, std::memory_order_relaxed);
+    counter.totalTicks.store(0, std::memory_order_relaxed);
+    counter.maxTicks.store(0, std::memory_order_relaxed);
+    counter.histogram.reset();
+  }
+}
+
+uint64_t StageTimers::getCount(Stage stage) const {
+  return stages_[static_cast<int>(stage)].count.load(
+      std::memory_order_relaxed);
+}
+
+uint64_t StageTimers::getTotalNs(Stage stage) const {
+  return CycleClock::toNanoseconds(
+      stages_[static_cast<int>(stage)].totalTicks.load(
+          std::memory_order_relaxed));
+}
+
+uint64_t StageTimers::getMaxNs(Stage stage) const {
+  return CycleClock::toNanoseconds(
+      stages_[static_cast<int>(stage)].maxTicks.load(
+          std::memory_order_relaxed));
+}
+
+std::string StageTimers::dump() const {
+  std::string text;
+  char line[160];
+  snprintf(line, sizeof(line), "%-10s %10s %10s %10s %10s %10s %10s\n",
+           "stage", "count", "total", "mean", "p50", "p99", "max");
+  text += line;
+
+  for (int i = 0; i < kStageCount; ++i) {
+    Stage stage = static_cast<Stage>(i);
+    uint64_t count = getCount(stage);
+    uint64_t totalNs = getTotalNs(stage);
+    const LatencyHistogram &histogram = getHistogram(stage);
+    snprintf(line, sizeof(line), "%-10s %10llu %10s %10s %10s %10s %10s\n",
+             stageName(stage), static_cast<unsigned long long>(count),
+             formatLatency(totalNs).c_str(),
+             formatLatency(count ? totalNs / count : 0).c_str(),
+             formatLatency(histogram.valueAtPercentile(50.0)).c_str(),
+             formatLatency(histogram.valueAtPercentile(99.0)).c_str(),
+             formatLatency(getMaxNs(stage)).c_str());
+    text += line;
+  }
+  return text;
+}
+
+std::string StageTimers::logLine() const {
+  char line[256];
+  formatLogLine(line, sizeof(line));
+  return line;
+}
+
+size_t StageTimers::formatLogLine(char *buffer, size_t size) const {
+  if (size == 0) {
+    return 0;
+  }
+  size_t length = 0;
+  buffer[0] = '\0';
+  for (int i = 0; i < kStageCount && length + 1 < size; ++i) {
+    Stage stage = static_cast<Stage>(i);
+    uint64_t count = getCount(stage);
+    if (count == 0) {
+      continue;
+    }
+    char mean[32];
+    char max[32];
+    formatLatency(getTotalNs(stage) / count, mean, sizeof(mean));
+    formatLatency(getMaxNs(stage), max, sizeof(max));
+    int written = snprintf(buffer + length, size - length, "%s%s=%s/%s",
+                           length ? " " : "", stageName(stage), mean, max);
+    if (written < 0) {
+      break;
+    }
+    length = std::min(size - 1, length + static_cast<size_t>(written));
+  }
+  if (length == 0) {
+    return static_cast<size_t>(snprintf(buffer, size, "no samples"));
+  }
+  return length;
+}
@@ -0,0 +1,89 @@
+#include "startup_timer.h"
+#include "latency_histogram.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+namespace {
+
+uint64_t toNs(Clock::TimePoint::duration duration) {
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(duration);
+  return ns.count() > 0 ? static_cast<uint64_t>(ns.count()) : 0;
+}
+
+} // namespace
+
+StartupTimer::StartupTimer(const Clock &clock)
+    : clock_(&clock), preStartNs_(0), interceptionLiveNs_(0),
+      interceptionLive_(false) {
+  start();
+}
+
+void StartupTimer::start() {
+  start_ = clock_->now();
+  last_ = start_;
+  phases_.clear();
+  interceptionLiveNs_ = 0;
+  interceptionLive_ = false;
+}
+
+void StartupTimer::mark(const char *phase) {
+  Clock::TimePoint now = clock_->now();
+  phases_.push_back({phase, toNs(now - last_), toNs(now - start_)});
+  last_ = now;
+}
+
+void StartupTimer::markInterceptionLive(const char *phase) {
+  mark(phase);
+  interceptionLiveNs_ = phases_.back().sinceStartNs;
+  interceptionLive_ = true;
+}
+
+uint64_t StartupTimer::getTimeToInterceptionNs() const {
+  return interceptionLive_ ? preStartNs_ + interceptionLiveNs_ : 0;
+}
+
+uint64_t StartupTimer::getTotalNs() const {
+  return preStartNs_ + (phases_.empty() ? 0 : phases_.back().sinceStartNs);
+}
+
+std::string StartupTimer::summary() const {
+  std::string line;
+  if (preStartNs_ > 0) {
+    line = "process " + formatLatency(preStartNs_);
+  }
+  for (const Phase &phase : phases_) {
+    if (!line.empty()) {
+      line += " | ";
+    }
+    line += phase.name + " " + formatLatency(phase.durationNs);
+  }
+  if (interceptionLive_) {
+    line += " | interception live at " +
+            formatLatency(getTimeToInterceptionNs());
+  }
+  return line;
+}
+
+uint64_t StartupTimer::processAgeNs() {
+#ifdef _WIN32
+  FILETIME creation, exitTime, kernel, user, now;
+  if (!GetProcessTimes(GetCurrentProcess(), &creation, &exitTime, &kernel,
+                       &user)) {
+    return 0;
+  }
+  GetSystemTimeAsFileTime(&now);
+  ULARGE_INTEGER created, current;
+  created.LowPart = creation.dwLowDateTime;
+  created.HighPart = creation.dwHighDateTime;
+  current.LowPart = now.dwLowDateTime;
+  current.HighPart = now.dwHighDateTime;
+  // FILETIME counts 100ns intervals
+  return current.QuadPart > created.QuadPart
+             ? (current.QuadPart - created.QuadPart) * 100
+             : 0;
+#else
+  return 0;
+#endif
+}
@@ -0,0 +1,314 @@
+#include "stroke_recorder.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// One segment file mapped into memory for its whole lifetime
+struct MappedSegment {
+  std::string path;
+  uint64_t bytes = 0;
+  uint8_t *base = nullptr;
+#ifdef _WIN32
+  HANDLE file = INVALID_HANDLE_VALUE;
+  HANDLE mapping = nullptr;
+#else
+  int fd = -1;
+#endif
+
+  TraceFormat::FileHeader *header() {
+    return reinterpret_cast<TraceFormat::FileHeader *>(base);
+  }
+  TraceFormat::TraceRecord *records() {
+    return reinterpret_cast<TraceFormat::TraceRecord *>(
+        base + TraceFormat::kHeaderSize);
+  }
+
+  // Create the file at full size and map it
+  bool open(const std::string &filePath, uint64_t size) {
+    path = filePath;
+    bytes = size;
+#ifdef _WIN32
+    file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+                       FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+                       FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+      return false;
+    }
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE,
+                                 static_cast<DWORD>(size >> 32),
+                                 static_cast<DWORD>(size & 0xFFFFFFFF),
+                                 nullptr);
+    if (!mapping) {
+      close(0);
+      return false;
+    }
+    base = static_cast<uint8_t *>(
+        MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, static_cast<SIZE_T>(size)));
+#else
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      return false;
+    }
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+      close(0);
+      return false;
+    }
+    void *view = mmap(nullptr, static_cast<size_t>(size),
+                      PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    base = (view == MAP_FAILED) ? nullptr : static_cast<uint8_t *>(view);
+#endif
+    if (!base) {
+      close(0);
+      return false;
+    }
+    return true;
+  }
+
+  // Unmap and close, trimming the file to finalBytes (0 = delete the file)
+  void close(uint64_t finalBytes) {
+#ifdef _WIN32
+    if (base) {
+      FlushViewOfFile(base, 0);
+      UnmapViewOfFile(base);
+    }
+    if (mapping) {
+      CloseHandle(mapping);
+    }
+    if (file != INVALID_HANDLE_VALUE) {
+      if (finalBytes > 0) {
+        LARGE_INTEGER length;
+        length.QuadPart = static_cast<LONGLONG>(finalBytes);
+        SetFilePointerEx(file, length, nullptr, FILE_BEGIN);
+        SetEndOfFile(file);
+      }
+      CloseHandle(file);
+    }
+    mapping = nullptr;
+    file = INVALID_HANDLE_VALUE;
+#else
+    if (base) {
+      msync(base, static_cast<size_t>(bytes), MS_ASYNC);
+      munmap(base, static_cast<size_t>(bytes));
+    }
+    if (fd >= 0) {
+      if (finalBytes > 0 && ftruncate(fd, static_cast<off_t>(finalBytes))) {
+        // Keep the full-size file; readers only trust recordCount
+      }
+      ::close(fd);
+    }
+    fd = -1;
+#endif
+    base = nullptr;
+    if (finalBytes == 0 && !path.empty()) {
+      std::remove(path.c_str());
+    }
+  }
+};
+
+StrokeRecorder::StrokeRecorder()
+    : thresholdMs_(0), startUnixMs_(0), origin_(0), active_(false),
+      current_(nullptr), header_(nullptr), records_(nullptr), capacity_(0),
+      used_(0), lastVirtualMask_(0), recorded_(0), dropped_(0),
+      stopRequested_(false), spare_(nullptr), nextSequence_(0) {}
+
+StrokeRecorder::~StrokeRecorder() { stop(); }
+
+std::string StrokeRecorder::segmentPath(const std::string &basePath,
+                                        uint64_t sequence) {
+  char suffix[32];
+  snprintf(suffix, sizeof(suffix), ".%06llu",
+           static_cast<unsigned long long>(sequence));
+  return basePath + suffix + TraceFormat::kFileExtension;
+}
+
+bool StrokeRecorder::start(const Options &options,
+                           const std::vector<TraceFormat::KeyInfo> &keys,
+                           int thresholdMs) {
+  if (active_ || options.basePath.empty()) {
+    return false;
+  }
+
+  options_ = options;
+  // Accept "name.emkt" as well as a bare prefix
+  const std::string extension = TraceFormat::kFileExtension;
+  if (options_.basePath.size() > extension.size() &&
+      options_.basePath.compare(options_.basePath.size() - extension.size(),
+                                extension.size(), extension) == 0) {
+    options_.basePath.resize(options_.basePath.size() - extension.size());
+  }
+  if (options_.segmentBytes <
+      TraceFormat::kHeaderSize + 64 * sizeof(TraceFormat::TraceRecord)) {
+    options_.segmentBytes =
+        TraceFormat::kHeaderSize + 64 * sizeof(TraceFormat::TraceRecord);
+  }
+  if (options_.maxSegments < 1) {
+    options_.maxSegments = 1;
+  }
+
+  keys_ = keys;
+  thresholdMs_ = thresholdMs;
+  startUnixMs_ = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count());
+  CycleClock::calibrate();
+  origin_ = CycleClock::now();
+  nextSequence_ = 1;
+  recorded_.store(0, std::memory_order_relaxed);
+  dropped_.store(0, std::memory_order_relaxed);
+  finished_.clear();
+
+  MappedSegment *first = createSegment(nextSequence_++);
+  if (!first) {
+    return false;
+  }
+  current_ = first;
+  header_ = first->header();
+  records_ = first->records();
+  capacity_ = header_->recordCapacity;
+  used_ = 0;
+  lastVirtualMask_ = 0;
+
+  stopRequested_ = false;
+  rotator_ = std::thread(&StrokeRecorder::rotatorLoop, this);
+  active_ = true;
+  return true;
+}
+
+void StrokeRecorder::stop() {
+  if (!active_) {
+    return;
+  }
+  active_ = false;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopRequested_ = true;
+  }
+  wake_.notify_one();
+  rotator_.join();
+
+  // The rotation thread has exited; finish up on this thread
+  if (current_) {
+    retireSegment(current_, false);
+    current_ = nullptr;
+    header_ = nullptr;
+    records_ = nullptr;
+  }
+  if (spare_) {
+    spare_->close(0);
+    delete spare_;
+    spare_ = nullptr;
+  }
+}
+
+std::string StrokeRecorder::getCurrentPath() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return current_ ? current_->path : std::string();
+}
+
+bool StrokeRecorder::rotate() {
+  // Never wait for the rotation thread: it may be busy finalizing
+  std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+  if (!lock.owns_lock() || !spare_) {
+    return false;
+  }
+
+  if (current_) {
+    retired_.push_back(current_);
+  }
+  current_ = spare_;
+  spare_ = nullptr;
+  header_ = current_->header();
+  records_ = current_->records();
+  capacity_ = header_->recordCapacity;
+  used_ = 0;
+  lock.unlock();
+  wake_.notify_one();
+  return true;
+}
+
+void StrokeRecorder::rotatorLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    // Finalize segments handed over by the producer
+    while (!retired_.empty()) {
+      std::vector<MappedSegment *> retired;
+      retired.swap(retired_);
+      lock.unlock();
+      for (MappedSegment *segment : retired) {
+        retireSegment(segment, true);
+      }
+      lock.lock();
+    }
+
+    if (stopRequested_) {
+      break;
+    }
+
+    // Keep one mapped segment ready for the next rotation
+    if (!spare_) {
+      uint64_t sequence = nextSequence_++;
+      lock.unlock();
+      MappedSegment *segment = createSegment(sequence);
+      lock.lock();
+      spare_ = segment;
+      if (!spare_) {
+        // Retry later (e.g. disk full); records are dropped meanwhile
+        wake_.wait_for(lock, std::chrono::seconds(1));
+        continue;
+      }
+    }
+
+    wake_.wait(lock, [this]() { return stopRequested_ || !retired_.empty(); });
+  }
+}
+
+MappedSegment *StrokeRecorder::createSegment(uint64_t sequence) {
+  MappedSegment *segment = new MappedSegment();
+  if (!segment->open(segmentPath(options_.basePath, sequence),
+                     options_.segmentBytes)) {
+    delete segment;
+    return nullptr;
+  }
+
+  uint64_t capacity = (options_.segmentBytes - TraceFormat::kHeaderSize) /
+                      sizeof(TraceFormat::TraceRecord);
+  TraceFormat::initHeader(*segment->header(), keys_, startUnixMs_, sequence,
+                          capacity, thresholdMs_);
+  segment->header()->nanosecondsPerTick = CycleClock::nanosecondsPerTick();
+  return segment;
+}
+
+void StrokeRecorder::retireSegment(MappedSegment *segment,
+                                   bool stillRecording) {
+  // Shrink the segment to the records actually written
+  TraceFormat::FileHeader *header = segment->header();
+  uint64_t count = header->recordCount;
+  header->recordCapacity = count;
+  uint64_t finalBytes =
+      TraceFormat::kHeaderSize + count * sizeof(TraceFormat::TraceRecord);
+  std::string path = segment->path;
+  segment->close(finalBytes);
+  delete segment;
+
+  // Enforce the segment cap, counting the one still being written
+  size_t keep = static_cast<size_t>(options_.maxSegments);
+  if (stillRecording) {
+    keep--;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  finished_.push_back(path);
+  while (finished_.size() > keep) {
+    std::remove(finished_.front().c_str());
+    finished_.pop_front();
+  }
+}
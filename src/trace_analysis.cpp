@@ -0,0 +1,219 @@
+#include "trace_analysis.h"
+#include "interception.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr uint8_t kNoKey = 0xFF;
+
+size_t scanIndex(uint16_t code, bool e0) {
+  return (code & 0xFF) | (e0 ? 0x100 : 0);
+}
+
+// Per-key state while scanning one segment
+struct KeyScanState {
+  bool down = false;
+  uint64_t downAtNs = 0;
+  bool inEpisode = false;
+  bool stuck = false;
+  bool fixed = false;
+  uint64_t episodeStartNs = 0;
+};
+
+} // namespace
+
+KeyTraceStats &TraceStats::key(const std::string &id) {
+  for (auto &entry : keys) {
+    if (entry->id == id) {
+      return *entry;
+    }
+  }
+  keys.push_back(std::make_unique<KeyTraceStats>(id));
+  return *keys.back();
+}
+
+const KeyTraceStats *TraceStats::findKey(const std::string &id) const {
+  for (const auto &entry : keys) {
+    if (entry->id == id) {
+      return entry.get();
+    }
+  }
+  return nullptr;
+}
+
+uint64_t TraceStats::totalEpisodes() const {
+  uint64_t total = 0;
+  for (const auto &entry : keys) {
+    total += entry->episodes;
+  }
+  return total;
+}
+
+uint64_t TraceStats::totalFixes() const {
+  uint64_t total = 0;
+  for (const auto &entry : keys) {
+    total += entry->fixes;
+  }
+  return total;
+}
+
+void TraceStats::merge(const TraceStats &other) {
+  files += other.files;
+  bytes += other.bytes;
+  records += other.records;
+  strokes += other.strokes;
+  virtualChanges += other.virtualChanges;
+  durationNs += other.durationNs;
+  openEpisodes += other.openEpisodes;
+  for (const auto &from : other.keys) {
+    KeyTraceStats &into = key(from->id);
+    into.presses += from->presses;
+    into.episodes += from->episodes;
+    into.stuck += from->stuck;
+    into.fixes += from->fixes;
+    into.selfResolved += from->selfResolved;
+    into.episodeNs.merge(from->episodeNs);
+    into.timeToFixNs.merge(from->timeToFixNs);
+    into.holdNs.merge(from->holdNs);
+  }
+  for (size_t i = 0; i < kMaxTraceDevices; ++i) {
+    devices[i].strokes += other.devices[i].strokes;
+    devices[i].presses += other.devices[i].presses;
+    devices[i].fixes += other.devices[i].fixes;
+  }
+  interKeyNs.merge(other.interKeyNs);
+}
+
+void analyzeTrace(const TraceFormat::FileHeader &header,
+                  const TraceFormat::TraceRecord *records, size_t count,
+                  TraceStats &stats) {
+  stats.files++;
+  stats.bytes += TraceFormat::kHeaderSize +
+                 uint64_t(count) * sizeof(TraceFormat::TraceRecord);
+  stats.records += count;
+  if (count > 0) {
+    uint64_t firstNs = TraceFormat::timestampNs(header, records[0]);
+    uint64_t lastNs = TraceFormat::timestampNs(header, records[count - 1]);
+    if (lastNs > firstNs) {
+      stats.durationNs += lastNs - firstNs;
+    }
+  }
+
+  // Key table of this segment: statistics looked up once, scan codes mapped
+  // to key indices through a flat table
+  size_t keyCount = std::min<size_t>(header.keyCount, TraceFormat::kMaxKeys);
+  KeyTraceStats *keyStats[TraceFormat::kMaxKeys];
+  KeyScanState keyState[TraceFormat::kMaxKeys];
+  uint8_t keyForScan[512];
+  std::memset(keyForScan, kNoKey, sizeof(keyForScan));
+  for (size_t i = 0; i < keyCount; ++i) {
+    const TraceFormat::KeyEntry &entry = header.keys[i];
+    keyStats[i] = &stats.key(TraceFormat::keyId(entry));
+    keyForScan[scanIndex(entry.scanCode, entry.needsE0 != 0)] =
+        static_cast<uint8_t>(i);
+  }
+
+  // Physically held scan codes (all keys), to tell presses from auto-repeat
+  bool held[512] = {};
+  bool anyPress = false;
+  uint64_t lastPressNs = 0;
+
+  for (size_t r = 0; r < count; ++r) {
+    const TraceFormat::TraceRecord &record = records[r];
+    uint64_t timeNs = TraceFormat::timestampNs(header, record);
+    switch (record.type) {
+    case TraceFormat::kRecordStroke: {
+      stats.strokes++;
+      DeviceTraceStats &device =
+          stats.devices[std::min<size_t>(record.device, kMaxTraceDevices - 1)];
+      device.strokes++;
+      size_t scan =
+          scanIndex(record.code, (record.state & INTERCEPTION_KEY_E0) != 0);
+      uint8_t keyIndex = keyForScan[scan];
+      if (!(record.state & INTERCEPTION_KEY_UP)) {
+        if (held[scan]) {
+          break; // Auto-repeat
+        }
+        held[scan] = true;
+        device.presses++;
+        if (anyPress) {
+          stats.interKeyNs.record(timeNs - lastPressNs);
+        }
+        anyPress = true;
+        lastPressNs = timeNs;
+        if (keyIndex < keyCount) {
+          keyStats[keyIndex]->presses++;
+          keyState[keyIndex].down = true;
+          keyState[keyIndex].downAtNs = timeNs;
+        }
+      } else {
+        held[scan] = false;
+        if (keyIndex < keyCount && keyState[keyIndex].down) {
+          keyState[keyIndex].down = false;
+          keyStats[keyIndex]->holdNs.record(timeNs -
+                                            keyState[keyIndex].downAtNs);
+        }
+      }
+      break;
+    }
+    case TraceFormat::kRecordVirtualState:
+      stats.virtualChanges++;
+      break;
+    case TraceFormat::kRecordFix: {
+      stats.devices[std::min<size_t>(record.device, kMaxTraceDevices - 1)]
+          .fixes++;
+      if (record.keyIndex >= keyCount) {
+        break;
+      }
+      KeyScanState &state = keyState[record.keyIndex];
+      KeyTraceStats &key = *keyStats[record.keyIndex];
+      key.fixes++;
+      // Episode start not in this segment: use the recorded mismatch time
+      key.timeToFixNs.record(state.inEpisode
+                                 ? timeNs - state.episodeStartNs
+                                 : uint64_t(record.value) * 1000000);
+      state.fixed = true;
+      break;
+    }
+    case TraceFormat::kRecordTracker: {
+      if (record.keyIndex >= keyCount) {
+        break;
+      }
+      KeyScanState &state = keyState[record.keyIndex];
+      KeyTraceStats &key = *keyStats[record.keyIndex];
+      switch (record.state) {
+      case TraceFormat::kTrackerMismatchStart:
+        key.episodes++;
+        state.inEpisode = true;
+        state.stuck = false;
+        state.fixed = false;
+        state.episodeStartNs = timeNs;
+        break;
+      case TraceFormat::kTrackerStuck:
+        if (state.inEpisode && !state.stuck) {
+          state.stuck = true;
+          key.stuck++;
+        }
+        break;
+      case TraceFormat::kTrackerReset:
+        if (state.inEpisode) {
+          key.episodeNs.record(timeNs - state.episodeStartNs);
+          if (!state.fixed) {
+            key.selfResolved++;
+          }
+        }
+        state.inEpisode = false;
+        break;
+      }
+      break;
+    }
+    }
+  }
+
+  for (size_t i = 0; i < keyCount; ++i) {
+    if (keyState[i].inEpisode) {
+      stats.openEpisodes++;
+    }
+  }
+}
@@ -0,0 +1,274 @@
+#include "trace_format.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace TraceFormat {
+
+void initHeader(FileHeader &header, const std::vector<KeyInfo> &keys,
+                uint64_t startUnixMs, uint64_t segmentIndex,
+                uint64_t recordCapacity, int thresholdMs) {
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.recordSize = sizeof(TraceRecord);
+  header.headerSize = kHeaderSize;
+  header.startUnixMs = startUnixMs;
+  header.segmentIndex = segmentIndex;
+  header.recordCapacity = recordCapacity;
+  header.recordCount = 0;
+  header.thresholdMs = static_cast<uint32_t>(thresholdMs);
+
+  uint32_t count = 0;
+  for (const auto &key : keys) {
+    if (count >= kMaxKeys) {
+      break;
+    }
+    KeyEntry &entry = header.keys[count++];
+    key.id.copy(entry.id, sizeof(entry.id) - 1);
+    entry.scanCode = key.scanCode;
+    entry.needsE0 = key.needsE0 ? 1 : 0;
+    entry.vkCode = key.vkCode;
+  }
+  header.keyCount = count;
+}
+
+std::string validateHeader(const FileHeader &header, uint64_t fileSize) {
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+    return "not a trace file (bad magic)";
+  }
+  if (header.version < kMinVersion || header.version > kVersion) {
+    return "unsupported trace version " + std::to_string(header.version);
+  }
+  if (header.recordSize != sizeof(TraceRecord) ||
+      header.headerSize != kHeaderSize) {
+    return "unexpected record or header size";
+  }
+  if (header.keyCount > kMaxKeys) {
+    return "too many keys in header";
+  }
+  if (fileSize < kHeaderSize + header.recordCapacity * sizeof(TraceRecord)) {
+    return "file shorter than its record capacity";
+  }
+  return "";
+}
+
+std::string keyId(const KeyEntry &entry) {
+  return std::string(entry.id, strnlen(entry.id, sizeof(entry.id)));
+}
+
+bool readTraceFile(const std::string &path, TraceFile &out,
+                   std::string *error) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file.is_open()) {
+    if (error) {
+      *error = "cannot open " + path;
+    }
+    return false;
+  }
+
+  uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+  file.seekg(0);
+  if (fileSize < kHeaderSize ||
+      !file.read(reinterpret_cast<char *>(&out.header), kHeaderSize)) {
+    if (error) {
+      *error = "file too short for header";
+    }
+    return false;
+  }
+
+  std::string problem = validateHeader(out.header, fileSize);
+  if (!problem.empty()) {
+    if (error) {
+      *error = problem;
+    }
+    return false;
+  }
+
+  uint64_t count = out.header.recordCount;
+  if (count > out.header.recordCapacity) {
+    count = out.header.recordCapacity;
+  }
+  out.records.resize(static_cast<size_t>(count));
+  if (count > 0 &&
+      !file.read(reinterpret_cast<char *>(out.records.data()),
+                 static_cast<std::streamsize>(count * sizeof(TraceRecord)))) {
+    if (error) {
+      *error = "truncated record data";
+    }
+    return false;
+  }
+
+  // Trim trailing empty slots
+  while (!out.records.empty() && out.records.back().type == kRecordEmpty) {
+    out.records.pop_back();
+  }
+
+  if (out.header.nanosecondsPerTick > 0) {
+    for (auto &record : out.records) {
+      record.timestampNs = timestampNs(out.header, record);
+    }
+    out.header.nanosecondsPerTick = 0;
+  }
+  return true;
+}
+
+bool writeTraceFile(const std::string &path, const FileHeader &header,
+                    const std::vector<TraceRecord> &records,
+                    std::string *error) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    if (error) {
+      *error = "cannot create " + path;
+    }
+    return false;
+  }
+
+  FileHeader finalHeader = header;
+  finalHeader.recordCapacity = records.size();
+  finalHeader.recordCount = records.size();
+  file.write(reinterpret_cast<const char *>(&finalHeader), kHeaderSize);
+  if (!records.empty()) {
+    file.write(reinterpret_cast<const char *>(records.data()),
+               static_cast<std::streamsize>(records.size() *
+                                            sizeof(TraceRecord)));
+  }
+  if (!file.good()) {
+    if (error) {
+      *error = "write failed for " + path;
+    }
+    return false;
+  }
+  return true;
+}
+
+bool collectTraceFiles(const std::string &path,
+                       std::vector<std::string> &files,
+                       const std::string &extension) {
+  namespace fs = std::filesystem;
+  std::error_code ec;
+  if (fs::is_directory(path, ec)) {
+    std::vector<std::string> found;
+    for (const auto &entry : fs::recursive_directory_iterator(path, ec)) {
+      if (entry.is_regular_file(ec) && entry.path().extension() == extension) {
+        found.push_back(entry.path().string());
+      }
+    }
+    std::sort(found.begin(), found.end());
+    files.insert(files.end(), found.begin(), found.end());
+    return true;
+  }
+  if (fs::is_regular_file(path, ec)) {
+    files.push_back(path);
+    return true;
+  }
+  return false;
+}
+
+bool MappedTraceFile::open(const std::string &path, std::string *error) {
+  close();
+  std::string problem;
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  LARGE_INTEGER size;
+  if (file == INVALID_HANDLE_VALUE) {
+    problem = "cannot open " + path;
+  } else if (!GetFileSizeEx(file, &size) ||
+             static_cast<uint64_t>(size.QuadPart) < kHeaderSize) {
+    CloseHandle(file);
+    problem = "file too short for header";
+  } else {
+    file_ = file;
+    bytes_ = static_cast<uint64_t>(size.QuadPart);
+    mapping_ = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_) {
+      base_ = static_cast<const uint8_t *>(
+          MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (!base_) {
+      problem = "cannot map " + path;
+    }
+  }
+#else
+  fd_ = ::open(path.c_str(), O_RDONLY);
+  struct stat info;
+  if (fd_ < 0) {
+    problem = "cannot open " + path;
+  } else if (fstat(fd_, &info) != 0 ||
+             static_cast<uint64_t>(info.st_size) < kHeaderSize) {
+    problem = "file too short for header";
+  } else {
+    bytes_ = static_cast<uint64_t>(info.st_size);
+    void *view = mmap(nullptr, static_cast<size_t>(bytes_), PROT_READ,
+                      MAP_PRIVATE, fd_, 0);
+    if (view == MAP_FAILED) {
+      problem = "cannot map " + path;
+    } else {
+      base_ = static_cast<const uint8_t *>(view);
+      // Records are scanned once, front to back
+      madvise(view, static_cast<size_t>(bytes_), MADV_SEQUENTIAL);
+    }
+  }
+#endif
+  if (problem.empty()) {
+    problem = validateHeader(header(), bytes_);
+  }
+  if (!problem.empty()) {
+    close();
+    if (error) {
+      *error = problem;
+    }
+    return false;
+  }
+
+  uint64_t count = header().recordCount;
+  if (count > header().recordCapacity) {
+    count = header().recordCapacity;
+  }
+  while (count > 0 && records()[count - 1].type == kRecordEmpty) {
+    count--;
+  }
+  count_ = static_cast<size_t>(count);
+  return true;
+}
+
+void MappedTraceFile::close() {
+#ifdef _WIN32
+  if (base_) {
+    UnmapViewOfFile(base_);
+  }
+  if (mapping_) {
+    CloseHandle(mapping_);
+  }
+  if (file_) {
+    CloseHandle(file_);
+  }
+  mapping_ = nullptr;
+  file_ = nullptr;
+#else
+  if (base_) {
+    munmap(const_cast<uint8_t *>(base_), static_cast<size_t>(bytes_));
+  }
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+  fd_ = -1;
+#endif
+  base_ = nullptr;
+  bytes_ = 0;
+  count_ = 0;
+}
+
+} // namespace TraceFormat
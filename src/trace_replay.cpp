@@ -0,0 +1,480 @@
+#include "trace_replay.h"
+#include "modifier_key_fixer.h"
+#include "simulator.h"
+#include "trace_format.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <cstring>
+#include <deque>
+#else
+#include "fake_interception.h"
+#include "fake_win32.h"
+#endif
+
+namespace {
+
+// processEvents() timeout of the shipped programs: the loop's idle rate
+const int kPollMs = 50;
+
+// Keyboard stroke of a recording, at its time since the recording started
+struct ReplayStroke {
+  uint64_t timeNs;
+  InterceptionDevice device;
+  InterceptionKeyStroke stroke;
+};
+
+// Trace files named directly, plus the *.emkt files of named directories
+bool collectFiles(const std::vector<std::string> &paths,
+                  std::vector<std::string> &files, std::string &error) {
+  for (const std::string &path : paths) {
+    if (!TraceFormat::collectTraceFiles(path, files)) {
+      error = path + ": no such file or directory";
+      return false;
+    }
+  }
+  if (files.empty()) {
+    error = "no trace files";
+    return false;
+  }
+  return true;
+}
+
+std::vector<ReplayStroke> strokesOf(const TraceFormat::TraceFile &trace) {
+  std::vector<ReplayStroke> strokes;
+  strokes.reserve(trace.records.size());
+  for (const auto &record : trace.records) {
+    if (record.type != TraceFormat::kRecordStroke) {
+      continue;
+    }
+    ReplayStroke stroke;
+    stroke.timeNs = record.timestampNs;
+    stroke.device = interception_is_keyboard(record.device)
+                        ? record.device
+                        : INTERCEPTION_KEYBOARD(0);
+    stroke.stroke.code = record.code;
+    stroke.stroke.state = record.state;
+    stroke.stroke.information = record.information;
+    strokes.push_back(stroke);
+  }
+  return strokes;
+}
+
+// Driver and OS key state under the shipped event loop during a replay.
+// Strokes come from the trace, every forwarded or injected stroke updates
+// the key state at once, and a key-up is lost on the way with the given
+// probability (deterministically). ModifierKeyFixer runs on top of it
+// unchanged: headless builds already link the fake driver and OS layer
+// (shim/), and on Windows the executable's own imports of the Interception
+// driver, GetAsyncKeyState and Sleep are pointed at the functions below.
+class ReplayDriver {
+public:
+  explicit ReplayDriver(double dropKeyUpRate)
+      : dropKeyUpRate_(dropKeyUpRate), random_(1) {}
+  ~ReplayDriver();
+
+  ReplayDriver(const ReplayDriver &) = delete;
+  ReplayDriver &operator=(const ReplayDriver &) = delete;
+
+  // Before the fixer opens its input
+  bool install(std::string &error);
+
+  // Scan code to virtual key table of the keys the fixer monitors
+  void mapKeys(const ModifierKeyStates &physical,
+               const VirtualKeyStates &virtualStates);
+
+  void push(const ReplayStroke &stroke);
+
+#ifdef _WIN32
+  // Driver and key state calls, reached through the redirected imports
+  InterceptionDevice nextDevice() const {
+    return queue_.empty() ? 0 : queue_.front().device;
+  }
+  bool receive(InterceptionDevice device, InterceptionKeyStroke &stroke);
+  void deliver(const InterceptionKeyStroke &stroke);
+  bool isDown(int vkCode) const {
+    return vkCode > 0 && vkCode < 256 && vkDown_[vkCode];
+  }
+#endif
+
+private:
+  // A key-up reaching the OS is lost
+  bool dropped(const InterceptionKeyStroke &stroke) {
+    return (stroke.state & INTERCEPTION_KEY_UP) && dropKeyUpRate_ > 0 &&
+           random_.uniform() < dropKeyUpRate_;
+  }
+
+  double dropKeyUpRate_;
+  SimRandom random_;
+#ifdef _WIN32
+  struct Queued {
+    InterceptionDevice device;
+    InterceptionKeyStroke stroke;
+  };
+  std::deque<Queued> queue_;
+  int vkForScan_[512];
+  bool vkDown_[256];
+#else
+  bool present_[INTERCEPTION_MAX_KEYBOARD + 1] = {};
+#endif
+};
+
+#ifdef _WIN32
+
+ReplayDriver *g_driver = nullptr;
+
+size_t scanIndex(unsigned short code, unsigned short state) {
+  return (code & 0xFF) | ((state & INTERCEPTION_KEY_E0) ? 0x100 : 0);
+}
+
+// Stand-ins with the signatures of the imports they replace
+InterceptionContext replayCreateContext() { return g_driver; }
+
+void replayDestroyContext(InterceptionContext) {}
+
+void replaySetFilter(InterceptionContext, InterceptionPredicate,
+                     InterceptionFilter) {}
+
+InterceptionDevice replayWait(InterceptionContext, unsigned long) {
+  return g_driver ? g_driver->nextDevice() : 0;
+}
+
+int replayReceive(InterceptionContext, InterceptionDevice device,
+                  InterceptionStroke *stroke, unsigned int count) {
+  return count > 0 && g_driver &&
+                 g_driver->receive(
+                     device, *reinterpret_cast<InterceptionKeyStroke *>(stroke))
+             ? 1
+             : 0;
+}
+
+int replaySend(InterceptionContext, InterceptionDevice,
+               const InterceptionStroke *stroke, unsigned int count) {
+  const auto *keys = reinterpret_cast<const InterceptionKeyStroke *>(stroke);
+  for (unsigned int i = 0; g_driver && i < count; ++i) {
+    g_driver->deliver(keys[i]);
+  }
+  return static_cast<int>(count);
+}
+
+SHORT WINAPI replayGetAsyncKeyState(int vkCode) {
+  return g_driver && g_driver->isDown(vkCode) ? static_cast<SHORT>(0x8000)
+                                              : 0;
+}
+
+VOID WINAPI replaySleep(DWORD) {}
+
+// Point every import of the named function in this executable at
+// replacement. Returns false if the executable does not import it.
+bool patchImport(const char *name, const void *replacement) {
+  auto *base = reinterpret_cast<uint8_t *>(GetModuleHandleA(nullptr));
+  auto *dos = reinterpret_cast<IMAGE_DOS_HEADER *>(base);
+  auto *nt = reinterpret_cast<IMAGE_NT_HEADERS *>(base + dos->e_lfanew);
+  const IMAGE_DATA_DIRECTORY &imports =
+      nt->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT];
+  if (imports.VirtualAddress == 0) {
+    return false;
+  }
+
+  bool patched = false;
+  for (auto *module = reinterpret_cast<IMAGE_IMPORT_DESCRIPTOR *>(
+           base + imports.VirtualAddress);
+       module->Name != 0; ++module) {
+    if (module->OriginalFirstThunk == 0) {
+      continue; // No name table to match against
+    }
+    auto *names = reinterpret_cast<IMAGE_THUNK_DATA *>(
+        base + module->OriginalFirstThunk);
+    auto *slots =
+        reinterpret_cast<IMAGE_THUNK_DATA *>(base + module->FirstThunk);
+    for (; names->u1.AddressOfData != 0; ++names, ++slots) {
+      if (IMAGE_SNAP_BY_ORDINAL(names->u1.Ordinal)) {
+        continue;
+      }
+      auto *import = reinterpret_cast<IMAGE_IMPORT_BY_NAME *>(
+          base + names->u1.AddressOfData);
+      if (std::strcmp(reinterpret_cast<const char *>(import->Name), name) !=
+          0) {
+        continue;
+      }
+      DWORD protection;
+      if (!VirtualProtect(&slots->u1.Function, sizeof(slots->u1.Function),
+                          PAGE_READWRITE, &protection)) {
+        return false;
+      }
+      slots->u1.Function = reinterpret_cast<ULONG_PTR>(replacement);
+      VirtualProtect(&slots->u1.Function, sizeof(slots->u1.Function),
+                     protection, &protection);
+      patched = true;
+    }
+  }
+  return patched;
+}
+
+bool ReplayDriver::install(std::string &error) {
+  // Imports stay redirected for the rest of the process: --replay exits
+  // when it is done and never talks to the real driver
+  static bool redirected = false;
+  if (!redirected) {
+    struct Import {
+      const char *name;
+      const void *replacement;
+    };
+    const Import imports[] = {
+        {"interception_create_context",
+         reinterpret_cast<const void *>(&replayCreateContext)},
+        {"interception_destroy_context",
+         reinterpret_cast<const void *>(&replayDestroyContext)},
+        {"interception_set_filter",
+         reinterpret_cast<const void *>(&replaySetFilter)},
+        {"interception_wait_with_timeout",
+         reinterpret_cast<const void *>(&replayWait)},
+        {"interception_receive",
+         reinterpret_cast<const void *>(&replayReceive)},
+        {"interception_send", reinterpret_cast<const void *>(&replaySend)},
+        {"GetAsyncKeyState",
+         reinterpret_cast<const void *>(&replayGetAsyncKeyState)}};
+    for (const Import &import : imports) {
+      if (!patchImport(import.name, import.replacement)) {
+        error = std::string("cannot redirect ") + import.name;
+        return false;
+      }
+    }
+    // Fix settle time; real sleeps would only slow the replay down
+    patchImport("Sleep", reinterpret_cast<const void *>(&replaySleep));
+    redirected = true;
+  }
+
+  std::fill(std::begin(vkForScan_), std::end(vkForScan_), 0);
+  std::fill(std::begin(vkDown_), std::end(vkDown_), false);
+  g_driver = this;
+  return true;
+}
+
+ReplayDriver::~ReplayDriver() {
+  if (g_driver == this) {
+    g_driver = nullptr;
+  }
+}
+
+void ReplayDriver::mapKeys(const ModifierKeyStates &physical,
+                           const VirtualKeyStates &virtualStates) {
+  for (const auto &key : physical.getKeys()) {
+    const VirtualKeyState *virtKey = virtualStates.findKeyById(key.id);
+    if (virtKey && virtKey->vkCode > 0 && virtKey->vkCode < 256) {
+      vkForScan_[scanIndex(key.scanCode,
+                           key.needsE0 ? INTERCEPTION_KEY_E0 : 0)] =
+          virtKey->vkCode;
+    }
+  }
+}
+
+void ReplayDriver::push(const ReplayStroke &stroke) {
+  queue_.push_back({stroke.device, stroke.stroke});
+}
+
+bool ReplayDriver::receive(InterceptionDevice device,
+                           InterceptionKeyStroke &stroke) {
+  if (queue_.empty() || queue_.front().device != device) {
+    return false;
+  }
+  stroke = queue_.front().stroke;
+  queue_.pop_front();
+  return true;
+}
+
+void ReplayDriver::deliver(const InterceptionKeyStroke &stroke) {
+  int vkCode = vkForScan_[scanIndex(stroke.code, stroke.state)];
+  if (vkCode > 0 && !dropped(stroke)) {
+    vkDown_[vkCode] = !(stroke.state & INTERCEPTION_KEY_UP);
+  }
+}
+
+#else
+
+bool ReplayDriver::install(std::string &) {
+  FakeInterception::reset();
+  FakeWin32::reset();
+  FakeInterception::setCaptureSent(false);
+  FakeInterception::setWaitBlocks(false);
+  FakeWin32::setSleepEnabled(false);
+  FakeInterception::setDeliveryFilter(
+      [this](InterceptionDevice, const InterceptionKeyStroke &stroke) {
+        return !dropped(stroke);
+      });
+  present_[INTERCEPTION_KEYBOARD(0)] = true;
+  return true;
+}
+
+ReplayDriver::~ReplayDriver() { FakeInterception::setDeliveryFilter(nullptr); }
+
+void ReplayDriver::mapKeys(const ModifierKeyStates &physical,
+                           const VirtualKeyStates &virtualStates) {
+  for (const auto &key : physical.getKeys()) {
+    const VirtualKeyState *virtKey = virtualStates.findKeyById(key.id);
+    if (virtKey) {
+      FakeWin32::mapScanCode(key.scanCode, key.needsE0, virtKey->vkCode);
+    }
+  }
+}
+
+void ReplayDriver::push(const ReplayStroke &stroke) {
+  if (!present_[stroke.device]) {
+    FakeInterception::addDevice(stroke.device, "HID\\REPLAY_KEYBOARD");
+    present_[stroke.device] = true;
+  }
+  FakeInterception::pushKeyStroke(stroke.device, stroke.stroke.code,
+                                  stroke.stroke.state,
+                                  stroke.stroke.information);
+}
+
+#endif
+
+// One recording through a fresh fixer; returns the fixes it made
+bool replayTrace(const std::vector<ReplayStroke> &strokes,
+                 const ReplayOptions &options, const Config *config,
+                 int &fixes, double &elapsedNs, std::string &error) {
+  ReplayDriver driver(options.dropKeyUpRate);
+  if (!driver.install(error)) {
+    return false;
+  }
+  ManualClock clock;
+  ModifierKeyFixer fixer(clock);
+  if (!(config ? fixer.initialize(*config) : fixer.initialize())) {
+    error = "cannot open the replay driver";
+    return false;
+  }
+  fixer.setShowMessages(false);
+  driver.mapKeys(fixer.getPhysicalStates(), fixer.getVirtualStates());
+
+  const auto poll = std::chrono::milliseconds(kPollMs);
+  const Clock::TimePoint origin = clock.now();
+  Clock::TimePoint lastIteration = origin;
+  auto start = std::chrono::steady_clock::now();
+  for (const ReplayStroke &stroke : strokes) {
+    Clock::TimePoint due =
+        origin + std::chrono::duration_cast<Clock::TimePoint::duration>(
+                     std::chrono::nanoseconds(stroke.timeNs));
+    due = std::max<Clock::TimePoint>(due, lastIteration);
+    // The waits that time out while a key is out of step
+    while (fixer.hasAnyMismatch() && lastIteration + poll <= due) {
+      lastIteration += poll;
+      clock.set(lastIteration);
+      fixer.processEvents(kPollMs);
+    }
+    lastIteration = due;
+    clock.set(due);
+    driver.push(stroke);
+    fixer.processEvents(kPollMs);
+  }
+  // Let the trackers observe the final state
+  clock.set(lastIteration + poll);
+  fixer.processEvents(kPollMs);
+  elapsedNs += std::chrono::duration<double, std::nano>(
+                   std::chrono::steady_clock::now() - start)
+                   .count();
+
+  fixes = fixer.getStatistics().getTotalFixes();
+  return true;
+}
+
+} // namespace
+
+bool replayTraces(const ReplayOptions &options, ReplayResult &result,
+                  std::string &error) {
+  std::vector<std::string> files;
+  if (!collectFiles(options.paths, files, error)) {
+    return false;
+  }
+
+  Config config;
+  bool haveConfig = !options.configPath.empty();
+  if (haveConfig && !config.load(options.configPath)) {
+    error = "failed to load config " + options.configPath;
+    return false;
+  }
+
+  // Each recording is its own timeline: replay the files one after another
+  std::vector<std::vector<ReplayStroke>> traces;
+  for (const std::string &file : files) {
+    TraceFormat::TraceFile trace;
+    std::string readError;
+    if (!TraceFormat::readTraceFile(file, trace, &readError)) {
+      error = file + ": " + readError;
+      return false;
+    }
+    traces.push_back(strokesOf(trace));
+  }
+
+  std::vector<double> samples;
+  int passes = std::max<int>(1, options.passes);
+  for (int pass = 0; pass < passes; ++pass) {
+    uint64_t strokes = 0;
+    uint64_t fixes = 0;
+    double elapsedNs = 0;
+    for (const std::vector<ReplayStroke> &strokesOfTrace : traces) {
+      int traceFixes = 0;
+      if (!replayTrace(strokesOfTrace, options, haveConfig ? &config : nullptr,
+                       traceFixes, elapsedNs, error)) {
+        return false;
+      }
+      strokes += strokesOfTrace.size();
+      fixes += static_cast<uint64_t>(traceFixes);
+    }
+    result.strokes = strokes;
+    result.fixes = fixes;
+    samples.push_back(strokes ? elapsedNs / strokes : 0);
+  }
+
+  std::sort(samples.begin(), samples.end());
+  size_t n = samples.size();
+  result.medianNsPerStroke =
+      n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+  result.minNsPerStroke = samples.front();
+  return true;
+}
+
+int replayMain(int argc, char *argv[]) {
+  ReplayOptions options;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--replay") {
+      continue;
+    } else if (arg == "--passes" && hasValue) {
+      options.passes = std::atoi(argv[++i]);
+    } else if (arg == "--drop" && hasValue) {
+      options.dropKeyUpRate = std::atof(argv[++i]);
+    } else if (arg == "--config" && hasValue) {
+      options.configPath = argv[++i];
+    } else if (arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+      std::cerr << "Unknown option: " << arg << std::endl;
+      std::cerr << "Usage: " << argv[0]
+                << " --replay [--passes n] [--drop rate] [--config file]"
+                << " <trace.emkt|dir>..." << std::endl;
+      return 1;
+    } else {
+      options.paths.push_back(arg);
+    }
+  }
+
+  ReplayResult result;
+  std::string error;
+  if (!replayTraces(options, result, error)) {
+    std::cerr << "ERROR: " << error << std::endl;
+    return 1;
+  }
+
+  std::cout << "Replayed " << result.strokes << " strokes x "
+            << std::max<int>(1, options.passes) << " pass(es), " << result.fixes
+            << " fix(es) per pass" << std::endl;
+  std::cout << std::fixed << std::setprecision(1)
+            << "median " << result.medianNsPerStroke << " ns/stroke (min "
+            << result.minNsPerStroke << ")" << std::endl;
+  return 0;
+}
@@ -0,0 +1,171 @@
+#include "trace_writer.h"
+#include <chrono>
+#include <cstdio>
+
+TraceWriter &TraceWriter::instance() {
+  static TraceWriter writer;
+  return writer;
+}
+
+TraceWriter::~TraceWriter() { stop(); }
+
+bool TraceWriter::start(const std::string &path) {
+  if (writer_.joinable()) {
+    return false;
+  }
+
+  file_.open(path, std::ios::out | std::ios::trunc);
+  if (!file_.is_open()) {
+    return false;
+  }
+
+  // Discard anything left over from a previous session
+  {
+    std::lock_guard<std::mutex> lock(ringsMutex_);
+    for (auto &ring : rings_) {
+      ring->tail.store(ring->head.load(std::memory_order_acquire),
+                       std::memory_order_release);
+    }
+  }
+
+  file_ << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+  file_ << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,"
+           "\"args\":{\"name\":\"escModKey\"}}";
+  dropped_.store(0, std::memory_order_relaxed);
+  written_.store(0, std::memory_order_relaxed);
+
+  CycleClock::calibrate();
+  originTicks_ = CycleClock::now();
+  stopRequested_ = false;
+  writer_ = std::thread(&TraceWriter::writerLoop, this);
+  enabled_.store(true, std::memory_order_release);
+  return true;
+}
+
+void TraceWriter::stop() {
+  if (!writer_.joinable()) {
+    return;
+  }
+
+  enabled_.store(false, std::memory_order_release);
+  {
+    std::lock_guard<std::mutex> lock(wakeMutex_);
+    stopRequested_ = true;
+  }
+  wake_.notify_one();
+  writer_.join();
+
+  file_ << ",\n{\"name\":\"trace_stats\",\"ph\":\"M\",\"pid\":1,\"tid\":0,"
+           "\"args\":{\"written\":"
+        << written_.load(std::memory_order_relaxed)
+        << ",\"dropped\":" << dropped_.load(std::memory_order_relaxed)
+        << "}}\n]}\n";
+  file_.close();
+}
+
+void TraceWriter::emit(const TraceEvent &event) {
+  if (!enabled_.load(std::memory_order_relaxed)) {
+    return;
+  }
+
+  ThreadRing *ring = ringForThisThread();
+  uint64_t head = ring->head.load(std::memory_order_relaxed);
+  if (head - ring->tail.load(std::memory_order_acquire) >= kRingCapacity) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  ring->events[head & (kRingCapacity - 1)] = event;
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+TraceWriter::ThreadRing *TraceWriter::ringForThisThread() {
+  // Registered once per thread; rings live as long as the writer so a
+  // thread may exit without unregistering
+  thread_local ThreadRing *ring = nullptr;
+  if (!ring) {
+    std::lock_guard<std::mutex> lock(ringsMutex_);
+    rings_.push_back(std::make_unique<ThreadRing>());
+    ring = rings_.back().get();
+    ring->tid = static_cast<uint32_t>(rings_.size());
+  }
+  return ring;
+}
+
+void TraceWriter::writerLoop() {
+  std::unique_lock<std::mutex> lock(wakeMutex_);
+  while (!stopRequested_) {
+    wake_.wait_for(lock, std::chrono::milliseconds(10));
+    lock.unlock();
+    drainAll();
+    lock.lock();
+  }
+  lock.unlock();
+  drainAll();
+  file_.flush();
+}
+
+void TraceWriter::drainAll() {
+  std::lock_guard<std::mutex> lock(ringsMutex_);
+  for (auto &ring : rings_) {
+    uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+    uint64_t head = ring->head.load(std::memory_order_acquire);
+    for (; tail != head; ++tail) {
+      writeEvent(ring->events[tail & (kRingCapacity - 1)], ring->tid);
+    }
+    ring->tail.store(tail, std::memory_order_release);
+  }
+}
+
+void TraceWriter::writeEvent(const TraceEvent &event, uint32_t tid) {
+  char buffer[320];
+  // Events begun before start() (e.g. a wait already blocked) are clipped
+  // to the origin rather than wrapping around to a huge timestamp
+  uint64_t startTicks = event.startTicks;
+  uint64_t durationTicks = event.durationTicks;
+  if (startTicks < originTicks_) {
+    uint64_t early = originTicks_ - startTicks;
+    durationTicks = durationTicks > early ? durationTicks - early : 0;
+    startTicks = originTicks_;
+  }
+  double ts = CycleClock::toNanoseconds(startTicks - originTicks_) / 1000.0;
+  int length = 0;
+
+  if (event.phase == TracePhase::Complete) {
+    double dur = CycleClock::toNanoseconds(durationTicks) / 1000.0;
+    length = snprintf(buffer, sizeof(buffer),
+                      ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                      "\"ts\":%.3f,\"dur\":%.3f",
+                      event.name, tid, ts, dur);
+  } else {
+    length = snprintf(buffer, sizeof(buffer),
+                      ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,"
+                      "\"tid\":%u,\"ts\":%.3f",
+                      event.name, tid, ts);
+  }
+  file_.write(buffer, length);
+
+  if (event.argName || event.detail[0]) {
+    file_ << ",\"args\":{";
+    if (event.argName) {
+      file_ << "\"" << event.argName << "\":" << event.arg;
+    }
+    if (event.detail[0]) {
+      if (event.argName) {
+        file_ << ",";
+      }
+      // Detail is a key ID or similar identifier; drop anything that
+      // would need escaping
+      file_ << "\"detail\":\"";
+      for (const char *c = event.detail; *c; ++c) {
+        if (*c != '"' && *c != '\\' && static_cast<unsigned char>(*c) >= 0x20) {
+          file_ << *c;
+        }
+      }
+      file_ << "\"";
+    }
+    file_ << "}";
+  }
+  file_ << "}";
+  written_.fetch_add(1, std::memory_order_relaxed);
+}
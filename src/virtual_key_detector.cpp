@@ -142,6 +142,16 @@ bool VirtualKeyStates::anyAlt() const { return lalt() || ralt(); }
 
 bool VirtualKeyStates::anyWin() const { return lwin() || rwin(); }
 
+uint32_t VirtualKeyStates::pressedMask() const {
+  uint32_t mask = 0;
+  for (size_t i = 0; i < keys_.size() && i < 32; ++i) {
+    if (keys_[i].pressed) {
+      mask |= 1u << i;
+    }
+  }
+  return mask;
+}
+
 bool VirtualKeyStates::operator!=(const VirtualKeyStates &other) const {
   if (keys_.size() != other.keys_.size()) {
     return true;
@@ -0,0 +1,145 @@
+#include "work_stealing_pool.h"
+#include <algorithm>
+
+WorkStealingPool::WorkStealingPool(size_t threads)
+    : task_(nullptr), steals_(0), generation_(0), busyWorkers_(0),
+      stopRequested_(false) {
+  if (threads == 0) {
+    threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+  }
+  for (size_t i = 0; i < threads; ++i) {
+    queues_.push_back(std::make_unique<Queue>());
+  }
+  // Worker 0 is the thread that calls run()
+  for (size_t i = 1; i < threads; ++i) {
+    threads_.emplace_back(&WorkStealingPool::workerLoop, this, i);
+  }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopRequested_ = true;
+  }
+  start_.notify_all();
+  for (auto &thread : threads_) {
+    thread.join();
+  }
+}
+
+void WorkStealingPool::run(size_t count, const Task &task) {
+  if (count == 0) {
+    return;
+  }
+
+  // Contiguous ranges, so each worker starts on neighbouring tasks
+  size_t workers = queues_.size();
+  for (size_t i = 0; i < workers; ++i) {
+    Queue &queue = *queues_[i];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.begin = count * i / workers;
+    queue.end = count * (i + 1) / workers;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = &task;
+    busyWorkers_ = threads_.size();
+    generation_++;
+  }
+  start_.notify_all();
+
+  work(0);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [this] { return busyWorkers_ == 0; });
+  task_ = nullptr;
+}
+
+void WorkStealingPool::workerLoop(size_t worker) {
+  uint64_t seen = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_.wait(lock,
+                  [&] { return stopRequested_ || generation_ != seen; });
+      if (stopRequested_) {
+        return;
+      }
+      seen = generation_;
+    }
+
+    work(worker);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--busyWorkers_ == 0) {
+      done_.notify_one();
+    }
+  }
+}
+
+void WorkStealingPool::work(size_t worker) {
+  size_t index;
+  while (true) {
+    if (take(worker, index)) {
+      (*task_)(index, worker);
+    } else if (!steal(worker)) {
+      return;
+    }
+  }
+}
+
+bool WorkStealingPool::take(size_t worker, size_t &index) {
+  Queue &queue = *queues_[worker];
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if (queue.begin == queue.end) {
+    return false;
+  }
+  index = queue.begin++;
+  return true;
+}
+
+bool WorkStealingPool::steal(size_t worker) {
+  while (true) {
+    // Victim with the most tasks left (each size is read under its queue's
+    // lock, but the victim may drain before it is locked again below)
+    size_t victim = worker;
+    size_t most = 0;
+    for (size_t i = 0; i < queues_.size(); ++i) {
+      if (i == worker) {
+        continue;
+      }
+      Queue &queue = *queues_[i];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (queue.end - queue.begin > most) {
+        most = queue.end - queue.begin;
+        victim = i;
+      }
+    }
+    if (victim == worker) {
+      return false;
+    }
+
+    size_t begin;
+    size_t end;
+    {
+      Queue &queue = *queues_[victim];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      size_t left = queue.end - queue.begin;
+      if (left == 0) {
+        continue; // Drained meanwhile; look again
+      }
+      // Back half; a single task left goes to the thief
+      end = queue.end;
+      begin = queue.end - (left + 1) / 2;
+      queue.end = begin;
+    }
+
+    Queue &own = *queues_[worker];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    own.begin = begin;
+    own.end = end;
+    steals_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+}
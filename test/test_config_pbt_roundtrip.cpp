@@ -2,65 +2,61 @@
 // Validates: Requirements 1.1, 1.2, 1.3, 1.4, 1.5
 
 #include "config.h"
+#include "property_test.h"
 #include <cassert>
 #include <fstream>
 #include <iostream>
-#include <random>
 #include <sstream>
 #include <string>
 #include <vector>
 
-// Random generator
-std::random_device rd;
-std::mt19937 gen(rd());
-
 // Helper: Generate random scan code
-unsigned short randomScanCode() {
-  std::uniform_int_distribution<> dis(0x01, 0xFF);
-  return static_cast<unsigned short>(dis(gen));
-}
-
-// Helper: Generate random bool
-bool randomBool() {
-  std::uniform_int_distribution<> dis(0, 1);
-  return dis(gen) == 1;
+unsigned short randomScanCode(PropertySource &source) {
+  return static_cast<unsigned short>(source.range(0x01, 0xFF));
 }
 
 // Helper: Generate random valid modifier key ID
-std::string randomModifierKeyId() {
+std::string randomModifierKeyId(PropertySource &source) {
   static const std::vector<std::string> validKeys = {
       "lctrl", "rctrl", "lshift", "rshift", "lalt", "ralt", "lwin", "rwin"};
-  std::uniform_int_distribution<> dis(0, validKeys.size() - 1);
-  return validKeys[dis(gen)];
+  return source.pick(validKeys);
 }
 
 // Helper: Generate random mapping type
-std::string randomMappingType() {
+std::string randomMappingType(PropertySource &source) {
   static const std::vector<std::string> types = {"additional", "replace"};
-  std::uniform_int_distribution<> dis(0, types.size() - 1);
-  return types[dis(gen)];
+  return source.pick(types);
 }
 
 // Helper: Generate random description
-std::string randomDescription() {
+std::string randomDescription(PropertySource &source) {
   static const std::vector<std::string> descriptions = {
       "Test mapping 1", "Test mapping 2", "CapsLock to Ctrl", "Custom mapping",
       ""};
-  std::uniform_int_distribution<> dis(0, descriptions.size() - 1);
-  return descriptions[dis(gen)];
+  return source.pick(descriptions);
 }
 
 // Helper: Generate random valid key mapping
-KeyMappingConfig generateRandomMapping() {
-  return KeyMappingConfig(randomScanCode(), randomBool(), randomModifierKeyId(),
-                          randomMappingType(), randomDescription());
+KeyMappingConfig generateRandomMapping(PropertySource &source) {
+  unsigned short scanCode = randomScanCode(source);
+  bool needsE0 = source.boolean();
+  std::string targetKeyId = randomModifierKeyId(source);
+  std::string type = randomMappingType(source);
+  std::string description = randomDescription(source);
+  std::ostringstream note;
+  note << "mapping 0x" << std::hex << scanCode << (needsE0 ? "/E0" : "")
+       << " -> " << targetKeyId << " (" << type << ", \"" << description
+       << "\")";
+  source.note(note.str());
+  return KeyMappingConfig(scanCode, needsE0, targetKeyId, type, description);
 }
 
 // Helper: Generate random list of mappings
-std::vector<KeyMappingConfig> generateRandomMappings(int count) {
+std::vector<KeyMappingConfig> generateRandomMappings(PropertySource &source,
+                                                     size_t maxCount) {
   std::vector<KeyMappingConfig> mappings;
-  for (int i = 0; i < count; ++i) {
-    mappings.push_back(generateRandomMapping());
+  while (source.another(mappings.size(), maxCount)) {
+    mappings.push_back(generateRandomMapping(source));
   }
   return mappings;
 }
@@ -86,13 +82,10 @@ bool mappingsEqual(const KeyMappingConfig &a, const KeyMappingConfig &b) {
 // Property 1: Configuration round-trip consistency
 // For any valid mapping configuration list, serializing to TOML and parsing
 // back should produce equivalent configuration
-bool testRoundTripProperty(int iteration) {
+bool testRoundTripProperty(PropertySource &source) {
   // Generate random number of mappings (0-5)
-  std::uniform_int_distribution<> countDis(0, 5);
-  int count = countDis(gen);
-
   std::vector<KeyMappingConfig> originalMappings =
-      generateRandomMappings(count);
+      generateRandomMappings(source, 5);
 
   // Create config and set mappings
   Config config;
@@ -100,48 +93,38 @@ bool testRoundTripProperty(int iteration) {
 
   // Save to file
   std::string filename =
-      "test_roundtrip_" + std::to_string(iteration) + ".toml";
+      "test_roundtrip_" + std::to_string(source.index()) + ".toml";
   TempFile tempFile(filename);
 
   if (!config.save(filename)) {
-    std::cerr << "Failed to save config in iteration " << iteration
-              << std::endl;
-    return false;
+    return source.fail("Failed to save config");
   }
 
   // Load from file
   Config loadedConfig;
   if (!loadedConfig.load(filename)) {
-    std::cerr << "Failed to load config in iteration " << iteration
-              << std::endl;
-    return false;
+    return source.fail("Failed to load config");
   }
 
   // Compare mappings
   const auto &loadedMappings = loadedConfig.getKeyMappings();
 
   if (originalMappings.size() != loadedMappings.size()) {
-    std::cerr << "Mapping count mismatch in iteration " << iteration
-              << ": expected " << originalMappings.size() << ", got "
-              << loadedMappings.size() << std::endl;
-    return false;
+    return source.fail("Mapping count mismatch: expected " +
+                       std::to_string(originalMappings.size()) + ", got " +
+                       std::to_string(loadedMappings.size()));
   }
 
   for (size_t i = 0; i < originalMappings.size(); ++i) {
     if (!mappingsEqual(originalMappings[i], loadedMappings[i])) {
-      std::cerr << "Mapping mismatch at index " << i << " in iteration "
-                << iteration << std::endl;
-      std::cerr << "  Original: scanCode=0x" << std::hex
-                << originalMappings[i].sourceScanCode
-                << ", E0=" << originalMappings[i].sourceNeedsE0
-                << ", target=" << originalMappings[i].targetKeyId
-                << ", type=" << originalMappings[i].mappingType << std::endl;
-      std::cerr << "  Loaded: scanCode=0x" << std::hex
-                << loadedMappings[i].sourceScanCode
-                << ", E0=" << loadedMappings[i].sourceNeedsE0
-                << ", target=" << loadedMappings[i].targetKeyId
-                << ", type=" << loadedMappings[i].mappingType << std::endl;
-      return false;
+      std::ostringstream message;
+      message << "Mapping mismatch at index " << i << std::endl;
+      message << "  Loaded: scanCode=0x" << std::hex
+              << loadedMappings[i].sourceScanCode
+              << ", E0=" << loadedMappings[i].sourceNeedsE0
+              << ", target=" << loadedMappings[i].targetKeyId
+              << ", type=" << loadedMappings[i].mappingType;
+      return source.fail(message.str());
     }
   }
 
@@ -152,39 +135,11 @@ int main() {
   std::cout << "=== Config Key Mapping Property-Based Tests ===" << std::endl;
   std::cout << std::endl;
 
-  const int NUM_ITERATIONS = 100;
-
-  std::cout << "Property 1: Configuration round-trip consistency" << std::endl;
-  std::cout << "Running " << NUM_ITERATIONS << " iterations..." << std::endl;
-
-  int passed = 0;
-  int failed = 0;
+  const int NUM_ITERATIONS = 10000;
+  PropertyRunner runner;
 
-  for (int i = 0; i < NUM_ITERATIONS; ++i) {
-    if (testRoundTripProperty(i)) {
-      passed++;
-    } else {
-      failed++;
-      std::cerr << "FAILED at iteration " << i << std::endl;
-      break; // Stop on first failure to show the issue
-    }
-
-    // Progress indicator
-    if ((i + 1) % 10 == 0) {
-      std::cout << "  Completed " << (i + 1) << "/" << NUM_ITERATIONS
-                << " iterations..." << std::endl;
-    }
-  }
+  runner.check("Property 1: Configuration round-trip consistency",
+               NUM_ITERATIONS, testRoundTripProperty);
 
-  std::cout << std::endl;
-  std::cout << "Results: " << passed << " passed, " << failed << " failed"
-            << std::endl;
-
-  if (failed == 0) {
-    std::cout << "Property test PASSED!" << std::endl;
-    return 0;
-  } else {
-    std::cout << "Property test FAILED!" << std::endl;
-    return 1;
-  }
+  return runner.finish();
 }
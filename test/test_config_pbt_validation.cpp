@@ -4,79 +4,39 @@
 // Property 8: Mapping type validation - Validates: Requirements 3.2, 3.4
 
 #include "config.h"
+#include "property_test.h"
 #include <cassert>
 #include <fstream>
 #include <iostream>
-#include <random>
 #include <sstream>
 #include <string>
 #include <vector>
 
-// Random generator
-std::random_device rd;
-std::mt19937 gen(rd());
-
 // Helper: Generate random scan code
-unsigned short randomScanCode() {
-  std::uniform_int_distribution<int> dis(0x01, 0xFF);
-  return static_cast<unsigned short>(dis(gen));
-}
-
-// Helper: Generate random bool
-bool randomBool() {
-  std::uniform_int_distribution<int> dis(0, 1);
-  return dis(gen) == 1;
+unsigned short randomScanCode(PropertySource &source) {
+  return static_cast<unsigned short>(source.range(0x01, 0xFF));
 }
 
 // Helper: Generate random INVALID modifier key ID
-std::string randomInvalidKeyId() {
-  static std::vector<std::string> invalidKeys;
-  if (invalidKeys.empty()) {
-    invalidKeys.push_back("invalid");
-    invalidKeys.push_back("capslock");
-    invalidKeys.push_back("tab");
-    invalidKeys.push_back("enter");
-    invalidKeys.push_back("space");
-    invalidKeys.push_back("LCTRL");
-    invalidKeys.push_back("Rctrl");
-    invalidKeys.push_back("leftctrl");
-    invalidKeys.push_back("ctrl");
-    invalidKeys.push_back("shift");
-  }
-  std::uniform_int_distribution<size_t> dis(0, invalidKeys.size() - 1);
-  return invalidKeys[dis(gen)];
+std::string randomInvalidKeyId(PropertySource &source) {
+  static const std::vector<std::string> invalidKeys = {
+      "invalid", "capslock", "tab", "enter", "space", "LCTRL", "Rctrl",
+      "leftctrl", "ctrl", "shift"};
+  return source.pick(invalidKeys);
 }
 
 // Helper: Generate random VALID modifier key ID
-std::string randomValidKeyId() {
-  static std::vector<std::string> validKeys;
-  if (validKeys.empty()) {
-    validKeys.push_back("lctrl");
-    validKeys.push_back("rctrl");
-    validKeys.push_back("lshift");
-    validKeys.push_back("rshift");
-    validKeys.push_back("lalt");
-    validKeys.push_back("ralt");
-    validKeys.push_back("lwin");
-    validKeys.push_back("rwin");
-  }
-  std::uniform_int_distribution<size_t> dis(0, validKeys.size() - 1);
-  return validKeys[dis(gen)];
+std::string randomValidKeyId(PropertySource &source) {
+  static const std::vector<std::string> validKeys = {
+      "lctrl", "rctrl", "lshift", "rshift", "lalt", "ralt", "lwin", "rwin"};
+  return source.pick(validKeys);
 }
 
 // Helper: Generate random INVALID mapping type
-std::string randomInvalidMappingType() {
-  static std::vector<std::string> invalidTypes;
-  if (invalidTypes.empty()) {
-    invalidTypes.push_back("invalid");
-    invalidTypes.push_back("replace_all");
-    invalidTypes.push_back("add");
-    invalidTypes.push_back("override");
-    invalidTypes.push_back("ADDITIONAL");
-    invalidTypes.push_back("Replace");
-  }
-  std::uniform_int_distribution<size_t> dis(0, invalidTypes.size() - 1);
-  return invalidTypes[dis(gen)];
+std::string randomInvalidMappingType(PropertySource &source) {
+  static const std::vector<std::string> invalidTypes = {
+      "invalid", "replace_all", "add", "override", "ADDITIONAL", "Replace"};
+  return source.pick(invalidTypes);
 }
 
 // Helper: Create temp file
@@ -91,8 +51,9 @@ private:
 };
 
 // Property 2: Invalid configurations are rejected
-bool testInvalidConfigRejection(int iteration) {
-  std::string filename = "test_invalid_" + std::to_string(iteration) + ".toml";
+bool testInvalidConfigRejection(PropertySource &source) {
+  std::string filename =
+      "test_invalid_" + std::to_string(source.index()) + ".toml";
   TempFile tempFile(filename);
 
   // Generate config with missing required field
@@ -100,12 +61,13 @@ bool testInvalidConfigRejection(int iteration) {
   ss << "[general]\n";
   ss << "thresholdMs = 1000\n\n";
   ss << "[[keyMappings]]\n";
-  ss << "sourceScanCode = 0x" << std::hex << randomScanCode() << std::dec
+  ss << "sourceScanCode = 0x" << std::hex << randomScanCode(source) << std::dec
      << "\n";
   // Missing sourceNeedsE0
-  ss << "targetKeyId = \"" << randomValidKeyId() << "\"\n";
+  ss << "targetKeyId = \"" << randomValidKeyId(source) << "\"\n";
   ss << "mappingType = \"additional\"\n";
 
+  source.note(ss.str());
   std::ofstream file(filename);
   file << ss.str();
   file.close();
@@ -114,23 +76,20 @@ bool testInvalidConfigRejection(int iteration) {
   bool loaded = config.load(filename);
 
   if (!loaded) {
-    std::cerr << "Config should load even with invalid mappings (iteration "
-              << iteration << ")" << std::endl;
-    return false;
+    return source.fail("Config should load even with invalid mappings");
   }
 
   if (config.getKeyMappings().size() != 0) {
-    std::cerr << "Invalid mapping should be ignored (iteration " << iteration
-              << ")" << std::endl;
-    return false;
+    return source.fail("Invalid mapping should be ignored");
   }
 
   return true;
 }
 
 // Property 7: Target key ID validation
-bool testTargetKeyIdValidation(int iteration) {
-  std::string filename = "test_target_" + std::to_string(iteration) + ".toml";
+bool testTargetKeyIdValidation(PropertySource &source) {
+  std::string filename =
+      "test_target_" + std::to_string(source.index()) + ".toml";
   TempFile tempFile(filename);
 
   // Generate config with invalid target key ID
@@ -138,12 +97,13 @@ bool testTargetKeyIdValidation(int iteration) {
   ss << "[general]\n";
   ss << "thresholdMs = 1000\n\n";
   ss << "[[keyMappings]]\n";
-  ss << "sourceScanCode = 0x" << std::hex << randomScanCode() << std::dec
+  ss << "sourceScanCode = 0x" << std::hex << randomScanCode(source) << std::dec
      << "\n";
-  ss << "sourceNeedsE0 = " << (randomBool() ? "true" : "false") << "\n";
-  ss << "targetKeyId = \"" << randomInvalidKeyId() << "\"\n";
+  ss << "sourceNeedsE0 = " << (source.boolean() ? "true" : "false") << "\n";
+  ss << "targetKeyId = \"" << randomInvalidKeyId(source) << "\"\n";
   ss << "mappingType = \"additional\"\n";
 
+  source.note(ss.str());
   std::ofstream file(filename);
   file << ss.str();
   file.close();
@@ -152,23 +112,20 @@ bool testTargetKeyIdValidation(int iteration) {
   bool loaded = config.load(filename);
 
   if (!loaded) {
-    std::cerr << "Config should load (iteration " << iteration << ")"
-              << std::endl;
-    return false;
+    return source.fail("Config should load");
   }
 
   if (config.getKeyMappings().size() != 0) {
-    std::cerr << "Invalid target key ID should be rejected (iteration "
-              << iteration << ")" << std::endl;
-    return false;
+    return source.fail("Invalid target key ID should be rejected");
   }
 
   return true;
 }
 
 // Property 8: Mapping type validation and default value
-bool testMappingTypeValidation(int iteration) {
-  std::string filename = "test_type_" + std::to_string(iteration) + ".toml";
+bool testMappingTypeValidation(PropertySource &source) {
+  std::string filename =
+      "test_type_" + std::to_string(source.index()) + ".toml";
   TempFile tempFile(filename);
 
   // Generate config with invalid mapping type
@@ -176,12 +133,13 @@ bool testMappingTypeValidation(int iteration) {
   ss << "[general]\n";
   ss << "thresholdMs = 1000\n\n";
   ss << "[[keyMappings]]\n";
-  ss << "sourceScanCode = 0x" << std::hex << randomScanCode() << std::dec
+  ss << "sourceScanCode = 0x" << std::hex << randomScanCode(source) << std::dec
      << "\n";
-  ss << "sourceNeedsE0 = " << (randomBool() ? "true" : "false") << "\n";
-  ss << "targetKeyId = \"" << randomValidKeyId() << "\"\n";
-  ss << "mappingType = \"" << randomInvalidMappingType() << "\"\n";
+  ss << "sourceNeedsE0 = " << (source.boolean() ? "true" : "false") << "\n";
+  ss << "targetKeyId = \"" << randomValidKeyId(source) << "\"\n";
+  ss << "mappingType = \"" << randomInvalidMappingType(source) << "\"\n";
 
+  source.note(ss.str());
   std::ofstream file(filename);
   file << ss.str();
   file.close();
@@ -190,30 +148,24 @@ bool testMappingTypeValidation(int iteration) {
   bool loaded = config.load(filename);
 
   if (!loaded) {
-    std::cerr << "Config should load (iteration " << iteration << ")"
-              << std::endl;
-    return false;
+    return source.fail("Config should load");
   }
 
   if (config.getKeyMappings().size() != 1) {
-    std::cerr << "Should have 1 mapping (iteration " << iteration << ")"
-              << std::endl;
-    return false;
+    return source.fail("Should have 1 mapping");
   }
 
   if (config.getKeyMappings()[0].mappingType != "additional") {
-    std::cerr << "Should use default 'additional' type (iteration " << iteration
-              << ")" << std::endl;
-    return false;
+    return source.fail("Should use default 'additional' type");
   }
 
   return true;
 }
 
 // Additional test: Missing mapping type should default to "additional"
-bool testMissingMappingType(int iteration) {
+bool testMissingMappingType(PropertySource &source) {
   std::string filename =
-      "test_missing_type_" + std::to_string(iteration) + ".toml";
+      "test_missing_type_" + std::to_string(source.index()) + ".toml";
   TempFile tempFile(filename);
 
   // Generate config without mapping type
@@ -221,11 +173,12 @@ bool testMissingMappingType(int iteration) {
   ss << "[general]\n";
   ss << "thresholdMs = 1000\n\n";
   ss << "[[keyMappings]]\n";
-  ss << "sourceScanCode = 0x" << std::hex << randomScanCode() << std::dec
+  ss << "sourceScanCode = 0x" << std::hex << randomScanCode(source) << std::dec
      << "\n";
-  ss << "sourceNeedsE0 = " << (randomBool() ? "true" : "false") << "\n";
-  ss << "targetKeyId = \"" << randomValidKeyId() << "\"\n";
+  ss << "sourceNeedsE0 = " << (source.boolean() ? "true" : "false") << "\n";
+  ss << "targetKeyId = \"" << randomValidKeyId(source) << "\"\n";
 
+  source.note(ss.str());
   std::ofstream file(filename);
   file << ss.str();
   file.close();
@@ -234,21 +187,15 @@ bool testMissingMappingType(int iteration) {
   bool loaded = config.load(filename);
 
   if (!loaded) {
-    std::cerr << "Config should load (iteration " << iteration << ")"
-              << std::endl;
-    return false;
+    return source.fail("Config should load");
   }
 
   if (config.getKeyMappings().size() != 1) {
-    std::cerr << "Should have 1 mapping (iteration " << iteration << ")"
-              << std::endl;
-    return false;
+    return source.fail("Should have 1 mapping");
   }
 
   if (config.getKeyMappings()[0].mappingType != "additional") {
-    std::cerr << "Should use default 'additional' type (iteration " << iteration
-              << ")" << std::endl;
-    return false;
+    return source.fail("Should use default 'additional' type");
   }
 
   return true;
@@ -258,118 +205,17 @@ int main() {
   std::cout << "=== Config Validation Property-Based Tests ===" << std::endl;
   std::cout << std::endl;
 
-  const int NUM_ITERATIONS = 100;
-  int totalPassed = 0;
-  int totalFailed = 0;
-
-  // Property 2
-  std::cout << "Property 2: Invalid configurations are rejected" << std::endl;
-  std::cout << "Running " << NUM_ITERATIONS << " iterations..." << std::endl;
-
-  int passed = 0;
-  for (int i = 0; i < NUM_ITERATIONS; ++i) {
-    if (testInvalidConfigRejection(i)) {
-      passed++;
-    } else {
-      std::cerr << "FAILED at iteration " << i << std::endl;
-      break;
-    }
-    if ((i + 1) % 25 == 0) {
-      std::cout << "  Completed " << (i + 1) << "/" << NUM_ITERATIONS
-                << std::endl;
-    }
-  }
-  std::cout << "Result: " << passed << "/" << NUM_ITERATIONS << " passed"
-            << std::endl;
-  totalPassed += passed;
-  if (passed < NUM_ITERATIONS)
-    totalFailed++;
-  std::cout << std::endl;
-
-  // Property 7
-  std::cout << "Property 7: Target key ID validation" << std::endl;
-  std::cout << "Running " << NUM_ITERATIONS << " iterations..." << std::endl;
-
-  passed = 0;
-  for (int i = 0; i < NUM_ITERATIONS; ++i) {
-    if (testTargetKeyIdValidation(i)) {
-      passed++;
-    } else {
-      std::cerr << "FAILED at iteration " << i << std::endl;
-      break;
-    }
-    if ((i + 1) % 25 == 0) {
-      std::cout << "  Completed " << (i + 1) << "/" << NUM_ITERATIONS
-                << std::endl;
-    }
-  }
-  std::cout << "Result: " << passed << "/" << NUM_ITERATIONS << " passed"
-            << std::endl;
-  totalPassed += passed;
-  if (passed < NUM_ITERATIONS)
-    totalFailed++;
-  std::cout << std::endl;
-
-  // Property 8
-  std::cout << "Property 8: Mapping type validation and default value"
-            << std::endl;
-  std::cout << "Running " << NUM_ITERATIONS << " iterations..." << std::endl;
-
-  passed = 0;
-  for (int i = 0; i < NUM_ITERATIONS; ++i) {
-    if (testMappingTypeValidation(i)) {
-      passed++;
-    } else {
-      std::cerr << "FAILED at iteration " << i << std::endl;
-      break;
-    }
-    if ((i + 1) % 25 == 0) {
-      std::cout << "  Completed " << (i + 1) << "/" << NUM_ITERATIONS
-                << std::endl;
-    }
-  }
-  std::cout << "Result: " << passed << "/" << NUM_ITERATIONS << " passed"
-            << std::endl;
-  totalPassed += passed;
-  if (passed < NUM_ITERATIONS)
-    totalFailed++;
-  std::cout << std::endl;
+  const int NUM_ITERATIONS = 10000;
+  PropertyRunner runner;
 
-  // Additional test
-  std::cout << "Additional: Missing mapping type defaults to 'additional'"
-            << std::endl;
-  std::cout << "Running " << NUM_ITERATIONS << " iterations..." << std::endl;
-
-  passed = 0;
-  for (int i = 0; i < NUM_ITERATIONS; ++i) {
-    if (testMissingMappingType(i)) {
-      passed++;
-    } else {
-      std::cerr << "FAILED at iteration " << i << std::endl;
-      break;
-    }
-    if ((i + 1) % 25 == 0) {
-      std::cout << "  Completed " << (i + 1) << "/" << NUM_ITERATIONS
-                << std::endl;
-    }
-  }
-  std::cout << "Result: " << passed << "/" << NUM_ITERATIONS << " passed"
-            << std::endl;
-  totalPassed += passed;
-  if (passed < NUM_ITERATIONS)
-    totalFailed++;
-  std::cout << std::endl;
+  runner.check("Property 2: Invalid configurations are rejected",
+               NUM_ITERATIONS, testInvalidConfigRejection);
+  runner.check("Property 7: Target key ID validation", NUM_ITERATIONS,
+               testTargetKeyIdValidation);
+  runner.check("Property 8: Mapping type validation and default value",
+               NUM_ITERATIONS, testMappingTypeValidation);
+  runner.check("Additional: Missing mapping type defaults to 'additional'",
+               NUM_ITERATIONS, testMissingMappingType);
 
-  // Summary
-  std::cout << "=== Summary ===" << std::endl;
-  std::cout << "Total iterations: " << totalPassed << "/"
-            << (NUM_ITERATIONS * 4) << std::endl;
-
-  if (totalFailed == 0) {
-    std::cout << "All property tests PASSED!" << std::endl;
-    return 0;
-  } else {
-    std::cout << totalFailed << " property test(s) FAILED!" << std::endl;
-    return 1;
-  }
+  return runner.finish();
 }
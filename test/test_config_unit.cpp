@@ -246,6 +246,83 @@ targetKeyId = "lctrl"
   std::cout << "PASSED" << std::endl;
 }
 
+// Test 9: Per-key and adaptive thresholds load and survive a save
+void testKeyThresholds() {
+  std::cout << "Test 9: Per-key and adaptive thresholds... ";
+
+  std::string configContent = R"(
+[general]
+thresholdMs = 1000
+keyThresholds = { ralt = 2000, lwin = 1500, lshift = -5 }
+
+[adaptiveThreshold]
+enabled = true
+quantile = 0.95
+marginMs = 100
+)";
+
+  createTempConfigFile("test_key_thresholds.toml", configContent);
+
+  Config config;
+  assert(config.load("test_key_thresholds.toml") && "Should load config");
+  const auto &thresholds = config.getKeyThresholds();
+  assert(thresholds.size() == 2 && "Non-positive threshold ignored");
+  for (const auto &threshold : thresholds) {
+    assert(((threshold.first == "ralt" && threshold.second == 2000) ||
+            (threshold.first == "lwin" && threshold.second == 1500)) &&
+           "Key thresholds");
+  }
+  const AdaptiveThresholdConfig &adaptive = config.getAdaptiveThreshold();
+  assert(adaptive.enabled && adaptive.quantile == 0.95 &&
+         adaptive.marginMs == 100 && "Adaptive settings");
+  assert(adaptive.minMs == 300 && adaptive.minSamples == 50 &&
+         "Unset adaptive settings keep their defaults");
+
+  assert(config.save("test_key_thresholds.toml") && "Should save config");
+  Config reloaded;
+  assert(reloaded.load("test_key_thresholds.toml") && "Should reload");
+  assert(reloaded.getKeyThresholds() == thresholds && "Thresholds saved");
+  assert(reloaded.getAdaptiveThreshold().enabled &&
+         reloaded.getAdaptiveThreshold().quantile == 0.95 &&
+         reloaded.getAdaptiveThreshold().marginMs == 100 &&
+         "Adaptive settings saved");
+
+  createTempConfigFile("test_key_thresholds.toml",
+                       "[adaptiveThreshold]\nenabled = true\nquantile = 1.5\n");
+  Config invalid;
+  assert(invalid.load("test_key_thresholds.toml") && "Should load config");
+  assert(!invalid.getAdaptiveThreshold().enabled &&
+         invalid.getAdaptiveThreshold().quantile == 0.99 &&
+         "Invalid adaptive settings fall back to defaults");
+
+  deleteTempFile("test_key_thresholds.toml");
+  std::cout << "PASSED" << std::endl;
+}
+
+// Test 10: Paths with quotes and backslashes survive a save
+void testPathsWithQuotesRoundTrip() {
+  std::cout << "Test 10: Paths with apostrophes survive a save... ";
+
+  const std::string apostrophe = "C:\\Users\\O'Brien\\escModKey";
+  Config config;
+  config.setLogFile(apostrophe + "\\escModKey.log");
+  config.setTraceFile(apostrophe + "\\\"trace\".json");
+  config.setRecordFile("C:\\Program Files\\escModKey\\strokes.emkt");
+  config.setFlightRecorderDir(apostrophe + "\\dumps");
+  assert(config.save("test_quoted_paths.toml") && "Should save config");
+
+  Config reloaded;
+  assert(reloaded.load("test_quoted_paths.toml") && "Should reload config");
+  assert(reloaded.getLogFile() == config.getLogFile() && "Log file");
+  assert(reloaded.getTraceFile() == config.getTraceFile() && "Trace file");
+  assert(reloaded.getRecordFile() == config.getRecordFile() && "Record file");
+  assert(reloaded.getFlightRecorderDir() == config.getFlightRecorderDir() &&
+         "Flight recorder directory");
+
+  deleteTempFile("test_quoted_paths.toml");
+  std::cout << "PASSED" << std::endl;
+}
+
 int main() {
   std::cout << "=== Config Key Mapping Unit Tests ===" << std::endl;
   std::cout << std::endl;
@@ -259,6 +336,8 @@ int main() {
     testInvalidTargetKeyId();
     testInvalidMappingType();
     testMissingMappingType();
+    testKeyThresholds();
+    testPathsWithQuotesRoundTrip();
 
     std::cout << std::endl;
     std::cout << "All tests PASSED!" << std::endl;
@@ -0,0 +1,143 @@
+#include "differential.h"
+#include "simulator.h"
+#include "work_stealing_pool.h"
+#include <cassert>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Tests of the differential harness: the live detector and fix logic agree
+// with the frozen reference, and a planted difference is found and shrunk
+
+// Live code with a planted bug: stuck transitions are never reported
+class MissingStuckSubject : public DiffSubject {
+public:
+  MissingStuckSubject() : inner_(makeCurrentSubject()) {}
+
+  void initialize(const DiffConfig &config) override {
+    inner_->initialize(config);
+  }
+
+  std::vector<DiffKey> getKeys() const override { return inner_->getKeys(); }
+
+  void step(const DiffEvent &event, DiffVirtualLayer &layer,
+            DiffStep &result) override {
+    inner_->step(event, layer, result);
+    std::vector<TrackerEvent> kept;
+    for (const TrackerEvent &change : result.changes) {
+      if (change.change != TrackerChange::Stuck) {
+        kept.push_back(change);
+      }
+    }
+    result.changes = kept;
+  }
+
+private:
+  std::unique_ptr<DiffSubject> inner_;
+};
+
+void testGeneratedCasesAgree() {
+  std::cout << "Test 1: Generated cases agree with the reference... ";
+
+  WorkStealingPool pool(2);
+  DiffReport report = runDifferential(
+      5000, [](size_t index) { return generateDiffCase(index, 200); }, pool,
+      makeReferenceSubject, makeCurrentSubject);
+  assert(report.cases == 5000 && report.events > 5000 && "Cases ran");
+  if (report.hasFailure) {
+    std::cerr << report.mismatch.description << std::endl
+              << describeDiffCase(report.minimal);
+  }
+  assert(!report.hasFailure && report.failures == 0 && "No divergence");
+
+  // Generation is deterministic in the seed
+  DiffCase a = generateDiffCase(42, 200);
+  DiffCase b = generateDiffCase(42, 200);
+  assert(describeDiffCase(a) == describeDiffCase(b) && "Reproducible");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testRecordedStrokesAgree() {
+  std::cout << "Test 2: Recorded strokes agree with the reference... ";
+
+  TraceGeneratorOptions generator;
+  generator.strokeCount = 20000;
+  std::vector<SimStroke> strokes =
+      generateTrace(generator, ModifierKeyStates());
+  std::vector<DiffCase> cases =
+      diffCasesFromStrokes(strokes, 7, 1000, 50, 0.05);
+  assert(cases.size() == (strokes.size() + 999) / 1000 && "One per window");
+
+  size_t idle = 0;
+  size_t lost = 0;
+  for (const DiffEvent &event : cases[0].events) {
+    idle += event.idle;
+    lost += event.lost;
+  }
+  assert(idle > 0 && lost > 0 && "Idle iterations and lost key-ups added");
+
+  WorkStealingPool pool(2);
+  DiffReport report = runDifferential(
+      cases.size(), [&](size_t index) { return cases[index]; }, pool,
+      makeReferenceSubject, makeCurrentSubject);
+  assert(!report.hasFailure && "No divergence");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testDivergenceShrunk() {
+  std::cout << "Test 3: Planted divergence is found and shrunk... ";
+
+  WorkStealingPool pool(2);
+  DiffSubjectFactory buggy = [] {
+    return std::unique_ptr<DiffSubject>(new MissingStuckSubject());
+  };
+  DiffReport report = runDifferential(
+      200, [](size_t index) { return generateDiffCase(index, 200); }, pool,
+      makeReferenceSubject, buggy);
+  assert(report.hasFailure && report.failures > 0 && "Divergence found");
+  assert(report.mismatch.found &&
+         report.mismatch.description.find("tracker changes") !=
+             std::string::npos &&
+         "Minimal case still fails the same way");
+
+  // Two or three events (e.g. press, lost release, a later event) and at
+  // most one configuration entry (e.g. a custom key sharing a scan code)
+  const DiffCase &minimal = report.minimal;
+  assert(!minimal.events.empty() && minimal.events.size() <= 3 &&
+         "Events shrunk");
+  assert(minimal.config.customKeys.size() + minimal.config.keyMappings.size() +
+                 minimal.config.disabledKeys.size() <=
+             1 &&
+         "Configuration shrunk");
+  assert(describeDiffCase(minimal).find("Policy: ") != std::string::npos &&
+         "Reproducer lists the policy");
+
+  // The reference agrees with itself
+  assert(!runDiffCase(minimal, makeReferenceSubject, makeReferenceSubject)
+              .found &&
+         "Reference is deterministic");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+int main() {
+  std::cout << "=== Differential Harness Tests ===" << std::endl;
+  std::cout << std::endl;
+
+  try {
+    testGeneratedCasesAgree();
+    testRecordedStrokesAgree();
+    testDivergenceShrunk();
+
+    std::cout << std::endl;
+    std::cout << "All differential harness tests PASSED!" << std::endl;
+    return 0;
+  } catch (const std::exception &e) {
+    std::cerr << std::endl;
+    std::cerr << "Test FAILED with exception: " << e.what() << std::endl;
+    return 1;
+  }
+}
@@ -0,0 +1,489 @@
+#include "clock.h"
+#include "fake_interception.h"
+#include "fake_win32.h"
+#include "modifier_key_fixer.h"
+#include <Windows.h>
+#include <cassert>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// End-to-end tests of ModifierKeyFixer on the fake Interception driver
+// (headless builds only)
+
+const InterceptionDevice kKeyboard = INTERCEPTION_KEYBOARD(0);
+const InterceptionDevice kMouse = INTERCEPTION_MOUSE(0);
+
+void resetFakes() {
+  FakeInterception::reset();
+  FakeWin32::reset();
+  FakeInterception::setWaitBlocks(false);
+  FakeWin32::setSleepEnabled(false);
+}
+
+void testStrokesAreForwarded() {
+  std::cout << "Test 1: Strokes are forwarded and reach the OS layer... ";
+  resetFakes();
+
+  ModifierKeyFixer fixer;
+  fixer.setShowMessages(false);
+  assert(fixer.initialize() && "Fake driver should create a context");
+  assert(FakeInterception::getContextCount() == 1 && "One context expected");
+  assert(interception_get_filter(nullptr, kKeyboard) == 0 &&
+         "Null context has no filter");
+
+  std::vector<InterceptionKeyStroke> input = {
+      {0x1D, INTERCEPTION_KEY_DOWN, 0},
+      {0x1E, INTERCEPTION_KEY_DOWN, 0},
+      {0x1E, INTERCEPTION_KEY_UP, 0},
+      {0x1D, INTERCEPTION_KEY_UP, 0}};
+  FakeInterception::pushKeyStrokes(kKeyboard, input);
+  assert(FakeInterception::getPendingCount() == input.size() &&
+         "Keyboard input should be captured by the fixer's filter");
+
+  fixer.processEvents(0);
+  assert(fixer.getPhysicalStates().findKeyById("lctrl")->pressed &&
+         "Physical state should follow the stroke");
+  assert(FakeWin32::getKeyState(VK_LCONTROL) &&
+         "Forwarded key-down should reach the OS layer");
+  assert((GetAsyncKeyState(VK_LCONTROL) & 0x8000) &&
+         "GetAsyncKeyState should report the OS layer");
+  assert(fixer.getVirtualStates().findKeyById("lctrl")->pressed &&
+         "Virtual detector should read the OS layer");
+
+  for (size_t i = 1; i < input.size(); ++i) {
+    fixer.processEvents(0);
+  }
+  assert(FakeInterception::getPendingCount() == 0 && "All input received");
+  assert(!FakeWin32::getKeyState(VK_LCONTROL) && "Ctrl released again");
+
+  std::vector<FakeInterception::SentStroke> sent = FakeInterception::takeSent();
+  assert(sent.size() == input.size() && "Every stroke should be forwarded");
+  for (size_t i = 0; i < input.size(); ++i) {
+    assert(sent[i].device == kKeyboard && "Forwarded to the same device");
+    assert(sent[i].stroke.code == input[i].code &&
+           sent[i].stroke.state == input[i].state &&
+           "Strokes should be forwarded unchanged and in order");
+  }
+
+  // The mouse is not filtered: its input never reaches the fixer
+  InterceptionMouseStroke click = {INTERCEPTION_MOUSE_LEFT_BUTTON_DOWN, 0, 0,
+                                   0, 0, 0};
+  FakeInterception::pushMouseStroke(kMouse, click);
+  assert(FakeInterception::getPendingCount() == 0 &&
+         "Unfiltered device input bypasses the context");
+
+  fixer.cleanup();
+  assert(FakeInterception::getContextCount() == 0 && "Context destroyed");
+
+  // Without a context keyboard input goes straight to the OS
+  FakeInterception::pushKeyStroke(kKeyboard, 0x2A, INTERCEPTION_KEY_DOWN);
+  assert(FakeWin32::getKeyState(VK_LSHIFT) && "Bypassed input reaches the OS");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testLostKeyUpIsFixed() {
+  std::cout << "Test 2: Lost key-up is detected and fixed... ";
+  resetFakes();
+
+  // Lose the first Left Ctrl key-up on its way to the OS
+  int droppedKeyUps = 0;
+  FakeInterception::setDeliveryFilter(
+      [&droppedKeyUps](InterceptionDevice, const InterceptionKeyStroke &key) {
+        if (key.code == 0x1D && (key.state & INTERCEPTION_KEY_UP) &&
+            droppedKeyUps == 0) {
+          droppedKeyUps++;
+          return false;
+        }
+        return true;
+      });
+
+  ManualClock clock;
+  ModifierKeyFixer fixer(clock);
+  fixer.setShowMessages(false);
+  fixer.setThreshold(1000);
+  assert(fixer.initialize() && "Initialization should succeed");
+
+  FakeInterception::pushKeyStroke(kKeyboard, 0x1D, INTERCEPTION_KEY_DOWN);
+  fixer.processEvents(0);
+  clock.advanceMs(100);
+  FakeInterception::pushKeyStroke(kKeyboard, 0x1D, INTERCEPTION_KEY_UP);
+  fixer.processEvents(0);
+  assert(droppedKeyUps == 1 && "Key-up should have been lost");
+  assert(FakeWin32::getKeyState(VK_LCONTROL) && "Ctrl stuck in the OS");
+  assert(fixer.getMismatchTrackers().lctrl().isMismatched &&
+         "Mismatch should be tracked");
+
+  // Idle iterations while time passes
+  clock.advanceMs(1500);
+  fixer.processEvents(0);
+  assert(fixer.getMismatchTrackers().lctrl().getDurationMs() == 1500 &&
+         "Tracker should use the injected clock");
+
+  // The next key-down triggers the fix
+  FakeInterception::pushKeyStroke(kKeyboard, 0x1E, INTERCEPTION_KEY_DOWN);
+  fixer.processEvents(0);
+  assert(fixer.getStatistics().getFixCount("lctrl") == 1 &&
+         "Ctrl should have been fixed");
+  assert(!FakeWin32::getKeyState(VK_LCONTROL) &&
+         "Injected release should reach the OS");
+  assert(!fixer.getVirtualStates().findKeyById("lctrl")->pressed &&
+         "Virtual state re-read after the fix");
+  assert(FakeWin32::getSleptMs() >= 20 && "Fix settle delay requested");
+
+  std::vector<FakeInterception::SentStroke> sent = FakeInterception::takeSent();
+  assert(sent.size() == 4 && "Down, lost up, injected up, trigger");
+  assert(sent[2].stroke.code == 0x1D &&
+         sent[2].stroke.state == INTERCEPTION_KEY_UP &&
+         "Injected release before the trigger key");
+  assert(sent[3].stroke.code == 0x1E && "Trigger key forwarded after the fix");
+
+  fixer.processEvents(0);
+  assert(!fixer.getMismatchTrackers().lctrl().isMismatched &&
+         "Mismatch should be resolved");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testHardwareIdsAndDevices() {
+  std::cout << "Test 3: Devices and hardware IDs... ";
+  resetFakes();
+
+  InterceptionContext context = interception_create_context();
+  FakeInterception::addDevice(INTERCEPTION_KEYBOARD(3), "HID\\VID_1234");
+
+  char buffer[256];
+  unsigned int bytes = interception_get_hardware_id(
+      context, INTERCEPTION_KEYBOARD(3), buffer, sizeof(buffer));
+  assert(bytes == (12 + 2) * 2 && "UTF-16 multi-string expected");
+  const uint16_t *wide = reinterpret_cast<const uint16_t *>(buffer);
+  std::string id;
+  for (size_t i = 0; wide[i] != 0; ++i) {
+    id += static_cast<char>(wide[i]);
+  }
+  assert(id == "HID\\VID_1234" && "Hardware ID should round trip");
+  assert(interception_get_hardware_id(context, INTERCEPTION_KEYBOARD(4),
+                                      buffer, sizeof(buffer)) == 0 &&
+         "Absent device has no hardware ID");
+
+  // Filters and precedence are per context and device
+  interception_set_filter(context, interception_is_keyboard,
+                          INTERCEPTION_FILTER_KEY_UP);
+  assert(interception_get_filter(context, kKeyboard) ==
+             INTERCEPTION_FILTER_KEY_UP &&
+         "Filter should be stored");
+  assert(interception_get_filter(context, kMouse) == 0 &&
+         "Predicate limits the filter to keyboards");
+  interception_set_precedence(context, kKeyboard, 5);
+  assert(interception_get_precedence(context, kKeyboard) == 5 &&
+         "Precedence should be stored");
+
+  FakeInterception::pushKeyStroke(INTERCEPTION_KEYBOARD(3), 0x10,
+                                  INTERCEPTION_KEY_DOWN);
+  assert(FakeInterception::getPendingCount() == 0 &&
+         "Key-down does not match a key-up filter");
+  FakeInterception::pushKeyStroke(INTERCEPTION_KEYBOARD(3), 0x10,
+                                  INTERCEPTION_KEY_UP);
+  assert(interception_wait_with_timeout(context, 0) ==
+             INTERCEPTION_KEYBOARD(3) &&
+         "Wait reports the device with input");
+
+  InterceptionKeyStroke key;
+  assert(interception_receive(context, INTERCEPTION_KEYBOARD(3),
+                              (InterceptionStroke *)&key, 1) == 1 &&
+         "One stroke received");
+  assert(key.code == 0x10 && key.state == INTERCEPTION_KEY_UP &&
+         "Received stroke should match");
+  assert(interception_wait_with_timeout(context, 0) == 0 &&
+         "No input left");
+
+  FakeInterception::removeDevice(INTERCEPTION_KEYBOARD(3));
+  FakeInterception::pushKeyStroke(INTERCEPTION_KEYBOARD(3), 0x10,
+                                  INTERCEPTION_KEY_UP);
+  assert(FakeInterception::getPendingCount() == 0 &&
+         "Removed device produces no input");
+
+  interception_destroy_context(context);
+
+  std::cout << "PASSED" << std::endl;
+}
+
+// Forward strokeCount strokes pushed by a producer thread; returns strokes/s
+double runProducerThroughput(ModifierKeyFixer &fixer, uint64_t strokeCount) {
+  std::thread producer([strokeCount]() {
+    for (uint64_t i = 0; i < strokeCount; i += 2) {
+      FakeInterception::pushKeyStroke(kKeyboard, 0x1E, INTERCEPTION_KEY_DOWN);
+      FakeInterception::pushKeyStroke(kKeyboard, 0x1E, INTERCEPTION_KEY_UP);
+    }
+  });
+
+  auto start = std::chrono::steady_clock::now();
+  while (FakeInterception::getSentCount() < strokeCount) {
+    fixer.processEvents(50);
+  }
+  double elapsedSec = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+  producer.join();
+
+  assert(FakeInterception::getPendingCount() == 0 && "Queue drained");
+  assert(fixer.getStatistics().getTotalFixes() == 0 && "No fixes expected");
+#if ESCMODKEY_LATENCY_STATS
+  assert(fixer.getStatistics().getForwardLatency().getCount() == strokeCount &&
+         "Every forwarded stroke should be timed");
+#endif
+  return strokeCount / elapsedSec;
+}
+
+void testThroughputWithProducerThread() {
+  std::cout << "Test 4: Blocking waits with a producer thread... ";
+  resetFakes();
+  FakeInterception::setWaitBlocks(true);
+  FakeInterception::setCaptureSent(false);
+
+  ModifierKeyFixer fixer;
+  fixer.setShowMessages(false);
+  assert(fixer.initialize() && "Initialization should succeed");
+
+  const uint64_t strokeCount = 200000;
+  double strokesPerSec = runProducerThroughput(fixer, strokeCount);
+#if ESCMODKEY_STAGE_TIMING
+  assert(fixer.getStageTimers().getCount(Stage::Forward) == strokeCount &&
+         "Every forward should be counted");
+#endif
+
+  std::cout << "PASSED (" << static_cast<uint64_t>(strokesPerSec)
+            << " strokes/s, "
+            << formatLatencySummary(
+                   fixer.getStatistics().getForwardLatency().summarize())
+            << ")" << std::endl;
+}
+
+void testThroughputWithAllObservers() {
+  std::cout << "Test 5: Forwarding latency with every observer on... ";
+  resetFakes();
+  FakeInterception::setWaitBlocks(true);
+  FakeInterception::setCaptureSent(false);
+
+  std::filesystem::path dir =
+      std::filesystem::temp_directory_path() / "escModKey_fake_observers";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+
+  Config config;
+  config.loadDefaults();
+  config.setShowMessages(false);
+  config.setRecordFile((dir / "strokes.emkt").string());
+  config.setFlightRecorderDir((dir / "dumps").string());
+  config.setShadowPolicies({"500", "2000:any"});
+
+  // Debug level: every stroke is logged (to a file, not the console)
+  Logger::Options logOptions;
+  logOptions.console = false;
+  logOptions.filePath = (dir / "debug.log").string();
+  logOptions.level = LogLevel::Debug;
+  assert(Logger::instance().start(logOptions) && "Logger started");
+
+  const uint64_t strokeCount = 200000;
+  double strokesPerSec;
+  LatencyHistogram::Summary latency;
+  {
+    ModifierKeyFixer fixer;
+    assert(fixer.initialize(config) && "Initialization should succeed");
+    assert(fixer.getRecorder().isActive() && "Recording started");
+    assert(fixer.getFlightRecorder().isActive() && "Flight recorder started");
+    assert(fixer.getShadowEvaluator().isActive() && "Shadow policies started");
+
+    strokesPerSec = runProducerThroughput(fixer, strokeCount);
+    latency = fixer.getStatistics().getForwardLatency().summarize();
+    fixer.cleanup();
+    assert(fixer.getRecorder().getRecordCount() +
+               fixer.getRecorder().getDroppedCount() >=
+           strokeCount &&
+           "Every stroke recorded or counted as dropped");
+  }
+  Logger::instance().stop();
+  Logger::instance().setLevel(LogLevel::Info);
+  std::filesystem::remove_all(dir);
+
+  std::cout << "PASSED (" << static_cast<uint64_t>(strokesPerSec)
+            << " strokes/s, " << formatLatencySummary(latency) << ")"
+            << std::endl;
+}
+
+void testTimerFixWithoutTrigger() {
+  std::cout << "Test 6: Timer fix releases a stuck key without input... ";
+  resetFakes();
+
+  // Lose the first Left Ctrl key-up on its way to the OS
+  int droppedKeyUps = 0;
+  FakeInterception::setDeliveryFilter(
+      [&droppedKeyUps](InterceptionDevice, const InterceptionKeyStroke &key) {
+        if (key.code == 0x1D && (key.state & INTERCEPTION_KEY_UP) &&
+            droppedKeyUps == 0) {
+          droppedKeyUps++;
+          return false;
+        }
+        return true;
+      });
+
+  ManualClock clock;
+  ModifierKeyFixer fixer(clock);
+  fixer.setShowMessages(false);
+  assert(fixer.initialize() && "Initialization should succeed");
+  fixer.setThreshold(1000);
+  fixer.setTimerFix(true);
+
+  FakeInterception::pushKeyStroke(kKeyboard, 0x1D, INTERCEPTION_KEY_DOWN);
+  fixer.processEvents(50);
+  FakeInterception::pushKeyStroke(kKeyboard, 0x1D, INTERCEPTION_KEY_UP);
+  fixer.processEvents(50);
+  assert(FakeWin32::getKeyState(VK_LCONTROL) && "Ctrl stuck in the OS");
+
+  clock.advanceMs(999);
+  fixer.processEvents(50);
+  assert(fixer.getStatistics().getFixCount("lctrl") == 0 &&
+         "Not stuck before the threshold");
+  clock.advanceMs(1);
+  fixer.processEvents(50);
+  assert(fixer.getStatistics().getFixCount("lctrl") == 1 &&
+         "Released at the deadline by an idle iteration");
+  assert(!FakeWin32::getKeyState(VK_LCONTROL) &&
+         "Injected release should reach the OS");
+
+  std::vector<FakeInterception::SentStroke> sent = FakeInterception::takeSent();
+  assert(sent.size() == 3 && sent[2].device == kKeyboard &&
+         sent[2].stroke.code == 0x1D &&
+         sent[2].stroke.state == INTERCEPTION_KEY_UP &&
+         "Release sent to the keyboard of the last stroke");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testReleaseCheckFromConfig() {
+  std::cout << "Test 7: Release check repairs a dropped key-up at once... ";
+  resetFakes();
+
+  int droppedKeyUps = 0;
+  FakeInterception::setDeliveryFilter(
+      [&droppedKeyUps](InterceptionDevice, const InterceptionKeyStroke &key) {
+        if (key.code == 0x1D && (key.state & INTERCEPTION_KEY_UP) &&
+            droppedKeyUps == 0) {
+          droppedKeyUps++;
+          return false;
+        }
+        return true;
+      });
+
+  ManualClock clock;
+  ModifierKeyFixer fixer(clock);
+  assert(fixer.initialize() && "Initialization should succeed");
+  Config config;
+  config.setShowMessages(false);
+  config.setReleaseCheckMs(30);
+  fixer.applyConfig(config);
+  assert(fixer.getReleaseCheck() == 30 && "Taken from the configuration");
+
+  FakeInterception::pushKeyStroke(kKeyboard, 0x1D, INTERCEPTION_KEY_DOWN);
+  fixer.processEvents(50);
+  FakeInterception::pushKeyStroke(kKeyboard, 0x1D, INTERCEPTION_KEY_UP);
+  fixer.processEvents(50);
+  assert(FakeWin32::getKeyState(VK_LCONTROL) && "Ctrl stuck in the OS");
+
+  // The next key-down arrives after the window: the release goes first
+  clock.advanceMs(30);
+  FakeInterception::pushKeyStroke(kKeyboard, 0x2E, INTERCEPTION_KEY_DOWN);
+  fixer.processEvents(50);
+  assert(fixer.getStatistics().getFixCount("lctrl") == 1 &&
+         !FakeWin32::getKeyState(VK_LCONTROL) && "Released by the check");
+
+  std::vector<FakeInterception::SentStroke> sent = FakeInterception::takeSent();
+  assert(sent.size() == 4 && sent[2].stroke.code == 0x1D &&
+         sent[2].stroke.state == INTERCEPTION_KEY_UP &&
+         sent[3].stroke.code == 0x2E &&
+         "Release injected before the key-down is forwarded");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testKeyDownRepairFromConfig() {
+  std::cout << "Test 8: A lost key-down is sent again... ";
+  resetFakes();
+
+  int droppedKeyDowns = 0;
+  FakeInterception::setDeliveryFilter(
+      [&droppedKeyDowns](InterceptionDevice, const InterceptionKeyStroke &key) {
+        if (key.code == 0x1D && !(key.state & INTERCEPTION_KEY_UP) &&
+            droppedKeyDowns == 0) {
+          droppedKeyDowns++;
+          return false;
+        }
+        return true;
+      });
+
+  ManualClock clock;
+  ModifierKeyFixer fixer(clock);
+  assert(fixer.initialize() && "Initialization should succeed");
+  Config config;
+  config.setShowMessages(false);
+  config.setLostKeyDownMs(80);
+  config.setRepairKeyDown(true);
+  fixer.applyConfig(config);
+  assert(fixer.getRepairKeyDown() && "Taken from the configuration");
+
+  FakeInterception::pushKeyStroke(kKeyboard, 0x1D, INTERCEPTION_KEY_DOWN);
+  fixer.processEvents(50);
+  assert(!FakeWin32::getKeyState(VK_LCONTROL) && "Ctrl never went down");
+
+  clock.advanceMs(79);
+  fixer.processEvents(50);
+  assert(fixer.getStatistics().getTotalLostKeyDowns() == 0 &&
+         "Below the threshold");
+  clock.advanceMs(1);
+  fixer.processEvents(50);
+  const FixStatistics &stats = fixer.getStatistics();
+  assert(stats.getLostKeyDownCount("lctrl") == 1 &&
+         stats.getKeyDownRepairCount("lctrl") == 1 &&
+         FakeWin32::getKeyState(VK_LCONTROL) && "Key-down sent again");
+
+  // The key-up that follows is forwarded as usual
+  FakeInterception::pushKeyStroke(kKeyboard, 0x1D, INTERCEPTION_KEY_UP);
+  fixer.processEvents(50);
+  assert(!FakeWin32::getKeyState(VK_LCONTROL) && stats.getTotalFixes() == 0 &&
+         "Released normally");
+
+  std::vector<FakeInterception::SentStroke> sent = FakeInterception::takeSent();
+  assert(sent.size() == 3 && sent[1].stroke.code == 0x1D &&
+         sent[1].stroke.state == INTERCEPTION_KEY_DOWN &&
+         "Key-down injected once");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+int main() {
+  std::cout << "=== Fake Driver End-to-End Tests ===" << std::endl;
+  std::cout << std::endl;
+
+  try {
+    testStrokesAreForwarded();
+    testLostKeyUpIsFixed();
+    testHardwareIdsAndDevices();
+    testThroughputWithProducerThread();
+    testThroughputWithAllObservers();
+    testTimerFixWithoutTrigger();
+    testReleaseCheckFromConfig();
+    testKeyDownRepairFromConfig();
+
+    std::cout << std::endl;
+    std::cout << "All fake driver tests PASSED!" << std::endl;
+    return 0;
+  } catch (const std::exception &e) {
+    std::cerr << std::endl;
+    std::cerr << "Test FAILED with exception: " << e.what() << std::endl;
+    return 1;
+  }
+}
@@ -0,0 +1,522 @@
+#include "clock.h"
+#include "fix_logic.h"
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+// Counts reads so tests can check how often the source is consulted
+class CountingClock : public Clock {
+public:
+  explicit CountingClock(const Clock &source) : source_(source), reads(0) {}
+  TimePoint now() const override {
+    reads++;
+    return source_.now();
+  }
+
+  const Clock &source_;
+  mutable int reads;
+};
+
+InterceptionKeyStroke keyDown(unsigned short code) {
+  InterceptionKeyStroke stroke;
+  stroke.code = code;
+  stroke.state = INTERCEPTION_KEY_DOWN;
+  stroke.information = 0;
+  return stroke;
+}
+
+void setPressed(ModifierKeyStates &states, const std::string &id,
+                bool pressed) {
+  states.findKeyById(id)->pressed = pressed;
+}
+
+void setPressed(VirtualKeyStates &states, const std::string &id,
+                bool pressed) {
+  states.findKeyById(id)->pressed = pressed;
+}
+
+void testManualAndCachedClock() {
+  std::cout << "Test 1: Manual and cached clocks... ";
+
+  ManualClock manual;
+  Clock::TimePoint start = manual.now();
+  manual.advanceMs(250);
+  assert(manual.now() - start == std::chrono::milliseconds(250) &&
+         "Manual clock should advance exactly");
+
+  CountingClock counting(manual);
+  CachedClock cached(counting);
+  assert(counting.reads == 1 && "Cached clock reads once on construction");
+  manual.advanceMs(100);
+  assert(cached.now() == start + std::chrono::milliseconds(250) &&
+         "Cached clock must not move until refreshed");
+  for (int i = 0; i < 10; ++i) {
+    cached.now();
+  }
+  assert(counting.reads == 1 && "Queries must not read the source");
+  cached.refresh();
+  assert(cached.now() == start + std::chrono::milliseconds(350) &&
+         "Refresh should take a new reading");
+  assert(counting.reads == 2 && "Refresh reads the source once");
+
+  SteadyClock steady;
+  Clock::TimePoint a = steady.now();
+  assert(steady.now() >= a && "Steady clock must be monotonic");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testTrackerUsesInjectedClock() {
+  std::cout << "Test 2: Trackers follow the injected clock... ";
+
+  ManualClock clock;
+  ModifierMismatchTrackers trackers;
+  trackers.setClock(&clock);
+  trackers.initializeForKeys({"lctrl", "rctrl"});
+
+  MismatchTracker *tracker = trackers.getTracker("lctrl");
+  tracker->start();
+  assert(tracker->getDurationMs() == 0 && "No time has passed");
+  clock.advanceMs(999);
+  assert(!tracker->isStuck(1000) && "Not stuck before the threshold");
+  assert(!trackers.hasAnyStuck(1000) && "No tracker stuck yet");
+  clock.advanceMs(1);
+  assert(tracker->isStuck(1000) && "Stuck exactly at the threshold");
+  assert(trackers.hasAnyStuck(1000) && "Collection should see it");
+  assert(trackers.lctrl().getDurationMs() == 1000 &&
+         "Duration should come from the injected clock");
+
+  // Starting again while mismatched keeps the original start time
+  clock.advanceMs(500);
+  tracker->start();
+  assert(tracker->getDurationMs() == 1500 && "Start time must be kept");
+
+  tracker->reset();
+  assert(!tracker->isStuck(1000) && "Reset clears the mismatch");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testFixLogicDecisions() {
+  std::cout << "Test 3: Fix logic with explicit time... ";
+
+  ModifierKeyStates physical;
+  VirtualKeyStates virtualStates;
+  FixLogic logic;
+  logic.setThreshold(1000);
+  logic.initialize(physical, virtualStates);
+  assert(logic.getKeyCount() == physical.getKeys().size() &&
+         "One tracker per key");
+
+  ManualClock clock;
+  std::vector<TrackerEvent> events;
+
+  // Ctrl released physically but still pressed virtually
+  setPressed(virtualStates, "lctrl", true);
+  logic.updateTrackers(physical, virtualStates, clock.now(), &events);
+  assert(events.size() == 1 && events[0].change == TrackerChange::MismatchStart &&
+         "Mismatch start expected");
+  assert(!logic.shouldFix(keyDown(0x1E), physical, clock.now()) &&
+         "Not stuck yet");
+
+  clock.advanceMs(1200);
+  events.clear();
+  logic.updateTrackers(physical, virtualStates, clock.now(), &events);
+  assert(events.size() == 1 && events[0].change == TrackerChange::Stuck &&
+         events[0].mismatchMs == 1200 && "Stuck transition expected");
+
+  // Reported once only
+  events.clear();
+  logic.updateTrackers(physical, virtualStates, clock.now(), &events);
+  assert(events.empty() && "Stuck must be reported once");
+
+  InterceptionKeyStroke keyUp = keyDown(0x1E);
+  keyUp.state = INTERCEPTION_KEY_UP;
+  assert(!logic.shouldFix(keyUp, physical, clock.now()) &&
+         "Key-ups never trigger a fix");
+
+  setPressed(physical, "lshift", true);
+  assert(!logic.shouldFix(keyDown(0x1E), physical, clock.now()) &&
+         "Held modifier blocks the fix");
+  setPressed(physical, "lshift", false);
+  assert(logic.shouldFix(keyDown(0x1E), physical, clock.now()) &&
+         "Key-down should trigger the fix");
+
+  size_t lctrl = 0;
+  assert(logic.getKeyId(lctrl) == "lctrl" && "Default key order");
+  assert(logic.isStuck(lctrl, clock.now()) && "Ctrl is stuck");
+  assert(logic.getMismatchMs(lctrl, clock.now()) == 1200 &&
+         "Mismatch duration");
+  logic.recordFix(lctrl, clock.now());
+  assert(logic.getStatistics().getFixCount("lctrl") == 1 &&
+         "Fix should be counted");
+
+  // Virtual release ends the mismatch
+  setPressed(virtualStates, "lctrl", false);
+  events.clear();
+  logic.updateTrackers(physical, virtualStates, clock.now(), &events);
+  assert(events.size() == 1 && events[0].change == TrackerChange::Reset &&
+         "Reset transition expected");
+  assert(!logic.hasAnyMismatch() && "No mismatch left");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testTriggersAndKeyThresholds() {
+  std::cout << "Test 4: Fix triggers and per-key thresholds... ";
+
+  ModifierKeyStates physical;
+  VirtualKeyStates virtualStates;
+  FixLogic logic;
+  logic.setThreshold(1000);
+  logic.initialize(physical, virtualStates);
+  size_t lctrl = 0;
+  logic.setKeyThreshold(lctrl, 3000);
+  assert(logic.getKeyThreshold(lctrl) == 3000 &&
+         logic.getKeyThreshold(1) == 1000 && "Override of one key only");
+
+  ManualClock clock;
+  setPressed(virtualStates, "lctrl", true);
+  logic.updateTrackers(physical, virtualStates, clock.now());
+  clock.advanceMs(1200);
+  std::vector<TrackerEvent> events;
+  logic.updateTrackers(physical, virtualStates, clock.now(), &events);
+  assert(events.empty() && !logic.isStuck(lctrl, clock.now()) &&
+         !logic.shouldFix(keyDown(0x1E), physical, clock.now()) &&
+         "Own threshold not reached");
+  clock.advanceMs(2000);
+  logic.updateTrackers(physical, virtualStates, clock.now(), &events);
+  assert(events.size() == 1 && events[0].change == TrackerChange::Stuck &&
+         logic.isStuck(lctrl, clock.now()) && "Stuck after own threshold");
+
+  // Default: blocked while a monitored key is held
+  setPressed(physical, "lshift", true);
+  assert(!logic.shouldFix(keyDown(0x1E), physical, clock.now()) &&
+         "Idle trigger blocked by held key");
+  logic.setTrigger(FixTrigger::AnyKeyDown);
+  assert(logic.shouldFix(keyDown(0x1E), physical, clock.now()) &&
+         "Any key-down triggers");
+  setPressed(physical, "lshift", false);
+
+  // Other: a monitored key's own key-down does not trigger
+  logic.setTrigger(FixTrigger::OtherKeyDown);
+  assert(!logic.shouldFix(keyDown(0x2A), physical, clock.now()) &&
+         "Shift key-down is not another key");
+  assert(logic.shouldFix(keyDown(0x1E), physical, clock.now()) &&
+         "Letter key-down triggers");
+
+  logic.setKeyThreshold(lctrl, 0);
+  assert(logic.getKeyThreshold(lctrl) == 1000 && "Override removed");
+  logic.setKeyThreshold(lctrl, 5000);
+  logic.initialize(physical, virtualStates);
+  assert(logic.getKeyThreshold(lctrl) == 1000 &&
+         "initialize() clears overrides");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+// One mismatch of ms that the OS resolves on its own
+void benignMismatch(FixLogic &logic, ModifierKeyStates &physical,
+                    VirtualKeyStates &virtualStates, ManualClock &clock,
+                    const std::string &id, int ms) {
+  setPressed(virtualStates, id, true);
+  logic.updateTrackers(physical, virtualStates, clock.now());
+  clock.advanceMs(ms);
+  setPressed(virtualStates, id, false);
+  logic.updateTrackers(physical, virtualStates, clock.now());
+  clock.advanceMs(100);
+}
+
+void testAdaptiveThresholds() {
+  std::cout << "Test 5: Adaptive per-key thresholds... ";
+
+  ModifierKeyStates physical;
+  VirtualKeyStates virtualStates;
+  FixLogic logic;
+  logic.setThreshold(1000);
+  logic.initialize(physical, virtualStates);
+  size_t lctrl = 0;
+  size_t ralt = 0;
+  while (logic.getKeyId(ralt) != "ralt") {
+    ++ralt;
+  }
+  assert(logic.setKeyThreshold("ralt", 3000) && "Set by ID");
+  assert(!logic.setKeyThreshold("nokey", 3000) && "Unknown ID");
+
+  AdaptiveThresholdConfig adaptive;
+  adaptive.enabled = true;
+  adaptive.quantile = 0.9;
+  adaptive.marginMs = 200;
+  adaptive.minMs = 300;
+  adaptive.maxMs = 2500;
+  adaptive.minSamples = 20;
+  logic.setAdaptive(adaptive);
+
+  // Ctrl only lags a few ms; AltGr is held by automation for up to 1.6 s
+  ManualClock clock;
+  for (int i = 0; i < 19; ++i) {
+    benignMismatch(logic, physical, virtualStates, clock, "lctrl", 5 + i % 5);
+    benignMismatch(logic, physical, virtualStates, clock, "ralt",
+                   800 + 40 * (i % 20));
+  }
+  assert(logic.getLearnedThreshold(lctrl) == 0 &&
+         logic.getKeyThreshold(lctrl) == 1000 &&
+         logic.getKeyThreshold(ralt) == 3000 && "Not enough samples yet");
+  benignMismatch(logic, physical, virtualStates, clock, "lctrl", 9);
+  benignMismatch(logic, physical, virtualStates, clock, "ralt", 1560);
+  assert(logic.getBenignMismatchCount(lctrl) == 20 && "Samples counted");
+  assert(logic.getKeyThreshold(lctrl) == 300 && "Clamped to the minimum");
+  int learned = logic.getKeyThreshold(ralt);
+  assert(learned >= 1600 && learned <= 1800 &&
+         "Quantile plus margin replaces the configured threshold");
+
+  // A fixed mismatch is learned once, censored at the threshold; a
+  // re-pressed key is not learned
+  setPressed(virtualStates, "lctrl", true);
+  logic.updateTrackers(physical, virtualStates, clock.now());
+  clock.advanceMs(400);
+  assert(logic.isStuck(lctrl, clock.now()) && "Stuck after learned 300 ms");
+  logic.recordFix(lctrl, clock.now());
+  setPressed(virtualStates, "lctrl", false);
+  logic.updateTrackers(physical, virtualStates, clock.now());
+  benignMismatch(logic, physical, virtualStates, clock, "lctrl", 0);
+  setPressed(virtualStates, "lctrl", true);
+  logic.updateTrackers(physical, virtualStates, clock.now());
+  clock.advanceMs(200);
+  setPressed(physical, "lctrl", true);
+  logic.updateTrackers(physical, virtualStates, clock.now());
+  setPressed(physical, "lctrl", false);
+  setPressed(virtualStates, "lctrl", false);
+  logic.updateTrackers(physical, virtualStates, clock.now());
+  assert(logic.getBenignMismatchCount(lctrl) == 22 &&
+         "The fix and the mismatch without key press are learned");
+
+  // New bounds apply to the same estimate; a new quantile starts over
+  adaptive.maxMs = 1000;
+  logic.setAdaptive(adaptive);
+  assert(logic.getKeyThreshold(ralt) == 1000 && "Re-clamped");
+  adaptive.quantile = 0.5;
+  logic.setAdaptive(adaptive);
+  assert(logic.getLearnedThreshold(ralt) == 0 &&
+         logic.getBenignMismatchCount(ralt) == 0 &&
+         logic.getKeyThreshold(ralt) == 3000 && "Relearning");
+  adaptive.enabled = false;
+  logic.setAdaptive(adaptive);
+  assert(logic.getLearnedThreshold(ralt) == 0 && "Disabled");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testIdleFixAndDeadlines() {
+  std::cout << "Test 6: Timer fix decisions and deadlines... ";
+
+  ModifierKeyStates physical;
+  VirtualKeyStates virtualStates;
+  FixLogic logic;
+  logic.setThreshold(1000);
+  logic.initialize(physical, virtualStates);
+  size_t lctrl = 0;
+  logic.setKeyThreshold(lctrl, 500);
+
+  ManualClock clock;
+  Clock::TimePoint start = clock.now();
+  Clock::TimePoint when;
+  assert(!logic.nextStuckTime(clock.now(), when) && "Nothing pending");
+  setPressed(virtualStates, "lctrl", true);
+  setPressed(virtualStates, "lshift", true);
+  logic.updateTrackers(physical, virtualStates, clock.now());
+  assert(logic.nextStuckTime(clock.now(), when) &&
+         when == start + std::chrono::milliseconds(500) &&
+         "Earliest deadline is Ctrl's own threshold");
+  assert(!logic.shouldFixIdle(physical, clock.now()) && "Not stuck yet");
+
+  clock.advanceMs(500);
+  assert(logic.shouldFixIdle(physical, clock.now()) && "Ctrl stuck");
+  assert(logic.nextStuckTime(clock.now(), when) &&
+         when == start + std::chrono::milliseconds(1000) &&
+         "Stuck keys have no deadline; Shift's is next");
+  setPressed(physical, "rshift", true);
+  assert(!logic.shouldFixIdle(physical, clock.now()) &&
+         "A held monitored key blocks the timer too");
+  setPressed(physical, "rshift", false);
+
+  // A fixed key gets a new period until its release lands
+  logic.recordFix(lctrl, clock.now());
+  logic.restartMismatch(lctrl, clock.now());
+  assert(!logic.isStuck(lctrl, clock.now()) &&
+         logic.getMismatchMs(lctrl, clock.now()) == 0 &&
+         "Not released again at once");
+  clock.advanceMs(500);
+  assert(logic.isStuck(lctrl, clock.now()) && "Stuck again if never landed");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testReleaseChecks() {
+  std::cout << "Test 7: Release check deadlines... ";
+
+  ModifierKeyStates physical;
+  VirtualKeyStates virtualStates;
+  FixLogic logic;
+  logic.initialize(physical, virtualStates);
+  logic.setReleaseCheck(50);
+  size_t lctrl = 0;
+
+  ManualClock clock;
+  Clock::TimePoint start = clock.now();
+  Clock::TimePoint when;
+  setPressed(physical, "lctrl", true);
+  setPressed(virtualStates, "lctrl", true);
+  setPressed(physical, "lshift", true);
+  setPressed(virtualStates, "lshift", true);
+  logic.updateTrackers(physical, virtualStates, clock.now());
+  assert(!logic.nextReleaseCheck(when) && "Nothing armed while held");
+
+  // Ctrl's key-up does not reach the OS; Shift's does at once
+  setPressed(physical, "lctrl", false);
+  setPressed(physical, "lshift", false);
+  setPressed(virtualStates, "lshift", false);
+  logic.updateTrackers(physical, virtualStates, clock.now());
+  assert(logic.nextReleaseCheck(when) &&
+         when == start + std::chrono::milliseconds(50) && "Ctrl armed");
+  clock.advanceMs(49);
+  assert(!logic.releaseCheckDue(clock.now()) && "Window still open");
+  clock.advanceMs(1);
+  assert(logic.releaseCheckDue(clock.now()) && "Window closed");
+  assert(logic.collectDroppedReleases(clock.now()) == 1 &&
+         logic.isDroppedRelease(lctrl) && "Ctrl's key-up was dropped");
+  assert(!logic.nextReleaseCheck(when) && "Collected checks are disarmed");
+
+  // The OS following within the window disarms the check
+  setPressed(physical, "lctrl", true);
+  logic.updateTrackers(physical, virtualStates, clock.now());
+  setPressed(physical, "lctrl", false);
+  logic.updateTrackers(physical, virtualStates, clock.now());
+  clock.advanceMs(20);
+  setPressed(virtualStates, "lctrl", false);
+  logic.updateTrackers(physical, virtualStates, clock.now());
+  assert(!logic.nextReleaseCheck(when) && "Followed in time");
+  assert(logic.collectDroppedReleases(clock.now() +
+                                      std::chrono::milliseconds(100)) == 0 &&
+         !logic.isDroppedRelease(lctrl) && "Nothing dropped");
+
+  // A key the OS holds without a physical release is left to the threshold
+  setPressed(virtualStates, "lalt", true);
+  logic.updateTrackers(physical, virtualStates, clock.now());
+  assert(logic.hasAnyMismatch() && !logic.nextReleaseCheck(when) &&
+         "Only forwarded key-ups are checked");
+
+  logic.setReleaseCheck(0);
+  setPressed(physical, "lctrl", true);
+  setPressed(virtualStates, "lctrl", true);
+  logic.updateTrackers(physical, virtualStates, clock.now());
+  setPressed(physical, "lctrl", false);
+  logic.updateTrackers(physical, virtualStates, clock.now());
+  assert(!logic.nextReleaseCheck(when) && "Disabled");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testLostKeyDowns() {
+  std::cout << "Test 8: Lost key-down tracking... ";
+
+  ModifierKeyStates physical;
+  VirtualKeyStates virtualStates;
+  FixLogic logic;
+  logic.initialize(physical, virtualStates);
+  logic.setLostKeyDownThreshold(100);
+  const FixStatistics &stats = logic.getStatistics();
+  size_t lctrl = 0;
+
+  ManualClock clock;
+  setPressed(physical, "lctrl", true);
+  logic.updateTrackers(physical, virtualStates, clock.now());
+  assert(logic.isMissing(lctrl) && logic.hasAnyMissing() &&
+         !logic.hasAnyMismatch() && "Held but not registered");
+
+  // The OS catching up before the threshold is lag, not a loss
+  clock.advanceMs(30);
+  setPressed(virtualStates, "lctrl", true);
+  logic.updateTrackers(physical, virtualStates, clock.now());
+  assert(!logic.isMissing(lctrl) && !logic.hasLostKeyDowns() &&
+         stats.getKeyDownLag().getCount() == 1 &&
+         stats.getKeyDownLag().getMax() >= 30000000 && "Key-down lag");
+
+  // Released physically first: release lag for the stuck direction
+  setPressed(physical, "lctrl", false);
+  logic.updateTrackers(physical, virtualStates, clock.now());
+  clock.advanceMs(10);
+  setPressed(virtualStates, "lctrl", false);
+  logic.updateTrackers(physical, virtualStates, clock.now());
+  assert(stats.getReleaseLag().getCount() == 1 && "Release lag");
+
+  // Never registered: reported once after the threshold
+  setPressed(physical, "lctrl", true);
+  logic.updateTrackers(physical, virtualStates, clock.now());
+  clock.advanceMs(99);
+  logic.updateTrackers(physical, virtualStates, clock.now());
+  assert(!logic.hasLostKeyDowns() && "Below the threshold");
+  clock.advanceMs(1);
+  logic.updateTrackers(physical, virtualStates, clock.now());
+  assert(logic.hasLostKeyDowns() &&
+         logic.getMissingMs(lctrl, clock.now()) == 100 && "Lost key-down");
+  assert(logic.takeLostKeyDown(lctrl) && !logic.hasLostKeyDowns() &&
+         !logic.takeLostKeyDown(lctrl) && "Taken once");
+  logic.recordKeyDownRepair(lctrl);
+  clock.advanceMs(200);
+  logic.updateTrackers(physical, virtualStates, clock.now());
+  assert(!logic.hasLostKeyDowns() && logic.isMissing(lctrl) &&
+         stats.getTotalLostKeyDowns() == 1 &&
+         stats.getLostKeyDownCount("lctrl") == 1 &&
+         stats.getKeyDownRepairCount("lctrl") == 1 && "Counted once");
+
+  // Letting go ends it without a lag sample; a pending report is dropped
+  setPressed(physical, "lctrl", false);
+  logic.updateTrackers(physical, virtualStates, clock.now());
+  assert(!logic.isMissing(lctrl) && !logic.hasAnyMissing() &&
+         stats.getKeyDownLag().getCount() == 1 && "Let go");
+  setPressed(physical, "lctrl", true);
+  logic.updateTrackers(physical, virtualStates, clock.now());
+  clock.advanceMs(100);
+  logic.updateTrackers(physical, virtualStates, clock.now());
+  setPressed(physical, "lctrl", false);
+  logic.updateTrackers(physical, virtualStates, clock.now());
+  assert(!logic.hasLostKeyDowns() && stats.getTotalLostKeyDowns() == 2 &&
+         "Pending report dropped");
+
+  // The stuck direction takes over from a missing key-down at once
+  setPressed(physical, "lctrl", true);
+  logic.updateTrackers(physical, virtualStates, clock.now());
+  setPressed(physical, "lctrl", false);
+  setPressed(virtualStates, "lctrl", true);
+  logic.updateTrackers(physical, virtualStates, clock.now());
+  assert(!logic.isMissing(lctrl) && logic.hasAnyMismatch() &&
+         "Direction switched");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+int main() {
+  std::cout << "=== Fix Logic Unit Tests ===" << std::endl;
+  std::cout << std::endl;
+
+  try {
+    testManualAndCachedClock();
+    testTrackerUsesInjectedClock();
+    testFixLogicDecisions();
+    testTriggersAndKeyThresholds();
+    testAdaptiveThresholds();
+    testIdleFixAndDeadlines();
+    testReleaseChecks();
+    testLostKeyDowns();
+
+    std::cout << std::endl;
+    std::cout << "All fix logic tests PASSED!" << std::endl;
+    return 0;
+  } catch (const std::exception &e) {
+    std::cerr << std::endl;
+    std::cerr << "Test FAILED with exception: " << e.what() << std::endl;
+    return 1;
+  }
+}
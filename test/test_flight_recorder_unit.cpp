@@ -0,0 +1,156 @@
+#include "flight_recorder.h"
+#include "trace_format.h"
+#include <cassert>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Tests of the in-memory flight recorder and its dump files
+
+namespace fs = std::filesystem;
+
+std::vector<TraceFormat::KeyInfo> testKeys() {
+  return {{"lctrl", 0x1D, false, 0xA2}, {"rctrl", 0x1D, true, 0xA3}};
+}
+
+fs::path freshDirectory(const char *name) {
+  fs::path dir = fs::temp_directory_path() / name;
+  fs::remove_all(dir);
+  return dir;
+}
+
+size_t countDumps(const fs::path &dir) {
+  size_t count = 0;
+  for (const auto &entry : fs::directory_iterator(dir)) {
+    if (entry.path().extension() == TraceFormat::kFileExtension) {
+      count++;
+    }
+  }
+  return count;
+}
+
+void testInactive() {
+  std::cout << "Test 1: No dump before start()... ";
+
+  FlightRecorder recorder;
+  assert(!recorder.isActive() && "Not started");
+  assert(!recorder.dump("fix") && "Nothing to dump");
+  assert(recorder.getDumpCount() == 0 && "No dump written");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testRingKeepsNewest() {
+  std::cout << "Test 2: Dump holds the newest records, oldest first... ";
+
+  fs::path dir = freshDirectory("escModKey_flight_ring");
+  FlightRecorder recorder;
+  FlightRecorder::Options options;
+  options.directory = dir.string();
+  options.capacity = 6; // Rounded up to 8
+  recorder.start(options, testKeys(), 1000);
+
+  recorder.recordVirtualState(0x1, 0x1);
+  recorder.recordVirtualState(0x1, 0x0); // Unchanged mask: not recorded
+  for (uint16_t i = 0; i < 20; ++i) {
+    recorder.recordStroke(1, 0x1D, i % 2, i);
+  }
+  recorder.recordTracker(0, TraceFormat::kTrackerStuck, 1200);
+  recorder.recordFix(1, 0, 0x1D, 1, 1200);
+  assert(recorder.dump("fix") && "Dump taken");
+  recorder.waitIdle();
+
+  std::string path = recorder.getLastDumpPath();
+  assert(recorder.getDumpCount() == 1 && "One dump written");
+  assert(fs::path(path).parent_path() == dir && "Written to the directory");
+  assert(path.find("-fix.emkt") != std::string::npos && "Reason in name");
+
+  TraceFormat::TraceFile trace;
+  std::string error;
+  assert(TraceFormat::readTraceFile(path, trace, &error) && "Readable dump");
+  assert(trace.header.thresholdMs == 1000 && "Threshold in header");
+  assert(trace.header.keyCount == 2 && "Key table in header");
+  assert(trace.records.size() == 8 && "Only the ring's capacity kept");
+  for (size_t i = 0; i < 6; ++i) {
+    assert(trace.records[i].type == TraceFormat::kRecordStroke &&
+           trace.records[i].information == 14 + i && "Newest strokes in order");
+  }
+  assert(trace.records[6].type == TraceFormat::kRecordTracker &&
+         trace.records[6].state == TraceFormat::kTrackerStuck && "Tracker");
+  assert(trace.records[7].type == TraceFormat::kRecordFix &&
+         trace.records[7].value == 1200 && "Fix last");
+  for (size_t i = 1; i < trace.records.size(); ++i) {
+    assert(trace.records[i].timestampNs >= trace.records[i - 1].timestampNs &&
+           "Times since start, in order");
+  }
+
+  recorder.stop();
+  fs::remove_all(dir);
+  std::cout << "PASSED" << std::endl;
+}
+
+void testBusyAndPrune() {
+  std::cout << "Test 3: Busy dumps are skipped, old dumps deleted... ";
+
+  fs::path dir = freshDirectory("escModKey_flight_prune");
+  FlightRecorder recorder;
+  FlightRecorder::Options options;
+  options.directory = dir.string();
+  options.capacity = 64;
+  options.maxDumps = 2;
+  recorder.start(options, testKeys(), 1000);
+  recorder.recordStroke(1, 0x1D, 0, 0);
+
+  // The second dump either finds the first one written or is skipped
+  recorder.dump("fix");
+  recorder.dump("fix");
+  recorder.waitIdle();
+  assert(recorder.getDumpCount() + recorder.getSkippedCount() == 2 &&
+         "Every dump written or counted");
+
+  for (int i = 0; i < 3; ++i) {
+    assert(recorder.dump("manual") && "Idle recorder takes the dump");
+    recorder.waitIdle();
+  }
+  assert(countDumps(dir) == 2 && "Only maxDumps kept");
+  assert(fs::exists(recorder.getLastDumpPath()) && "Newest dump kept");
+
+  recorder.stop();
+  fs::remove_all(dir);
+  std::cout << "PASSED" << std::endl;
+}
+
+void testDumpRequest() {
+  std::cout << "Test 4: Dump requests from another thread... ";
+
+  FlightRecorder recorder;
+  assert(!recorder.takeDumpRequest() && "Nothing requested");
+  std::thread tray([&recorder] { recorder.requestDump(); });
+  tray.join();
+  assert(recorder.takeDumpRequest() && "Request seen");
+  assert(!recorder.takeDumpRequest() && "Request consumed");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+int main() {
+  std::cout << "=== Flight Recorder Tests ===" << std::endl;
+  std::cout << std::endl;
+
+  try {
+    testInactive();
+    testRingKeepsNewest();
+    testBusyAndPrune();
+    testDumpRequest();
+
+    std::cout << std::endl;
+    std::cout << "All flight recorder tests PASSED!" << std::endl;
+    return 0;
+  } catch (const std::exception &e) {
+    std::cerr << std::endl;
+    std::cerr << "Test FAILED with exception: " << e.what() << std::endl;
+    return 1;
+  }
+}
@@ -22,7 +22,7 @@ void testCompleteConfigLoadAndApply() {
   std::string configContent =
       "[general]\nthresholdMs = 1500\nshowMessages = false\n\n";
   configContent +=
-      "[keyMonitoring]\nmonitorCtrl = true\nmonitorShift = false\n";
+      "[keys]\nmonitorCtrl = true\nmonitorShift = false\n";
   configContent += "monitorAlt = false\nmonitorWin = false\n\n";
   configContent +=
       "[[keyMappings]]\nsourceScanCode = 0x3A\nsourceNeedsE0 = false\n";
@@ -47,7 +47,7 @@ void testRestartReloadsMappings() {
 
   std::string configContent1 = "[general]\nthresholdMs = 1000\n\n";
   configContent1 +=
-      "[keyMonitoring]\nmonitorCtrl = true\nmonitorShift = false\n";
+      "[keys]\nmonitorCtrl = true\nmonitorShift = false\n";
   configContent1 += "monitorAlt = false\nmonitorWin = false\n\n";
   configContent1 +=
       "[[keyMappings]]\nsourceScanCode = 0x3A\nsourceNeedsE0 = false\n";
@@ -62,7 +62,7 @@ void testRestartReloadsMappings() {
 
   std::string configContent2 = "[general]\nthresholdMs = 1000\n\n";
   configContent2 +=
-      "[keyMonitoring]\nmonitorCtrl = true\nmonitorShift = false\n";
+      "[keys]\nmonitorCtrl = true\nmonitorShift = false\n";
   configContent2 += "monitorAlt = false\nmonitorWin = false\n\n";
   configContent2 +=
       "[[keyMappings]]\nsourceScanCode = 0x3A\nsourceNeedsE0 = false\n";
@@ -87,7 +87,7 @@ void testErrorConfigHandling() {
 
   std::string configContent = "[general]\nthresholdMs = 1000\n\n";
   configContent +=
-      "[keyMonitoring]\nmonitorCtrl = true\nmonitorShift = false\n";
+      "[keys]\nmonitorCtrl = true\nmonitorShift = false\n";
   configContent += "monitorAlt = false\nmonitorWin = false\n\n";
   configContent +=
       "[[keyMappings]]\nsourceScanCode = 0x3A\nsourceNeedsE0 = false\n";
@@ -114,7 +114,7 @@ void testConfigWithNoMappings() {
   std::cout << "Test 4: Config with no mappings... ";
 
   std::string configContent = "[general]\nthresholdMs = 1000\n\n";
-  configContent += "[keyMonitoring]\nmonitorCtrl = true\nmonitorShift = true\n";
+  configContent += "[keys]\nmonitorCtrl = true\nmonitorShift = true\n";
   configContent += "monitorAlt = true\nmonitorWin = true\n";
 
   createTempConfigFile("test_no_mappings.toml", configContent);
@@ -132,7 +132,7 @@ void testMultipleMappingsToDifferentTargets() {
   std::cout << "Test 5: Multiple mappings to different targets... ";
 
   std::string configContent = "[general]\nthresholdMs = 1000\n\n";
-  configContent += "[keyMonitoring]\nmonitorCtrl = true\nmonitorShift = true\n";
+  configContent += "[keys]\nmonitorCtrl = true\nmonitorShift = true\n";
   configContent += "monitorAlt = true\nmonitorWin = true\n\n";
   configContent +=
       "[[keyMappings]]\nsourceScanCode = 0x3A\nsourceNeedsE0 = false\n";
@@ -169,7 +169,7 @@ void testConfigReloadPreservesSettings() {
       "[general]\nthresholdMs = 2000\nshowMessages = true\n\n";
   configContent += "[notifications]\nenabled = true\nnotifyOnFix = "
                    "true\nnotifyOnStartup = false\n\n";
-  configContent += "[keyMonitoring]\nmonitorCtrl = true\nmonitorShift = true\n";
+  configContent += "[keys]\nmonitorCtrl = true\nmonitorShift = true\n";
   configContent += "monitorAlt = false\nmonitorWin = false\n\n";
   configContent +=
       "[[keyMappings]]\nsourceScanCode = 0x3A\nsourceNeedsE0 = false\n";
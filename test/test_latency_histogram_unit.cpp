@@ -0,0 +1,221 @@
+#include "cycle_clock.h"
+#include "latency_histogram.h"
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+void testEmptyHistogram() {
+  std::cout << "Test 1: Empty histogram... ";
+
+  LatencyHistogram histogram;
+  auto summary = histogram.summarize();
+  assert(summary.count == 0 && "Empty histogram should have no samples");
+  assert(summary.p99Ns == 0 && "Empty histogram percentile should be 0");
+  assert(formatLatencySummary(summary) == "no samples" &&
+         "Empty summary text mismatch");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testSmallValuesAreExact() {
+  std::cout << "Test 2: Small values are exact... ";
+
+  for (uint64_t v = 0; v < LatencyHistogram::kSubBucketCount; ++v) {
+    size_t index = LatencyHistogram::bucketIndex(v);
+    assert(index == v && "Values below sub-bucket count map to themselves");
+    assert(LatencyHistogram::bucketUpperBound(index) == v &&
+           "Upper bound of exact bucket should be the value");
+  }
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testBucketBoundsContainValue() {
+  std::cout << "Test 3: Bucket bounds contain value within 3%... ";
+
+  uint64_t values[] = {64,      65,         100,         1000,
+                       12345,   999999,     1000000,     123456789,
+                       1ull << 30, (1ull << 40) - 1};
+  for (uint64_t v : values) {
+    size_t index = LatencyHistogram::bucketIndex(v);
+    assert(index < LatencyHistogram::kBucketCount && "Index out of range");
+    uint64_t upper = LatencyHistogram::bucketUpperBound(index);
+    assert(upper >= v && "Upper bound below value");
+    assert(upper - v <= v / 32 && "Bucket wider than precision target");
+    if (index > 0) {
+      assert(LatencyHistogram::bucketUpperBound(index - 1) < v &&
+             "Previous bucket should end below value");
+    }
+  }
+
+  // Indices are monotonic across a wide range
+  size_t previous = 0;
+  for (uint64_t v = 1; v < (1ull << 40); v = v * 3 / 2 + 1) {
+    size_t index = LatencyHistogram::bucketIndex(v);
+    assert(index >= previous && "Bucket index not monotonic");
+    previous = index;
+  }
+
+  // Huge values are clamped into the last bucket
+  assert(LatencyHistogram::bucketIndex(UINT64_MAX) ==
+             LatencyHistogram::kBucketCount - 1 &&
+         "Overflow should clamp to last bucket");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testPercentiles() {
+  std::cout << "Test 4: Percentiles of uniform samples... ";
+
+  LatencyHistogram histogram;
+  for (uint64_t v = 1; v <= 10000; ++v) {
+    histogram.record(v * 100); // 100ns .. 1ms
+  }
+
+  auto summary = histogram.summarize();
+  assert(summary.count == 10000 && "Count mismatch");
+  assert(summary.maxNs == 1000000 && "Max mismatch");
+  assert(summary.meanNs == 500050 && "Mean mismatch");
+
+  // Within bucket precision of the exact answers
+  assert(summary.p50Ns >= 500000 && summary.p50Ns <= 500000 * 33 / 32 &&
+         "p50 out of range");
+  assert(summary.p99Ns >= 990000 && summary.p99Ns <= 1000000 &&
+         "p99 out of range");
+  assert(summary.p999Ns >= 999000 && summary.p999Ns <= 1000000 &&
+         "p99.9 out of range");
+
+  histogram.reset();
+  assert(histogram.getCount() == 0 && "Reset should clear count");
+  assert(histogram.getMax() == 0 && "Reset should clear max");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testConcurrentReader() {
+  std::cout << "Test 5: Concurrent reader sees consistent counts... ";
+
+  auto histogram = std::make_unique<LatencyHistogram>();
+  const uint64_t samples = 200000;
+
+  std::thread writer([&histogram, samples]() {
+    for (uint64_t i = 0; i < samples; ++i) {
+      histogram->record(i % 5000);
+    }
+  });
+
+  // Reader may observe any prefix, but never more than was written
+  uint64_t lastCount = 0;
+  while (lastCount < samples) {
+    auto summary = histogram->summarize();
+    assert(summary.count >= lastCount && "Count went backwards");
+    assert(summary.maxNs < 5000 && "Max out of range");
+    lastCount = summary.count;
+  }
+  writer.join();
+
+  assert(histogram->getCount() == samples && "Final count mismatch");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testMerge() {
+  std::cout << "Test 6: Merged histogram equals one fed all samples... ";
+
+  LatencyHistogram low;
+  LatencyHistogram high;
+  LatencyHistogram all;
+  for (uint64_t v = 1; v <= 10000; ++v) {
+    (v % 3 ? low : high).record(v * 100);
+    all.record(v * 100);
+  }
+  low.merge(high);
+
+  auto merged = low.summarize();
+  auto expected = all.summarize();
+  assert(merged.count == expected.count && "Count mismatch");
+  assert(merged.maxNs == expected.maxNs && "Max mismatch");
+  assert(merged.meanNs == expected.meanNs && "Mean mismatch");
+  assert(merged.p50Ns == expected.p50Ns && merged.p99Ns == expected.p99Ns &&
+         "Percentiles mismatch");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testCycleTickUnits() {
+  std::cout << "Test 7: Tick histogram reads back nanoseconds... ";
+
+  CycleClock::calibrate();
+  LatencyHistogram ticks(LatencyHistogram::Unit::CycleTicks);
+  LatencyHistogram ns;
+  for (uint64_t v = 1; v <= 10000; ++v) {
+    ticks.record(v * 100);
+    ns.record(CycleClock::toNanoseconds(v * 100));
+  }
+
+  // Bucketed in ticks, so compare within the ~3% bucket resolution
+  auto fromTicks = ticks.summarize();
+  auto expected = ns.summarize();
+  auto near = [](uint64_t a, uint64_t b) {
+    uint64_t diff = a > b ? a - b : b - a;
+    return diff * 100 <= b * 4 + 100;
+  };
+  assert(fromTicks.count == expected.count && "Count mismatch");
+  assert(fromTicks.maxNs == CycleClock::toNanoseconds(1000000) &&
+         "Max converted exactly");
+  assert(near(fromTicks.meanNs, expected.meanNs) && "Mean mismatch");
+  assert(near(fromTicks.p50Ns, expected.p50Ns) &&
+         near(fromTicks.p99Ns, expected.p99Ns) && "Percentiles mismatch");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testRecordOverhead() {
+  std::cout << "Test 8: Timestamp + record overhead... ";
+
+  CycleClock::calibrate();
+  LatencyHistogram histogram(LatencyHistogram::Unit::CycleTicks);
+  const int iterations = 1000000;
+
+  // As on the input path: two tick reads and a record, no conversion
+  uint64_t start = CycleClock::now();
+  for (int i = 0; i < iterations; ++i) {
+    uint64_t t0 = CycleClock::now();
+    histogram.record(CycleClock::now() - t0);
+  }
+  uint64_t perStrokeNs =
+      CycleClock::toNanoseconds(CycleClock::now() - start) / iterations;
+
+  assert(histogram.getCount() == static_cast<uint64_t>(iterations) &&
+         "Count mismatch");
+  // Generous (unoptimised builds, virtual machines) but catches a lock, a
+  // syscall or an allocation creeping into the path
+  assert(perStrokeNs < 300 && "Timestamp + record too slow");
+  std::cout << "PASSED (" << perStrokeNs << "ns per stroke)" << std::endl;
+}
+
+int main() {
+  std::cout << "=== Latency Histogram Unit Tests ===" << std::endl;
+  std::cout << std::endl;
+
+  try {
+    testEmptyHistogram();
+    testSmallValuesAreExact();
+    testBucketBoundsContainValue();
+    testPercentiles();
+    testConcurrentReader();
+    testMerge();
+    testCycleTickUnits();
+    testRecordOverhead();
+
+    std::cout << std::endl;
+    std::cout << "All latency histogram tests PASSED!" << std::endl;
+    return 0;
+  } catch (const std::exception &e) {
+    std::cerr << std::endl;
+    std::cerr << "Test FAILED with exception: " << e.what() << std::endl;
+    return 1;
+  }
+}
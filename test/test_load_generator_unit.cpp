@@ -0,0 +1,209 @@
+#include "fake_interception.h"
+#include "fake_win32.h"
+#include "load_generator.h"
+#include "modifier_key_fixer.h"
+#include <cassert>
+#include <iostream>
+#include <map>
+#include <utility>
+#include <vector>
+
+// Tests of the synthetic load generator (headless builds only)
+
+void testScheduleShape() {
+  std::cout << "Test 1: Schedule count, numbering and burst timing... ";
+
+  LoadOptions options;
+  options.profile = LoadProfile::Scanner;
+  options.devices = 3;
+  options.strokeCount = 1000;
+  options.rate = 2800; // One 28-stroke barcode every 10ms per device
+  std::vector<LoadStroke> schedule = generateLoad(options);
+
+  assert(schedule.size() == 1000 && "Exact stroke count");
+  std::map<InterceptionDevice, int> perDevice;
+  for (size_t i = 0; i < schedule.size(); ++i) {
+    assert(schedule[i].stroke.information == i + 1 &&
+           "Sequence numbers follow schedule order");
+    assert((i == 0 || schedule[i - 1].timeNs <= schedule[i].timeNs) &&
+           "Schedule is sorted by time");
+    perDevice[schedule[i].device]++;
+  }
+  assert(perDevice.size() == 3 && "Three keyboards");
+  assert(perDevice[INTERCEPTION_KEYBOARD(0)] == 334 &&
+         perDevice[INTERCEPTION_KEYBOARD(2)] == 333 &&
+         "Strokes split evenly across devices");
+
+  // Device 1: strokes 0..27 at t=0, the next barcode 10ms later
+  std::vector<uint64_t> firstDevice;
+  for (const LoadStroke &s : schedule) {
+    if (s.device == INTERCEPTION_KEYBOARD(0)) {
+      firstDevice.push_back(s.timeNs);
+    }
+  }
+  assert(firstDevice[0] == 0 && firstDevice[27] == 0 &&
+         "A burst is emitted back to back");
+  assert(firstDevice[28] == 10000000 && "Bursts keep the average rate");
+
+  options.rate = 0;
+  for (const LoadStroke &s : generateLoad(options)) {
+    assert(s.timeNs == 0 && "Rate 0 schedules everything at once");
+  }
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testProfilesAreBalanced() {
+  std::cout << "Test 2: Every profile releases what it presses... ";
+
+  const LoadProfile profiles[] = {LoadProfile::Typing, LoadProfile::Modifiers,
+                                  LoadProfile::Typematic,
+                                  LoadProfile::Scanner};
+  for (LoadProfile profile : profiles) {
+    LoadOptions options;
+    options.profile = profile;
+    options.devices = 2;
+    options.strokeCount = 20000;
+    options.seed = 42;
+    std::vector<LoadStroke> schedule = generateLoad(options);
+
+    LoadProfile parsed;
+    assert(parseLoadProfile(loadProfileName(profile), parsed) &&
+           parsed == profile && "Profile names round-trip");
+
+    // Per device and key: no release without a press, and at most the
+    // keys of the unit cut at the end remain held
+    std::map<std::pair<InterceptionDevice, int>, bool> held;
+    int modifierStrokes = 0;
+    for (const LoadStroke &s : schedule) {
+      int key = s.stroke.code | ((s.stroke.state & INTERCEPTION_KEY_E0) << 8);
+      bool down = !(s.stroke.state & INTERCEPTION_KEY_UP);
+      auto id = std::make_pair(s.device, key);
+      if (!down) {
+        assert(held[id] && "Release follows a press on the same device");
+      }
+      held[id] = down;
+      if (s.stroke.code == 0x1D || s.stroke.code == 0x2A ||
+          s.stroke.code == 0x36 || s.stroke.code == 0x38 ||
+          s.stroke.code == 0x5B || s.stroke.code == 0x5C) {
+        modifierStrokes++;
+      }
+    }
+    int stillHeld = 0;
+    for (const auto &entry : held) {
+      stillHeld += entry.second ? 1 : 0;
+    }
+    assert(stillHeld <= 8 && "Only the truncated final units hold keys");
+
+    if (profile == LoadProfile::Modifiers) {
+      assert(modifierStrokes > static_cast<int>(schedule.size()) / 2 &&
+             "Modifier-heavy mix is mostly modifiers");
+    }
+    if (profile == LoadProfile::Scanner) {
+      assert(modifierStrokes == 0 && "Scanners send no modifiers");
+    }
+  }
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testMonitorDetectsAnomalies() {
+  std::cout << "Test 3: Monitor detects lost, duplicated and reordered... ";
+
+  LoadOptions options;
+  options.strokeCount = 6;
+  std::vector<LoadStroke> schedule = generateLoad(options);
+  LoadMonitor monitor(schedule);
+  for (uint32_t seq = 1; seq <= 6; ++seq) {
+    monitor.pushed(seq, 100 * seq);
+  }
+
+  auto forward = [&](uint32_t seq, uint64_t nowNs) {
+    monitor.forwarded(schedule[seq - 1].device, schedule[seq - 1].stroke,
+                      nowNs);
+  };
+  forward(1, 1000);
+  forward(3, 1100);
+  forward(2, 1200); // After 3: reordered
+  forward(3, 1300); // Again: duplicated
+
+  InterceptionKeyStroke release = {0x1D, INTERCEPTION_KEY_UP, 0};
+  monitor.forwarded(schedule[0].device, release, 1400); // Injected by a fix
+
+  InterceptionKeyStroke altered = schedule[4].stroke;
+  altered.state ^= INTERCEPTION_KEY_UP;
+  monitor.forwarded(schedule[4].device, altered, 1500);
+  forward(6, 1600);
+  // Stroke 4 is never forwarded
+
+  assert(monitor.getPushed() == 6 && "All pushed");
+  assert(monitor.getForwarded() == 7 && "Every send counted");
+  assert(monitor.getInjected() == 1 && "Unnumbered stroke is injected");
+  assert(monitor.getDuplicated() == 1 && "One duplicate");
+  assert(monitor.getReordered() == 1 && "One reordered stroke");
+  assert(monitor.getCorrupted() == 1 && "One altered stroke");
+  assert(monitor.getDropped() == 1 && "One lost stroke");
+  assert(monitor.getLatency().getCount() == 5 &&
+         "Latency recorded once per delivered stroke");
+  assert(monitor.getLatency().getMax() == 1000 && "Latency is push to send");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testRunThroughFixer() {
+  std::cout << "Test 4: Stroke storm through processEvents... ";
+  FakeInterception::reset();
+  FakeWin32::reset();
+
+  ModifierKeyFixer fixer;
+  fixer.setShowMessages(false);
+  assert(fixer.initialize() && "Fake driver should create a context");
+
+  LoadOptions options;
+  options.profile = LoadProfile::Modifiers;
+  options.devices = 4;
+  options.strokeCount = 40000;
+  options.rate = 0;
+  std::vector<LoadStroke> schedule = generateLoad(options);
+
+  LoadReport report = runLoad(fixer, schedule, 10);
+  assert(report.pushed == schedule.size() && "Everything pushed");
+  assert(report.intact() && "Nothing lost, duplicated or reordered");
+  assert(report.forwarded == schedule.size() && report.injected == 0 &&
+         report.fixes == 0 && "Well-formed input triggers no fixes");
+  assert(report.latency.count == schedule.size() &&
+         "Every stroke has a latency sample");
+  assert(report.throughput > 0 && report.cpuNsPerStroke > 0 &&
+         "Throughput and CPU cost measured");
+
+  // Keyboards used by the schedule were added to the driver
+  InterceptionContext context = interception_create_context();
+  wchar_t id[64];
+  assert(interception_get_hardware_id(context, INTERCEPTION_KEYBOARD(3), id,
+                                      sizeof(id)) > 0 &&
+         "Fourth keyboard present");
+  interception_destroy_context(context);
+
+  std::cout << "PASSED (" << static_cast<uint64_t>(report.throughput)
+            << " strokes/s)" << std::endl;
+}
+
+int main() {
+  std::cout << "=== Load Generator Tests ===" << std::endl;
+  std::cout << std::endl;
+
+  try {
+    testScheduleShape();
+    testProfilesAreBalanced();
+    testMonitorDetectsAnomalies();
+    testRunThroughFixer();
+
+    std::cout << std::endl;
+    std::cout << "All load generator tests PASSED!" << std::endl;
+    return 0;
+  } catch (const std::exception &e) {
+    std::cerr << std::endl;
+    std::cerr << "Test FAILED with exception: " << e.what() << std::endl;
+    return 1;
+  }
+}
@@ -0,0 +1,194 @@
+#include "logger.h"
+#include <cassert>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Tests of the asynchronous levelled logger
+
+namespace fs = std::filesystem;
+
+std::vector<std::string> readLines(const fs::path &path) {
+  std::vector<std::string> lines;
+  std::ifstream file(path);
+  std::string line;
+  while (std::getline(file, line)) {
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+fs::path freshDirectory(const char *name) {
+  fs::path dir = fs::temp_directory_path() / name;
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+  return dir;
+}
+
+void testFormatting() {
+  std::cout << "Test 1: Placeholders are filled in order... ";
+
+  LogRecord record{};
+  record.format = "{s}: code 0x{x} after {}ms";
+  record.args[0] = 0x1D;
+  record.args[1] = 1500;
+  std::string text = "lctrl";
+  text.copy(record.text, text.size());
+  char buffer[64];
+  size_t length = Logger::formatMessage(record, buffer, sizeof(buffer));
+  assert(std::string(buffer, length) == "lctrl: code 0x1D after 1500ms" &&
+         "Text, hex and decimal");
+
+  length = Logger::formatMessage(record, buffer, 8);
+  assert(length == 7 && std::string(buffer) == "lctrl: " &&
+         "Truncated to the buffer");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testLevelsAndFile() {
+  std::cout << "Test 2: Records reach the file in order, filtered by level... ";
+
+  fs::path dir = freshDirectory("escModKey_logger_test");
+  Logger::Options options;
+  options.console = false;
+  options.filePath = (dir / "test.log").string();
+  options.level = LogLevel::Info;
+  assert(Logger::instance().start(options) && "Logger started");
+  assert(!Logger::instance().start(options) && "Already running");
+
+  Log::info("first {}", 1);
+  Log::debug("hidden");
+  std::thread other([] { Log::warning("from {s}", "another thread"); });
+  other.join();
+  Log::error("last {}", 3);
+  Logger::instance().stop();
+
+  std::vector<std::string> lines = readLines(dir / "test.log");
+  assert(lines.size() == 3 && "Debug record filtered out");
+  assert(lines[0].find(" INFO  first 1") != std::string::npos &&
+         "Level and message");
+  assert(lines[1].find(" WARN  from another thread") != std::string::npos &&
+         "Other thread interleaved by time");
+  assert(lines[2].find(" ERROR last 3") != std::string::npos && "Last");
+  assert(Logger::instance().getWrittenCount() == 3 && "Counted");
+
+  fs::remove_all(dir);
+  std::cout << "PASSED" << std::endl;
+}
+
+void testBacklog() {
+  std::cout << "Test 3: Records from before start() go to the file too... ";
+
+  fs::path dir = freshDirectory("escModKey_logger_backlog");
+  std::ostringstream captured;
+  std::streambuf *console = std::cerr.rdbuf(captured.rdbuf());
+  Log::warning("Invalid mapping type '{s}'", "swap");
+  std::cerr.rdbuf(console);
+  assert(captured.str() == "Warning: Invalid mapping type 'swap'\n" &&
+         "Written to the console straight away");
+
+  Logger::Options options;
+  options.console = false;
+  options.filePath = (dir / "test.log").string();
+  assert(Logger::instance().start(options) && "Logger started");
+  Logger::instance().stop();
+
+  std::vector<std::string> lines = readLines(dir / "test.log");
+  assert(!lines.empty() &&
+         lines[0].find("WARN  Invalid mapping type 'swap'") !=
+             std::string::npos &&
+         "Earlier warning at the top of the file");
+
+  fs::remove_all(dir);
+  std::cout << "PASSED" << std::endl;
+}
+
+void testRotation() {
+  std::cout << "Test 4: Log files rotate at the size limit... ";
+
+  fs::path dir = freshDirectory("escModKey_logger_rotate");
+  Logger::Options options;
+  options.console = false;
+  options.filePath = (dir / "test.log").string();
+  options.fileBytes = 4096;
+  options.maxFiles = 3;
+  options.level = LogLevel::Debug;
+  assert(Logger::instance().start(options) && "Logger started");
+  for (int i = 0; i < 1000; ++i) {
+    Log::debug("stroke device {} code 0x{x} state 0x{x}", 1, 0x1D, i % 2);
+    if (i % 100 == 99) {
+      // Stay well within one thread's ring
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+  }
+  Logger::instance().stop();
+
+  assert(fs::exists(dir / "test.log") && fs::exists(dir / "test.log.1") &&
+         fs::exists(dir / "test.log.2") && "Three files kept");
+  assert(!fs::exists(dir / "test.log.3") && "Oldest deleted");
+  for (const char *name : {"test.log", "test.log.1", "test.log.2"}) {
+    assert(fs::file_size(dir / name) <= options.fileBytes && "Size limit");
+  }
+  assert(Logger::instance().getDroppedCount() == 0 && "Nothing dropped");
+
+  fs::remove_all(dir);
+  std::cout << "PASSED" << std::endl;
+}
+
+void testRingFull() {
+  std::cout << "Test 5: A full ring drops and reports records... ";
+
+  fs::path dir = freshDirectory("escModKey_logger_full");
+  Logger::Options options;
+  options.console = false;
+  options.filePath = (dir / "test.log").string();
+  assert(Logger::instance().start(options) && "Logger started");
+  // Faster than a 10ms drain can keep up with
+  size_t count = 4 * Logger::kRingCapacity;
+  for (size_t i = 0; i < count; ++i) {
+    Log::info("record {}", i);
+  }
+  Logger::instance().stop();
+
+  uint64_t dropped = Logger::instance().getDroppedCount();
+  std::vector<std::string> lines = readLines(dir / "test.log");
+  size_t reports = 0;
+  for (const std::string &line : lines) {
+    if (line.find("dropped (ring full)") != std::string::npos) {
+      reports++;
+    }
+  }
+  assert(dropped > 0 && "Some records dropped");
+  assert(lines.size() == count - dropped + reports &&
+         "The rest written, plus the drop reports");
+  assert(reports > 0 && "Drops reported in the log");
+
+  fs::remove_all(dir);
+  std::cout << "PASSED" << std::endl;
+}
+
+int main() {
+  std::cout << "=== Logger Tests ===" << std::endl;
+  std::cout << std::endl;
+
+  try {
+    testFormatting();
+    testLevelsAndFile();
+    testBacklog();
+    testRotation();
+    testRingFull();
+
+    std::cout << std::endl;
+    std::cout << "All logger tests PASSED!" << std::endl;
+    return 0;
+  } catch (const std::exception &e) {
+    std::cerr << std::endl;
+    std::cerr << "Test FAILED with exception: " << e.what() << std::endl;
+    return 1;
+  }
+}
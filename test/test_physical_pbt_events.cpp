@@ -12,35 +12,33 @@
 
 #include "config.h"
 #include "physical_key_detector.h"
+#include "property_test.h"
 #include <Windows.h>
 #include <cassert>
 #include <iostream>
-#include <random>
+#include <sstream>
 #include <string>
 #include <vector>
 
-// Random generator
-std::random_device rd;
-std::mt19937 gen(rd());
-
 // Helper: Generate random scan code
-unsigned short randomScanCode() {
-  std::uniform_int_distribution<> dis(0x01, 0xFF);
-  return static_cast<unsigned short>(dis(gen));
-}
-
-// Helper: Generate random bool
-bool randomBool() {
-  std::uniform_int_distribution<> dis(0, 1);
-  return dis(gen) == 1;
+unsigned short randomScanCode(PropertySource &source) {
+  return static_cast<unsigned short>(source.range(0x01, 0xFF));
 }
 
 // Helper: Generate random valid modifier key ID
-std::string randomModifierKeyId() {
+std::string randomModifierKeyId(PropertySource &source) {
   static const std::vector<std::string> validKeys = {
       "lctrl", "rctrl", "lshift", "rshift", "lalt", "ralt", "lwin", "rwin"};
-  std::uniform_int_distribution<> dis(0, validKeys.size() - 1);
-  return validKeys[dis(gen)];
+  return source.pick(validKeys);
+}
+
+// Helper: Describe a mapping for the counterexample
+std::string describeMapping(unsigned short scanCode, bool needsE0,
+                            const std::string &targetKeyId) {
+  std::ostringstream out;
+  out << "mapping 0x" << std::hex << scanCode << (needsE0 ? "/E0" : "")
+      << " -> " << targetKeyId;
+  return out.str();
 }
 
 // Helper: Get scan code and E0 flag for a modifier key ID
@@ -98,14 +96,15 @@ void enableMonitoringForKey(const std::string &keyId, bool &monitorCtrl,
 }
 
 // Property 3: Source key press synchronizes target key
-bool testSourceKeyPressSyncsTarget(int iteration) {
-  unsigned short sourceScanCode = randomScanCode();
-  bool sourceNeedsE0 = randomBool();
-  std::string targetKeyId = randomModifierKeyId();
+bool testSourceKeyPressSyncsTarget(PropertySource &source) {
+  unsigned short sourceScanCode = randomScanCode(source);
+  bool sourceNeedsE0 = source.boolean();
+  std::string targetKeyId = randomModifierKeyId(source);
 
   std::vector<KeyMappingConfig> mappings;
   mappings.emplace_back(sourceScanCode, sourceNeedsE0, targetKeyId,
                         "additional");
+  source.note(describeMapping(sourceScanCode, sourceNeedsE0, targetKeyId));
 
   bool monitorCtrl = false, monitorShift = false, monitorAlt = false,
        monitorWin = false;
@@ -117,8 +116,7 @@ bool testSourceKeyPressSyncsTarget(int iteration) {
                                 monitorWin, {}, {}, mappings);
 
   if (isKeyPressed(detector, targetKeyId)) {
-    std::cerr << "Initial state error in iteration " << iteration << std::endl;
-    return false;
+    return source.fail("Initial state error");
   }
 
   InterceptionKeyStroke stroke =
@@ -126,23 +124,22 @@ bool testSourceKeyPressSyncsTarget(int iteration) {
   detector.processKeyStroke(stroke);
 
   if (!isKeyPressed(detector, targetKeyId)) {
-    std::cerr << "Target key not pressed after source press in iteration "
-              << iteration << std::endl;
-    return false;
+    return source.fail("Target key not pressed after source press");
   }
 
   return true;
 }
 
 // Property 4: Source key release synchronizes target key
-bool testSourceKeyReleaseSyncsTarget(int iteration) {
-  unsigned short sourceScanCode = randomScanCode();
-  bool sourceNeedsE0 = randomBool();
-  std::string targetKeyId = randomModifierKeyId();
+bool testSourceKeyReleaseSyncsTarget(PropertySource &source) {
+  unsigned short sourceScanCode = randomScanCode(source);
+  bool sourceNeedsE0 = source.boolean();
+  std::string targetKeyId = randomModifierKeyId(source);
 
   std::vector<KeyMappingConfig> mappings;
   mappings.emplace_back(sourceScanCode, sourceNeedsE0, targetKeyId,
                         "additional");
+  source.note(describeMapping(sourceScanCode, sourceNeedsE0, targetKeyId));
 
   bool monitorCtrl = false, monitorShift = false, monitorAlt = false,
        monitorWin = false;
@@ -162,19 +159,17 @@ bool testSourceKeyReleaseSyncsTarget(int iteration) {
   detector.processKeyStroke(releaseStroke);
 
   if (isKeyPressed(detector, targetKeyId)) {
-    std::cerr << "Target key still pressed after source release in iteration "
-              << iteration << std::endl;
-    return false;
+    return source.fail("Target key still pressed after source release");
   }
 
   return true;
 }
 
 // Property 5: Target key itself updates independently
-bool testTargetKeyIndependentUpdate(int iteration) {
-  unsigned short sourceScanCode = randomScanCode();
-  bool sourceNeedsE0 = randomBool();
-  std::string targetKeyId = randomModifierKeyId();
+bool testTargetKeyIndependentUpdate(PropertySource &source) {
+  unsigned short sourceScanCode = randomScanCode(source);
+  bool sourceNeedsE0 = source.boolean();
+  std::string targetKeyId = randomModifierKeyId(source);
 
   std::pair<unsigned short, bool> targetInfo = getScanCodeForKeyId(targetKeyId);
   unsigned short targetScanCode = targetInfo.first;
@@ -183,6 +178,7 @@ bool testTargetKeyIndependentUpdate(int iteration) {
   std::vector<KeyMappingConfig> mappings;
   mappings.emplace_back(sourceScanCode, sourceNeedsE0, targetKeyId,
                         "additional");
+  source.note(describeMapping(sourceScanCode, sourceNeedsE0, targetKeyId));
 
   bool monitorCtrl = false, monitorShift = false, monitorAlt = false,
        monitorWin = false;
@@ -198,9 +194,7 @@ bool testTargetKeyIndependentUpdate(int iteration) {
   detector.processKeyStroke(pressStroke);
 
   if (!isKeyPressed(detector, targetKeyId)) {
-    std::cerr << "Target key not pressed after direct press in iteration "
-              << iteration << std::endl;
-    return false;
+    return source.fail("Target key not pressed after direct press");
   }
 
   InterceptionKeyStroke releaseStroke =
@@ -208,22 +202,20 @@ bool testTargetKeyIndependentUpdate(int iteration) {
   detector.processKeyStroke(releaseStroke);
 
   if (isKeyPressed(detector, targetKeyId)) {
-    std::cerr << "Target key still pressed after direct release in iteration "
-              << iteration << std::endl;
-    return false;
+    return source.fail("Target key still pressed after direct release");
   }
 
   return true;
 }
 
 // Property 6: Multiple source keys to same target
-bool testMultipleSourcesKeepTargetPressed(int iteration) {
-  std::string targetKeyId = randomModifierKeyId();
+bool testMultipleSourcesKeepTargetPressed(PropertySource &source) {
+  std::string targetKeyId = randomModifierKeyId(source);
 
-  unsigned short source1ScanCode = randomScanCode();
-  bool source1NeedsE0 = randomBool();
-  unsigned short source2ScanCode = randomScanCode();
-  bool source2NeedsE0 = randomBool();
+  unsigned short source1ScanCode = randomScanCode(source);
+  bool source1NeedsE0 = source.boolean();
+  unsigned short source2ScanCode = randomScanCode(source);
+  bool source2NeedsE0 = source.boolean();
 
   if (source1ScanCode == source2ScanCode && source1NeedsE0 == source2NeedsE0) {
     source2ScanCode = (source1ScanCode + 1) % 0xFF;
@@ -232,8 +224,10 @@ bool testMultipleSourcesKeepTargetPressed(int iteration) {
   std::vector<KeyMappingConfig> mappings;
   mappings.emplace_back(source1ScanCode, source1NeedsE0, targetKeyId,
                         "additional");
+  source.note(describeMapping(source1ScanCode, source1NeedsE0, targetKeyId));
   mappings.emplace_back(source2ScanCode, source2NeedsE0, targetKeyId,
                         "additional");
+  source.note(describeMapping(source2ScanCode, source2NeedsE0, targetKeyId));
 
   bool monitorCtrl = false, monitorShift = false, monitorAlt = false,
        monitorWin = false;
@@ -249,9 +243,7 @@ bool testMultipleSourcesKeepTargetPressed(int iteration) {
   detector.processKeyStroke(press1);
 
   if (!isKeyPressed(detector, targetKeyId)) {
-    std::cerr << "Target not pressed after first source in iteration "
-              << iteration << std::endl;
-    return false;
+    return source.fail("Target not pressed after first source");
   }
 
   InterceptionKeyStroke press2 =
@@ -259,26 +251,32 @@ bool testMultipleSourcesKeepTargetPressed(int iteration) {
   detector.processKeyStroke(press2);
 
   if (!isKeyPressed(detector, targetKeyId)) {
-    std::cerr << "Target not pressed after second source in iteration "
-              << iteration << std::endl;
-    return false;
+    return source.fail("Target not pressed after second source");
   }
 
   return true;
 }
 
 // Property 10: Mapping lookup correctness
-bool testMappingLookupCorrectness(int iteration) {
-  unsigned short mappedScanCode = randomScanCode();
-  bool mappedNeedsE0 = randomBool();
-  std::string targetKeyId = randomModifierKeyId();
+bool testMappingLookupCorrectness(PropertySource &source) {
+  unsigned short mappedScanCode = randomScanCode(source);
+  bool mappedNeedsE0 = source.boolean();
+  std::string targetKeyId = randomModifierKeyId(source);
 
   unsigned short unmappedScanCode = (mappedScanCode + 1) % 0xFF;
   bool unmappedNeedsE0 = !mappedNeedsE0;
 
+  // The unmapped key must not be the target key itself
+  std::pair<unsigned short, bool> targetInfo = getScanCodeForKeyId(targetKeyId);
+  if (unmappedScanCode == targetInfo.first &&
+      unmappedNeedsE0 == targetInfo.second) {
+    unmappedScanCode = (unmappedScanCode + 1) % 0xFF;
+  }
+
   std::vector<KeyMappingConfig> mappings;
   mappings.emplace_back(mappedScanCode, mappedNeedsE0, targetKeyId,
                         "additional");
+  source.note(describeMapping(mappedScanCode, mappedNeedsE0, targetKeyId));
 
   bool monitorCtrl = false, monitorShift = false, monitorAlt = false,
        monitorWin = false;
@@ -294,9 +292,7 @@ bool testMappingLookupCorrectness(int iteration) {
   detector.processKeyStroke(mappedPress);
 
   if (!isKeyPressed(detector, targetKeyId)) {
-    std::cerr << "Mapped key didn't affect target in iteration " << iteration
-              << std::endl;
-    return false;
+    return source.fail("Mapped key didn't affect target");
   }
 
   InterceptionKeyStroke mappedRelease =
@@ -308,9 +304,7 @@ bool testMappingLookupCorrectness(int iteration) {
   detector.processKeyStroke(unmappedPress);
 
   if (isKeyPressed(detector, targetKeyId)) {
-    std::cerr << "Unmapped key affected target in iteration " << iteration
-              << std::endl;
-    return false;
+    return source.fail("Unmapped key affected target");
   }
 
   return true;
@@ -321,155 +315,19 @@ int main() {
             << std::endl;
   std::cout << std::endl;
 
-  const int NUM_ITERATIONS = 100;
-  int totalPassed = 0;
-  int totalFailed = 0;
-
-  std::cout << "Property 3: Source key press synchronizes target" << std::endl;
-  std::cout << "Running " << NUM_ITERATIONS << " iterations..." << std::endl;
-
-  int passed = 0;
-  int failed = 0;
-
-  for (int i = 0; i < NUM_ITERATIONS; ++i) {
-    if (testSourceKeyPressSyncsTarget(i)) {
-      passed++;
-    } else {
-      failed++;
-      std::cerr << "FAILED at iteration " << i << std::endl;
-      break;
-    }
-
-    if ((i + 1) % 10 == 0) {
-      std::cout << "  Completed " << (i + 1) << "/" << NUM_ITERATIONS
-                << " iterations..." << std::endl;
-    }
-  }
-
-  std::cout << "Results: " << passed << " passed, " << failed << " failed"
-            << std::endl;
-  totalPassed += passed;
-  totalFailed += failed;
-
-  std::cout << std::endl;
-  std::cout << "Property 4: Source key release synchronizes target"
-            << std::endl;
-  std::cout << "Running " << NUM_ITERATIONS << " iterations..." << std::endl;
-
-  passed = 0;
-  failed = 0;
-
-  for (int i = 0; i < NUM_ITERATIONS; ++i) {
-    if (testSourceKeyReleaseSyncsTarget(i)) {
-      passed++;
-    } else {
-      failed++;
-      std::cerr << "FAILED at iteration " << i << std::endl;
-      break;
-    }
-
-    if ((i + 1) % 10 == 0) {
-      std::cout << "  Completed " << (i + 1) << "/" << NUM_ITERATIONS
-                << " iterations..." << std::endl;
-    }
-  }
-
-  std::cout << "Results: " << passed << " passed, " << failed << " failed"
-            << std::endl;
-  totalPassed += passed;
-  totalFailed += failed;
-
-  std::cout << std::endl;
-  std::cout << "Property 5: Target key updates independently" << std::endl;
-  std::cout << "Running " << NUM_ITERATIONS << " iterations..." << std::endl;
-
-  passed = 0;
-  failed = 0;
-
-  for (int i = 0; i < NUM_ITERATIONS; ++i) {
-    if (testTargetKeyIndependentUpdate(i)) {
-      passed++;
-    } else {
-      failed++;
-      std::cerr << "FAILED at iteration " << i << std::endl;
-      break;
-    }
-
-    if ((i + 1) % 10 == 0) {
-      std::cout << "  Completed " << (i + 1) << "/" << NUM_ITERATIONS
-                << " iterations..." << std::endl;
-    }
-  }
-
-  std::cout << "Results: " << passed << " passed, " << failed << " failed"
-            << std::endl;
-  totalPassed += passed;
-  totalFailed += failed;
-
-  std::cout << std::endl;
-  std::cout << "Property 6: Multiple sources keep target pressed" << std::endl;
-  std::cout << "Running " << NUM_ITERATIONS << " iterations..." << std::endl;
-
-  passed = 0;
-  failed = 0;
-
-  for (int i = 0; i < NUM_ITERATIONS; ++i) {
-    if (testMultipleSourcesKeepTargetPressed(i)) {
-      passed++;
-    } else {
-      failed++;
-      std::cerr << "FAILED at iteration " << i << std::endl;
-      break;
-    }
-
-    if ((i + 1) % 10 == 0) {
-      std::cout << "  Completed " << (i + 1) << "/" << NUM_ITERATIONS
-                << " iterations..." << std::endl;
-    }
-  }
-
-  std::cout << "Results: " << passed << " passed, " << failed << " failed"
-            << std::endl;
-  totalPassed += passed;
-  totalFailed += failed;
-
-  std::cout << std::endl;
-  std::cout << "Property 10: Mapping lookup correctness" << std::endl;
-  std::cout << "Running " << NUM_ITERATIONS << " iterations..." << std::endl;
-
-  passed = 0;
-  failed = 0;
-
-  for (int i = 0; i < NUM_ITERATIONS; ++i) {
-    if (testMappingLookupCorrectness(i)) {
-      passed++;
-    } else {
-      failed++;
-      std::cerr << "FAILED at iteration " << i << std::endl;
-      break;
-    }
-
-    if ((i + 1) % 10 == 0) {
-      std::cout << "  Completed " << (i + 1) << "/" << NUM_ITERATIONS
-                << " iterations..." << std::endl;
-    }
-  }
-
-  std::cout << "Results: " << passed << " passed, " << failed << " failed"
-            << std::endl;
-  totalPassed += passed;
-  totalFailed += failed;
-
-  std::cout << std::endl;
-  std::cout << "=== Final Results ===" << std::endl;
-  std::cout << "Total: " << totalPassed << " passed, " << totalFailed
-            << " failed" << std::endl;
-
-  if (totalFailed == 0) {
-    std::cout << "All property tests PASSED!" << std::endl;
-    return 0;
-  } else {
-    std::cout << "Some property tests FAILED!" << std::endl;
-    return 1;
-  }
+  const int NUM_ITERATIONS = 10000;
+  PropertyRunner runner;
+
+  runner.check("Property 3: Source key press synchronizes target",
+               NUM_ITERATIONS, testSourceKeyPressSyncsTarget);
+  runner.check("Property 4: Source key release synchronizes target",
+               NUM_ITERATIONS, testSourceKeyReleaseSyncsTarget);
+  runner.check("Property 5: Target key updates independently", NUM_ITERATIONS,
+               testTargetKeyIndependentUpdate);
+  runner.check("Property 6: Multiple sources keep target pressed",
+               NUM_ITERATIONS, testMultipleSourcesKeepTargetPressed);
+  runner.check("Property 10: Mapping lookup correctness", NUM_ITERATIONS,
+               testMappingLookupCorrectness);
+
+  return runner.finish();
 }
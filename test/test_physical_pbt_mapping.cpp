@@ -3,35 +3,24 @@
 
 #include "config.h"
 #include "physical_key_detector.h"
+#include "property_test.h"
 #include <Windows.h>
 #include <cassert>
 #include <iostream>
-#include <random>
+#include <sstream>
 #include <string>
 #include <vector>
 
-// Random generator
-std::random_device rd;
-std::mt19937 gen(rd());
-
 // Helper: Generate random scan code
-unsigned short randomScanCode() {
-  std::uniform_int_distribution<> dis(0x01, 0xFF);
-  return static_cast<unsigned short>(dis(gen));
-}
-
-// Helper: Generate random bool
-bool randomBool() {
-  std::uniform_int_distribution<> dis(0, 1);
-  return dis(gen) == 1;
+unsigned short randomScanCode(PropertySource &source) {
+  return static_cast<unsigned short>(source.range(0x01, 0xFF));
 }
 
 // Helper: Generate random valid modifier key ID
-std::string randomModifierKeyId() {
+std::string randomModifierKeyId(PropertySource &source) {
   static const std::vector<std::string> validKeys = {
       "lctrl", "rctrl", "lshift", "rshift", "lalt", "ralt", "lwin", "rwin"};
-  std::uniform_int_distribution<> dis(0, validKeys.size() - 1);
-  return validKeys[dis(gen)];
+  return source.pick(validKeys);
 }
 
 // Helper: Generate random mapping type
@@ -41,16 +30,24 @@ std::string randomMappingType() {
 }
 
 // Helper: Generate random valid key mapping
-KeyMappingConfig generateRandomMapping() {
-  return KeyMappingConfig(randomScanCode(), randomBool(), randomModifierKeyId(),
-                          randomMappingType(), "Random mapping");
+KeyMappingConfig generateRandomMapping(PropertySource &source) {
+  unsigned short scanCode = randomScanCode(source);
+  bool needsE0 = source.boolean();
+  std::string targetKeyId = randomModifierKeyId(source);
+  std::ostringstream note;
+  note << "mapping 0x" << std::hex << scanCode << (needsE0 ? "/E0" : "")
+       << " -> " << targetKeyId;
+  source.note(note.str());
+  return KeyMappingConfig(scanCode, needsE0, targetKeyId, randomMappingType(),
+                          "Random mapping");
 }
 
-// Helper: Generate random list of mappings
-std::vector<KeyMappingConfig> generateRandomMappings(int count) {
+// Helper: Generate random list of mappings (up to maxCount)
+std::vector<KeyMappingConfig> generateRandomMappings(PropertySource &source,
+                                                     size_t maxCount) {
   std::vector<KeyMappingConfig> mappings;
-  for (int i = 0; i < count; ++i) {
-    mappings.push_back(generateRandomMapping());
+  while (source.another(mappings.size(), maxCount)) {
+    mappings.push_back(generateRandomMapping(source));
   }
   return mappings;
 }
@@ -63,16 +60,21 @@ struct MonitoringConfig {
   bool monitorWin;
 };
 
-MonitoringConfig generateRandomMonitoring() {
-  // Ensure at least one key type is monitored
+MonitoringConfig generateRandomMonitoring(PropertySource &source) {
   MonitoringConfig config;
-  do {
-    config.monitorCtrl = randomBool();
-    config.monitorShift = randomBool();
-    config.monitorAlt = randomBool();
-    config.monitorWin = randomBool();
-  } while (!config.monitorCtrl && !config.monitorShift && !config.monitorAlt &&
-           !config.monitorWin);
+  config.monitorCtrl = source.boolean();
+  config.monitorShift = source.boolean();
+  config.monitorAlt = source.boolean();
+  config.monitorWin = source.boolean();
+
+  // Ensure at least one key type is monitored
+  if (!config.monitorShift && !config.monitorAlt && !config.monitorWin) {
+    config.monitorCtrl = true;
+  }
+  source.note(std::string("monitor") + (config.monitorCtrl ? " ctrl" : "") +
+              (config.monitorShift ? " shift" : "") +
+              (config.monitorAlt ? " alt" : "") +
+              (config.monitorWin ? " win" : ""));
   return config;
 }
 
@@ -93,14 +95,12 @@ bool isKeyMonitored(const std::string &keyId, const MonitoringConfig &config) {
 // For any mapping configuration list and monitoring configuration,
 // when the physical key detector initializes, it should establish
 // associations for each valid mapping (where target key is monitored)
-bool testMappingTableProperty(int iteration) {
+bool testMappingTableProperty(PropertySource &source) {
   // Generate random monitoring configuration
-  MonitoringConfig monitoring = generateRandomMonitoring();
+  MonitoringConfig monitoring = generateRandomMonitoring(source);
 
   // Generate random number of mappings (0-10)
-  std::uniform_int_distribution<> countDis(0, 10);
-  int count = countDis(gen);
-  std::vector<KeyMappingConfig> mappings = generateRandomMappings(count);
+  std::vector<KeyMappingConfig> mappings = generateRandomMappings(source, 10);
 
   // Initialize detector
   PhysicalKeyDetector detector;
@@ -140,17 +140,16 @@ bool testMappingTableProperty(int iteration) {
     expectedKeyCount += 2; // lwin, rwin
 
   if (monitoredCount != expectedKeyCount) {
-    std::cerr << "Key count mismatch in iteration " << iteration
-              << ": expected " << expectedKeyCount << ", got " << monitoredCount
-              << std::endl;
-    return false;
+    return source.fail("Key count mismatch: expected " +
+                       std::to_string(expectedKeyCount) + ", got " +
+                       std::to_string(monitoredCount));
   }
 
   return true;
 }
 
 // Additional test: Verify that mappings with unmonitored targets are ignored
-bool testUnmonitoredTargetProperty(int iteration) {
+bool testUnmonitoredTargetProperty(PropertySource &source) {
   // Create a mapping to a key that won't be monitored
   std::vector<KeyMappingConfig> mappings;
   mappings.emplace_back(0x3A, false, "lctrl", "additional");
@@ -168,16 +167,15 @@ bool testUnmonitoredTargetProperty(int iteration) {
 
   // Should only have shift keys (2 keys)
   if (keys.size() != 2) {
-    std::cerr << "Expected 2 keys (shift only), got " << keys.size()
-              << " in iteration " << iteration << std::endl;
-    return false;
+    return source.fail("Expected 2 keys (shift only), got " +
+                       std::to_string(keys.size()));
   }
 
   return true;
 }
 
 // Test: Multiple mappings to same target
-bool testMultipleMappingsToSameTargetProperty(int iteration) {
+bool testMultipleMappingsToSameTargetProperty(PropertySource &source) {
   // Create multiple mappings to the same target
   std::vector<KeyMappingConfig> mappings;
   mappings.emplace_back(0x3A, false, "lctrl", "additional", "Mapping 1");
@@ -196,9 +194,8 @@ bool testMultipleMappingsToSameTargetProperty(int iteration) {
 
   // Should have 2 ctrl keys
   if (keys.size() != 2) {
-    std::cerr << "Expected 2 keys (ctrl only), got " << keys.size()
-              << " in iteration " << iteration << std::endl;
-    return false;
+    return source.fail("Expected 2 keys (ctrl only), got " +
+                       std::to_string(keys.size()));
   }
 
   return true;
@@ -209,105 +206,20 @@ int main() {
             << std::endl;
   std::cout << std::endl;
 
-  const int NUM_ITERATIONS = 100;
-  int totalPassed = 0;
-  int totalFailed = 0;
+  const int NUM_ITERATIONS = 10000;
+  PropertyRunner runner;
 
   // Test Property 9: Mapping table establishment
-  std::cout << "Property 9: Initialization establishes mapping table"
-            << std::endl;
-  std::cout << "Running " << NUM_ITERATIONS << " iterations..." << std::endl;
-
-  int passed = 0;
-  int failed = 0;
-
-  for (int i = 0; i < NUM_ITERATIONS; ++i) {
-    if (testMappingTableProperty(i)) {
-      passed++;
-    } else {
-      failed++;
-      std::cerr << "FAILED at iteration " << i << std::endl;
-      break;
-    }
-
-    if ((i + 1) % 10 == 0) {
-      std::cout << "  Completed " << (i + 1) << "/" << NUM_ITERATIONS
-                << " iterations..." << std::endl;
-    }
-  }
-
-  std::cout << "Results: " << passed << " passed, " << failed << " failed"
-            << std::endl;
-  totalPassed += passed;
-  totalFailed += failed;
+  runner.check("Property 9: Initialization establishes mapping table",
+               NUM_ITERATIONS, testMappingTableProperty);
 
   // Test: Unmonitored targets are ignored
-  std::cout << std::endl;
-  std::cout << "Additional test: Unmonitored targets are ignored" << std::endl;
-  std::cout << "Running " << NUM_ITERATIONS << " iterations..." << std::endl;
-
-  passed = 0;
-  failed = 0;
-
-  for (int i = 0; i < NUM_ITERATIONS; ++i) {
-    if (testUnmonitoredTargetProperty(i)) {
-      passed++;
-    } else {
-      failed++;
-      std::cerr << "FAILED at iteration " << i << std::endl;
-      break;
-    }
-
-    if ((i + 1) % 10 == 0) {
-      std::cout << "  Completed " << (i + 1) << "/" << NUM_ITERATIONS
-                << " iterations..." << std::endl;
-    }
-  }
-
-  std::cout << "Results: " << passed << " passed, " << failed << " failed"
-            << std::endl;
-  totalPassed += passed;
-  totalFailed += failed;
+  runner.check("Additional test: Unmonitored targets are ignored",
+               NUM_ITERATIONS, testUnmonitoredTargetProperty);
 
   // Test: Multiple mappings to same target
-  std::cout << std::endl;
-  std::cout << "Additional test: Multiple mappings to same target" << std::endl;
-  std::cout << "Running " << NUM_ITERATIONS << " iterations..." << std::endl;
-
-  passed = 0;
-  failed = 0;
-
-  for (int i = 0; i < NUM_ITERATIONS; ++i) {
-    if (testMultipleMappingsToSameTargetProperty(i)) {
-      passed++;
-    } else {
-      failed++;
-      std::cerr << "FAILED at iteration " << i << std::endl;
-      break;
-    }
+  runner.check("Additional test: Multiple mappings to same target",
+               NUM_ITERATIONS, testMultipleMappingsToSameTargetProperty);
 
-    if ((i + 1) % 10 == 0) {
-      std::cout << "  Completed " << (i + 1) << "/" << NUM_ITERATIONS
-                << " iterations..." << std::endl;
-    }
-  }
-
-  std::cout << "Results: " << passed << " passed, " << failed << " failed"
-            << std::endl;
-  totalPassed += passed;
-  totalFailed += failed;
-
-  // Final results
-  std::cout << std::endl;
-  std::cout << "=== Final Results ===" << std::endl;
-  std::cout << "Total: " << totalPassed << " passed, " << totalFailed
-            << " failed" << std::endl;
-
-  if (totalFailed == 0) {
-    std::cout << "All property tests PASSED!" << std::endl;
-    return 0;
-  } else {
-    std::cout << "Some property tests FAILED!" << std::endl;
-    return 1;
-  }
+  return runner.finish();
 }
@@ -0,0 +1,136 @@
+#include "policy_sweep.h"
+#include "simulator.h"
+#include "work_stealing_pool.h"
+#include <cassert>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Tests of the fix policy sweep: grid construction and parallel replay
+
+std::vector<std::vector<SimStroke>> generatedTraces(size_t count) {
+  Simulator probe;
+  probe.initialize();
+  std::vector<std::vector<SimStroke>> traces;
+  for (size_t i = 0; i < count; ++i) {
+    TraceGeneratorOptions generator;
+    generator.seed = i + 1;
+    generator.strokeCount = 20000;
+    traces.push_back(generateTrace(generator, probe.getPhysicalStates()));
+  }
+  return traces;
+}
+
+void testGrid() {
+  std::cout << "Test 1: Grid covers every combination... ";
+
+  std::vector<SweepPolicy> grid = buildSweepGrid(
+      {500, 1000}, {FixTrigger::IdleKeyDown, FixTrigger::AnyKeyDown},
+      {{"lwin", {0, 3000}}, {"lctrl", {2000}}});
+  assert(grid.size() == 8 && "2 thresholds x 2 triggers x 2 x 1");
+  assert(grid[0].describe() == "500ms idle lctrl=2000" && "First policy");
+  assert(grid[1].describe() == "500ms idle lwin=3000 lctrl=2000" &&
+         "0 means no override");
+  assert(grid[7].describe() == "1000ms any lwin=3000 lctrl=2000" &&
+         "Last policy");
+
+  FixTrigger trigger;
+  assert(parseFixTrigger("other", trigger) &&
+         trigger == FixTrigger::OtherKeyDown && "Trigger names round-trip");
+  assert(!parseFixTrigger("never", trigger) && "Unknown trigger rejected");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testSweepMatchesSingleRuns() {
+  std::cout << "Test 2: Parallel sweep matches sequential runs... ";
+
+  std::vector<std::vector<SimStroke>> traces = generatedTraces(3);
+  SimulationOptions options;
+  options.layer.dropKeyUpRate = 0.01;
+  options.layer.seed = 5;
+  std::vector<SweepPolicy> grid = buildSweepGrid(
+      {300, 1000, 3000}, {FixTrigger::IdleKeyDown, FixTrigger::OtherKeyDown},
+      {});
+
+  WorkStealingPool pool(4);
+  std::vector<SweepResult> results =
+      runSweep(grid, traces, options, nullptr, pool);
+  assert(results.size() == grid.size() && "One result per policy");
+
+  // Same as replaying each trace on its own, with the per-trace seed
+  const SweepPolicy &policy = grid[3];
+  SweepResult expected;
+  for (size_t t = 0; t < traces.size(); ++t) {
+    SimulationOptions traceOptions = options;
+    traceOptions.layer.seed = options.layer.seed + t;
+    Simulator simulator(traceOptions);
+    simulator.initialize();
+    simulator.setThreshold(policy.thresholdMs);
+    simulator.setTrigger(policy.trigger);
+    simulator.run(traces[t]);
+    expected.fixes += simulator.getReport().fixes;
+    expected.droppedKeyUps += simulator.getReport().droppedKeyUps;
+  }
+  assert(results[3].fixes == expected.fixes &&
+         results[3].droppedKeyUps == expected.droppedKeyUps &&
+         "Sweep result equals sequential runs");
+
+  // Without jitter every policy sees the same lost key-ups, each of which
+  // is either fixed or missed
+  for (const SweepResult &result : results) {
+    assert(result.droppedKeyUps == results[0].droppedKeyUps &&
+           result.droppedKeyUps > 0 && "Same lost key-ups");
+    assert(result.trueFixes() + result.missedStuck() ==
+               result.droppedKeyUps &&
+           "Each lost key-up fixed or missed");
+  }
+  // A longer threshold misses more of them
+  assert(results[0].missedStuckRate() <= results[4].missedStuckRate() &&
+         "Missed rate grows with the threshold");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testPerKeyOverride() {
+  std::cout << "Test 3: Per-key overrides hold back fixes of those keys... ";
+
+  std::vector<std::vector<SimStroke>> traces = generatedTraces(2);
+  SimulationOptions options;
+  options.layer.dropKeyUpRate = 0.02;
+  // A key-up lags past the short threshold now and then
+  options.layer.lagMs = 100;
+  options.layer.lagJitterMs = 400;
+  std::vector<SweepPolicy> grid =
+      buildSweepGrid({300}, {FixTrigger::AnyKeyDown},
+                     {{"lctrl", {0, 60000}}, {"rctrl", {0, 60000}}});
+
+  WorkStealingPool pool(2);
+  std::vector<SweepResult> results =
+      runSweep(grid, traces, options, nullptr, pool);
+  assert(results.size() == 4 && "Four policies");
+  assert(results[0].falseFixes > 0 && "Short threshold causes false fixes");
+  assert(results[3].fixes < results[0].fixes &&
+         "Long per-key thresholds fix less");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+int main() {
+  std::cout << "=== Policy Sweep Tests ===" << std::endl;
+  std::cout << std::endl;
+
+  try {
+    testGrid();
+    testSweepMatchesSingleRuns();
+    testPerKeyOverride();
+
+    std::cout << std::endl;
+    std::cout << "All policy sweep tests PASSED!" << std::endl;
+    return 0;
+  } catch (const std::exception &e) {
+    std::cerr << std::endl;
+    std::cerr << "Test FAILED with exception: " << e.what() << std::endl;
+    return 1;
+  }
+}
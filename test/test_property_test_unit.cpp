@@ -0,0 +1,123 @@
+#include "property_test.h"
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Tests of the property-based test engine: reproducible draws, replay,
+// shrinking and failure reporting
+
+void testDrawsAndReplay() {
+  std::cout << "Test 1: Draws are reproducible and replayable... ";
+
+  PropertySource a(12345, 0);
+  PropertySource b(12345, 0);
+  std::vector<uint64_t> drawn;
+  for (int i = 0; i < 100; ++i) {
+    uint64_t value = a.draw(1000);
+    assert(value < 1000 && "In range");
+    assert(value == b.draw(1000) && "Same seed, same draws");
+    drawn.push_back(value);
+  }
+  assert(a.getChoices() == drawn && "Every draw recorded");
+
+  int low = a.range(-5, 5);
+  assert(low >= -5 && low <= 5 && "Range is inclusive");
+
+  // Replay returns the recorded values, clamped, then zeros
+  PropertySource replay({7, 500, 2}, 3);
+  assert(replay.draw(10) == 7 && "Recorded value");
+  assert(replay.draw(10) == 9 && "Clamped to the draw's range");
+  assert(replay.boolean() && "Bool from a replayed 2");
+  assert(replay.draw(10) == 0 && replay.index() == 3 && "Zeros after the end");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+// Fails when a list of values up to 100 sums to 500 or more
+bool sumBelow500(PropertySource &source) {
+  std::vector<int> values;
+  int sum = 0;
+  while (source.another(values.size(), 50)) {
+    values.push_back(source.range(0, 100));
+    sum += values.back();
+  }
+  source.note(std::to_string(values.size()) + " values, sum " +
+              std::to_string(sum));
+  return sum < 500 || source.fail("Sum too large");
+}
+
+void testShrinking() {
+  std::cout << "Test 2: Failing cases are shrunk... " << std::endl;
+
+  PropertyRunner runner(2);
+  runner.setSeed(1);
+  assert(!runner.check("Expected failure: sum below 500", 2000, sumBelow500) &&
+         "Property fails");
+
+  // Lowering values is greedy, so the list need not reach the 5 elements
+  // of the global minimum, but every value is as low as it can go
+  const PropertyFailure &failure = runner.getLastFailure();
+  assert(failure.shrinkSteps > 0 && "Shrunk");
+  assert(failure.notes.size() == 1 && "One note");
+  const std::string &note = failure.notes[0];
+  assert(std::stoul(note) <= 10 && "Short list");
+  assert(note.substr(note.find("sum")) == "sum 500" && "Minimal sum");
+  assert(failure.message == "Sum too large" && "Failure message kept");
+
+  // The reported case replays exactly from the seed
+  PropertyRunner again(1);
+  again.setSeed(1);
+  again.check("Expected failure: sum below 500", 2000, sumBelow500);
+  assert(again.getLastFailure().caseIndex == failure.caseIndex &&
+         again.getLastFailure().choices == failure.choices &&
+         "Same seed, same failure on any thread count");
+
+  std::cout << "Test 2: PASSED" << std::endl;
+}
+
+void testExceptionsAndSummary() {
+  std::cout << "Test 3: Exceptions fail the property... " << std::endl;
+
+  PropertyRunner runner(2);
+  runner.setSeed(2);
+  assert(runner.check("Passing property", 100,
+                      [](PropertySource &source) {
+                        return source.draw(10) < 10;
+                      }) &&
+         "Holds");
+  assert(!runner.check("Expected failure: throws", 100,
+                       [](PropertySource &source) -> bool {
+                         if (source.draw(10) == 3) {
+                           throw std::runtime_error("boom");
+                         }
+                         return true;
+                       }) &&
+         "Exception is a failure");
+  assert(runner.getLastFailure().message == "exception: boom" &&
+         runner.getLastFailure().choices == std::vector<uint64_t>{3} &&
+         "Exception message and minimal draw");
+  assert(runner.finish() == 1 && "Failed run exits with 1");
+
+  std::cout << "Test 3: PASSED" << std::endl;
+}
+
+int main() {
+  std::cout << "=== Property Test Engine Tests ===" << std::endl;
+  std::cout << std::endl;
+
+  try {
+    testDrawsAndReplay();
+    testShrinking();
+    testExceptionsAndSummary();
+
+    std::cout << std::endl;
+    std::cout << "All property test engine tests PASSED!" << std::endl;
+    return 0;
+  } catch (const std::exception &e) {
+    std::cerr << std::endl;
+    std::cerr << "Test FAILED with exception: " << e.what() << std::endl;
+    return 1;
+  }
+}
@@ -0,0 +1,93 @@
+#include "quantile_estimator.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Tests of the P² streaming quantile estimator
+
+// Exact quantile by nearest rank
+double exactQuantile(std::vector<double> values, double p) {
+  std::sort(values.begin(), values.end());
+  size_t rank = static_cast<size_t>(std::ceil(p * values.size()));
+  return values[rank > 0 ? rank - 1 : 0];
+}
+
+void testFewValuesAreExact() {
+  std::cout << "Test 1: Fewer than five values are exact... ";
+
+  P2Quantile median(0.5);
+  assert(median.value() == 0.0 && median.count() == 0 && "Empty");
+  median.add(30);
+  median.add(10);
+  median.add(20);
+  assert(median.value() == 20 && median.count() == 3 && "Median of three");
+
+  P2Quantile high(0.99);
+  for (double value : {4.0, 1.0, 3.0, 2.0}) {
+    high.add(value);
+  }
+  assert(high.value() == 4 && "High quantile of four values is the maximum");
+
+  high.reset();
+  assert(high.count() == 0 && high.value() == 0.0 && "Reset");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testAccuracy() {
+  std::cout << "Test 2: Estimates track the exact quantile... ";
+
+  std::mt19937_64 random(42);
+  std::uniform_real_distribution<double> uniform(0.0, 1000.0);
+  std::exponential_distribution<double> exponential(1.0 / 20.0);
+  for (double p : {0.5, 0.9, 0.99}) {
+    P2Quantile uniformEstimate(p);
+    P2Quantile exponentialEstimate(p);
+    std::vector<double> uniformValues;
+    std::vector<double> exponentialValues;
+    for (int i = 0; i < 20000; ++i) {
+      double u = uniform(random);
+      double e = exponential(random);
+      uniformEstimate.add(u);
+      exponentialEstimate.add(e);
+      uniformValues.push_back(u);
+      exponentialValues.push_back(e);
+    }
+    double exact = exactQuantile(uniformValues, p);
+    assert(std::fabs(uniformEstimate.value() - exact) < 20 &&
+           "Uniform within 2% of the range");
+    exact = exactQuantile(exponentialValues, p);
+    assert(std::fabs(exponentialEstimate.value() - exact) < 0.05 * exact &&
+           "Exponential within 5%");
+  }
+
+  // Sorted input is the hardest case for the markers
+  P2Quantile sorted(0.9);
+  for (int i = 1; i <= 10000; ++i) {
+    sorted.add(i);
+  }
+  assert(std::fabs(sorted.value() - 9000) < 100 && "Sorted input");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+int main() {
+  std::cout << "=== Quantile Estimator Tests ===" << std::endl;
+  std::cout << std::endl;
+
+  try {
+    testFewValuesAreExact();
+    testAccuracy();
+
+    std::cout << std::endl;
+    std::cout << "All quantile estimator tests PASSED!" << std::endl;
+    return 0;
+  } catch (const std::exception &e) {
+    std::cerr << std::endl;
+    std::cerr << "Test FAILED with exception: " << e.what() << std::endl;
+    return 1;
+  }
+}
@@ -0,0 +1,183 @@
+#include "scenario.h"
+#include <cassert>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Tests of the scenario language and its interpreter
+
+ScenarioResult run(const std::string &text) {
+  Scenario scenario;
+  std::string error;
+  bool parsed = parseScenario(text, scenario, error);
+  if (!parsed) {
+    std::cerr << error << std::endl;
+  }
+  assert(parsed && "Scenario should parse");
+  return runScenario(scenario);
+}
+
+void testLostKeyUpIsFixed() {
+  std::cout << "Test 1: A lost key-up is fixed by the next key-down... ";
+
+  ScenarioResult result = run("down lctrl; up lctrl; virt lctrl=1\n"
+                              "expect mismatch lctrl\n"
+                              "advance 1200ms\n"
+                              "expect stuck lctrl; expect phys lctrl=0\n"
+                              "down a\n"
+                              "expect fix lctrl\n"
+                              "expect virt lctrl=0; expect ok lctrl\n"
+                              "up a; expect nofix; expect fixes 1\n");
+  assert(result.passed && "Scenario should pass");
+  assert(result.strokes == 4 && result.checks == 8 && "Counts");
+
+  // Same with the key-up lost on the way to the OS
+  result = run("down lctrl\n"
+               "up lctrl lost\n"
+               "expect virt lctrl=1\n"
+               "advance 999ms; down a; expect nofix\n"
+               "advance 1s; down b; expect fix lctrl\n");
+  assert(result.passed && "Lost key-up scenario should pass");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testFailedCheckIsReported() {
+  std::cout << "Test 2: A failed check reports its line... ";
+
+  ScenarioResult result = run("# Ctrl held: no fix\n"
+                              "down lctrl; up lctrl lost\n"
+                              "advance 500ms; down lshift\n"
+                              "advance 2s; down a\n"
+                              "expect fix lctrl\n"
+                              "expect nofix\n");
+  assert(!result.passed && "Scenario should fail");
+  assert(result.line == 5 && "First failing check");
+  assert(result.message == "expected fix lctrl, got nofix" && "Message");
+  assert(result.checks == 1 && "Later commands are not run");
+
+  result = run("down lctrl; up lctrl lost; advance 500ms\n"
+               "expect stuck lctrl\n");
+  assert(!result.passed && result.line == 2 &&
+         result.message == "expected lctrl stuck, got mismatch (500 ms)" &&
+         "Tracker message includes the mismatch time");
+
+  result = run("expect virt capslock=0\n");
+  assert(!result.passed &&
+         result.message == "key 'capslock' is not monitored" &&
+         "Unknown ids fail");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testParseErrors() {
+  std::cout << "Test 3: Parse errors name the line... ";
+
+  const std::vector<std::pair<std::string, std::string>> cases = {
+      {"down a\npress a\n", "line 2: unknown command 'press'"},
+      {"advance soon\n", "line 1: usage: advance <n>[ms|s]"},
+      {"virt lctrl\n", "line 1: usage: virt <id>=0|1"},
+      {"down a\nmonitor ctrl\n",
+       "line 2: monitor must come before other commands"},
+      {"trigger sometimes\n", "line 1: usage: trigger idle|any|other"},
+      {"timer soon\n", "line 1: usage: timer on|off"},
+      {"releasecheck -5\n", "line 1: usage: releasecheck <ms>"},
+      {"lostkeydown 0\n", "line 1: usage: lostkeydown <ms>"},
+      {"repair always\n", "line 1: usage: repair on|off"},
+      {"down lctrl gone\n", "line 1: usage: down <key> [lost]"},
+      {"expect maybe lctrl\n", "line 1: unknown check 'expect maybe'"},
+      {"map 0x200 lctrl\n", "line 1: usage: map <scan> <id>"}};
+  for (const auto &testCase : cases) {
+    Scenario scenario;
+    std::string error;
+    assert(!parseScenario(testCase.first, scenario, error) &&
+           "Should not parse");
+    assert(error == testCase.second && "Error message");
+  }
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testSetupCommands() {
+  std::cout << "Test 4: Key selection, mappings and policies... ";
+
+  // Caps Lock mapped to Ctrl holds it physically; only Ctrl is monitored
+  ScenarioResult result = run("monitor ctrl\n"
+                              "map 0x3a lctrl\n"
+                              "down capslock; expect phys lctrl=1\n"
+                              "up capslock; expect phys lctrl=0\n"
+                              "expect virt lshift=0\n");
+  assert(!result.passed && result.line == 5 &&
+         result.message == "key 'lshift' is not monitored" &&
+         "Unmonitored groups have no keys");
+
+  result = run("custom Caps 0x3a 0x14\n"
+               "threshold caps 300; threshold 5000\n"
+               "down caps; up caps lost; advance 400ms\n"
+               "expect stuck caps\n"
+               "down a; expect fix caps\n");
+  assert(result.passed && "Custom key with its own threshold");
+
+  result = run("trigger any\n"
+               "down lctrl; up lctrl lost; advance 1500ms\n"
+               "down lshift; expect fix lctrl\n");
+  assert(result.passed && "'any' trigger fixes while a modifier is held");
+
+  result = run("disable lwin\n"
+               "down lwin; up lwin lost; advance 2s; down a; expect nofix\n");
+  assert(result.passed && "Disabled keys are not fixed");
+
+  result = run("map 0x3a nokey\ndown a\n");
+  assert(!result.passed && result.line == 2 &&
+         result.message == "map target 'nokey' is not monitored" &&
+         "Bad mapping targets fail at the first command");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testRegressionScenarios() {
+  std::cout << "Test 5: Regression scenarios pass... ";
+
+#ifdef ESCMODKEY_SCENARIO_DIR
+  namespace fs = std::filesystem;
+  size_t count = 0;
+  for (const auto &entry : fs::directory_iterator(ESCMODKEY_SCENARIO_DIR)) {
+    if (entry.path().extension() != ".scn") {
+      continue;
+    }
+    ScenarioResult result = runScenarioFile(entry.path().string());
+    if (!result.passed) {
+      std::cerr << entry.path().string() << ":" << result.line << ": "
+                << result.message << std::endl;
+    }
+    assert(result.passed && "Regression scenario failed");
+    ++count;
+  }
+  assert(count > 0 && "Scenario directory should not be empty");
+  std::cout << "PASSED (" << count << " files)" << std::endl;
+#else
+  std::cout << "SKIPPED (no scenario directory)" << std::endl;
+#endif
+}
+
+int main() {
+  std::cout << "=== Scenario Tests ===" << std::endl;
+  std::cout << std::endl;
+
+  try {
+    testLostKeyUpIsFixed();
+    testFailedCheckIsReported();
+    testParseErrors();
+    testSetupCommands();
+    testRegressionScenarios();
+
+    std::cout << std::endl;
+    std::cout << "All scenario tests PASSED!" << std::endl;
+    return 0;
+  } catch (const std::exception &e) {
+    std::cerr << std::endl;
+    std::cerr << "Test FAILED with exception: " << e.what() << std::endl;
+    return 1;
+  }
+}
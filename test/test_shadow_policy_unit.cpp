@@ -0,0 +1,146 @@
+#include "clock.h"
+#include "shadow_policy.h"
+#include <cassert>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Tests of shadow fix policies: parsing, decisions compared with the live
+// policy, and the non-blocking ring
+
+const uint16_t kKeyA = 0x1E;
+
+// Default keys: lctrl is index 0 in both tables, lshift index 2
+const uint32_t kLctrl = 1u << 0;
+const uint32_t kLshift = 1u << 2;
+
+void testParse() {
+  std::cout << "Test 1: Policy strings... ";
+
+  ShadowPolicy policy;
+  assert(ShadowPolicy::parse("750", policy) && policy.thresholdMs == 750 &&
+         policy.trigger == FixTrigger::IdleKeyDown && "Threshold only");
+  assert(ShadowPolicy::parse("1500:other", policy) &&
+         policy.thresholdMs == 1500 &&
+         policy.trigger == FixTrigger::OtherKeyDown && "With trigger");
+  assert(policy.describe() == "1500ms other" && "Description");
+  assert(!ShadowPolicy::parse("", policy) && "Empty rejected");
+  assert(!ShadowPolicy::parse("fast", policy) && "Not a number");
+  assert(!ShadowPolicy::parse("750:never", policy) && "Unknown trigger");
+  assert(!ShadowPolicy::parse("-5", policy) && "Negative threshold");
+  assert(policy.thresholdMs == 1500 && "Failed parse leaves policy alone");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testComparedWithLive() {
+  std::cout << "Test 2: Decisions compared with the live policy... ";
+
+  ModifierKeyStates physical;
+  VirtualKeyStates virtualStates;
+  ManualClock clock;
+  ShadowEvaluator shadow;
+  ShadowPolicy fast;
+  fast.thresholdMs = 500;
+  ShadowPolicy slow;
+  slow.thresholdMs = 2000;
+  ShadowPolicy any;
+  any.thresholdMs = 500;
+  any.trigger = FixTrigger::AnyKeyDown;
+  shadow.start({fast, slow, any}, physical, virtualStates, clock);
+  assert(shadow.isActive() && "Started");
+
+  // Episode 1: lctrl stuck, the live policy fixes it at 1200ms
+  shadow.recordState(0, kLctrl);
+  clock.advanceMs(800);
+  shadow.recordStroke(kKeyA, INTERCEPTION_KEY_DOWN);
+  clock.advanceMs(400);
+  shadow.recordStroke(kKeyA, INTERCEPTION_KEY_DOWN);
+  shadow.recordLiveFix(0);
+  shadow.recordState(0, 0);
+
+  // Episode 2: lctrl stuck while lshift is held, then heals by itself
+  clock.advanceMs(1000);
+  shadow.recordState(kLshift, kLctrl | kLshift);
+  clock.advanceMs(700);
+  shadow.recordStroke(kKeyA, INTERCEPTION_KEY_DOWN);
+  clock.advanceMs(100);
+  shadow.recordState(0, 0);
+
+  shadow.waitIdle();
+  std::vector<ShadowResult> results = shadow.getResults();
+  assert(results.size() == 3 && "One result per policy");
+
+  const ShadowResult &fastResult = results[0];
+  assert(fastResult.wouldFix == 1 && fastResult.agreed == 1 &&
+         fastResult.liveOnly == 0 && fastResult.shadowOnly == 0 &&
+         "Fast policy fixed earlier, once per episode");
+  assert(fastResult.meanLeadMs() == 400.0 && "400ms ahead of the live fix");
+
+  const ShadowResult &slowResult = results[1];
+  assert(slowResult.wouldFix == 0 && slowResult.liveOnly == 1 &&
+         "Slow policy had not fixed yet");
+
+  const ShadowResult &anyResult = results[2];
+  assert(anyResult.wouldFix == 2 && anyResult.agreed == 1 &&
+         anyResult.shadowOnly == 1 && "Held Shift does not stop 'any'");
+
+  std::string summary = shadow.summary(1);
+  assert(summary.find("Live policy: 1 fixes") != std::string::npos &&
+         summary.find("Shadow 500ms any: 2 would fix") != std::string::npos &&
+         "Summary lists every policy");
+
+  shadow.stop();
+  assert(!shadow.isActive() && "Stopped");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testFullRingDrops() {
+  std::cout << "Test 3: Full ring drops instead of blocking... ";
+
+  ModifierKeyStates physical;
+  VirtualKeyStates virtualStates;
+  ManualClock clock;
+  ShadowEvaluator shadow;
+  shadow.start({ShadowPolicy()}, physical, virtualStates, clock, 8);
+  for (int i = 0; i < 100000; ++i) {
+    shadow.recordStroke(kKeyA, static_cast<uint16_t>(i % 2));
+  }
+  assert(shadow.getDroppedCount() > 0 && "Overflow counted");
+  assert(shadow.summary(0).find("dropped") != std::string::npos &&
+         "Drops reported");
+  shadow.stop();
+
+  // Restart evaluates from a clean state
+  shadow.start({ShadowPolicy()}, physical, virtualStates, clock);
+  shadow.waitIdle();
+  assert(shadow.getDroppedCount() == 0 &&
+         shadow.getResults()[0].wouldFix == 0 && "Fresh results");
+  shadow.stop();
+
+  ShadowEvaluator idle;
+  idle.start({}, physical, virtualStates, clock);
+  assert(!idle.isActive() && "No policies, no thread");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+int main() {
+  std::cout << "=== Shadow Policy Tests ===" << std::endl;
+  std::cout << std::endl;
+
+  try {
+    testParse();
+    testComparedWithLive();
+    testFullRingDrops();
+
+    std::cout << std::endl;
+    std::cout << "All shadow policy tests PASSED!" << std::endl;
+    return 0;
+  } catch (const std::exception &e) {
+    std::cerr << std::endl;
+    std::cerr << "Test FAILED with exception: " << e.what() << std::endl;
+    return 1;
+  }
+}
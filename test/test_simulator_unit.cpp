@@ -0,0 +1,441 @@
+#include "simulator.h"
+#include "trace_format.h"
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+const uint16_t kLctrl = 0x1D;
+const uint16_t kLshift = 0x2A;
+const uint16_t kLetterA = 0x1E;
+
+uint64_t ms(uint64_t value) { return value * 1000000ull; }
+
+SimStroke down(uint64_t timeMs, uint16_t code) {
+  return {ms(timeMs), code, INTERCEPTION_KEY_DOWN};
+}
+
+SimStroke up(uint64_t timeMs, uint16_t code) {
+  return {ms(timeMs), code, INTERCEPTION_KEY_UP};
+}
+
+void testNormalTypingNeedsNoFix() {
+  std::cout << "Test 1: Normal typing triggers no fix... ";
+
+  Simulator simulator;
+  simulator.initialize();
+  simulator.setThreshold(1000);
+  simulator.run({down(0, kLctrl), down(50, kLetterA), up(120, kLetterA),
+                 up(150, kLctrl), down(3000, kLetterA), up(3080, kLetterA)});
+
+  const SimulationReport &report = simulator.getReport();
+  assert(report.strokes == 6 && "Stroke count mismatch");
+  assert(report.fixes == 0 && "No fix expected");
+  assert(report.stuckEvents == 0 && "No stuck key expected");
+  assert(!simulator.getVirtualStates().lctrl() &&
+         "Virtual Ctrl should be released");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testDroppedKeyUpIsFixed() {
+  std::cout << "Test 2: A lost key-up is fixed on the next key-down... ";
+
+  SimulationOptions options;
+  options.layer.dropKeyUpRate = 1.0; // Every monitored key-up is lost
+  Simulator simulator(options);
+  simulator.initialize();
+  simulator.setThreshold(1000);
+
+  simulator.feed(down(0, kLctrl));
+  simulator.feed(up(100, kLctrl));
+  simulator.advanceTo(ms(1500));
+  assert(simulator.getVirtualStates().lctrl() &&
+         "Virtual Ctrl should be stuck");
+  assert(simulator.getReport().stuckEvents == 1 &&
+         "Idle iterations should report the stuck key");
+
+  // A key-down before the threshold would not fix; this one is after it
+  simulator.feed(down(2000, kLetterA));
+  const SimulationReport &report = simulator.getReport();
+  assert(report.fixes == 1 && "Exactly one fix expected");
+  assert(report.falseFixes == 0 && "Fix should be for a lost key-up");
+  const FixDecision &decision = report.decisions[0];
+  assert(simulator.getLogic().getKeyId(decision.keyIndex) == "lctrl" &&
+         "Wrong key fixed");
+  assert(decision.causedByDrop && "Decision should be marked as real");
+  assert(decision.triggerCode == kLetterA && "Wrong trigger");
+  assert(decision.mismatchMs >= 1850 && decision.mismatchMs <= 1900 &&
+         "Mismatch duration should follow virtual time");
+  assert(!simulator.getVirtualStates().lctrl() &&
+         "Fix should release the virtual key");
+  assert(simulator.countStuckKeys() == 0 && "No key should remain stuck");
+  assert(simulator.getLogic().getStatistics().getFixCount("lctrl") == 1 &&
+         "Statistics should count the fix");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testKeyDownWhileModifierHeldDoesNotFix() {
+  std::cout << "Test 3: No fix while a monitored key is held... ";
+
+  SimulationOptions options;
+  options.layer.dropKeyUpRate = 1.0;
+  Simulator simulator(options);
+  simulator.initialize();
+  simulator.setThreshold(1000);
+  // Shift goes down before Ctrl counts as stuck and stays down
+  simulator.run({down(0, kLctrl), up(100, kLctrl), down(500, kLshift),
+                 down(2000, kLetterA), up(2050, kLetterA)});
+
+  assert(simulator.getReport().stuckEvents == 1 && "Ctrl should be stuck");
+  assert(simulator.getReport().fixes == 0 &&
+         "Physical Shift held: fix must wait");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testSlowLayerCausesFalseFix() {
+  std::cout << "Test 4: A lagging virtual layer is reported as false fix... ";
+
+  SimulationOptions options;
+  options.layer.lagMs = 1500.0;
+  Simulator simulator(options);
+  simulator.initialize();
+  simulator.setThreshold(1000);
+  simulator.run({down(0, kLctrl), up(3000, kLctrl), down(4200, kLetterA),
+                 up(4250, kLetterA)});
+
+  const SimulationReport &report = simulator.getReport();
+  assert(report.fixes == 1 && "Lag beyond threshold looks stuck");
+  assert(report.falseFixes == 1 && "Fix should be classified as false");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testGeneratedTraceIsDeterministic() {
+  std::cout << "Test 5: Generated runs are reproducible and consistent... ";
+
+  SimulationOptions options;
+  options.layer.dropKeyUpRate = 0.01;
+  options.layer.lagMs = 2.0;
+  options.layer.lagJitterMs = 3.0;
+  options.layer.seed = 42;
+
+  TraceGeneratorOptions generator;
+  generator.seed = 7;
+  generator.strokeCount = 200000;
+
+  Simulator first(options);
+  first.initialize();
+  std::vector<SimStroke> strokes =
+      generateTrace(generator, first.getPhysicalStates());
+  for (size_t i = 1; i < strokes.size(); ++i) {
+    assert(strokes[i].timeNs >= strokes[i - 1].timeNs &&
+           "Generated strokes must be ordered");
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  first.run(strokes);
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+
+  Simulator second(options);
+  second.initialize();
+  second.run(strokes);
+
+  const SimulationReport &a = first.getReport();
+  const SimulationReport &b = second.getReport();
+  assert(a.fixes == b.fixes && a.droppedKeyUps == b.droppedKeyUps &&
+         a.iterations == b.iterations && "Runs should be identical");
+  assert(a.droppedKeyUps > 0 && a.fixes > 0 && "Expected some stuck keys");
+  assert(a.decisions.size() == a.fixes && "Every fix should be reported");
+
+  uint64_t realFixes = a.fixes - a.falseFixes;
+  assert(realFixes + a.selfHealed +
+                 static_cast<uint64_t>(first.countStuckKeys()) <=
+             a.droppedKeyUps &&
+         "Stuck keys must come from lost key-ups");
+  assert(static_cast<uint64_t>(
+             first.getLogic().getStatistics().getTotalFixes()) == a.fixes &&
+         "Statistics mismatch");
+
+  double perSecond =
+      elapsed > 0 ? a.strokes * 1000000.0 / static_cast<double>(elapsed) : 0;
+  std::cout << "PASSED (" << a.fixes << " fixes, "
+            << static_cast<uint64_t>(perSecond) << " strokes/s)" << std::endl;
+}
+
+void testTraceFileReplay() {
+  std::cout << "Test 6: Strokes survive a trace file round trip... ";
+
+  Simulator simulator;
+  simulator.initialize();
+  TraceGeneratorOptions generator;
+  generator.strokeCount = 1000;
+  std::vector<SimStroke> strokes =
+      generateTrace(generator, simulator.getPhysicalStates());
+
+  TraceFormat::FileHeader header;
+  TraceFormat::initHeader(header, {}, 0, 1, 0, 1000);
+  const std::string filename = "test_simulator_replay.emkt";
+  assert(TraceFormat::writeTraceFile(filename, header,
+                                     strokesToRecords(strokes)) &&
+         "Failed to write trace");
+
+  TraceFormat::TraceFile trace;
+  assert(TraceFormat::readTraceFile(filename, trace) && "Failed to read trace");
+  std::vector<SimStroke> replayed = strokesFromTrace(trace);
+  assert(replayed.size() == strokes.size() && "Stroke count mismatch");
+  for (size_t i = 0; i < strokes.size(); ++i) {
+    assert(replayed[i].timeNs == strokes[i].timeNs &&
+           replayed[i].code == strokes[i].code &&
+           replayed[i].state == strokes[i].state && "Stroke mismatch");
+  }
+
+  std::remove(filename.c_str());
+  std::cout << "PASSED" << std::endl;
+}
+
+void testTimerFixShrinksStuckTime() {
+  std::cout << "Test 7: Timer fixes release stuck keys at the deadline... ";
+
+  SimulationOptions options;
+  options.layer.dropKeyUpRate = 1.0;
+  Simulator simulator(options);
+  simulator.initialize();
+  simulator.setThreshold(1000);
+  simulator.setTimerFix(true);
+
+  simulator.feed(down(0, kLctrl));
+  simulator.feed(up(100, kLctrl));
+  simulator.advanceTo(ms(1500));
+  const SimulationReport &report = simulator.getReport();
+  assert(report.fixes == 1 && report.timerFixes == 1 &&
+         "Fixed without a trigger key-down");
+  const FixDecision &decision = report.decisions[0];
+  assert(decision.triggerCode == 0 && decision.timeNs == ms(1100) &&
+         decision.mismatchMs == 1000 && "Released exactly at the deadline");
+  assert(!simulator.getVirtualStates().lctrl() && "Ctrl released");
+
+  // Sparse typing: the next key-down is often far past the threshold
+  SimulationOptions dropping;
+  dropping.layer.dropKeyUpRate = 0.01;
+  TraceGeneratorOptions generator;
+  generator.strokeCount = 20000;
+  generator.meanGapMs = 1500;
+  uint64_t stuckNs[2];
+  for (int timer = 0; timer < 2; ++timer) {
+    Simulator run(dropping);
+    run.initialize();
+    run.setTimerFix(timer == 1);
+    run.run(generateTrace(generator, run.getPhysicalStates()));
+    assert(run.getReport().fixes > 0 && run.getReport().falseFixes == 0 &&
+           "Only lost key-ups are fixed");
+    stuckNs[timer] = run.getReport().stuckNs;
+  }
+  assert(stuckNs[1] < stuckNs[0] * 3 / 4 && "Stuck time should shrink");
+
+  std::cout << "PASSED (stuck " << stuckNs[0] / 1000000 << " ms -> "
+            << stuckNs[1] / 1000000 << " ms)" << std::endl;
+}
+
+void testReleaseCheckCatchesDroppedKeyUps() {
+  std::cout << "Test 8: Release checks catch dropped key-ups early... ";
+
+  SimulationOptions options;
+  options.layer.dropKeyUpRate = 1.0;
+  Simulator simulator(options);
+  simulator.initialize();
+  simulator.setReleaseCheck(50);
+
+  simulator.feed(down(0, kLctrl));
+  simulator.feed(up(100, kLctrl));
+  simulator.advanceTo(ms(500));
+  const SimulationReport &report = simulator.getReport();
+  assert(report.fixes == 1 && report.releaseCheckFixes == 1 &&
+         report.timerFixes == 0 && "Released by the check");
+  const FixDecision &decision = report.decisions[0];
+  assert(decision.releaseCheck && decision.timeNs == ms(150) &&
+         decision.mismatchMs == 50 && "Released when the window closed");
+  assert(!simulator.getVirtualStates().lctrl() && "Ctrl released");
+
+  // Drop rates from rare to frequent; the layer lags up to 31 ms
+  TraceGeneratorOptions generator;
+  generator.strokeCount = 20000;
+  for (double rate : {0.002, 0.01, 0.05}) {
+    SimulationOptions dropping;
+    dropping.layer.dropKeyUpRate = rate;
+    dropping.layer.lagJitterMs = 30;
+    uint64_t stuckNs[2];
+    for (int check = 0; check < 2; ++check) {
+      Simulator run(dropping);
+      run.initialize();
+      run.setReleaseCheck(check == 1 ? 50 : 0);
+      run.run(generateTrace(generator, run.getPhysicalStates()));
+      const SimulationReport &result = run.getReport();
+      assert(result.falseFixes == 0 && "Only lost key-ups are fixed");
+      if (check == 1) {
+        assert(result.releaseCheckFixes == result.droppedKeyUps &&
+               result.stuckEvents == 0 &&
+               "Every lost key-up is caught before the threshold");
+      }
+      stuckNs[check] = result.stuckNs;
+    }
+    assert(stuckNs[1] < stuckNs[0] / 5 && "Stuck time should shrink");
+    std::cout << rate * 100 << "%: " << stuckNs[0] / 1000000 << " -> "
+              << stuckNs[1] / 1000000 << " ms; ";
+  }
+
+  // A window shorter than the layer lag releases keys that were only late
+  SimulationOptions slow;
+  slow.layer.lagMs = 80;
+  Simulator lagging(slow);
+  lagging.initialize();
+  lagging.setReleaseCheck(50);
+  lagging.feed(down(0, kLctrl));
+  lagging.feed(up(100, kLctrl));
+  lagging.advanceTo(ms(500));
+  assert(lagging.getReport().falseFixes == 1 && "Window below the lag");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testLostKeyDownRepair() {
+  std::cout << "Test 9: Lost key-downs are reported and repaired... ";
+
+  SimulationOptions options;
+  options.layer.dropKeyDownRate = 1.0;
+  for (int repair = 0; repair < 2; ++repair) {
+    Simulator simulator(options);
+    simulator.initialize();
+    simulator.setLostKeyDownThreshold(100);
+    simulator.setRepairKeyDown(repair == 1);
+    simulator.feed(down(10, kLctrl));
+    simulator.advanceTo(ms(400));
+    const SimulationReport &report = simulator.getReport();
+    assert(report.droppedKeyDowns == 1 && report.lostKeyDowns == 1 &&
+           report.keyDownRepairs == static_cast<uint64_t>(repair) &&
+           "Reported once");
+    assert(simulator.getVirtualStates().lctrl() == (repair == 1) &&
+           "Registered only when repaired");
+    simulator.feed(up(500, kLctrl));
+    simulator.advanceTo(ms(600));
+    assert(!simulator.getVirtualStates().lctrl() && report.fixes == 0 &&
+           "Released normally");
+    if (repair == 1) {
+      assert(report.missingNs < ms(200) && "Repaired at the threshold");
+    } else {
+      assert(report.missingNs == ms(490) && "Missing until let go");
+    }
+  }
+
+  // Lag below the threshold is never a lost key-down; repairs shorten the
+  // time dropped key-downs go unregistered
+  TraceGeneratorOptions generator;
+  generator.strokeCount = 20000;
+  uint64_t missingNs[3];
+  for (int run = 0; run < 3; ++run) {
+    SimulationOptions dropping;
+    dropping.layer.dropKeyDownRate = run == 0 ? 0.0 : 0.01;
+    dropping.layer.lagJitterMs = 30;
+    Simulator simulator(dropping);
+    simulator.initialize();
+    simulator.setLostKeyDownThreshold(50);
+    simulator.setRepairKeyDown(run != 1);
+    simulator.run(generateTrace(generator, simulator.getPhysicalStates()));
+    const SimulationReport &result = simulator.getReport();
+    assert(result.falseFixes == 0 && result.stuckEvents == 0 &&
+           "Repairs never leave keys stuck");
+    assert(result.lostKeyDowns <= result.droppedKeyDowns &&
+           (run == 1 ? result.keyDownRepairs == 0
+                     : result.keyDownRepairs == result.lostKeyDowns) &&
+           "Only dropped key-downs are reported");
+    missingNs[run] = result.missingNs;
+  }
+  assert(missingNs[0] == 0 && "No drops, nothing missing");
+  assert(missingNs[2] < missingNs[1] && "Missing time should shrink");
+  std::cout << "PASSED (missing " << missingNs[1] / 1000000 << " ms -> "
+            << missingNs[2] / 1000000 << " ms)" << std::endl;
+}
+
+void testAdaptiveThresholdFollowsLagIncrease() {
+  std::cout << "Test 10: A learned threshold rises again after the lag "
+               "grows... ";
+
+  Simulator simulator;
+  simulator.initialize();
+  simulator.setThreshold(1000);
+  AdaptiveThresholdConfig adaptive;
+  adaptive.enabled = true;
+  adaptive.quantile = 0.9;
+  adaptive.marginMs = 100;
+  adaptive.minMs = 300;
+  adaptive.maxMs = 3000;
+  adaptive.minSamples = 20;
+  simulator.setAdaptive(adaptive);
+
+  // Ctrl held for a second, then a letter 600 ms after its release: the
+  // mismatch lasts as long as the layer's lag
+  uint64_t t = 0;
+  auto cycles = [&](int count) {
+    int fixesBefore = simulator.getReport().fixes;
+    for (int i = 0; i < count; ++i, t += 3000) {
+      simulator.feed(down(t, kLctrl));
+      simulator.feed(up(t + 1000, kLctrl));
+      simulator.feed(down(t + 1600, kLetterA));
+      simulator.feed(up(t + 1650, kLetterA));
+    }
+    simulator.advanceTo(ms(t));
+    return simulator.getReport().fixes - fixesBefore;
+  };
+
+  simulator.setLag(50);
+  assert(cycles(100) == 0 && "Short lag needs no fix");
+  const FixLogic &logic = simulator.getLogic();
+  size_t lctrl = 0;
+  assert(logic.getKeyId(lctrl) == "lctrl" && "Default key order");
+  assert(logic.getLearnedThreshold(lctrl) == 300 && "Learned the minimum");
+
+  // Now 800 ms: each mismatch past the learned threshold is fixed (falsely),
+  // and each fix pushes the threshold up until the lag fits under it
+  simulator.setLag(800);
+  int fixes = cycles(300);
+  assert(fixes > 0 && "The old threshold fixes the longer mismatches");
+  int learned = logic.getLearnedThreshold(lctrl);
+  assert(learned >= 800 && learned <= 1000 &&
+         "Recovered to the new lag plus margin");
+  assert(cycles(100) == 0 && "No false fixes once it has recovered");
+
+  std::cout << "PASSED (" << fixes << " false fixes, 300 ms -> " << learned
+            << " ms)" << std::endl;
+}
+
+int main() {
+  std::cout << "=== Simulator Unit Tests ===" << std::endl;
+  std::cout << std::endl;
+
+  try {
+    testNormalTypingNeedsNoFix();
+    testDroppedKeyUpIsFixed();
+    testKeyDownWhileModifierHeldDoesNotFix();
+    testSlowLayerCausesFalseFix();
+    testGeneratedTraceIsDeterministic();
+    testTraceFileReplay();
+    testTimerFixShrinksStuckTime();
+    testReleaseCheckCatchesDroppedKeyUps();
+    testLostKeyDownRepair();
+    testAdaptiveThresholdFollowsLagIncrease();
+
+    std::cout << std::endl;
+    std::cout << "All simulator tests PASSED!" << std::endl;
+    return 0;
+  } catch (const std::exception &e) {
+    std::cerr << std::endl;
+    std::cerr << "Test FAILED with exception: " << e.what() << std::endl;
+    return 1;
+  }
+}
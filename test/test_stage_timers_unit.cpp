@@ -0,0 +1,118 @@
+#include "stage_timers.h"
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+void testStageNames() {
+  std::cout << "Test 1: Every stage has a name... ";
+
+  for (int i = 0; i < kStageCount; ++i) {
+    std::string name = stageName(static_cast<Stage>(i));
+    assert(!name.empty() && name != "unknown" && "Stage name missing");
+  }
+  assert(std::string(stageName(Stage::CheckFix)) == "checkFix" &&
+         "CheckFix name mismatch");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testRecordAggregates() {
+  std::cout << "Test 2: Record aggregates count, total and max... ";
+
+  auto timers = std::make_unique<StageTimers>();
+  timers->record(Stage::Receive, 100);
+  timers->record(Stage::Receive, 300);
+  timers->record(Stage::Receive, 200);
+
+  assert(timers->getCount(Stage::Receive) == 3 && "Count mismatch");
+  assert(timers->getCount(Stage::Forward) == 0 && "Other stage touched");
+  assert(timers->getTotalNs(Stage::Receive) ==
+             CycleClock::toNanoseconds(600) &&
+         "Total mismatch");
+  assert(timers->getMaxNs(Stage::Receive) == CycleClock::toNanoseconds(300) &&
+         "Max mismatch");
+  assert(timers->getHistogram(Stage::Receive).getCount() == 3 &&
+         "Histogram count mismatch");
+  assert(timers->getHistogram(Stage::Receive).getMax() ==
+             CycleClock::toNanoseconds(300) &&
+         "Histogram records ticks and reads back nanoseconds");
+
+  timers->reset();
+  assert(timers->getCount(Stage::Receive) == 0 && "Reset should clear count");
+  assert(timers->getHistogram(Stage::Receive).getCount() == 0 &&
+         "Reset should clear histogram");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testLapChargesConsecutiveStages() {
+  std::cout << "Test 3: Lap charges consecutive stages... ";
+
+  auto timers = std::make_unique<StageTimers>();
+  StageLap lap(*timers);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  lap.lap(Stage::Wait);
+  lap.lap(Stage::Receive);
+  lap.skip();
+  lap.lap(Stage::Forward);
+
+#if ESCMODKEY_STAGE_TIMING
+  assert(timers->getCount(Stage::Wait) == 1 && "Wait not recorded");
+  assert(timers->getCount(Stage::Receive) == 1 && "Receive not recorded");
+  assert(timers->getCount(Stage::Forward) == 1 && "Forward not recorded");
+  assert(timers->getTotalNs(Stage::Wait) >= 4000000 &&
+         "Wait should include the sleep");
+  assert(timers->getTotalNs(Stage::Receive) < 4000000 &&
+         "Receive should not include the sleep");
+#else
+  assert(timers->getCount(Stage::Wait) == 0 && "Timing compiled out");
+#endif
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testDumpAndLogLine() {
+  std::cout << "Test 4: Dump and log line formatting... ";
+
+  auto timers = std::make_unique<StageTimers>();
+  assert(timers->logLine() == "no samples" && "Empty log line mismatch");
+
+  timers->record(Stage::CheckFix, 1000);
+  std::string dump = timers->dump();
+  std::string line = timers->logLine();
+
+  for (int i = 0; i < kStageCount; ++i) {
+    assert(dump.find(stageName(static_cast<Stage>(i))) != std::string::npos &&
+           "Dump missing stage row");
+  }
+  assert(line.find("checkFix=") != std::string::npos &&
+         "Log line missing recorded stage");
+  assert(line.find("wait=") == std::string::npos &&
+         "Log line should skip empty stages");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+int main() {
+  std::cout << "=== Stage Timers Unit Tests ===" << std::endl;
+  std::cout << std::endl;
+
+  try {
+    testStageNames();
+    testRecordAggregates();
+    testLapChargesConsecutiveStages();
+    testDumpAndLogLine();
+
+    std::cout << std::endl;
+    std::cout << "All stage timer tests PASSED!" << std::endl;
+    return 0;
+  } catch (const std::exception &e) {
+    std::cerr << std::endl;
+    std::cerr << "Test FAILED with exception: " << e.what() << std::endl;
+    return 1;
+  }
+}
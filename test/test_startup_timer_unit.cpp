@@ -0,0 +1,96 @@
+#include "clock.h"
+#include "startup_timer.h"
+#include <cassert>
+#include <iostream>
+
+// Tests of the startup phase timer
+
+void testPhases() {
+  std::cout << "Test 1: Phases measure the time since the previous mark... ";
+
+  ManualClock clock;
+  StartupTimer startup(clock);
+  clock.advanceMs(2);
+  startup.mark("config");
+  clock.advanceMs(3);
+  startup.mark("initialize");
+
+  const auto &phases = startup.getPhases();
+  assert(phases.size() == 2 && "One entry per mark");
+  assert(phases[0].name == "config" && phases[0].durationNs == 2000000 &&
+         "First phase runs from start()");
+  assert(phases[1].durationNs == 3000000 &&
+         phases[1].sinceStartNs == 5000000 &&
+         "Second phase runs from the first mark");
+  assert(startup.getTotalNs() == 5000000 && "Total is the last mark");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testTimeToInterception() {
+  std::cout << "Test 2: Time to interception includes pre-start time... ";
+
+  ManualClock clock;
+  StartupTimer startup(clock);
+  startup.setPreStartNs(10000000);
+  clock.advanceMs(4);
+  startup.mark("initialize");
+  assert(startup.getTimeToInterceptionNs() == 0 && "Not live yet");
+
+  clock.advanceMs(1);
+  startup.markInterceptionLive("workerStart");
+  clock.advanceMs(20);
+  startup.mark("trayIcon");
+
+  assert(startup.getTimeToInterceptionNs() == 15000000 &&
+         "Later phases do not count");
+  assert(startup.getTotalNs() == 35000000 && "Total covers every phase");
+
+  std::string summary = startup.summary();
+  assert(summary.find("process 10.00ms") == 0 && "Pre-start time first");
+  assert(summary.find("trayIcon 20.00ms") != std::string::npos &&
+         "Every phase listed");
+  assert(summary.find("interception live at 15.00ms") != std::string::npos &&
+         "Milestone listed");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testRestart() {
+  std::cout << "Test 3: start() clears earlier phases... ";
+
+  ManualClock clock;
+  StartupTimer startup(clock);
+  clock.advanceMs(1);
+  startup.markInterceptionLive("workerStart");
+  clock.advanceMs(5);
+  startup.start();
+  clock.advanceMs(1);
+  startup.mark("config");
+
+  assert(startup.getPhases().size() == 1 && "Old phases dropped");
+  assert(startup.getPhases()[0].durationNs == 1000000 &&
+         "Measured from the new start");
+  assert(startup.getTimeToInterceptionNs() == 0 && "Milestone reset");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+int main() {
+  std::cout << "=== Startup Timer Tests ===" << std::endl;
+  std::cout << std::endl;
+
+  try {
+    testPhases();
+    testTimeToInterception();
+    testRestart();
+
+    std::cout << std::endl;
+    std::cout << "All startup timer tests PASSED!" << std::endl;
+    return 0;
+  } catch (const std::exception &e) {
+    std::cerr << std::endl;
+    std::cerr << "Test FAILED with exception: " << e.what() << std::endl;
+    return 1;
+  }
+}
@@ -0,0 +1,215 @@
+#include "stroke_recorder.h"
+#include "trace_format.h"
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+bool fileExists(const std::string &path) {
+  std::ifstream file(path);
+  return file.good();
+}
+
+std::vector<TraceFormat::KeyInfo> testKeys() {
+  return {{"lctrl", 0x1D, false, 0xA2}, {"rctrl", 0x1D, true, 0xA3}};
+}
+
+void removeSegments(const std::string &base, int count) {
+  for (int i = 1; i <= count; ++i) {
+    std::remove(StrokeRecorder::segmentPath(base, i).c_str());
+  }
+}
+
+void testSegmentPath() {
+  std::cout << "Test 1: Segment file names... ";
+
+  assert(StrokeRecorder::segmentPath("rec", 1) == "rec.000001.emkt" &&
+         "Unexpected segment name");
+  assert(StrokeRecorder::segmentPath("dir/rec", 123456) ==
+             "dir/rec.123456.emkt" &&
+         "Unexpected segment name with directory");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testRoundTrip() {
+  std::cout << "Test 2: Recorded strokes read back unchanged... ";
+
+  const std::string base = "test_recorder_roundtrip";
+  StrokeRecorder recorder;
+  StrokeRecorder::Options options;
+  options.basePath = base + ".emkt"; // Extension is stripped
+  assert(recorder.start(options, testKeys(), 1000) && "Failed to start");
+  assert(recorder.isActive() && "Recorder should be active");
+
+  recorder.recordStroke(1, 0x1D, 0, 0);
+  recorder.recordVirtualState(0x1, 0x1);
+  recorder.recordVirtualState(0x1, 0x0); // Unchanged mask: not recorded
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  recorder.recordStroke(1, 0x1D, 1, 0);
+  recorder.recordTracker(0, TraceFormat::kTrackerMismatchStart, 0);
+  recorder.recordFix(1, 0, 0x1D, 1, 1200);
+  recorder.stop();
+  assert(!recorder.isActive() && "Recorder should be stopped");
+  assert(recorder.getRecordCount() == 5 && "Record count mismatch");
+
+  TraceFormat::TraceFile trace;
+  std::string error;
+  bool ok = TraceFormat::readTraceFile(StrokeRecorder::segmentPath(base, 1),
+                                       trace, &error);
+  assert(ok && "Failed to read segment");
+  assert(trace.header.version == TraceFormat::kVersion && "Version mismatch");
+  assert(trace.header.nanosecondsPerTick == 0 && "Reader converts ticks");
+  assert(trace.header.segmentIndex == 1 && "Segment index mismatch");
+  assert(trace.header.thresholdMs == 1000 && "Threshold mismatch");
+  assert(trace.header.keyCount == 2 && "Key count mismatch");
+  assert(TraceFormat::keyId(trace.header.keys[1]) == "rctrl" &&
+         "Key table mismatch");
+  assert(trace.header.keys[1].needsE0 == 1 && "E0 flag mismatch");
+  assert(trace.records.size() == 5 && "Record count in file mismatch");
+
+  const auto &records = trace.records;
+  assert(records[0].type == TraceFormat::kRecordStroke &&
+         records[0].code == 0x1D && records[0].state == 0 &&
+         "First stroke mismatch");
+  assert(records[1].type == TraceFormat::kRecordVirtualState &&
+         records[1].value == 0x1 && "Virtual state mismatch");
+  assert(records[2].state == 1 && "Key-up stroke mismatch");
+  uint64_t gapNs = records[2].timestampNs - records[1].timestampNs;
+  assert(gapNs >= 20000000 && gapNs < 2000000000 &&
+         "Timestamps converted to nanoseconds");
+  assert(records[3].type == TraceFormat::kRecordTracker &&
+         records[3].state == TraceFormat::kTrackerMismatchStart &&
+         "Tracker record mismatch");
+  assert(records[4].type == TraceFormat::kRecordFix &&
+         records[4].value == 1200 && "Fix record mismatch");
+  for (size_t i = 1; i < records.size(); ++i) {
+    assert(records[i].timestampNs >= records[i - 1].timestampNs &&
+           "Timestamps must be monotonic");
+  }
+
+  // On disk the records keep raw ticks and the header carries the scale
+  TraceFormat::MappedTraceFile mapped;
+  assert(mapped.open(StrokeRecorder::segmentPath(base, 1), &error) &&
+         "Failed to map segment");
+  assert(mapped.header().nanosecondsPerTick ==
+             CycleClock::nanosecondsPerTick() &&
+         "Tick scale in header");
+  assert(TraceFormat::timestampNs(mapped.header(), mapped.records()[4]) ==
+             records[4].timestampNs &&
+         "Mapped timestamps convert like the reader");
+  mapped.close();
+
+  removeSegments(base, 1);
+  std::cout << "PASSED" << std::endl;
+}
+
+void testRotationAndCap() {
+  std::cout << "Test 3: Segments rotate and old ones are deleted... ";
+
+  const std::string base = "test_recorder_rotation";
+  const uint64_t recordsPerSegment = 64;
+  StrokeRecorder recorder;
+  StrokeRecorder::Options options;
+  options.basePath = base;
+  options.segmentBytes = TraceFormat::kHeaderSize +
+                         recordsPerSegment * sizeof(TraceFormat::TraceRecord);
+  options.maxSegments = 3;
+  assert(recorder.start(options, testKeys(), 1000) && "Failed to start");
+
+  // Pause after each full segment so the rotation thread always has a spare
+  // ready, then write one more record to start the last segment
+  const int segmentsToFill = 6;
+  uint32_t sequence = 0;
+  for (int segment = 0; segment < segmentsToFill; ++segment) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    for (uint64_t i = 0; i < recordsPerSegment; ++i) {
+      recorder.recordStroke(1, 0x2A, 0, sequence++);
+    }
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  recorder.recordStroke(1, 0x2A, 0, sequence++);
+  recorder.stop();
+
+  assert(recorder.getDroppedCount() == 0 && "No record should be dropped");
+  assert(recorder.getRecordCount() == sequence && "Record count mismatch");
+
+  // Only the newest maxSegments files remain
+  int newest = segmentsToFill + 1;
+  for (int i = 1; i <= newest; ++i) {
+    bool expected = i > newest - options.maxSegments;
+    assert(fileExists(StrokeRecorder::segmentPath(base, i)) == expected &&
+           "Unexpected set of segment files on disk");
+  }
+  assert(!fileExists(StrokeRecorder::segmentPath(base, newest + 1)) &&
+         "Spare segment should be removed on stop");
+
+  // Finished segments are trimmed to their records and keep strokes ordered
+  TraceFormat::TraceFile trace;
+  bool ok = TraceFormat::readTraceFile(
+      StrokeRecorder::segmentPath(base, newest - 1), trace);
+  assert(ok && "Failed to read rotated segment");
+  assert(trace.records.size() == recordsPerSegment && "Segment not full");
+  assert(trace.header.recordCapacity == recordsPerSegment &&
+         "Finished segment not trimmed");
+  for (size_t i = 1; i < trace.records.size(); ++i) {
+    assert(trace.records[i].information > trace.records[i - 1].information &&
+           "Strokes out of order");
+  }
+
+  removeSegments(base, newest + 1);
+  std::cout << "PASSED" << std::endl;
+}
+
+void testRejectsInvalidFiles() {
+  std::cout << "Test 4: Reader rejects foreign or unsupported files... ";
+
+  const std::string filename = "test_recorder_invalid.emkt";
+  {
+    std::ofstream file(filename, std::ios::binary);
+    std::string junk(2048, 'x');
+    file.write(junk.data(), junk.size());
+  }
+  TraceFormat::TraceFile trace;
+  std::string error;
+  assert(!TraceFormat::readTraceFile(filename, trace, &error) &&
+         "Junk file should be rejected");
+  assert(error.find("magic") != std::string::npos && "Expected magic error");
+
+  TraceFormat::FileHeader header;
+  TraceFormat::initHeader(header, testKeys(), 0, 1, 0, 1000);
+  header.version = TraceFormat::kVersion + 1;
+  assert(TraceFormat::writeTraceFile(filename, header, {}) &&
+         "Failed to write test file");
+  assert(!TraceFormat::readTraceFile(filename, trace, &error) &&
+         "Newer version should be rejected");
+  assert(error.find("version") != std::string::npos &&
+         "Expected version error");
+
+  std::remove(filename.c_str());
+  std::cout << "PASSED" << std::endl;
+}
+
+int main() {
+  std::cout << "=== Stroke Recorder Unit Tests ===" << std::endl;
+  std::cout << std::endl;
+
+  try {
+    testSegmentPath();
+    testRoundTrip();
+    testRotationAndCap();
+    testRejectsInvalidFiles();
+
+    std::cout << std::endl;
+    std::cout << "All stroke recorder tests PASSED!" << std::endl;
+    return 0;
+  } catch (const std::exception &e) {
+    std::cerr << std::endl;
+    std::cerr << "Test FAILED with exception: " << e.what() << std::endl;
+    return 1;
+  }
+}
@@ -0,0 +1,280 @@
+#include "interception.h"
+#include "trace_analysis.h"
+#include "trace_format.h"
+#include "work_stealing_pool.h"
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Tests of the offline trace analysis: work-stealing pool, mapped reader
+// and episode statistics
+
+const uint64_t kMs = 1000000;
+
+std::vector<TraceFormat::KeyInfo> testKeys() {
+  return {{"lctrl", 0x1D, false, 0xA2}, {"rctrl", 0x1D, true, 0xA3}};
+}
+
+TraceFormat::TraceRecord stroke(uint64_t ms, uint16_t code, uint16_t state,
+                                uint8_t device = 1) {
+  TraceFormat::TraceRecord record{};
+  record.timestampNs = ms * kMs;
+  record.type = TraceFormat::kRecordStroke;
+  record.device = device;
+  record.code = code;
+  record.state = state;
+  return record;
+}
+
+TraceFormat::TraceRecord tracker(uint64_t ms, uint8_t keyIndex,
+                                 TraceFormat::TrackerTransition what) {
+  TraceFormat::TraceRecord record{};
+  record.timestampNs = ms * kMs;
+  record.type = TraceFormat::kRecordTracker;
+  record.keyIndex = keyIndex;
+  record.state = what;
+  return record;
+}
+
+TraceFormat::TraceRecord fix(uint64_t ms, uint8_t keyIndex,
+                             uint32_t mismatchMs) {
+  TraceFormat::TraceRecord record{};
+  record.timestampNs = ms * kMs;
+  record.type = TraceFormat::kRecordFix;
+  record.device = 1;
+  record.keyIndex = keyIndex;
+  record.code = 0x1D;
+  record.state = INTERCEPTION_KEY_UP;
+  record.value = mismatchMs;
+  return record;
+}
+
+// lctrl: one episode fixed after 1200ms, one that resolves by itself;
+// rctrl: an episode still open at the end
+std::vector<TraceFormat::TraceRecord> sampleTrace() {
+  return {
+      stroke(0, 0x1D, INTERCEPTION_KEY_DOWN),
+      stroke(30, 0x1D, INTERCEPTION_KEY_DOWN), // Auto-repeat
+      stroke(100, 0x1D, INTERCEPTION_KEY_UP),
+      tracker(105, 0, TraceFormat::kTrackerMismatchStart),
+      tracker(1105, 0, TraceFormat::kTrackerStuck),
+      stroke(1300, 0x1E, INTERCEPTION_KEY_DOWN, 2), // 'A', another keyboard
+      fix(1305, 0, 1200),
+      tracker(1330, 0, TraceFormat::kTrackerReset),
+      stroke(1400, 0x1E, INTERCEPTION_KEY_UP, 2),
+      tracker(2000, 0, TraceFormat::kTrackerMismatchStart),
+      tracker(2040, 0, TraceFormat::kTrackerReset),
+      stroke(3000, 0x1D, INTERCEPTION_KEY_DOWN | INTERCEPTION_KEY_E0),
+      tracker(3100, 1, TraceFormat::kTrackerMismatchStart),
+  };
+}
+
+void testPoolRunsEveryTaskOnce() {
+  std::cout << "Test 1: Pool runs every task exactly once... ";
+
+  WorkStealingPool pool(4);
+  assert(pool.getWorkerCount() == 4 && "Worker count");
+  for (int round = 0; round < 3; ++round) {
+    const size_t count = 1000;
+    std::vector<std::atomic<int>> runs(count);
+    std::atomic<bool> badWorker(false);
+    pool.run(count, [&](size_t index, size_t worker) {
+      if (worker >= pool.getWorkerCount()) {
+        badWorker = true;
+      }
+      // The first tasks are much slower, so their owner falls behind
+      if (index < 10) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+      }
+      runs[index]++;
+    });
+    for (size_t i = 0; i < count; ++i) {
+      assert(runs[i] == 1 && "Each task once");
+    }
+    assert(!badWorker && "Worker index in range");
+  }
+  pool.run(0, [](size_t, size_t) { assert(false && "No tasks"); });
+
+  std::cout << "PASSED (" << pool.getStealCount() << " steals)" << std::endl;
+}
+
+void testMappedFile() {
+  std::cout << "Test 2: Mapped file matches the loaded file... ";
+
+  const std::string path = "test_trace_analysis.emkt";
+  std::vector<TraceFormat::TraceRecord> records = sampleTrace();
+  records.push_back(TraceFormat::TraceRecord()); // Empty slot is trimmed
+  TraceFormat::FileHeader header;
+  TraceFormat::initHeader(header, testKeys(), 0, 1, 0, 1000);
+  assert(TraceFormat::writeTraceFile(path, header, records) && "Written");
+
+  TraceFormat::TraceFile loaded;
+  assert(TraceFormat::readTraceFile(path, loaded) && "Loaded");
+  TraceFormat::MappedTraceFile mapped;
+  std::string error;
+  assert(mapped.open(path, &error) && "Mapped");
+  assert(mapped.recordCount() == loaded.records.size() &&
+         mapped.recordCount() == records.size() - 1 && "Same record count");
+  for (size_t i = 0; i < mapped.recordCount(); ++i) {
+    assert(mapped.records()[i].timestampNs == loaded.records[i].timestampNs &&
+           mapped.records()[i].type == loaded.records[i].type &&
+           "Same records");
+  }
+  assert(mapped.header().thresholdMs == 1000 && "Same header");
+  mapped.close();
+
+  assert(!mapped.open("missing.emkt", &error) && !error.empty() &&
+         "Missing file reported");
+  std::FILE *junk = std::fopen(path.c_str(), "wb");
+  std::fputs("not a trace", junk);
+  std::fclose(junk);
+  assert(!mapped.open(path, &error) && "Short file rejected");
+
+  std::remove(path.c_str());
+  std::cout << "PASSED" << std::endl;
+}
+
+void testEpisodeStatistics() {
+  std::cout << "Test 3: Episodes, fixes, timing and devices... ";
+
+  TraceFormat::FileHeader header;
+  TraceFormat::initHeader(header, testKeys(), 0, 1, 0, 1000);
+  std::vector<TraceFormat::TraceRecord> records = sampleTrace();
+  TraceStats stats;
+  analyzeTrace(header, records.data(), records.size(), stats);
+
+  assert(stats.files == 1 && stats.records == records.size() && "Totals");
+  assert(stats.strokes == 6 && stats.durationNs == 3100 * kMs && "Strokes");
+
+  const KeyTraceStats *lctrl = stats.findKey("lctrl");
+  assert(lctrl && lctrl->presses == 1 && "Auto-repeat is not a press");
+  assert(lctrl->episodes == 2 && lctrl->stuck == 1 && lctrl->fixes == 1 &&
+         lctrl->selfResolved == 1 && "Episode outcomes");
+  assert(lctrl->episodeNs.getCount() == 2 &&
+         lctrl->episodeNs.getMax() == 1225 * kMs && "Episode durations");
+  assert(lctrl->timeToFixNs.getCount() == 1 &&
+         lctrl->timeToFixNs.getMax() == 1200 * kMs && "Time to fix");
+  assert(lctrl->holdNs.getCount() == 1 &&
+         lctrl->holdNs.getMax() == 100 * kMs && "Hold time");
+
+  const KeyTraceStats *rctrl = stats.findKey("rctrl");
+  assert(rctrl && rctrl->presses == 1 && rctrl->episodes == 1 &&
+         "E0 key told apart");
+  assert(stats.openEpisodes == 1 && "Episode open at the end");
+
+  // Presses at 0, 1300 and 3000ms
+  assert(stats.interKeyNs.getCount() == 2 &&
+         stats.interKeyNs.getMax() == 1700 * kMs && "Inter-key gaps");
+  assert(stats.devices[1].strokes == 4 && stats.devices[1].fixes == 1 &&
+         "First keyboard");
+  assert(stats.devices[2].strokes == 2 && stats.devices[2].presses == 1 &&
+         "Second keyboard");
+
+  // Same trace stored as ticks (as the live recorder writes it)
+  TraceFormat::FileHeader tickHeader = header;
+  tickHeader.nanosecondsPerTick = 0.5;
+  std::vector<TraceFormat::TraceRecord> tickRecords = records;
+  for (auto &record : tickRecords) {
+    record.timestampNs *= 2;
+  }
+  TraceStats tickStats;
+  analyzeTrace(tickHeader, tickRecords.data(), tickRecords.size(), tickStats);
+  assert(tickStats.durationNs == stats.durationNs &&
+         tickStats.findKey("lctrl")->episodeNs.getMax() == 1225 * kMs &&
+         tickStats.interKeyNs.getMax() == 1700 * kMs && "Ticks scaled");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testMerge() {
+  std::cout << "Test 4: Files with different key tables merge by ID... ";
+
+  std::vector<TraceFormat::TraceRecord> records = sampleTrace();
+  TraceFormat::FileHeader first;
+  TraceFormat::initHeader(first, testKeys(), 0, 1, 0, 1000);
+  // Same keys in the opposite order: indices differ, IDs don't
+  TraceFormat::FileHeader second;
+  TraceFormat::initHeader(second,
+                          {{"rctrl", 0x1D, true, 0xA3},
+                           {"lctrl", 0x1D, false, 0xA2},
+                           {"capslock", 0x3A, false, 0x14}},
+                          0, 1, 0, 1000);
+
+  TraceStats a;
+  analyzeTrace(first, records.data(), records.size(), a);
+  TraceStats b;
+  analyzeTrace(second, records.data(), records.size(), b);
+  TraceStats overall;
+  overall.merge(a);
+  overall.merge(b);
+
+  assert(overall.files == 2 && overall.keys.size() == 3 && "Keys by ID");
+  const KeyTraceStats *lctrl = overall.findKey("lctrl");
+  const KeyTraceStats *rctrl = overall.findKey("rctrl");
+  // In the second file the tracker records for index 0 belong to rctrl
+  assert(lctrl->presses == 2 && lctrl->episodes == 3 && "lctrl merged");
+  assert(rctrl->presses == 2 && rctrl->episodes == 3 && "rctrl merged");
+  assert(overall.totalFixes() == 2 &&
+         overall.interKeyNs.getCount() == 4 && "Totals merged");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testCollectTraceFiles() {
+  std::cout << "Test 5: Trace files collected from directories... ";
+
+  namespace fs = std::filesystem;
+  fs::path dir = fs::temp_directory_path() / "escModKey_collect";
+  fs::remove_all(dir);
+  fs::create_directories(dir / "nested");
+  for (const char *name : {"b.emkt", "a.emkt", "notes.txt", "nested/c.emkt",
+                           "nested/d.scn"}) {
+    std::ofstream(dir / name) << "x";
+  }
+
+  std::vector<std::string> files;
+  assert(TraceFormat::collectTraceFiles(dir.string(), files) && "Directory");
+  assert(files.size() == 3 && "Only trace files, recursively");
+  assert(files[0] == (dir / "a.emkt").string() &&
+         files[1] == (dir / "b.emkt").string() &&
+         files[2] == (dir / "nested" / "c.emkt").string() && "Sorted");
+
+  files.clear();
+  assert(TraceFormat::collectTraceFiles(dir.string(), files, ".scn") &&
+         files.size() == 1 && "Other extension");
+  assert(TraceFormat::collectTraceFiles((dir / "notes.txt").string(),
+                                        files) &&
+         files.size() == 2 && "Named files taken as they are");
+  assert(!TraceFormat::collectTraceFiles((dir / "missing").string(), files) &&
+         files.size() == 2 && "Missing path rejected");
+
+  fs::remove_all(dir);
+  std::cout << "PASSED" << std::endl;
+}
+
+int main() {
+  std::cout << "=== Trace Analysis Tests ===" << std::endl;
+  std::cout << std::endl;
+
+  try {
+    testPoolRunsEveryTaskOnce();
+    testMappedFile();
+    testEpisodeStatistics();
+    testMerge();
+    testCollectTraceFiles();
+
+    std::cout << std::endl;
+    std::cout << "All trace analysis tests PASSED!" << std::endl;
+    return 0;
+  } catch (const std::exception &e) {
+    std::cerr << std::endl;
+    std::cerr << "Test FAILED with exception: " << e.what() << std::endl;
+    return 1;
+  }
+}
@@ -0,0 +1,157 @@
+#include "simulator.h"
+#include "stroke_recorder.h"
+#include "trace_format.h"
+#include "trace_replay.h"
+#include <cassert>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Tests of the headless trace replay used for profile-guided optimisation
+
+namespace fs = std::filesystem;
+
+// A generated trace written as a recording would be
+std::string writeTrace(const fs::path &dir, const char *name, uint64_t seed,
+                       uint64_t strokeCount, size_t &written) {
+  ModifierKeyStates keys;
+  TraceGeneratorOptions generator;
+  generator.seed = seed;
+  generator.strokeCount = strokeCount;
+  std::vector<SimStroke> strokes = generateTrace(generator, keys);
+  written = strokes.size();
+
+  std::vector<TraceFormat::KeyInfo> keyInfo;
+  for (const auto &key : keys.getKeys()) {
+    keyInfo.push_back({key.id, key.scanCode, key.needsE0, 0});
+  }
+  TraceFormat::FileHeader header;
+  TraceFormat::initHeader(header, keyInfo, 0, 1, 0, 1000);
+  std::string path = (dir / name).string();
+  std::string error;
+  assert(TraceFormat::writeTraceFile(path, header, strokesToRecords(strokes),
+                                     &error) &&
+         "Trace written");
+  return path;
+}
+
+void testReplayDirectory() {
+  std::cout << "Test 1: A directory replays every trace in it... ";
+
+  fs::path dir = fs::temp_directory_path() / "escModKey_replay_test";
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+  size_t first = 0;
+  size_t second = 0;
+  std::string a = writeTrace(dir, "a.emkt", 1, 20000, first);
+  writeTrace(dir, "b.emkt", 2, 20000, second);
+  std::ofstream(dir / "notes.txt") << "not a trace";
+
+  ReplayOptions options;
+  options.paths = {dir.string()};
+  options.passes = 3;
+  options.dropKeyUpRate = 0.01;
+  ReplayResult result;
+  std::string error;
+  assert(replayTraces(options, result, error) && "Replay succeeds");
+  assert(result.strokes == first + second && "Both traces, once per pass");
+  assert(result.fixes > 0 && "Lost key-ups lead to fixes");
+  assert(result.minNsPerStroke > 0 &&
+         result.minNsPerStroke <= result.medianNsPerStroke &&
+         "Timing recorded");
+
+  // The same drops every pass and every run
+  ReplayResult again;
+  assert(replayTraces(options, again, error) && "Replay succeeds again");
+  assert(again.fixes == result.fixes && "Replay is deterministic");
+
+  options.paths = {a};
+  options.passes = 1;
+  assert(replayTraces(options, result, error) && "A single file replays");
+  assert(result.strokes == first && "Only that trace");
+
+  fs::remove_all(dir);
+  std::cout << "PASSED" << std::endl;
+}
+
+void testErrors() {
+  std::cout << "Test 2: Missing traces are reported... ";
+
+  fs::path dir = fs::temp_directory_path() / "escModKey_replay_empty";
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+
+  ReplayOptions options;
+  ReplayResult result;
+  std::string error;
+  options.paths = {dir.string()};
+  assert(!replayTraces(options, result, error) && "Empty directory fails");
+  assert(error == "no trace files" && "Reason given");
+
+  options.paths = {(dir / "missing.emkt").string()};
+  assert(!replayTraces(options, result, error) && "Missing file fails");
+  assert(error.find("missing.emkt") != std::string::npos &&
+         "File named in the error");
+
+  fs::remove_all(dir);
+  std::cout << "PASSED" << std::endl;
+}
+
+void testReplayRunsProductionLoop() {
+  std::cout << "Test 3: Strokes go through the shipped event loop... ";
+
+  fs::path dir = fs::temp_directory_path() / "escModKey_replay_sink";
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+  size_t written = 0;
+  std::string trace = writeTrace(dir, "a.emkt", 3, 5000, written);
+
+  // The recorder is fed by FixerSink, which only the production loop has
+  std::string base = (dir / "replayed").string();
+  std::ofstream(dir / "config.toml")
+      << "[advanced]\nrecordFile = '" << base << "'\n";
+
+  ReplayOptions options;
+  options.paths = {trace};
+  options.configPath = (dir / "config.toml").string();
+  options.dropKeyUpRate = 0;
+  ReplayResult result;
+  std::string error;
+  assert(replayTraces(options, result, error) && "Replay succeeds");
+  assert(result.strokes == written && result.fixes == 0 &&
+         "Nothing lost, nothing fixed");
+
+  TraceFormat::TraceFile recorded;
+  assert(TraceFormat::readTraceFile(StrokeRecorder::segmentPath(base, 1),
+                                    recorded, &error) &&
+         "Replay recorded");
+  size_t strokes = 0;
+  for (const auto &record : recorded.records) {
+    strokes += record.type == TraceFormat::kRecordStroke;
+  }
+  assert(strokes == written && "Every stroke received by the fixer");
+
+  fs::remove_all(dir);
+  std::cout << "PASSED" << std::endl;
+}
+
+int main() {
+  std::cout << "=== Trace Replay Tests ===" << std::endl;
+  std::cout << std::endl;
+
+  try {
+    testReplayDirectory();
+    testErrors();
+    testReplayRunsProductionLoop();
+
+    std::cout << std::endl;
+    std::cout << "All trace replay tests PASSED!" << std::endl;
+    return 0;
+  } catch (const std::exception &e) {
+    std::cerr << std::endl;
+    std::cerr << "Test FAILED with exception: " << e.what() << std::endl;
+    return 1;
+  }
+}
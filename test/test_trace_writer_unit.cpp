@@ -0,0 +1,169 @@
+#include "trace_writer.h"
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+std::string readFile(const std::string &filename) {
+  std::ifstream file(filename);
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  return buffer.str();
+}
+
+size_t countOccurrences(const std::string &text, const std::string &needle) {
+  size_t count = 0;
+  for (size_t pos = text.find(needle); pos != std::string::npos;
+       pos = text.find(needle, pos + needle.size())) {
+    count++;
+  }
+  return count;
+}
+
+void testDisabledByDefault() {
+  std::cout << "Test 1: Tracing is disabled by default... ";
+
+  assert(!Trace::enabled() && "Tracing should start disabled");
+  // Emitting while disabled is a no-op
+  Trace::instant("ignored");
+  assert(TraceWriter::instance().getWrittenCount() == 0 &&
+         "Nothing should be written while disabled");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testWritesChromeTraceDocument() {
+  std::cout << "Test 2: Writes a Chrome trace-event document... ";
+
+  const std::string filename = "test_trace_1.json";
+  TraceWriter &writer = TraceWriter::instance();
+  bool started = writer.start(filename);
+  assert(started && "Failed to start trace");
+  assert(!writer.start(filename) && "Second start should be rejected");
+  assert(Trace::enabled() && "Tracing should be enabled");
+
+  {
+    Trace::Span span("outer");
+    uint64_t start = CycleClock::now();
+    Trace::complete("inner", start, CycleClock::now());
+    Trace::instant("strokeReceived", "scanCode", 0x1D, "down");
+    Trace::instant("fixInjected", nullptr, 0, "lctrl");
+  }
+  writer.stop();
+  assert(!Trace::enabled() && "Tracing should be disabled after stop");
+
+  std::string text = readFile(filename);
+  assert(text.find("{\"displayTimeUnit\"") == 0 && "Missing document header");
+  assert(text.rfind("]}") != std::string::npos && "Missing document footer");
+  assert(text.find("\"name\":\"outer\",\"ph\":\"X\"") != std::string::npos &&
+         "Missing span");
+  assert(text.find("\"name\":\"inner\",\"ph\":\"X\"") != std::string::npos &&
+         "Missing complete event");
+  assert(text.find("\"scanCode\":29,\"detail\":\"down\"") !=
+             std::string::npos &&
+         "Missing instant args");
+  assert(text.find("\"detail\":\"lctrl\"") != std::string::npos &&
+         "Missing detail-only args");
+  assert(writer.getWrittenCount() == 4 && "Written count mismatch");
+
+  std::remove(filename.c_str());
+  std::cout << "PASSED" << std::endl;
+}
+
+void testMultipleProducerThreads() {
+  std::cout << "Test 3: Events from several threads are all accounted... ";
+
+  const std::string filename = "test_trace_2.json";
+  TraceWriter &writer = TraceWriter::instance();
+  bool started = writer.start(filename);
+  assert(started && "Failed to restart trace");
+
+  const int threads = 4;
+  const int eventsPerThread = 20000;
+  std::vector<std::thread> producers;
+  for (int t = 0; t < threads; ++t) {
+    producers.emplace_back([]() {
+      for (int i = 0; i < eventsPerThread; ++i) {
+        Trace::instant("tick", "i", i);
+      }
+    });
+  }
+  for (auto &producer : producers) {
+    producer.join();
+  }
+  writer.stop();
+
+  uint64_t total = writer.getWrittenCount() + writer.getDroppedCount();
+  assert(total == static_cast<uint64_t>(threads * eventsPerThread) &&
+         "Every event should be written or counted as dropped");
+
+  std::string text = readFile(filename);
+  assert(countOccurrences(text, "\"name\":\"tick\"") ==
+             writer.getWrittenCount() &&
+         "File event count mismatch");
+
+  std::remove(filename.c_str());
+  std::cout << "PASSED (" << writer.getDroppedCount() << " dropped)"
+            << std::endl;
+}
+
+// Value of a numeric field following the first event with the given name
+double eventField(const std::string &text, const std::string &name,
+                  const std::string &field) {
+  size_t event = text.find("\"name\":\"" + name + "\"");
+  assert(event != std::string::npos && "Missing event");
+  size_t pos = text.find("\"" + field + "\":", event);
+  assert(pos != std::string::npos && "Missing field");
+  return std::strtod(text.c_str() + pos + field.size() + 3, nullptr);
+}
+
+void testSpanBegunBeforeStart() {
+  std::cout << "Test 4: A span begun before start() is clipped... ";
+
+  const std::string filename = "test_trace_3.json";
+  TraceWriter &writer = TraceWriter::instance();
+  // As the first wait lap of an event loop started before tracing
+  uint64_t begun = CycleClock::now();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  bool started = writer.start(filename);
+  assert(started && "Failed to restart trace");
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  Trace::complete("wait", begun, CycleClock::now());
+  writer.stop();
+
+  std::string text = readFile(filename);
+  double ts = eventField(text, "wait", "ts");
+  double dur = eventField(text, "wait", "dur");
+  assert(ts == 0.0 && "Starts at the trace origin");
+  assert(dur >= 4000.0 && dur < 100000.0 &&
+         "Only the part after start() is kept");
+
+  std::remove(filename.c_str());
+  std::cout << "PASSED" << std::endl;
+}
+
+int main() {
+  std::cout << "=== Trace Writer Unit Tests ===" << std::endl;
+  std::cout << std::endl;
+
+  try {
+    testDisabledByDefault();
+    testWritesChromeTraceDocument();
+    testMultipleProducerThreads();
+    testSpanBegunBeforeStart();
+
+    std::cout << std::endl;
+    std::cout << "All trace writer tests PASSED!" << std::endl;
+    return 0;
+  } catch (const std::exception &e) {
+    std::cerr << std::endl;
+    std::cerr << "Test FAILED with exception: " << e.what() << std::endl;
+    return 1;
+  }
+}
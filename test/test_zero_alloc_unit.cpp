@@ -0,0 +1,329 @@
+#include "clock.h"
+#include "config.h"
+#include "fake_interception.h"
+#include "fake_win32.h"
+#include "load_generator.h"
+#include "logger.h"
+#include "modifier_key_fixer.h"
+#include "trace_writer.h"
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <new>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Steady-state allocation guarantee of the event loop (headless builds
+// only). This binary replaces the global allocator with one that counts
+// calls made by the test thread while counting is switched on; after
+// initialization and a warm-up, processEvents() must not allocate, whether
+// it forwards, fixes, maps, records, dumps the flight recorder, traces or
+// logs.
+
+namespace {
+
+// Per thread: the trace writer thread may allocate while it formats JSON
+thread_local bool counting = false;
+std::atomic<uint64_t> allocations(0);
+
+void *countedAlloc(std::size_t size) {
+  if (counting) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+  void *p = std::malloc(size ? size : 1);
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+} // namespace
+
+void *operator new(std::size_t size) { return countedAlloc(size); }
+void *operator new[](std::size_t size) { return countedAlloc(size); }
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  try {
+    return countedAlloc(size);
+  } catch (...) {
+    return nullptr;
+  }
+}
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  try {
+    return countedAlloc(size);
+  } catch (...) {
+    return nullptr;
+  }
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+
+const InterceptionDevice kKeyboard = INTERCEPTION_KEYBOARD(0);
+
+// Discards console output while still running the formatting
+class NullBuffer : public std::streambuf {
+protected:
+  int overflow(int c) override { return c; }
+};
+
+void resetFakes() {
+  FakeInterception::reset();
+  FakeWin32::reset();
+  FakeInterception::setWaitBlocks(false);
+  FakeInterception::setCaptureSent(false);
+  FakeWin32::setSleepEnabled(false);
+}
+
+// Modifier-heavy typing; every 40th modifier release is lost on the way to
+// the OS, so keys get stuck and are fixed throughout the trace
+std::vector<InterceptionKeyStroke> makeTrace(size_t count, uint64_t seed) {
+  LoadOptions options;
+  options.profile = LoadProfile::Modifiers;
+  options.strokeCount = count;
+  options.rate = 0;
+  options.seed = seed;
+  std::vector<InterceptionKeyStroke> trace;
+  trace.reserve(count);
+  for (const LoadStroke &s : generateLoad(options)) {
+    trace.push_back(s.stroke);
+  }
+  return trace;
+}
+
+void dropSomeReleases() {
+  auto released = std::make_shared<uint64_t>(0);
+  FakeInterception::setDeliveryFilter(
+      [released](InterceptionDevice, const InterceptionKeyStroke &stroke) {
+        bool modifier = stroke.code == 0x1D || stroke.code == 0x2A ||
+                        stroke.code == 0x36 || stroke.code == 0x38;
+        if (!modifier || !(stroke.state & INTERCEPTION_KEY_UP) ||
+            stroke.information == 0) {
+          return true;
+        }
+        return ++*released % 40 != 0;
+      });
+}
+
+// Feed the trace one stroke per iteration, 30ms apart; returns the
+// allocations made by processEvents() over the whole trace
+uint64_t countAllocations(ModifierKeyFixer &fixer, ManualClock &clock,
+                          const std::vector<InterceptionKeyStroke> &trace) {
+  FakeInterception::pushKeyStrokes(kKeyboard, trace);
+  allocations = 0;
+  counting = true;
+  for (size_t i = 0; i < trace.size(); ++i) {
+    clock.advanceMs(30);
+    fixer.processEvents(0);
+  }
+  counting = false;
+  assert(FakeInterception::getPendingCount() == 0 && "Trace consumed");
+  return allocations;
+}
+
+void testCounterWorks() {
+  std::cout << "Test 1: Counting allocator sees heap allocations... ";
+
+  allocations = 0;
+  counting = true;
+  std::vector<int> *v = new std::vector<int>(100);
+  std::string *s = new std::string(64, 'x');
+  counting = false;
+  delete v;
+  delete s;
+  assert(allocations == 4 && "Two objects and their buffers");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testDefaultKeys() {
+  std::cout << "Test 2: Default keys, forwarding and fixes... ";
+  resetFakes();
+  dropSomeReleases();
+
+  ManualClock clock;
+  ModifierKeyFixer fixer(clock);
+  assert(fixer.initialize() && "Fake driver should create a context");
+  fixer.setShowMessages(false);
+
+  // Warm-up covers one-time work (first fix, lazily built buffers)
+  countAllocations(fixer, clock, makeTrace(5000, 1));
+  int warmupFixes = fixer.getStatistics().getTotalFixes();
+  assert(warmupFixes > 0 && "Warm-up trace exercises the fix path");
+
+  uint64_t count = countAllocations(fixer, clock, makeTrace(200000, 2));
+  int fixes = fixer.getStatistics().getTotalFixes() - warmupFixes;
+  assert(fixes > 0 && "Measured trace exercises the fix path");
+  if (count != 0) {
+    std::cerr << count << " allocation(s) in 200000 strokes" << std::endl;
+  }
+  assert(count == 0 && "processEvents() must not allocate");
+
+  std::cout << "PASSED (" << fixes << " fixes)" << std::endl;
+}
+
+void testConfiguredKeysAndRecording() {
+  std::cout << "Test 3: Custom keys, mappings, recording, dumps and shadow "
+               "policies... ";
+  resetFakes();
+  dropSomeReleases();
+
+  std::string recordPath =
+      (std::filesystem::temp_directory_path() / "escModKey_zero_alloc.emkt")
+          .string();
+  Config config;
+  config.loadDefaults();
+  config.setShowMessages(false);
+  config.setCustomKeys({CustomKeyConfig(0x3A, false, "Caps Lock", 0x14)});
+  config.setKeyMappings({KeyMappingConfig(0x3A, false, "lctrl")});
+  config.setRecordFile(recordPath);
+  std::filesystem::path dumpDir =
+      std::filesystem::temp_directory_path() / "escModKey_zero_alloc_dumps";
+  std::filesystem::remove_all(dumpDir);
+  config.setFlightRecorderDir(dumpDir.string());
+  config.setShadowPolicies({"500", "2000:any"});
+
+  ManualClock clock;
+  ModifierKeyFixer fixer(clock);
+  assert(fixer.initialize(config) && "Fake driver should create a context");
+  assert(fixer.getRecorder().isActive() && "Recording started");
+  assert(fixer.getFlightRecorder().isActive() && "Flight recorder started");
+  assert(fixer.getShadowEvaluator().isActive() && "Shadow policies started");
+
+  std::vector<InterceptionKeyStroke> trace = makeTrace(100000, 3);
+  for (size_t i = 0; i < trace.size(); i += 50) {
+    // Caps Lock taps exercise the custom key and the mapping
+    trace[i] = {0x3A, static_cast<unsigned short>(
+                          (i / 50) % 2 ? INTERCEPTION_KEY_UP
+                                       : INTERCEPTION_KEY_DOWN),
+                0};
+  }
+
+  // Dump file names are logged at info level
+  Logger::instance().setLevel(LogLevel::Warning);
+  countAllocations(fixer, clock, makeTrace(5000, 4));
+  fixer.requestFlightDump();
+  uint64_t count = countAllocations(fixer, clock, trace);
+  if (count != 0) {
+    std::cerr << count << " allocation(s) in 100000 strokes" << std::endl;
+  }
+  assert(count == 0 && "processEvents() must not allocate");
+
+  fixer.cleanup();
+  Logger::instance().setLevel(LogLevel::Info);
+  assert(fixer.getFlightRecorder().getDumpCount() > 0 && "Fixes dumped");
+  std::vector<ShadowResult> shadows =
+      fixer.getShadowEvaluator().getResults();
+  assert(shadows.size() == 2 && shadows[0].wouldFix > 0 &&
+         "Shadow policies evaluated");
+  std::filesystem::remove_all(dumpDir);
+  for (const auto &entry : std::filesystem::directory_iterator(
+           std::filesystem::temp_directory_path())) {
+    if (entry.path().filename().string().rfind("escModKey_zero_alloc", 0) ==
+        0) {
+      std::filesystem::remove(entry.path());
+    }
+  }
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testDiagnostics() {
+  std::cout << "Test 4: Console messages, stage log and tracing... ";
+  resetFakes();
+  dropSomeReleases();
+
+  std::string tracePath =
+      (std::filesystem::temp_directory_path() / "escModKey_zero_alloc.json")
+          .string();
+  assert(TraceWriter::instance().start(tracePath) && "Tracing started");
+
+  // Messages are formatted but discarded
+  NullBuffer discard;
+  std::streambuf *console = std::cout.rdbuf(&discard);
+  ManualClock clock;
+  ModifierKeyFixer fixer(clock);
+  assert(fixer.initialize() && "Fake driver should create a context");
+  fixer.setShowMessages(true);
+  fixer.setStageLogInterval(1000);
+
+  countAllocations(fixer, clock, makeTrace(5000, 5));
+  uint64_t count = countAllocations(fixer, clock, makeTrace(50000, 6));
+  std::cout.rdbuf(console);
+
+  TraceWriter::instance().stop();
+  std::filesystem::remove(tracePath);
+  if (count != 0) {
+    std::cerr << count << " allocation(s) in 50000 strokes" << std::endl;
+  }
+  assert(count == 0 && "processEvents() must not allocate");
+  assert(TraceWriter::instance().getWrittenCount() > 0 && "Events traced");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+void testDebugLogging() {
+  std::cout << "Test 5: Debug logging to a file... ";
+  resetFakes();
+  dropSomeReleases();
+
+  std::string logPath =
+      (std::filesystem::temp_directory_path() / "escModKey_zero_alloc.log")
+          .string();
+  Logger::Options options;
+  options.console = false;
+  options.filePath = logPath;
+  options.level = LogLevel::Debug;
+  assert(Logger::instance().start(options) && "Logger started");
+
+  ManualClock clock;
+  ModifierKeyFixer fixer(clock);
+  assert(fixer.initialize() && "Fake driver should create a context");
+  fixer.setShowMessages(true);
+
+  countAllocations(fixer, clock, makeTrace(1000, 7));
+  // Within one ring's worth per drain interval
+  uint64_t count = 0;
+  for (uint64_t seed = 8; seed < 28; ++seed) {
+    count += countAllocations(fixer, clock, makeTrace(500, seed));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  Logger::instance().stop();
+
+  uint64_t written = Logger::instance().getWrittenCount();
+  std::filesystem::remove(logPath);
+  if (count != 0) {
+    std::cerr << count << " allocation(s) in 10000 strokes" << std::endl;
+  }
+  assert(count == 0 && "processEvents() must not allocate");
+  assert(written > 10000 && "Every stroke logged");
+
+  std::cout << "PASSED" << std::endl;
+}
+
+int main() {
+  std::cout << "=== Zero Allocation Tests ===" << std::endl;
+  std::cout << std::endl;
+
+  try {
+    testCounterWorks();
+    testDefaultKeys();
+    testConfiguredKeysAndRecording();
+    testDiagnostics();
+    testDebugLogging();
+
+    std::cout << std::endl;
+    std::cout << "All zero allocation tests PASSED!" << std::endl;
+    return 0;
+  } catch (const std::exception &e) {
+    std::cerr << std::endl;
+    std::cerr << "Test FAILED with exception: " << e.what() << std::endl;
+    return 1;
+  }
+}
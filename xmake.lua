@@ -9,12 +9,122 @@ set_languages("c++17")
 -- 添加头文件目录
 add_includedirs("include")
 
+-- 按键转发延迟统计（关闭后热路径不再打时间戳）
+option("latency_stats")
+    set_default(true)
+    set_showmenu(true)
+    set_description("Record per-stroke forwarding latency histogram")
+option_end()
+
+if not has_config("latency_stats") then
+    add_defines("ESCMODKEY_LATENCY_STATS=0")
+end
+
+-- 热路径各阶段耗时统计
+option("stage_timing")
+    set_default(true)
+    set_showmenu(true)
+    set_description("Record per-stage processEvents timing counters")
+option_end()
+
+if not has_config("stage_timing") then
+    add_defines("ESCMODKEY_STAGE_TIMING=0")
+end
+
+-- 配置文件引导优化（PGO）阶段，与 LTO 一起用于 escModKey/escModKey_gui。
+-- 两个阶段都在 release 模式下构建，目标文件路径相同，GCC 的 .gcda 才能对应上。
+-- 通常不直接设置，而是运行 xmake pgo（见文件末尾）
+option("pgo")
+    set_default("off")
+    set_showmenu(true)
+    set_values("off", "instrument", "optimize")
+    set_description("Profile-guided optimization phase (run xmake pgo)")
+option_end()
+
+rule("pgo")
+    on_config(function (target)
+        local phase = get_config("pgo")
+        if not phase or phase == "off" then
+            return
+        end
+        target:set("policy", "build.optimization.lto", true)
+        local dir = path.join(os.projectdir(), "build", "pgo")
+        if target:has_tool("cxx", "cl") then
+            -- MSVC：每个可执行文件一个 .pgd，.pgc 写入 VCPROFILE_PATH
+            local pgd = path.join(dir, target:name() .. ".pgd")
+            if phase == "instrument" then
+                target:add("ldflags", "/GENPROFILE:PGD=" .. pgd, {force = true})
+            else
+                target:add("ldflags", "/USEPROFILE:PGD=" .. pgd, {force = true})
+            end
+        elseif target:has_tool("cxx", "clang", "clangxx") then
+            -- LLVM：训练时按 LLVM_PROFILE_FILE 写 .profraw，合并为 .profdata
+            local profdata = path.join(dir, target:name() .. ".profdata")
+            if phase == "instrument" then
+                target:add("cxflags", "-fprofile-instr-generate", {force = true})
+                target:add("ldflags", "-fprofile-instr-generate", {force = true})
+            else
+                target:add("cxflags", "-fprofile-instr-use=" .. profdata,
+                           {force = true})
+            end
+        else
+            -- GCC/MinGW：.gcda 按目标文件路径存放在 build/pgo 下
+            if phase == "instrument" then
+                target:add("cxflags", "-fprofile-generate=" .. dir,
+                           "-fprofile-update=atomic", {force = true})
+                target:add("ldflags", "-fprofile-generate=" .. dir, {force = true})
+            else
+                target:add("cxflags", "-fprofile-use=" .. dir,
+                           "-fprofile-correction", {force = true})
+            end
+        end
+    end)
+rule_end()
+
+-- Windows 平台链接 Win32 系统库；其他平台（无头 Linux 构建）使用 shim/ 中的替身
+local function add_win32_deps()
+    if is_plat("windows", "mingw") then
+        add_syslinks("user32", "shell32")
+    else
+        add_deps("fake_interception")
+    end
+end
+
+-- Interception 驱动（运行时需要 interception.dll）；其他平台使用 shim/ 中的假驱动
+local function add_interception_deps()
+    add_win32_deps()
+    if is_plat("windows", "mingw") then
+        add_linkdirs("lib")
+        add_links("interception")
+        after_build(function (target)
+            os.cp("lib/interception.dll", path.directory(target:targetfile()))
+        end)
+    end
+end
+
+-- 非 Windows 平台：内存中的假 Interception 驱动和 Win32 替身（测试、基准）
+if not is_plat("windows", "mingw") then
+target("fake_interception")
+    set_kind("static")
+    add_files("shim/src/fake_interception.cpp", "shim/src/fake_win32.cpp")
+    add_includedirs("shim/include", {public = true})
+    add_syslinks("pthread", {public = true})
+target_end()
+end
+
 -- 主程序（控制台版本）
+if is_plat("windows", "mingw") then
 target("escModKey")
     set_kind("binary")
+    add_rules("pgo")
     add_files("src/main.cpp", "src/physical_key_detector.cpp", 
               "src/virtual_key_detector.cpp", "src/modifier_key_fixer.cpp",
-              "src/config.cpp")
+              "src/fix_logic.cpp", "src/config.cpp", "src/latency_histogram.cpp",
+              "src/logger.cpp", "src/stage_timers.cpp", "src/trace_writer.cpp",
+              "src/trace_format.cpp", "src/stroke_recorder.cpp",
+              "src/flight_recorder.cpp",
+              "src/shadow_policy.cpp",
+              "src/trace_replay.cpp", "src/quantile_estimator.cpp")
     add_linkdirs("lib")
     add_links("interception")
     add_syslinks("user32", "shell32")
@@ -31,9 +141,16 @@ target("escModKey")
 target("escModKey_gui")
     set_kind("binary")
     set_targetdir("$(builddir)/$(plat)/$(arch)/$(mode)")
+    add_rules("pgo")
     add_files("src/main_gui.cpp", "src/physical_key_detector.cpp", 
               "src/virtual_key_detector.cpp", "src/modifier_key_fixer.cpp",
-              "src/config.cpp")
+              "src/fix_logic.cpp", "src/config.cpp", "src/latency_histogram.cpp",
+              "src/logger.cpp", "src/stage_timers.cpp", "src/trace_writer.cpp",
+              "src/trace_format.cpp", "src/stroke_recorder.cpp",
+              "src/flight_recorder.cpp",
+              "src/shadow_policy.cpp",
+              "src/startup_timer.cpp", "src/trace_replay.cpp",
+              "src/quantile_estimator.cpp")
     add_files("resources/app.rc")
     add_includedirs("resources")
     add_linkdirs("lib")
@@ -48,97 +165,479 @@ target("escModKey_gui")
             os.cp("config.toml", target_dir)
         end
     end)
+target_end()
+end
+
+-- 虚拟时间仿真器（无驱动，回放/生成按键序列）
+target("escModKey_sim")
+    set_kind("binary")
+    add_files("src/main_sim.cpp", "src/simulator.cpp", "src/fix_logic.cpp",
+              "src/physical_key_detector.cpp", "src/virtual_key_detector.cpp",
+              "src/config.cpp", "src/logger.cpp", "src/latency_histogram.cpp",
+              "src/trace_format.cpp",
+              "src/quantile_estimator.cpp")
+    add_win32_deps()
+
+-- 离线分析按键记录：内存映射 .emkt 文件，工作窃取线程池并行统计
+target("escModKey_analyze")
+    set_kind("binary")
+    add_files("src/main_analyze.cpp", "src/trace_analysis.cpp",
+              "src/work_stealing_pool.cpp", "src/trace_format.cpp",
+              "src/latency_histogram.cpp")
+
+-- 修复策略参数扫描：在记录语料上并行回放阈值、触发规则与按键阈值的组合
+target("escModKey_sweep")
+    set_kind("binary")
+    add_files("src/main_sweep.cpp", "src/policy_sweep.cpp",
+              "src/work_stealing_pool.cpp", "src/simulator.cpp",
+              "src/fix_logic.cpp", "src/physical_key_detector.cpp",
+              "src/virtual_key_detector.cpp", "src/config.cpp", "src/logger.cpp",
+              "src/latency_histogram.cpp", "src/trace_format.cpp",
+              "src/quantile_estimator.cpp")
+    add_win32_deps()
+
+-- 差分测试：当前检测与修复逻辑对照冻结的参考实现，分歧缩减为最小用例
+target("escModKey_diff")
+    set_kind("binary")
+    add_files("src/main_diff.cpp", "src/differential.cpp",
+              "src/reference_fixer.cpp", "src/work_stealing_pool.cpp",
+              "src/simulator.cpp", "src/fix_logic.cpp",
+              "src/physical_key_detector.cpp", "src/virtual_key_detector.cpp",
+              "src/config.cpp", "src/logger.cpp", "src/latency_histogram.cpp",
+              "src/trace_format.cpp",
+              "src/quantile_estimator.cpp")
+    add_win32_deps()
+
+-- 场景脚本：在虚拟时间下运行 .scn 场景文件（回归测试，见 scenarios/）
+target("escModKey_scenario")
+    set_kind("binary")
+    add_files("src/main_scenario.cpp", "src/scenario.cpp",
+              "src/trace_format.cpp", "src/work_stealing_pool.cpp",
+              "src/fix_logic.cpp", "src/physical_key_detector.cpp",
+              "src/virtual_key_detector.cpp", "src/config.cpp",
+              "src/logger.cpp", "src/latency_histogram.cpp",
+              "src/quantile_estimator.cpp")
+    add_win32_deps()
 
+-- 合成负载生成器：在假驱动上压测 processEvents（仅非 Windows 平台）
+if not is_plat("windows", "mingw") then
+target("escModKey_load")
+    set_kind("binary")
+    add_files("src/main_load.cpp", "src/load_generator.cpp",
+              "src/modifier_key_fixer.cpp",
+              "src/fix_logic.cpp", "src/physical_key_detector.cpp",
+              "src/virtual_key_detector.cpp", "src/config.cpp", "src/logger.cpp",
+              "src/latency_histogram.cpp", "src/stage_timers.cpp",
+              "src/trace_writer.cpp", "src/trace_format.cpp",
+              "src/stroke_recorder.cpp",
+              "src/flight_recorder.cpp", "src/shadow_policy.cpp",
+              "src/quantile_estimator.cpp")
+    add_deps("fake_interception")
+target_end()
+end
+
+-- 交互式检测器测试需要真实键盘，仅 Windows
+if is_plat("windows", "mingw") then
 -- 测试：物理按键检测器
 target("test_physical_unit")
     set_kind("binary")
     add_files("test/test_physical_unit.cpp", "src/physical_key_detector.cpp")
-    add_linkdirs("lib")
-    add_links("interception")
-    add_syslinks("user32")
-    after_build(function (target)
-        os.cp("lib/interception.dll", path.directory(target:targetfile()))
-    end)
+    add_interception_deps()
 
 -- 测试：虚拟按键检测器
 target("test_virtual_unit")
     set_kind("binary")
     add_files("test/test_virtual_unit.cpp", "src/virtual_key_detector.cpp")
-    add_syslinks("user32")
-    after_build(function (target)
-        os.cp("lib/interception.dll", path.directory(target:targetfile()))
-    end)
+    add_interception_deps()
+target_end()
+end
 
 -- 测试：配置文件按键映射（单元测试）
 target("test_config_unit")
     set_kind("binary")
-    add_files("test/test_config_unit.cpp", "src/config.cpp")
-    add_syslinks("user32", "shell32")
+    add_files("test/test_config_unit.cpp", "src/config.cpp", "src/logger.cpp")
+    add_win32_deps()
 
 -- 测试：配置文件按键映射（属性测试 - 往返）
 target("test_config_pbt_roundtrip")
     set_kind("binary")
-    add_files("test/test_config_pbt_roundtrip.cpp", "src/config.cpp")
-    add_syslinks("user32", "shell32")
+    add_files("test/test_config_pbt_roundtrip.cpp", "src/config.cpp", "src/logger.cpp",
+              "src/property_test.cpp", "src/work_stealing_pool.cpp")
+    add_win32_deps()
 
 -- 测试：配置验证（属性测试）
 target("test_config_pbt_validation")
     set_kind("binary")
-    add_files("test/test_config_pbt_validation.cpp", "src/config.cpp")
-    add_syslinks("user32", "shell32")
+    add_files("test/test_config_pbt_validation.cpp", "src/config.cpp", "src/logger.cpp",
+              "src/property_test.cpp", "src/work_stealing_pool.cpp")
+    add_win32_deps()
+
+-- 测试：属性测试引擎（单元测试）
+target("test_property_test_unit")
+    set_kind("binary")
+    add_files("test/test_property_test_unit.cpp", "src/property_test.cpp",
+              "src/work_stealing_pool.cpp")
 
 -- 测试：物理按键检测器映射初始化（单元测试）
 target("test_physical_unit_mapping")
     set_kind("binary")
-    add_files("test/test_physical_unit_mapping.cpp", "src/physical_key_detector.cpp", "src/config.cpp")
-    add_linkdirs("lib")
-    add_links("interception")
-    add_syslinks("user32", "shell32")
-    after_build(function (target)
-        os.cp("lib/interception.dll", path.directory(target:targetfile()))
-    end)
+    add_files("test/test_physical_unit_mapping.cpp", "src/physical_key_detector.cpp", "src/config.cpp", "src/logger.cpp")
+    add_interception_deps()
 
 -- 测试：物理按键检测器映射（属性测试）
 target("test_physical_pbt_mapping")
     set_kind("binary")
-    add_files("test/test_physical_pbt_mapping.cpp", "src/physical_key_detector.cpp", "src/config.cpp")
-    add_linkdirs("lib")
-    add_links("interception")
-    add_syslinks("user32", "shell32")
-    after_build(function (target)
-        os.cp("lib/interception.dll", path.directory(target:targetfile()))
-    end)
+    add_files("test/test_physical_pbt_mapping.cpp", "src/physical_key_detector.cpp", "src/config.cpp", "src/logger.cpp",
+              "src/property_test.cpp", "src/work_stealing_pool.cpp")
+    add_interception_deps()
 
 -- 测试：物理按键事件处理（单元测试）
 target("test_physical_unit_events")
     set_kind("binary")
-    add_files("test/test_physical_unit_events.cpp", "src/physical_key_detector.cpp", "src/config.cpp")
-    add_linkdirs("lib")
-    add_links("interception")
-    add_syslinks("user32", "shell32")
-    after_build(function (target)
-        os.cp("lib/interception.dll", path.directory(target:targetfile()))
-    end)
+    add_files("test/test_physical_unit_events.cpp", "src/physical_key_detector.cpp", "src/config.cpp", "src/logger.cpp")
+    add_interception_deps()
 
 -- 测试：物理按键事件处理（属性测试）
 target("test_physical_pbt_events")
     set_kind("binary")
-    add_files("test/test_physical_pbt_events.cpp", "src/physical_key_detector.cpp", "src/config.cpp")
-    add_linkdirs("lib")
-    add_links("interception")
-    add_syslinks("user32", "shell32")
-    after_build(function (target)
-        os.cp("lib/interception.dll", path.directory(target:targetfile()))
-    end)
+    add_files("test/test_physical_pbt_events.cpp", "src/physical_key_detector.cpp", "src/config.cpp", "src/logger.cpp",
+              "src/property_test.cpp", "src/work_stealing_pool.cpp")
+    add_interception_deps()
 
 -- 测试：集成测试
 target("test_integration_unit")
     set_kind("binary")
-    add_files("test/test_integration_unit.cpp", "src/config.cpp", "src/physical_key_detector.cpp",
-              "src/virtual_key_detector.cpp", "src/modifier_key_fixer.cpp")
-    add_linkdirs("lib")
-    add_links("interception")
-    add_syslinks("user32", "shell32")
-    after_build(function (target)
-        os.cp("lib/interception.dll", path.directory(target:targetfile()))
+    add_files("test/test_integration_unit.cpp", "src/config.cpp", "src/logger.cpp", "src/physical_key_detector.cpp",
+              "src/virtual_key_detector.cpp", "src/modifier_key_fixer.cpp",
+              "src/fix_logic.cpp", "src/latency_histogram.cpp",
+              "src/stage_timers.cpp", "src/trace_writer.cpp",
+              "src/trace_format.cpp",
+              "src/stroke_recorder.cpp",
+              "src/flight_recorder.cpp", "src/shadow_policy.cpp",
+              "src/quantile_estimator.cpp")
+    add_interception_deps()
+
+-- 测试：转发延迟直方图（单元测试）
+target("test_latency_histogram_unit")
+    set_kind("binary")
+    add_files("test/test_latency_histogram_unit.cpp", "src/latency_histogram.cpp")
+
+-- 测试：热路径阶段计时（单元测试）
+target("test_stage_timers_unit")
+    set_kind("binary")
+    add_files("test/test_stage_timers_unit.cpp", "src/stage_timers.cpp",
+              "src/latency_histogram.cpp", "src/trace_writer.cpp")
+
+-- 测试：启动阶段计时（单元测试）
+target("test_startup_timer_unit")
+    set_kind("binary")
+    add_files("test/test_startup_timer_unit.cpp", "src/startup_timer.cpp",
+              "src/latency_histogram.cpp")
+
+-- 测试：Chrome/Perfetto 跟踪导出（单元测试）
+target("test_trace_writer_unit")
+    set_kind("binary")
+    add_files("test/test_trace_writer_unit.cpp", "src/trace_writer.cpp")
+
+-- 测试：异步日志（单元测试）
+target("test_logger_unit")
+    set_kind("binary")
+    add_files("test/test_logger_unit.cpp", "src/logger.cpp")
+
+-- 测试：二进制按键记录（单元测试）
+target("test_stroke_recorder_unit")
+    set_kind("binary")
+    add_files("test/test_stroke_recorder_unit.cpp", "src/stroke_recorder.cpp",
+              "src/trace_format.cpp")
+
+-- 测试：离线记录分析与工作窃取线程池（单元测试）
+target("test_trace_analysis_unit")
+    set_kind("binary")
+    add_files("test/test_trace_analysis_unit.cpp", "src/trace_analysis.cpp",
+              "src/work_stealing_pool.cpp", "src/trace_format.cpp",
+              "src/latency_histogram.cpp")
+
+-- 测试：内存飞行记录器与转储（单元测试）
+target("test_flight_recorder_unit")
+    set_kind("binary")
+    add_files("test/test_flight_recorder_unit.cpp", "src/flight_recorder.cpp",
+              "src/trace_format.cpp", "src/config.cpp", "src/logger.cpp")
+    add_win32_deps()
+
+-- 测试：影子修复策略（单元测试）
+target("test_shadow_policy_unit")
+    set_kind("binary")
+    add_files("test/test_shadow_policy_unit.cpp", "src/shadow_policy.cpp",
+              "src/fix_logic.cpp", "src/physical_key_detector.cpp",
+              "src/virtual_key_detector.cpp", "src/config.cpp", "src/logger.cpp",
+              "src/latency_histogram.cpp",
+              "src/quantile_estimator.cpp")
+    add_win32_deps()
+
+-- 测试：虚拟时间仿真器（单元测试）
+target("test_simulator_unit")
+    set_kind("binary")
+    add_files("test/test_simulator_unit.cpp", "src/simulator.cpp",
+              "src/fix_logic.cpp", "src/physical_key_detector.cpp",
+              "src/virtual_key_detector.cpp", "src/config.cpp", "src/logger.cpp",
+              "src/latency_histogram.cpp", "src/trace_format.cpp",
+              "src/quantile_estimator.cpp")
+    add_win32_deps()
+
+-- 测试：修复策略参数扫描（单元测试）
+target("test_policy_sweep_unit")
+    set_kind("binary")
+    add_files("test/test_policy_sweep_unit.cpp", "src/policy_sweep.cpp",
+              "src/work_stealing_pool.cpp", "src/simulator.cpp",
+              "src/fix_logic.cpp", "src/physical_key_detector.cpp",
+              "src/virtual_key_detector.cpp", "src/config.cpp", "src/logger.cpp",
+              "src/latency_histogram.cpp", "src/trace_format.cpp",
+              "src/quantile_estimator.cpp")
+    add_win32_deps()
+
+-- 测试：对照参考实现的差分测试（单元测试）
+target("test_differential_unit")
+    set_kind("binary")
+    add_files("test/test_differential_unit.cpp", "src/differential.cpp",
+              "src/reference_fixer.cpp", "src/work_stealing_pool.cpp",
+              "src/simulator.cpp", "src/fix_logic.cpp",
+              "src/physical_key_detector.cpp", "src/virtual_key_detector.cpp",
+              "src/config.cpp", "src/logger.cpp", "src/latency_histogram.cpp",
+              "src/trace_format.cpp",
+              "src/quantile_estimator.cpp")
+    add_win32_deps()
+
+-- 测试：场景语言与 scenarios/ 中的回归场景（单元测试）
+target("test_scenario_unit")
+    set_kind("binary")
+    add_files("test/test_scenario_unit.cpp", "src/scenario.cpp",
+              "src/fix_logic.cpp", "src/physical_key_detector.cpp",
+              "src/virtual_key_detector.cpp", "src/config.cpp", "src/logger.cpp",
+              "src/latency_histogram.cpp",
+              "src/quantile_estimator.cpp")
+    add_defines("ESCMODKEY_SCENARIO_DIR=\"$(projectdir)/scenarios\"")
+    add_win32_deps()
+
+-- 测试：录制按键的计时回放（单元测试）
+target("test_trace_replay_unit")
+    set_kind("binary")
+    add_files("test/test_trace_replay_unit.cpp", "src/trace_replay.cpp",
+              "src/simulator.cpp", "src/modifier_key_fixer.cpp",
+              "src/fix_logic.cpp", "src/physical_key_detector.cpp",
+              "src/virtual_key_detector.cpp", "src/config.cpp",
+              "src/logger.cpp", "src/latency_histogram.cpp",
+              "src/stage_timers.cpp", "src/trace_writer.cpp",
+              "src/trace_format.cpp", "src/stroke_recorder.cpp",
+              "src/flight_recorder.cpp", "src/shadow_policy.cpp",
+              "src/quantile_estimator.cpp")
+    add_win32_deps()
+
+-- 测试：P² 流式分位数估计（单元测试）
+target("test_quantile_estimator_unit")
+    set_kind("binary")
+    add_files("test/test_quantile_estimator_unit.cpp",
+              "src/quantile_estimator.cpp")
+    add_win32_deps()
+
+-- 测试：修复逻辑与可注入时钟（单元测试）
+target("test_fix_logic_unit")
+    set_kind("binary")
+    add_files("test/test_fix_logic_unit.cpp", "src/fix_logic.cpp",
+              "src/physical_key_detector.cpp", "src/virtual_key_detector.cpp",
+              "src/config.cpp", "src/logger.cpp", "src/latency_histogram.cpp",
+              "src/quantile_estimator.cpp")
+    add_win32_deps()
+
+-- 测试：在假驱动上端到端运行 ModifierKeyFixer（仅非 Windows 平台）
+if not is_plat("windows", "mingw") then
+target("test_fake_driver_unit")
+    set_kind("binary")
+    add_files("test/test_fake_driver_unit.cpp", "src/modifier_key_fixer.cpp",
+              "src/fix_logic.cpp", "src/physical_key_detector.cpp",
+              "src/virtual_key_detector.cpp", "src/config.cpp", "src/logger.cpp",
+              "src/latency_histogram.cpp", "src/stage_timers.cpp",
+              "src/trace_writer.cpp", "src/trace_format.cpp",
+              "src/stroke_recorder.cpp",
+              "src/flight_recorder.cpp", "src/shadow_policy.cpp",
+              "src/quantile_estimator.cpp")
+    add_deps("fake_interception")
+target_end()
+end
+
+-- 测试：合成负载生成器（仅非 Windows 平台）
+if not is_plat("windows", "mingw") then
+target("test_load_generator_unit")
+    set_kind("binary")
+    add_files("test/test_load_generator_unit.cpp", "src/load_generator.cpp",
+              "src/modifier_key_fixer.cpp",
+              "src/fix_logic.cpp", "src/physical_key_detector.cpp",
+              "src/virtual_key_detector.cpp", "src/config.cpp", "src/logger.cpp",
+              "src/latency_histogram.cpp", "src/stage_timers.cpp",
+              "src/trace_writer.cpp", "src/trace_format.cpp",
+              "src/stroke_recorder.cpp",
+              "src/flight_recorder.cpp", "src/shadow_policy.cpp",
+              "src/quantile_estimator.cpp")
+    add_deps("fake_interception")
+target_end()
+end
+
+-- 测试：稳态事件循环零堆分配（计数分配器，仅非 Windows 平台）
+if not is_plat("windows", "mingw") then
+target("test_zero_alloc_unit")
+    set_kind("binary")
+    add_files("test/test_zero_alloc_unit.cpp", "src/load_generator.cpp",
+              "src/modifier_key_fixer.cpp",
+              "src/fix_logic.cpp", "src/physical_key_detector.cpp",
+              "src/virtual_key_detector.cpp", "src/config.cpp", "src/logger.cpp",
+              "src/latency_histogram.cpp", "src/stage_timers.cpp",
+              "src/trace_writer.cpp", "src/trace_format.cpp",
+              "src/stroke_recorder.cpp",
+              "src/flight_recorder.cpp", "src/shadow_policy.cpp",
+              "src/quantile_estimator.cpp")
+    add_deps("fake_interception")
+target_end()
+end
+
+-- 基准：检测器与修复器热路径微基准（JSON 输出，可与基线比较）
+target("bench_hot_paths")
+    set_kind("binary")
+    set_default(false)
+    add_files("bench/bench_hot_paths.cpp", "bench/bench_harness.cpp",
+              "src/fix_logic.cpp", "src/physical_key_detector.cpp",
+              "src/virtual_key_detector.cpp", "src/config.cpp", "src/logger.cpp",
+              "src/latency_histogram.cpp",
+              "src/quantile_estimator.cpp")
+    add_win32_deps()
+
+-- 基准：FixerCore 静态分派与生产路径的每次按键开销（仅非 Windows 平台）
+if not is_plat("windows", "mingw") then
+target("bench_fixer_core")
+    set_kind("binary")
+    set_default(false)
+    add_files("bench/bench_fixer_core.cpp", "src/modifier_key_fixer.cpp",
+              "src/fix_logic.cpp", "src/physical_key_detector.cpp",
+              "src/virtual_key_detector.cpp", "src/config.cpp", "src/logger.cpp",
+              "src/latency_histogram.cpp", "src/stage_timers.cpp",
+              "src/trace_writer.cpp", "src/trace_format.cpp",
+              "src/stroke_recorder.cpp",
+              "src/flight_recorder.cpp", "src/shadow_policy.cpp",
+              "src/quantile_estimator.cpp")
+    add_deps("fake_interception")
+target_end()
+end
+
+-- 基准：GUI 启动序列到拦截生效的时间，串行与快速启动对比（仅非 Windows 平台）
+if not is_plat("windows", "mingw") then
+target("bench_startup")
+    set_kind("binary")
+    set_default(false)
+    add_files("bench/bench_startup.cpp", "bench/bench_harness.cpp",
+              "src/startup_timer.cpp", "src/modifier_key_fixer.cpp",
+              "src/fix_logic.cpp", "src/physical_key_detector.cpp",
+              "src/virtual_key_detector.cpp", "src/config.cpp", "src/logger.cpp",
+              "src/latency_histogram.cpp", "src/stage_timers.cpp",
+              "src/trace_writer.cpp", "src/trace_format.cpp",
+              "src/stroke_recorder.cpp",
+              "src/flight_recorder.cpp", "src/shadow_policy.cpp",
+              "src/quantile_estimator.cpp")
+    add_deps("fake_interception")
+target_end()
+end
+
+-- xmake pgo：普通 release 构建并测基线 → 插桩构建 → 用录制的按键回放训练
+-- → PGO+LTO 重新构建 escModKey/escModKey_gui → 与基线对比（仅 Windows）。
+-- 回放运行发布版本的事件循环（ModifierKeyFixer），训练和对比都覆盖 processEvents
+task("pgo")
+    set_category("plugin")
+    on_run(function ()
+        import("core.base.option")
+        import("lib.detect.find_tool")
+
+        if not is_host("windows") then
+            raise("xmake pgo builds escModKey and escModKey_gui, which need Windows")
+        end
+
+        local corpus = option.get("corpus")
+        local passes = option.get("passes")
+        local dir = path.join(os.projectdir(), "build", "pgo")
+        local targets = {"escModKey", "escModKey_gui"}
+
+        -- 没有录制的按键时用仿真器生成（分支分布不如真实录制有代表性）
+        if #os.files(path.join(corpus, "*.emkt")) == 0 then
+            cprint("${yellow}no recorded traces in %s, generating a synthetic corpus", corpus)
+            corpus = path.join(dir, "corpus")
+            os.tryrm(corpus)
+            os.mkdir(corpus)
+            os.exec("xmake f -m release --pgo=off")
+            os.exec("xmake build escModKey_sim")
+            local generated = {
+                {"typing", "--gap 120 --chords 0.3"},
+                {"chords", "--gap 60 --chords 0.7"},
+                {"fast", "--gap 30 --chords 0.2"}}
+            for i, trace in ipairs(generated) do
+                os.execv("xmake", table.join({"run", "escModKey_sim", "--quiet",
+                    "--generate", "200000", "--seed", tostring(i),
+                    "--save", path.join(corpus, trace[1] .. ".emkt")},
+                    trace[2]:split(" ")))
+            end
+        end
+
+        local function replay(target)
+            local output = os.iorunv("xmake", {"run", target, "--replay",
+                "--passes", passes, corpus})
+            local ns = output:match("median ([%d%.]+) ns/stroke")
+            if not ns then
+                raise("unexpected replay output: %s", output)
+            end
+            return tonumber(ns)
+        end
+
+        -- 1. 普通 release 基线
+        os.exec("xmake f -m release --pgo=off")
+        os.exec("xmake build escModKey")
+        local baseline = replay("escModKey")
+
+        -- 2. 插桩构建并训练两个程序
+        os.tryrm(dir .. "/*.pgd")
+        os.tryrm(dir .. "/*.pgc")
+        os.tryrm(dir .. "/*.profraw")
+        os.tryrm(dir .. "/*.profdata")
+        os.tryrm(dir .. "/*.gcda")
+        os.mkdir(dir)
+        os.exec("xmake f -m release --pgo=instrument")
+        os.exec("xmake build " .. table.concat(targets, " "))
+        os.setenv("VCPROFILE_PATH", dir)
+        for _, target in ipairs(targets) do
+            os.setenv("LLVM_PROFILE_FILE",
+                      path.join(dir, target .. "-%p.profraw"))
+            os.execv("xmake", {"run", target, "--replay", corpus})
+            local raw = os.files(path.join(dir, target .. "-*.profraw"))
+            if #raw > 0 then
+                local profdata = find_tool("llvm-profdata")
+                if not profdata then
+                    raise("llvm-profdata not found")
+                end
+                os.execv(profdata.program, table.join({"merge", "-o",
+                    path.join(dir, target .. ".profdata")}, raw))
+            end
+        end
+
+        -- 3. 用收集的配置文件重新构建
+        os.exec("xmake f -m release --pgo=optimize")
+        os.exec("xmake build " .. table.concat(targets, " "))
+        local optimized = replay("escModKey")
+
+        print("replay over %s (%s passes, median ns/stroke):", corpus, passes)
+        print("  release  %8.1f", baseline)
+        print("  pgo+lto  %8.1f  (%+.1f%%)", optimized,
+              (optimized - baseline) / baseline * 100)
     end)
+    set_menu {
+        usage = "xmake pgo [options]",
+        description = "Build escModKey and escModKey_gui with PGO and LTO trained on recorded traces",
+        options = {
+            {nil, "corpus", "kv", "pgo/traces", "Directory of recorded traces (*.emkt)"},
+            {nil, "passes", "kv", "10", "Timed replay passes for the comparison"}
+        }
+    }
+task_end()